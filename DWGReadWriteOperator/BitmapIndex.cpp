@@ -0,0 +1,765 @@
+#include "BitmapIndex.h"
+#include <algorithm>
+#include <iterator>
+#include <string.h>
+
+namespace UserFiles
+{
+	namespace
+	{
+		// λͼ65536 λ
+		const size_t BITMAPWORDS = 1024;
+
+		// лʱ
+		enum
+		{
+			kContainerArray = 0,
+			kContainerBitmap = 1
+		};
+
+		// лʱͷ
+		struct ContainerHeader
+		{
+			uint16_t nKey;
+			uint16_t nType;
+			uint32_t nCard;
+		};
+
+		// ͳλ
+		uint32_t PopCount(uint64_t n)
+		{
+			n = n - ((n >> 1) & 0x5555555555555555ULL);
+			n = (n & 0x3333333333333333ULL) + ((n >> 2) & 0x3333333333333333ULL);
+			n = (n + (n >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+			return (uint32_t)((n * 0x0101010101010101ULL) >> 56);
+		}
+
+		void AppendBytes(std::vector<char>& vecOut, const void* p, size_t nSize)
+		{
+			if (nSize)
+			{
+				vecOut.insert(vecOut.end(), (const char*)p, (const char*)p + nSize);
+			}
+		}
+
+		bool EntryLess(const BitmapEntry& a, const BitmapEntry& b)
+		{
+			return a.nField != b.nField ? a.nField < b.nField : a.nValue < b.nValue;
+		}
+
+		bool FieldLess(const BitmapEntry& a, const BitmapEntry& b)
+		{
+			return a.nField < b.nField;
+		}
+	}
+
+	// תΪλͼ
+	void Bitmap::ToBitmap(Container& c)
+	{
+		if (c.IsBitmap())
+		{
+			return;
+		}
+		c.vecBits.assign(BITMAPWORDS, 0);
+		for (size_t i = 0; i < c.vecArray.size(); i++)
+		{
+			c.vecBits[c.vecArray[i] >> 6] |= (uint64_t)1 << (c.vecArray[i] & 63);
+		}
+		c.nCard = (uint32_t)c.vecArray.size();
+		std::vector<uint16_t>().swap(c.vecArray);
+	}
+
+	// ¼ԪظλͼԪʱתΪ
+	void Bitmap::Normalize(Container& c)
+	{
+		if (!c.IsBitmap())
+		{
+			c.nCard = (uint32_t)c.vecArray.size();
+			if (c.nCard > BITMAPARRAYMAX)
+			{
+				ToBitmap(c);
+			}
+			return;
+		}
+
+		uint32_t nCard = 0;
+		for (size_t i = 0; i < BITMAPWORDS; i++)
+		{
+			nCard += PopCount(c.vecBits[i]);
+		}
+		c.nCard = nCard;
+		if (nCard > BITMAPARRAYMAX)
+		{
+			return;
+		}
+
+		c.vecArray.clear();
+		c.vecArray.reserve(nCard);
+		for (size_t i = 0; i < BITMAPWORDS; i++)
+		{
+			for (uint64_t w = c.vecBits[i]; w; w &= w - 1)
+			{
+				c.vecArray.push_back((uint16_t)(i * 64 + PopCount((w & (0 - w)) - 1)));
+			}
+		}
+		std::vector<uint64_t>().swap(c.vecBits);
+	}
+
+	// 
+	Bitmap::Container Bitmap::AndContainer(const Container& a, const Container& b)
+	{
+		Container c;
+		c.nKey = a.nKey;
+		if (a.IsBitmap() && b.IsBitmap())
+		{
+			c.vecBits.resize(BITMAPWORDS);
+			for (size_t i = 0; i < BITMAPWORDS; i++)
+			{
+				c.vecBits[i] = a.vecBits[i] & b.vecBits[i];
+			}
+		}
+		else if (a.IsBitmap() || b.IsBitmap())
+		{
+			const Container& arr = a.IsBitmap() ? b : a;
+			const Container& bits = a.IsBitmap() ? a : b;
+			for (size_t i = 0; i < arr.vecArray.size(); i++)
+			{
+				uint16_t n = arr.vecArray[i];
+				if (bits.vecBits[n >> 6] & ((uint64_t)1 << (n & 63)))
+				{
+					c.vecArray.push_back(n);
+				}
+			}
+		}
+		else
+		{
+			std::set_intersection(a.vecArray.begin(), a.vecArray.end(), b.vecArray.begin(), b.vecArray.end(),
+				std::back_inserter(c.vecArray));
+		}
+		Normalize(c);
+		return c;
+	}
+
+	// 
+	Bitmap::Container Bitmap::OrContainer(const Container& a, const Container& b)
+	{
+		Container c;
+		c.nKey = a.nKey;
+		if (!a.IsBitmap() && !b.IsBitmap())
+		{
+			std::set_union(a.vecArray.begin(), a.vecArray.end(), b.vecArray.begin(), b.vecArray.end(),
+				std::back_inserter(c.vecArray));
+		}
+		else
+		{
+			const Container& other = a.IsBitmap() ? b : a;
+			c.vecBits = a.IsBitmap() ? a.vecBits : b.vecBits;
+			if (other.IsBitmap())
+			{
+				for (size_t i = 0; i < BITMAPWORDS; i++)
+				{
+					c.vecBits[i] |= other.vecBits[i];
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < other.vecArray.size(); i++)
+				{
+					c.vecBits[other.vecArray[i] >> 6] |= (uint64_t)1 << (other.vecArray[i] & 63);
+				}
+			}
+		}
+		Normalize(c);
+		return c;
+	}
+
+	// 
+	Bitmap::Container Bitmap::AndNotContainer(const Container& a, const Container& b)
+	{
+		Container c;
+		c.nKey = a.nKey;
+		if (!a.IsBitmap())
+		{
+			if (b.IsBitmap())
+			{
+				for (size_t i = 0; i < a.vecArray.size(); i++)
+				{
+					uint16_t n = a.vecArray[i];
+					if (!(b.vecBits[n >> 6] & ((uint64_t)1 << (n & 63))))
+					{
+						c.vecArray.push_back(n);
+					}
+				}
+			}
+			else
+			{
+				std::set_difference(a.vecArray.begin(), a.vecArray.end(), b.vecArray.begin(), b.vecArray.end(),
+					std::back_inserter(c.vecArray));
+			}
+		}
+		else
+		{
+			c.vecBits = a.vecBits;
+			if (b.IsBitmap())
+			{
+				for (size_t i = 0; i < BITMAPWORDS; i++)
+				{
+					c.vecBits[i] &= ~b.vecBits[i];
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < b.vecArray.size(); i++)
+				{
+					c.vecBits[b.vecArray[i] >> 6] &= ~((uint64_t)1 << (b.vecArray[i] & 63));
+				}
+			}
+		}
+		Normalize(c);
+		return c;
+	}
+
+	// [nBegin, nEnd) ȫλ
+	Bitmap Bitmap::Range(uint32_t nBegin, uint32_t nEnd)
+	{
+		Bitmap result;
+		if (nBegin >= nEnd)
+		{
+			return result;
+		}
+		uint32_t nLast = nEnd - 1;
+		for (uint32_t nKey = nBegin >> 16; nKey <= (nLast >> 16); nKey++)
+		{
+			uint32_t nLow = nKey == (nBegin >> 16) ? (nBegin & 0xFFFF) : 0;
+			uint32_t nHigh = nKey == (nLast >> 16) ? (nLast & 0xFFFF) : 0xFFFF;
+
+			Container c;
+			c.nKey = (uint16_t)nKey;
+			c.vecBits.assign(BITMAPWORDS, 0);
+			for (uint32_t i = nLow >> 6; i <= (nHigh >> 6); i++)
+			{
+				uint64_t w = ~(uint64_t)0;
+				if (i == (nLow >> 6))
+				{
+					w &= ~(uint64_t)0 << (nLow & 63);
+				}
+				if (i == (nHigh >> 6) && (nHigh & 63) != 63)
+				{
+					w &= ((uint64_t)1 << ((nHigh & 63) + 1)) - 1;
+				}
+				c.vecBits[i] = w;
+			}
+			Normalize(c);
+			result.m_vecContainers.push_back(c);
+		}
+		return result;
+	}
+
+	// Ԫ
+	void Bitmap::Add(uint32_t n)
+	{
+		uint16_t nKey = (uint16_t)(n >> 16);
+		uint16_t nLow = (uint16_t)(n & 0xFFFF);
+
+		// ʱһ
+		Container* pContainer = NULL;
+		if (m_vecContainers.empty() || m_vecContainers.back().nKey < nKey)
+		{
+			m_vecContainers.push_back(Container());
+			pContainer = &m_vecContainers.back();
+			pContainer->nKey = nKey;
+			pContainer->nCard = 0;
+		}
+		else if (m_vecContainers.back().nKey == nKey)
+		{
+			pContainer = &m_vecContainers.back();
+		}
+		else
+		{
+			std::vector<Container>::iterator it = m_vecContainers.begin();
+			size_t nCount = m_vecContainers.size();
+			while (nCount > 0)
+			{
+				size_t nStep = nCount / 2;
+				if ((it + nStep)->nKey < nKey)
+				{
+					it += nStep + 1;
+					nCount -= nStep + 1;
+				}
+				else
+				{
+					nCount = nStep;
+				}
+			}
+			if (it->nKey != nKey)
+			{
+				it = m_vecContainers.insert(it, Container());
+				it->nKey = nKey;
+				it->nCard = 0;
+			}
+			pContainer = &*it;
+		}
+
+		Container& c = *pContainer;
+		if (c.IsBitmap())
+		{
+			uint64_t nBit = (uint64_t)1 << (nLow & 63);
+			if (!(c.vecBits[nLow >> 6] & nBit))
+			{
+				c.vecBits[nLow >> 6] |= nBit;
+				c.nCard++;
+			}
+			return;
+		}
+
+		if (c.vecArray.empty() || c.vecArray.back() < nLow)
+		{
+			c.vecArray.push_back(nLow);
+		}
+		else
+		{
+			std::vector<uint16_t>::iterator it = std::lower_bound(c.vecArray.begin(), c.vecArray.end(), nLow);
+			if (*it == nLow)
+			{
+				return;
+			}
+			c.vecArray.insert(it, nLow);
+		}
+		c.nCard = (uint32_t)c.vecArray.size();
+		if (c.nCard > BITMAPARRAYMAX)
+		{
+			ToBitmap(c);
+		}
+	}
+
+	// Ƿ
+	bool Bitmap::Contains(uint32_t n) const
+	{
+		uint16_t nKey = (uint16_t)(n >> 16);
+		uint16_t nLow = (uint16_t)(n & 0xFFFF);
+		for (size_t nBegin = 0, nEnd = m_vecContainers.size(); nBegin < nEnd;)
+		{
+			size_t nMid = (nBegin + nEnd) / 2;
+			const Container& c = m_vecContainers[nMid];
+			if (c.nKey < nKey)
+			{
+				nBegin = nMid + 1;
+			}
+			else if (c.nKey > nKey)
+			{
+				nEnd = nMid;
+			}
+			else if (c.IsBitmap())
+			{
+				return (c.vecBits[nLow >> 6] & ((uint64_t)1 << (nLow & 63))) != 0;
+			}
+			else
+			{
+				return std::binary_search(c.vecArray.begin(), c.vecArray.end(), nLow);
+			}
+		}
+		return false;
+	}
+
+	// Ԫظ
+	uint64_t Bitmap::Cardinality() const
+	{
+		uint64_t nCard = 0;
+		for (size_t i = 0; i < m_vecContainers.size(); i++)
+		{
+			nCard += m_vecContainers[i].nCard;
+		}
+		return nCard;
+	}
+
+	// 
+	Bitmap Bitmap::And(const Bitmap& other) const
+	{
+		Bitmap result;
+		size_t i = 0, j = 0;
+		while (i < m_vecContainers.size() && j < other.m_vecContainers.size())
+		{
+			const Container& a = m_vecContainers[i];
+			const Container& b = other.m_vecContainers[j];
+			if (a.nKey < b.nKey)
+			{
+				i++;
+			}
+			else if (a.nKey > b.nKey)
+			{
+				j++;
+			}
+			else
+			{
+				Container c = AndContainer(a, b);
+				if (c.nCard)
+				{
+					result.m_vecContainers.push_back(c);
+				}
+				i++;
+				j++;
+			}
+		}
+		return result;
+	}
+
+	// 
+	Bitmap Bitmap::Or(const Bitmap& other) const
+	{
+		Bitmap result;
+		size_t i = 0, j = 0;
+		while (i < m_vecContainers.size() || j < other.m_vecContainers.size())
+		{
+			if (j == other.m_vecContainers.size()
+				|| (i < m_vecContainers.size() && m_vecContainers[i].nKey < other.m_vecContainers[j].nKey))
+			{
+				result.m_vecContainers.push_back(m_vecContainers[i++]);
+			}
+			else if (i == m_vecContainers.size() || m_vecContainers[i].nKey > other.m_vecContainers[j].nKey)
+			{
+				result.m_vecContainers.push_back(other.m_vecContainers[j++]);
+			}
+			else
+			{
+				result.m_vecContainers.push_back(OrContainer(m_vecContainers[i++], other.m_vecContainers[j++]));
+			}
+		}
+		return result;
+	}
+
+	// 
+	Bitmap Bitmap::AndNot(const Bitmap& other) const
+	{
+		Bitmap result;
+		size_t j = 0;
+		for (size_t i = 0; i < m_vecContainers.size(); i++)
+		{
+			const Container& a = m_vecContainers[i];
+			while (j < other.m_vecContainers.size() && other.m_vecContainers[j].nKey < a.nKey)
+			{
+				j++;
+			}
+			if (j == other.m_vecContainers.size() || other.m_vecContainers[j].nKey != a.nKey)
+			{
+				result.m_vecContainers.push_back(a);
+				continue;
+			}
+			Container c = AndNotContainer(a, other.m_vecContainers[j]);
+			if (c.nCard)
+			{
+				result.m_vecContainers.push_back(c);
+			}
+		}
+		return result;
+	}
+
+	// 
+	Bitmap Bitmap::Not(uint32_t nUniverse) const
+	{
+		return Range(0, nUniverse).AndNot(*this);
+	}
+
+	// Ԫ
+	void Bitmap::ToVector(std::vector<uint32_t>& vecResult) const
+	{
+		vecResult.reserve(vecResult.size() + (size_t)Cardinality());
+		for (size_t i = 0; i < m_vecContainers.size(); i++)
+		{
+			const Container& c = m_vecContainers[i];
+			uint32_t nHigh = (uint32_t)c.nKey << 16;
+			if (!c.IsBitmap())
+			{
+				for (size_t k = 0; k < c.vecArray.size(); k++)
+				{
+					vecResult.push_back(nHigh | c.vecArray[k]);
+				}
+				continue;
+			}
+			for (size_t k = 0; k < BITMAPWORDS; k++)
+			{
+				for (uint64_t w = c.vecBits[k]; w; w &= w - 1)
+				{
+					vecResult.push_back(nHigh | (uint32_t)(k * 64 + PopCount((w & (0 - w)) - 1)));
+				}
+			}
+		}
+	}
+
+	// лȻÿͷ
+	void Bitmap::Write(std::vector<char>& vecOut) const
+	{
+		uint32_t nContainers = (uint32_t)m_vecContainers.size();
+		AppendBytes(vecOut, &nContainers, sizeof(nContainers));
+		for (size_t i = 0; i < m_vecContainers.size(); i++)
+		{
+			const Container& c = m_vecContainers[i];
+			ContainerHeader header;
+			header.nKey = c.nKey;
+			header.nType = c.IsBitmap() ? kContainerBitmap : kContainerArray;
+			header.nCard = c.nCard;
+			AppendBytes(vecOut, &header, sizeof(header));
+			if (c.IsBitmap())
+			{
+				AppendBytes(vecOut, &c.vecBits[0], BITMAPWORDS * sizeof(uint64_t));
+			}
+			else
+			{
+				AppendBytes(vecOut, c.vecArray.empty() ? NULL : &c.vecArray[0], c.vecArray.size() * sizeof(uint16_t));
+			}
+		}
+	}
+
+	// лݲʱ false
+	bool Bitmap::Read(const char* pData, uint64_t nSize)
+	{
+		m_vecContainers.clear();
+
+		uint32_t nContainers = 0;
+		if (nSize < sizeof(nContainers))
+		{
+			return false;
+		}
+		memcpy(&nContainers, pData, sizeof(nContainers));
+		uint64_t nPos = sizeof(nContainers);
+
+		m_vecContainers.reserve(nContainers);
+		for (uint32_t i = 0; i < nContainers; i++)
+		{
+			ContainerHeader header;
+			if (nSize - nPos < sizeof(header))
+			{
+				m_vecContainers.clear();
+				return false;
+			}
+			memcpy(&header, pData + nPos, sizeof(header));
+			nPos += sizeof(header);
+			if (!m_vecContainers.empty() && header.nKey <= m_vecContainers.back().nKey)
+			{
+				m_vecContainers.clear();
+				return false;
+			}
+
+			Container c;
+			c.nKey = header.nKey;
+			if (header.nType == kContainerBitmap)
+			{
+				if (nSize - nPos < BITMAPWORDS * sizeof(uint64_t))
+				{
+					m_vecContainers.clear();
+					return false;
+				}
+				c.vecBits.resize(BITMAPWORDS);
+				memcpy(&c.vecBits[0], pData + nPos, BITMAPWORDS * sizeof(uint64_t));
+				nPos += BITMAPWORDS * sizeof(uint64_t);
+				Normalize(c);
+			}
+			else
+			{
+				if (header.nType != kContainerArray || header.nCard > BITMAPARRAYMAX
+					|| nSize - nPos < header.nCard * sizeof(uint16_t))
+				{
+					m_vecContainers.clear();
+					return false;
+				}
+				c.vecArray.resize(header.nCard);
+				if (header.nCard)
+				{
+					memcpy(&c.vecArray[0], pData + nPos, header.nCard * sizeof(uint16_t));
+				}
+				nPos += header.nCard * sizeof(uint16_t);
+				for (size_t k = 1; k < c.vecArray.size(); k++)
+				{
+					if (c.vecArray[k] <= c.vecArray[k - 1])
+					{
+						m_vecContainers.clear();
+						return false;
+					}
+				}
+				c.nCard = header.nCard;
+			}
+			if (c.nCard)
+			{
+				m_vecContainers.push_back(c);
+			}
+		}
+		return true;
+	}
+
+	// 
+	void BitmapIndexWriter::Clear()
+	{
+		m_nUniverse = 0;
+		m_mapBitmaps.clear();
+	}
+
+	// 
+	void BitmapIndexWriter::Add(enBitmapField enField, int32_t nValue, uint32_t nOrdinal)
+	{
+		m_mapBitmaps[std::make_pair((int)enField, nValue)].Add(nOrdinal);
+	}
+
+	// 
+	bool BitmapIndexWriter::Save(const std::string& sFile)
+	{
+		// map Ѱ (ֶ, ֵ) 
+		std::vector<BitmapEntry> vecEntries;
+		std::vector<char> vecData;
+		for (std::map<std::pair<int, int32_t>, Bitmap>::const_iterator it = m_mapBitmaps.begin(); it != m_mapBitmaps.end(); ++it)
+		{
+			BitmapEntry entry;
+			memset(&entry, 0, sizeof(entry));
+			entry.nField = (uint16_t)it->first.first;
+			entry.nValue = it->first.second;
+			entry.nOffset = vecData.size();
+			it->second.Write(vecData);
+			entry.nSize = vecData.size() - entry.nOffset;
+			vecData.resize((size_t)Align8(vecData.size()), 0);
+			vecEntries.push_back(entry);
+		}
+
+		BitmapHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.szMagic, BITMAPMAGIC, sizeof(header.szMagic));
+		header.nVersion = BITMAPVERSION;
+		header.nUniverse = m_nUniverse;
+		header.nEntries = vecEntries.size();
+		header.nEntriesOffset = Align8(sizeof(BitmapHeader));
+		header.nDataOffset = header.nEntriesOffset + Align8(vecEntries.size() * sizeof(BitmapEntry));
+		header.nDataSize = vecData.size();
+
+		SafeFileWriter out(sFile);
+		if (!out.IsOpen())
+		{
+			return false;
+		}
+		out.WritePadded(&header, sizeof(header));
+		out.WritePadded(vecEntries.empty() ? NULL : &vecEntries[0], vecEntries.size() * sizeof(BitmapEntry));
+		if (!vecData.empty())
+		{
+			out.Write(&vecData[0], vecData.size());
+		}
+		return out.Commit();
+	}
+
+	BitmapIndex::BitmapIndex()
+		: m_pHeader(NULL)
+		, m_pEntries(NULL)
+	{
+	}
+
+	BitmapIndex::~BitmapIndex()
+	{
+		Close();
+	}
+
+	// ļ
+	bool BitmapIndex::Open(const std::string& sFile)
+	{
+		Close();
+
+		if (!m_file.Open(sFile) || m_file.Size() < sizeof(BitmapHeader))
+		{
+			Close();
+			return false;
+		}
+
+		// Уļͷ͸ηΧ
+		uint64_t nSize = m_file.Size();
+		const BitmapHeader* pHeader = (const BitmapHeader*)m_file.Data();
+		if (memcmp(pHeader->szMagic, BITMAPMAGIC, sizeof(pHeader->szMagic)) != 0
+			|| pHeader->nVersion != BITMAPVERSION
+			|| pHeader->nEntriesOffset % 8
+			|| pHeader->nEntries > nSize / sizeof(BitmapEntry)
+			|| pHeader->nEntriesOffset + pHeader->nEntries * sizeof(BitmapEntry) > nSize
+			|| pHeader->nDataOffset > nSize
+			|| pHeader->nDataSize > nSize - pHeader->nDataOffset)
+		{
+			Close();
+			return false;
+		}
+
+		m_pHeader = pHeader;
+		m_pEntries = (const BitmapEntry*)(m_file.Data() + pHeader->nEntriesOffset);
+		return true;
+	}
+
+	// رļ
+	void BitmapIndex::Close()
+	{
+		m_file.Close();
+		m_pHeader = NULL;
+		m_pEntries = NULL;
+	}
+
+	// ¼
+	uint32_t BitmapIndex::Universe() const
+	{
+		return m_pHeader ? m_pHeader->nUniverse : 0;
+	}
+
+	// ֶεļ¼Χ
+	void BitmapIndex::FieldRange(enBitmapField enField, const BitmapEntry*& pBegin, const BitmapEntry*& pEnd) const
+	{
+		BitmapEntry key;
+		memset(&key, 0, sizeof(key));
+		key.nField = (uint16_t)enField;
+		const BitmapEntry* pFirst = m_pEntries;
+		const BitmapEntry* pLast = m_pEntries + (m_pHeader ? m_pHeader->nEntries : 0);
+		std::pair<const BitmapEntry*, const BitmapEntry*> range = std::equal_range(pFirst, pLast, key, FieldLess);
+		pBegin = range.first;
+		pEnd = range.second;
+	}
+
+	// ֵֶӦλͼ
+	bool BitmapIndex::Get(enBitmapField enField, int32_t nValue, Bitmap& bitmap) const
+	{
+		bitmap.Clear();
+
+		const BitmapEntry* pBegin = NULL;
+		const BitmapEntry* pEnd = NULL;
+		FieldRange(enField, pBegin, pEnd);
+
+		BitmapEntry key;
+		memset(&key, 0, sizeof(key));
+		key.nField = (uint16_t)enField;
+		key.nValue = nValue;
+		const BitmapEntry* p = std::lower_bound(pBegin, pEnd, key, EntryLess);
+		if (p == pEnd || p->nValue != nValue)
+		{
+			return false;
+		}
+		if (p->nOffset > m_pHeader->nDataSize || p->nSize > m_pHeader->nDataSize - p->nOffset)
+		{
+			return false;
+		}
+		return bitmap.Read(m_file.Data() + m_pHeader->nDataOffset + p->nOffset, p->nSize);
+	}
+
+	// ֶȡһֵλͼ
+	Bitmap BitmapIndex::GetAny(enBitmapField enField, const std::vector<int32_t>& vecValues) const
+	{
+		Bitmap result;
+		Bitmap bitmap;
+		for (size_t i = 0; i < vecValues.size(); i++)
+		{
+			if (Get(enField, vecValues[i], bitmap))
+			{
+				result = result.Or(bitmap);
+			}
+		}
+		return result;
+	}
+
+	// ֶγֵֹ
+	void BitmapIndex::Values(enBitmapField enField, std::vector<int32_t>& vecValues) const
+	{
+		const BitmapEntry* pBegin = NULL;
+		const BitmapEntry* pEnd = NULL;
+		FieldRange(enField, pBegin, pEnd);
+		for (const BitmapEntry* p = pBegin; p != pEnd; p++)
+		{
+			vecValues.push_back(p->nValue);
+		}
+	}
+
+}
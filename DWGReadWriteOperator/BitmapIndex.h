@@ -0,0 +1,175 @@
+#pragma once
+
+#include "FileOperator.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+namespace UserFiles
+{
+
+// λͼļ
+#define BITMAPFILE "entities.bmi"
+// λͼļʶ
+#define BITMAPMAGIC "DWGBMIDX"
+// λͼ汾
+#define BITMAPVERSION 1
+// ԪظתΪλͼ
+#define BITMAPARRAYMAX 4096
+
+	// ֶ
+	enum enBitmapField
+	{
+		kFieldLayer = 0,     // ͼ
+		kFieldType,          // enEntityType
+		kFieldColorIndex,    // ɫ
+		kFieldLineWeight     // ߿
+	};
+
+	/*
+	* λͼļֽ֣8 ֽڶ룩
+	*   BitmapHeader
+	*   BitmapEntry[nEntries]     (ֶ, ֵ) 
+	*                      лλͼ
+	*/
+
+	// ļͷ
+	struct BitmapHeader
+	{
+		char     szMagic[8];
+		uint32_t nVersion;
+		uint32_t nUniverse;      // ¼
+		uint64_t nEntries;
+		uint64_t nEntriesOffset;
+		uint64_t nDataOffset;
+		uint64_t nDataSize;
+	};
+
+	// ֵֶӦλͼ
+	struct BitmapEntry
+	{
+		uint16_t nField;         // enBitmapField
+		uint16_t nReserved;
+		int32_t  nValue;
+		uint64_t nOffset;        // ڵƫ
+		uint64_t nSize;
+	};
+
+	/*
+	* ѹλͼRoaring ṹ 16 λֿ飬ÿԪʱ飬
+	* ʱ 65536 λλͼԪΪʵеļ¼±ꡣ
+	*/
+	class Bitmap
+	{
+	public:
+		// [nBegin, nEnd) ȫλ
+		static Bitmap Range(uint32_t nBegin, uint32_t nEnd);
+
+		// Ԫأ
+		void Add(uint32_t n);
+		// Ƿ
+		bool Contains(uint32_t n) const;
+		// Ԫظ
+		uint64_t Cardinality() const;
+		// ǷΪ
+		bool Empty() const { return m_vecContainers.empty(); }
+		// 
+		void Clear() { m_vecContainers.clear(); }
+
+		// 
+		Bitmap And(const Bitmap& other) const;
+		Bitmap Or(const Bitmap& other) const;
+		Bitmap AndNot(const Bitmap& other) const;
+		// ΧΪ [0, nUniverse)
+		Bitmap Not(uint32_t nUniverse) const;
+
+		// Ԫ
+		void ToVector(std::vector<uint32_t>& vecResult) const;
+
+		// л
+		void Write(std::vector<char>& vecOut) const;
+		bool Read(const char* pData, uint64_t nSize);
+
+	private:
+		// vecBits ǿʱΪλͼΪ
+		struct Container
+		{
+			uint16_t nKey;
+			uint32_t nCard;
+			std::vector<uint16_t> vecArray;
+			std::vector<uint64_t> vecBits;
+
+			bool IsBitmap() const { return !vecBits.empty(); }
+		};
+
+		static void ToBitmap(Container& c);
+		static void Normalize(Container& c);
+		static Container AndContainer(const Container& a, const Container& b);
+		static Container OrContainer(const Container& a, const Container& b);
+		static Container AndNotContainer(const Container& a, const Container& b);
+
+	private:
+		//  nKey 
+		std::vector<Container> m_vecContainers;
+	};
+
+	// λͼд
+	class BitmapIndexWriter
+	{
+	public:
+		BitmapIndexWriter() : m_nUniverse(0) {}
+
+		// 
+		void Clear();
+		// ¼Not ķΧ
+		void SetUniverse(uint32_t nUniverse) { m_nUniverse = nUniverse; }
+		// ӣֵֶΪ nValue ļ¼ nOrdinal
+		void Add(enBitmapField enField, int32_t nValue, uint32_t nOrdinal);
+		// 棺дʱļ滻Ŀļ
+		bool Save(const std::string& sFile);
+
+	private:
+		uint32_t m_nUniverse;
+		std::map<std::pair<int, int32_t>, Bitmap> m_mapBitmaps;
+	};
+
+	// λͼȡ
+	class BitmapIndex
+	{
+	public:
+		BitmapIndex();
+		~BitmapIndex();
+
+		// ļ
+		bool Open(const std::string& sFile);
+		// رļ
+		void Close();
+		// ǷѴ
+		bool IsOpen() const { return m_pHeader != NULL; }
+
+		// ¼
+		uint32_t Universe() const;
+		// м¼
+		Bitmap All() const { return Bitmap::Range(0, Universe()); }
+		// ֵֶӦλͼûʱ false λͼ
+		bool Get(enBitmapField enField, int32_t nValue, Bitmap& bitmap) const;
+		// ֶȡһֵλͼֵĲ
+		Bitmap GetAny(enBitmapField enField, const std::vector<int32_t>& vecValues) const;
+		// ֶγֵֹ
+		void Values(enBitmapField enField, std::vector<int32_t>& vecValues) const;
+
+	private:
+		// ֶεļ¼Χ
+		void FieldRange(enBitmapField enField, const BitmapEntry*& pBegin, const BitmapEntry*& pEnd) const;
+
+		BitmapIndex(const BitmapIndex&);
+		BitmapIndex& operator=(const BitmapIndex&);
+
+	private:
+		MappedFile m_file;
+		const BitmapHeader* m_pHeader;
+		const BitmapEntry* m_pEntries;
+	};
+
+}
@@ -10,10 +10,7 @@ int main()
     std::cout << "Hello World!\n";
 
     DWGReader reader;
-    if (reader.ReadFile("D:\\无签名版20240322.dwg"))
-    {
-        reader.VisitEntity();
-    }
+    reader.ExtractFile("D:\\无签名版20240322.dwg");
     system("pause");
 
     return 0;
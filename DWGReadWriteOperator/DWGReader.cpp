@@ -1,10 +1,201 @@
 #include "DWGReader.h"
 #include "json/json.h"
+#include <fstream>
+#include <process.h>
+
+// ODA ʼ
+void DWGReader::InitODA()
+{
+	if (m_bInitialized)
+	{
+		return;
+	}
+	odInitialize(&svcs);
+	svcs.disableOutput(true);
+	// TrueType 
+	svcs.setTtfFontIndex(svcs.getTempPath() + L"OdTtfFontIndex.bin");
+	// 첽 I/O 
+	ExAsyncIORequestHandler::initAsyncIOService();
+	m_bInitialized = true;
+}
+
+// Ŀ¼
+std::string DWGReader::GetOutputRoot()
+{
+	return UserFiles::FileOperator::GetGenFilePath() + "..\\" + ROOTDIR + "\\";
+}
+
+// ȡļ
+bool DWGReader::ExtractFile(const std::string& sFileName)
+{
+	std::string sHash;
+	bool bCache = m_cacheConfig.bEnable && GetCacheKey(sFileName, sHash);
+	if (bCache && RestoreFromCache(sHash))
+	{
+		OutPutMsg("Cache hit: " + sHash);
+		return true;
+	}
+
+	if (!ReadFile(sFileName))
+	{
+		return false;
+	}
+	m_vecOutputFiles.clear();
+	// ʱд뻺
+	if (!VisitEntity())
+	{
+		return false;
+	}
+
+	if (bCache && !SaveToCache(sHash))
+	{
+		OutPutMsg("Save cache failed: " + sHash);
+	}
+	return true;
+}
+
+// 
+bool DWGReader::GetCacheKey(const std::string& sFileName, std::string& sKey)
+{
+	if (!UserFiles::FileOperator::HashFile(sFileName, sKey))
+	{
+		return false;
+	}
+	// ʽѡ仯оɵĻ
+	char szKey[128] = { '\0' };
+	sprintf_s(szKey, "-v%d.%d.%d.%d-s%d-b%llx", CACHEVERSION, STOREVERSION, INDEXVERSION, BITMAPVERSION,
+		m_storeWriter.SpatialOrder() ? 1 : 0, (unsigned long long)svcs.memoryBudget());
+	sKey += szKey;
+	return true;
+}
+
+// ӻָ
+bool DWGReader::RestoreFromCache(const std::string& sHash)
+{
+	std::string strEntry = m_cacheConfig.strCacheDir + sHash + "\\";
+	std::ifstream inFile((strEntry + CACHEMANIFEST).c_str());
+	if (!inFile.is_open())
+	{
+		return false;
+	}
+
+	std::string strRoot = GetOutputRoot();
+	if (!UserFiles::FileOperator::DirExist(strRoot))
+	{
+		if (!UserFiles::FileOperator::CreateDir(strRoot))
+		{
+			return false;
+		}
+	}
+
+	std::string strFile;
+	while (std::getline(inFile, strFile))
+	{
+		if (strFile.empty())
+		{
+			continue;
+		}
+		// Ŀ¼
+		size_t n = strFile.find_last_of('\\');
+		if (n != std::string::npos)
+		{
+			std::string strDir = strRoot + strFile.substr(0, n);
+			if (!UserFiles::FileOperator::DirExist(strDir))
+			{
+				if (!UserFiles::FileOperator::CreateDir(strDir))
+				{
+					return false;
+				}
+			}
+		}
+		if (!UserFiles::FileOperator::CopyUserFile(strEntry + strFile, strRoot + strFile, m_cacheConfig.bHardLink))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// ѱд뻺
+bool DWGReader::SaveToCache(const std::string& sHash)
+{
+	std::string strCacheDir = m_cacheConfig.strCacheDir;
+	if (!UserFiles::FileOperator::DirExist(strCacheDir))
+	{
+		if (!UserFiles::FileOperator::CreateDir(strCacheDir))
+		{
+			return false;
+		}
+	}
+	// д
+	if (UserFiles::FileOperator::FileExist(strCacheDir + sHash + "\\" + CACHEMANIFEST))
+	{
+		return true;
+	}
+
+	// дʱĿ¼ɺ̶Ľ
+	std::string strTmp = strCacheDir + sHash + ".tmp" + std::to_string(_getpid());
+	if (!UserFiles::FileOperator::DirExist(strTmp))
+	{
+		if (!UserFiles::FileOperator::CreateDir(strTmp))
+		{
+			return false;
+		}
+	}
+
+	if (!WriteCacheEntry(strTmp) || !UserFiles::FileOperator::RenameDir(strTmp, strCacheDir + sHash))
+	{
+		// ɾʱĿ¼²ȱĽ
+		UserFiles::FileOperator::RemoveDir(strTmp);
+		return false;
+	}
+	return true;
+}
+
+// ѱ嵥ƵĿ¼
+bool DWGReader::WriteCacheEntry(const std::string& strTmp)
+{
+	std::string strRoot = GetOutputRoot();
+	std::string strManifest;
+	for (size_t i = 0; i < m_vecOutputFiles.size(); i++)
+	{
+		const std::string& strFile = m_vecOutputFiles[i];
+		size_t n = strFile.find_last_of('\\');
+		if (n != std::string::npos)
+		{
+			std::string strDir = strTmp + "\\" + strFile.substr(0, n);
+			if (!UserFiles::FileOperator::DirExist(strDir))
+			{
+				if (!UserFiles::FileOperator::CreateDir(strDir))
+				{
+					return false;
+				}
+			}
+		}
+		// Ǹƣļᱻԭظд
+		if (!UserFiles::FileOperator::CopyUserFile(strRoot + strFile, strTmp + "\\" + strFile, false))
+		{
+			return false;
+		}
+		strManifest += strFile + "\n";
+	}
+
+	std::ofstream out((strTmp + "\\" + CACHEMANIFEST).c_str());
+	if (!out.is_open())
+	{
+		return false;
+	}
+	out << strManifest;
+	out.close();
+	return !out.fail();
+}
 
 // ȡļ
 bool DWGReader::ReadFile(const std::string& sFileName)
 {
-	m_pDb = svcs.readFile(sFileName.c_str());
+	InitODA();
+	// ڴԤʱּأ롢ɻ
+	m_pDb = svcs.readFile(sFileName.c_str(), false, svcs.memoryBudget() != 0);
 	if (m_pDb.isNull())
 	{
 		return false;
@@ -48,15 +239,31 @@ bool DWGReader::VisitEntity()
 		return false;
 	}
 
+	m_storeWriter.Clear();
+
+	ExBudgetPageController* pPager = svcs.pageController(m_pDb.get());
+	size_t nVisited = 0;
+
 	OdDbBlockTableRecordPtr pModelSpace = m_pDb->getModelSpaceId().safeOpenObject(OdDb::kForRead);
 	if (!pModelSpace.isNull())
 	{
 		OdDbObjectIteratorPtr iterM = pModelSpace->newIterator();
 		for (iterM->start(); !iterM->done(); iterM->step())
 		{
+			// һʵѹرգԤʱ
+			if (pPager && ++nVisited % BUDGETSTEP == 0)
+			{
+				pPager->applyBudget();
+			}
+
 			OdDbEntityPtr pEnt = iterM->entity(OdDb::kForRead);
 			if (!pEnt.isNull())
 			{
+				if (pPager)
+				{
+					pPager->touch(pEnt->objectId());
+				}
+
 				if (pEnt->isKindOf(OdDbPolyline::desc()))
 				{
 					OdDbPolylinePtr ent = OdDbPolyline::cast(pEnt);
@@ -70,11 +277,92 @@ bool DWGReader::VisitEntity()
 					{
 						//std::cout << "Save Poly : " << sObject << "Failed!" << std::endl;
 					}
+					PolyToStore(ent);
 				}
 			}
 		}
 	}
 
+	// ʵ
+	std::string strRoot = GetOutputRoot();
+	if (!UserFiles::FileOperator::DirExist(strRoot))
+	{
+		if (!UserFiles::FileOperator::CreateDir(strRoot))
+		{
+			return false;
+		}
+	}
+	if (!m_storeWriter.Save(strRoot + STOREFILE))
+	{
+		OutPutMsg("Save entity store failed!");
+		return false;
+	}
+	m_vecOutputFiles.push_back(STOREFILE);
+
+	// ռ
+	if (!SaveSpatialIndex(strRoot + INDEXFILE))
+	{
+		OutPutMsg("Save spatial index failed!");
+		return false;
+	}
+	m_vecOutputFiles.push_back(INDEXFILE);
+
+	// λͼ
+	if (!SaveBitmapIndex(strRoot + BITMAPFILE))
+	{
+		OutPutMsg("Save bitmap index failed!");
+		return false;
+	}
+	m_vecOutputFiles.push_back(BITMAPFILE);
+
+	if (pPager)
+	{
+		ExBudgetPageController::BudgetStats stats = pPager->budgetStats();
+		OutPutMsg("Paging: in " + std::to_string(stats.m_pageIns) + ", out " + std::to_string(stats.m_pageOuts)
+			+ ", resident " + std::to_string(stats.m_residentBytes) + " bytes");
+	}
+	return true;
+}
+
+// ʵ¼ɿռ
+bool DWGReader::SaveSpatialIndex(const std::string& sFile)
+{
+	// ĿΪʵеļ¼±
+	const std::vector<UserFiles::EntityRecord>& vecRecords = m_storeWriter.Records();
+	UserFiles::SpatialIndexWriter writer;
+	for (size_t i = 0; i < vecRecords.size(); i++)
+	{
+		const UserFiles::EntityRecord& rec = vecRecords[i];
+		if (rec.nFlags & UserFiles::kRecNoExtents)
+		{
+			continue;
+		}
+		UserFiles::IndexBox box = { rec.dMin[0], rec.dMin[1], rec.dMax[0], rec.dMax[1] };
+		writer.Add(box, (uint32_t)i);
+	}
+	return writer.Save(sFile);
+}
+
+// ʵ¼λͼ
+bool DWGReader::SaveBitmapIndex(const std::string& sFile)
+{
+	// ¼±꼴λͼе
+	const std::vector<UserFiles::EntityRecord>& vecRecords = m_storeWriter.Records();
+	UserFiles::BitmapIndexWriter writer;
+	writer.SetUniverse((uint32_t)vecRecords.size());
+	for (size_t i = 0; i < vecRecords.size(); i++)
+	{
+		const UserFiles::EntityRecord& rec = vecRecords[i];
+		writer.Add(UserFiles::kFieldLayer, (int32_t)rec.nLayer, (uint32_t)i);
+		writer.Add(UserFiles::kFieldType, rec.nType, (uint32_t)i);
+		if (rec.nType == UserFiles::kPoly && rec.nSize >= sizeof(UserFiles::PolyData))
+		{
+			const UserFiles::PolyData* pData = (const UserFiles::PolyData*)m_storeWriter.Data(rec);
+			writer.Add(UserFiles::kFieldColorIndex, pData->nColorIndex, (uint32_t)i);
+			writer.Add(UserFiles::kFieldLineWeight, pData->nLineWeight, (uint32_t)i);
+		}
+	}
+	return writer.Save(sFile);
 }
 // ȡͼ
 bool DWGReader::GetAllLayer()
@@ -228,6 +516,48 @@ bool DWGReader::PolyToFile(OdDbPolylinePtr line, const std::string& sFile)
 	return true;
 }
 
+// ʵдʵ
+bool DWGReader::PolyToStore(OdDbPolylinePtr line)
+{
+	if (line.isNull())
+	{
+		return false;
+	}
+
+	// ΧУȡʱȻ⣨ JSON һ£ֻǲռѯ
+	OdGeExtents3d extents;
+	bool bExtents = line->getGeomExtents(extents) == eOk;
+	double dMin[3] = { extents.minPoint().x, extents.minPoint().y, extents.minPoint().z };
+	double dMax[3] = { extents.maxPoint().x, extents.maxPoint().y, extents.maxPoint().z };
+
+	// ݣPolyData + 
+	unsigned int nVerts = line->numVerts();
+	std::vector<char> vecData(sizeof(UserFiles::PolyData) + nVerts * 2 * sizeof(double));
+	UserFiles::PolyData* pData = (UserFiles::PolyData*)&vecData[0];
+	pData->nVerts = nVerts;
+	OdCmColor stColor = line->color();
+	pData->nColor = ((uint32_t)stColor.red() << 16) | ((uint32_t)stColor.green() << 8) | stColor.blue();
+	pData->nLineWeight = line->lineWeight();
+	pData->nColorIndex = line->colorIndex();
+	pData->bClosed = line->isClosed() ? 1 : 0;
+	pData->nReserved = 0;
+	pData->dScale = line->linetypeScale();
+
+	double* pPoints = (double*)(pData + 1);
+	for (unsigned int i = 0; i < nVerts; i++)
+	{
+		OdGePoint2d curPt;
+		line->getPointAt(i, curPt);
+		pPoints[i * 2] = curPt.x;
+		pPoints[i * 2 + 1] = curPt.y;
+	}
+
+	uint32_t nLayer = m_storeWriter.AddLayer(OdString2String(line->layer()));
+	m_storeWriter.AddEntity((OdUInt64)line->objectId().getHandle(), UserFiles::kPoly, nLayer,
+		bExtents ? dMin : NULL, bExtents ? dMax : NULL, &vecData[0], vecData.size());
+	return true;
+}
+
 bool DWGReader::SaveEntity2File(OdDbEntityPtr pEntity, const std::string& strGUID,UserFiles::enEntityType enType)
 {
 	if (strGUID.empty())
@@ -235,7 +565,8 @@ bool DWGReader::SaveEntity2File(OdDbEntityPtr pEntity, const std::string& strGUI
 		return false;
 	}
 
-	std::string strRoot = UserFiles::FileOperator::GetGenFilePath() + "..\\" + ROOTDIR + "\\";
+	std::string strRoot = GetOutputRoot();
+	size_t nRootLen = strRoot.length();
 	//  Ŀ¼
 	if (!UserFiles::FileOperator::DirExist(strRoot))
 	{
@@ -284,6 +615,7 @@ bool DWGReader::SaveEntity2File(OdDbEntityPtr pEntity, const std::string& strGUI
 	{
 		if (PolyToFile(OdDbPolyline::cast(pEntity), strRoot))
 		{
+			m_vecOutputFiles.push_back(strRoot.substr(nRootLen));
 			std::cerr << "Poly2dToFile :" << strRoot << " Successfully! " << std::endl;
 		}
 		else
@@ -3,26 +3,66 @@
 #include "odaInclude.h"
 #include "ODAInit.h"
 #include "FileOperator.h"
+#include "EntityStore.h"
+#include "SpatialIndex.h"
+#include "BitmapIndex.h"
 #include <iostream>
+#include <vector>
+
+// ڴԤ㣺ÿٸʵһ
+#define BUDGETSTEP 256
+// ʽ汾ļ򲼾ֱ仯ʱһ
+#define CACHEVERSION 2
 
 class DWGReader
 {
 
 public:
+	// 
+	struct ResultCacheConfig
+	{
+		bool        bEnable;      // Ƿ
+		std::string strCacheDir;  // Ŀ¼·ָβ
+		bool        bHardLink;    // ʱӲӶǸƣļᱻдʱʹã
+	};
+
 	DWGReader()
     {
 		m_pDb = NULL;
-		// ODA ʼ
-		odInitialize(&svcs);
-		svcs.disableOutput(true);
+		m_bInitialized = false;
+		m_cacheConfig.bEnable = false;
+		m_cacheConfig.strCacheDir = UserFiles::FileOperator::GetGenFilePath() + "..\\" + CACHEDIR + "\\";
+		m_cacheConfig.bHardLink = false;
 	}
 
 	~DWGReader()
 	{
-		// жط
+		if (!m_bInitialized)
+		{
+			return;
+		}
+		// жطͷݿͻݿ
+		m_pDb.release();
+		svcs.clearDatabaseCache();
+		MyServices::clearXrefCache();
+		odUninitAsyncIOService();
 		odUninitialize();
 	}
 
+	// ý棬Ĭϲ
+	void SetResultCache(const ResultCacheConfig& config) { m_cacheConfig = config; }
+
+	// öڴԤ㣨ֽڣʱδʵĶ0 ʾơ
+	// ú󰴲ּطʽȡļ
+	void SetMemoryBudget(OdUInt64 nBytes) { svcs.setMemoryBudget(nBytes); }
+
+	// ʵݰռ˳
+	void SetSpatialOrder(bool bSpatialOrder) { m_storeWriter.SetSpatialOrder(bSpatialOrder); }
+
+	// ȡļýһʱֱӻָϴεĽʼݿ⣻
+	// ȡʵ壬ٰѽд뻺
+	bool ExtractFile(const std::string& sFileName);
+
 	// ȡļ
 	bool ReadFile(const std::string& sFileName);
 
@@ -38,6 +78,23 @@ public:
 	bool SaveEntity2File(OdDbEntityPtr pEntity, const std::string& strGUID, UserFiles::enEntityType enType);
 
 private:
+	// ODA ʼһζȡļʱ
+	void InitODA();
+
+	// Ŀ¼
+	std::string GetOutputRoot();
+
+	// ļݹϣ + ʽ汾 + Ӱѡ
+	bool GetCacheKey(const std::string& sFileName, std::string& sKey);
+
+	// ӻָ
+	bool RestoreFromCache(const std::string& sHash);
+
+	// ѱд뻺
+	bool SaveToCache(const std::string& sHash);
+
+	// ѱ嵥ƵĿ¼
+	bool WriteCacheEntry(const std::string& strTmp);
 
 	// άʵ߱ؼ
 	bool Poly2dToFile(OdDb2dPolylinePtr line, const std::string& sFile);
@@ -45,6 +102,15 @@ private:
 	// ʵ߱ؼ
 	bool PolyToFile(OdDbPolylinePtr line, const std::string& sFile);
 
+	// ʵдʵ
+	bool PolyToStore(OdDbPolylinePtr line);
+
+	// ʵ¼ɿռ
+	bool SaveSpatialIndex(const std::string& sFile);
+
+	// ʵ¼λͼͼ㡢͡ɫ߿
+	bool SaveBitmapIndex(const std::string& sFile);
+
 	// ת
 	std::string OdString2String(OdString sVal);
     
@@ -57,6 +123,14 @@ private:
 	OdDbDatabasePtr m_pDb;
 	// עͳʼ
 	OdStaticRxObject<MyServices> svcs;
+	// ODA Ƿѳʼ
+	bool m_bInitialized;
+	// 
+	ResultCacheConfig m_cacheConfig;
+	// ļĿ¼
+	std::vector<std::string> m_vecOutputFiles;
+	// ʵ⣺дĿ¼
+	UserFiles::EntityStoreWriter m_storeWriter;
 
 };
 
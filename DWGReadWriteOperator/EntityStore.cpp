@@ -0,0 +1,340 @@
+#include "EntityStore.h"
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <string.h>
+
+namespace UserFiles
+{
+	namespace
+	{
+		bool RecordLess(const EntityRecord& a, const EntityRecord& b)
+		{
+			return a.nHandle < b.nHandle;
+		}
+	}
+
+	// 
+	void EntityStoreWriter::Clear()
+	{
+		m_vecRecords.clear();
+		m_vecLayers.clear();
+		m_mapLayers.clear();
+		m_vecHeap.clear();
+	}
+
+	// ͼ
+	uint32_t EntityStoreWriter::AddLayer(const std::string& sName)
+	{
+		std::map<std::string, uint32_t>::const_iterator it = m_mapLayers.find(sName);
+		if (it != m_mapLayers.end())
+		{
+			return it->second;
+		}
+		uint32_t nLayer = (uint32_t)m_vecLayers.size();
+		m_vecLayers.push_back(sName);
+		m_mapLayers[sName] = nLayer;
+		return nLayer;
+	}
+
+	// ʵ
+	void EntityStoreWriter::AddEntity(uint64_t nHandle, enEntityType enType, uint32_t nLayer,
+		const double dMin[3], const double dMax[3], const void* pData, size_t nSize)
+	{
+		EntityRecord rec;
+		memset(&rec, 0, sizeof(rec));
+		rec.nHandle = nHandle;
+		rec.nType = (uint16_t)enType;
+		rec.nLayer = nLayer;
+		if (dMin && dMax)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				rec.dMin[i] = dMin[i];
+				rec.dMax[i] = dMax[i];
+			}
+		}
+		else
+		{
+			rec.nFlags |= kRecNoExtents;
+		}
+
+		// ݰ 8 ֽڶ룬ȡʱֱתɽṹָ
+		rec.nOffset = m_vecHeap.size();
+		rec.nSize = (uint32_t)nSize;
+		m_vecHeap.resize((size_t)Align8(m_vecHeap.size() + nSize), 0);
+		if (nSize)
+		{
+			memcpy(&m_vecHeap[(size_t)rec.nOffset], pData, nSize);
+		}
+		m_vecRecords.push_back(rec);
+	}
+
+	// 
+	bool EntityStoreWriter::Save(const std::string& sFile)
+	{
+		std::stable_sort(m_vecRecords.begin(), m_vecRecords.end(), RecordLess);
+
+		// ¼ͷ԰ֻ
+		if (m_bSpatialOrder && !m_vecRecords.empty())
+		{
+			// ûаΧеʵ
+			std::vector<IndexBox> vecBoxes;
+			std::vector<uint32_t> vecIndex, vecNoExtents;
+			for (size_t i = 0; i < m_vecRecords.size(); i++)
+			{
+				const EntityRecord& rec = m_vecRecords[i];
+				if (rec.nFlags & kRecNoExtents)
+				{
+					vecNoExtents.push_back((uint32_t)i);
+					continue;
+				}
+				IndexBox box = { rec.dMin[0], rec.dMin[1], rec.dMax[0], rec.dMax[1] };
+				vecBoxes.push_back(box);
+				vecIndex.push_back((uint32_t)i);
+			}
+			std::vector<uint32_t> vecOrder;
+			if (!vecBoxes.empty())
+			{
+				HilbertSort(vecBoxes, vecOrder);
+			}
+			for (size_t i = 0; i < vecOrder.size(); i++)
+			{
+				vecOrder[i] = vecIndex[vecOrder[i]];
+			}
+			vecOrder.insert(vecOrder.end(), vecNoExtents.begin(), vecNoExtents.end());
+
+			std::vector<char> vecHeap;
+			vecHeap.reserve(m_vecHeap.size());
+			for (size_t i = 0; i < vecOrder.size(); i++)
+			{
+				EntityRecord& rec = m_vecRecords[vecOrder[i]];
+				uint64_t nOffset = vecHeap.size();
+				vecHeap.insert(vecHeap.end(), m_vecHeap.begin() + (size_t)rec.nOffset, m_vecHeap.begin() + (size_t)(rec.nOffset + rec.nSize));
+				vecHeap.resize((size_t)Align8(vecHeap.size()), 0);
+				rec.nOffset = nOffset;
+			}
+			m_vecHeap.swap(vecHeap);
+		}
+
+		// ͼ׷ʵ֮
+		std::vector<LayerRecord> vecLayers(m_vecLayers.size());
+		std::vector<char> vecNames;
+		for (size_t i = 0; i < m_vecLayers.size(); i++)
+		{
+			vecLayers[i].nOffset = m_vecHeap.size() + vecNames.size();
+			vecLayers[i].nSize = (uint32_t)m_vecLayers[i].size();
+			vecLayers[i].nReserved = 0;
+			vecNames.insert(vecNames.end(), m_vecLayers[i].begin(), m_vecLayers[i].end());
+			vecNames.push_back('\0');
+		}
+
+		StoreHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.szMagic, STOREMAGIC, sizeof(header.szMagic));
+		header.nVersion = STOREVERSION;
+		header.nRecordSize = sizeof(EntityRecord);
+		header.nRecords = m_vecRecords.size();
+		header.nRecordsOffset = Align8(sizeof(StoreHeader));
+		header.nLayers = vecLayers.size();
+		header.nLayersOffset = header.nRecordsOffset + Align8(m_vecRecords.size() * sizeof(EntityRecord));
+		header.nHeapOffset = header.nLayersOffset + Align8(vecLayers.size() * sizeof(LayerRecord));
+		header.nHeapSize = m_vecHeap.size() + vecNames.size();
+
+		SafeFileWriter out(sFile);
+		if (!out.IsOpen())
+		{
+			return false;
+		}
+		out.WritePadded(&header, sizeof(header));
+		out.WritePadded(m_vecRecords.empty() ? NULL : &m_vecRecords[0], m_vecRecords.size() * sizeof(EntityRecord));
+		out.WritePadded(vecLayers.empty() ? NULL : &vecLayers[0], vecLayers.size() * sizeof(LayerRecord));
+		if (!m_vecHeap.empty())
+		{
+			out.Write(&m_vecHeap[0], m_vecHeap.size());
+		}
+		if (!vecNames.empty())
+		{
+			out.Write(&vecNames[0], vecNames.size());
+		}
+		return out.Commit();
+	}
+
+	EntityStore::EntityStore()
+		: m_pHeader(NULL)
+		, m_pRecords(NULL)
+		, m_pLayers(NULL)
+	{
+	}
+
+	EntityStore::~EntityStore()
+	{
+		Close();
+	}
+
+	// ļ
+	bool EntityStore::Open(const std::string& sFile)
+	{
+		Close();
+
+		if (!m_file.Open(sFile) || m_file.Size() < sizeof(StoreHeader))
+		{
+			Close();
+			return false;
+		}
+
+		// Уļͷ͸ηΧ
+		uint64_t nSize = m_file.Size();
+		const StoreHeader* pHeader = (const StoreHeader*)m_file.Data();
+		if (memcmp(pHeader->szMagic, STOREMAGIC, sizeof(pHeader->szMagic)) != 0
+			|| pHeader->nVersion != STOREVERSION
+			|| pHeader->nRecordSize != sizeof(EntityRecord)
+			|| pHeader->nRecordsOffset % 8 || pHeader->nLayersOffset % 8 || pHeader->nHeapOffset % 8
+			|| pHeader->nRecords > nSize / sizeof(EntityRecord)
+			|| pHeader->nLayers > nSize / sizeof(LayerRecord)
+			|| pHeader->nRecordsOffset + pHeader->nRecords * sizeof(EntityRecord) > nSize
+			|| pHeader->nLayersOffset + pHeader->nLayers * sizeof(LayerRecord) > nSize
+			|| pHeader->nHeapOffset > nSize
+			|| pHeader->nHeapSize > nSize - pHeader->nHeapOffset)
+		{
+			Close();
+			return false;
+		}
+
+		m_pHeader = pHeader;
+		m_pRecords = (const EntityRecord*)(m_file.Data() + pHeader->nRecordsOffset);
+		m_pLayers = (const LayerRecord*)(m_file.Data() + pHeader->nLayersOffset);
+		return true;
+	}
+
+	// رļ
+	void EntityStore::Close()
+	{
+		m_file.Close();
+		m_pHeader = NULL;
+		m_pRecords = NULL;
+		m_pLayers = NULL;
+	}
+
+	// ʵ
+	size_t EntityStore::Size() const
+	{
+		return m_pHeader ? (size_t)m_pHeader->nRecords : 0;
+	}
+
+	// 
+	const EntityRecord* EntityStore::Find(uint64_t nHandle) const
+	{
+		const EntityRecord* pBegin = m_pRecords;
+		const EntityRecord* pEnd = m_pRecords + Size();
+		EntityRecord key;
+		key.nHandle = nHandle;
+		const EntityRecord* p = std::lower_bound(pBegin, pEnd, key, RecordLess);
+		if (p == pEnd || p->nHandle != nHandle)
+		{
+			return NULL;
+		}
+		return p;
+	}
+
+	// ʵ
+	const void* EntityStore::Data(const EntityRecord& rec) const
+	{
+		if (!m_pHeader || rec.nOffset > m_pHeader->nHeapSize || rec.nSize > m_pHeader->nHeapSize - rec.nOffset)
+		{
+			return NULL;
+		}
+		return m_file.Data() + m_pHeader->nHeapOffset + rec.nOffset;
+	}
+
+	// ͼ
+	size_t EntityStore::NumLayers() const
+	{
+		return m_pHeader ? (size_t)m_pHeader->nLayers : 0;
+	}
+
+	// ͼ
+	const char* EntityStore::LayerName(uint32_t nLayer) const
+	{
+		if (nLayer >= NumLayers())
+		{
+			return NULL;
+		}
+		const LayerRecord& layer = m_pLayers[nLayer];
+		// ͬβ '\0' Ҫ
+		if (layer.nOffset >= m_pHeader->nHeapSize || layer.nSize >= m_pHeader->nHeapSize - layer.nOffset)
+		{
+			return NULL;
+		}
+		const char* pName = m_file.Data() + m_pHeader->nHeapOffset + layer.nOffset;
+		return pName[layer.nSize] == '\0' ? pName : NULL;
+	}
+
+	// Ʋͼ
+	bool EntityStore::FindLayer(const std::string& sName, uint32_t& nLayer) const
+	{
+		for (uint32_t i = 0; i < (uint32_t)NumLayers(); i++)
+		{
+			const char* pName = LayerName(i);
+			if (pName && m_pLayers[i].nSize == sName.size() && memcmp(pName, sName.c_str(), sName.size()) == 0)
+			{
+				nLayer = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// ɨ
+	size_t EntityStore::ScanType(enEntityType enType, std::vector<uint32_t>& vecResult) const
+	{
+		size_t nCount = 0;
+		const EntityRecord* p = m_pRecords;
+		for (size_t i = 0, n = Size(); i < n; i++, p++)
+		{
+			if (p->nType == (uint16_t)enType)
+			{
+				vecResult.push_back((uint32_t)i);
+				nCount++;
+			}
+		}
+		return nCount;
+	}
+
+	// ͼɨ
+	size_t EntityStore::ScanLayer(uint32_t nLayer, std::vector<uint32_t>& vecResult) const
+	{
+		size_t nCount = 0;
+		const EntityRecord* p = m_pRecords;
+		for (size_t i = 0, n = Size(); i < n; i++, p++)
+		{
+			if (p->nLayer == nLayer)
+			{
+				vecResult.push_back((uint32_t)i);
+				nCount++;
+			}
+		}
+		return nCount;
+	}
+
+	// Χɨ
+	size_t EntityStore::ScanExtents(const double dMin[2], const double dMax[2], std::vector<uint32_t>& vecResult) const
+	{
+		size_t nCount = 0;
+		const EntityRecord* p = m_pRecords;
+		for (size_t i = 0, n = Size(); i < n; i++, p++)
+		{
+			if (p->nFlags & kRecNoExtents)
+			{
+				continue;
+			}
+			if (p->dMin[0] <= dMax[0] && p->dMax[0] >= dMin[0]
+				&& p->dMin[1] <= dMax[1] && p->dMax[1] >= dMin[1])
+			{
+				vecResult.push_back((uint32_t)i);
+				nCount++;
+			}
+		}
+		return nCount;
+	}
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "FileOperator.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+namespace UserFiles
+{
+
+// ʵļ
+#define STOREFILE "entities.bin"
+// ʵļʶ
+#define STOREMAGIC "DWGENTS1"
+// ʵ汾
+#define STOREVERSION 1
+
+	/*
+	* ʵļֽ֣ 8 ֽڶ룩
+	*   StoreHeader
+	*   EntityRecord[nRecords]    ¼ͷ
+	*   LayerRecord[nLayers]      ͼ
+	*                       ʵͼ
+	* ļд޸ģȡʱֱӳ䵽ڴ棬л
+	*/
+
+	// ļͷ
+	struct StoreHeader
+	{
+		char     szMagic[8];
+		uint32_t nVersion;
+		uint32_t nRecordSize;    // sizeof(EntityRecord)
+		uint64_t nRecords;
+		uint64_t nRecordsOffset;
+		uint64_t nLayers;
+		uint64_t nLayersOffset;
+		uint64_t nHeapOffset;
+		uint64_t nHeapSize;
+	};
+
+	// ʵ¼־
+	enum enRecordFlags
+	{
+		kRecNoExtents = 0x0001,  // ûаΧУ뷶ΧѯͿռ
+	};
+
+	// ʵ¼ͷ
+	struct EntityRecord
+	{
+		uint64_t nHandle;        // ʵ
+		uint16_t nType;          // enEntityType
+		uint16_t nFlags;         // enRecordFlags
+		uint32_t nLayer;         // ͼ
+		double   dMin[3];        // Χ
+		double   dMax[3];
+		uint64_t nOffset;        // ڵƫ
+		uint32_t nSize;          // ݳ
+		uint32_t nReserved;
+	};
+
+	// ͼ¼ '\0' β
+	struct LayerRecord
+	{
+		uint64_t nOffset;
+		uint32_t nSize;          // β '\0'
+		uint32_t nReserved;
+	};
+
+	// ݣ nVerts  (x, y)
+	struct PolyData
+	{
+		uint32_t nVerts;
+		uint32_t nColor;         // 0x00RRGGBB
+		int32_t  nLineWeight;
+		int16_t  nColorIndex;
+		uint8_t  bClosed;
+		uint8_t  nReserved;
+		double   dScale;         // ͱ
+
+		const double* Points() const { return (const double*)(this + 1); }
+	};
+
+	// ʵд룺ռ¼һд
+	class EntityStoreWriter
+	{
+	public:
+		EntityStoreWriter() : m_bSpatialOrder(false) {}
+
+		// 
+		void Clear();
+		// ͼ㣬ͬͼ㷵ͬһ
+		uint32_t AddLayer(const std::string& sName);
+		// ʵ壬ݸƵdMindMax Ϊ NULL ʱΪ kRecNoExtents
+		void AddEntity(uint64_t nHandle, enEntityType enType, uint32_t nLayer,
+			const double dMin[3], const double dMax[3], const void* pData, size_t nSize);
+		// ʵ
+		size_t Size() const { return m_vecRecords.size(); }
+		// ¼ͷSave ֮󰴾
+		const std::vector<EntityRecord>& Records() const { return m_vecRecords; }
+		// ʵ
+		const void* Data(const EntityRecord& rec) const { return rec.nSize ? &m_vecHeap[(size_t)rec.nOffset] : NULL; }
+		// ռ䣨Hilbert˳УռʵļҲ
+		void SetSpatialOrder(bool bSpatialOrder) { m_bSpatialOrder = bSpatialOrder; }
+		bool SpatialOrder() const { return m_bSpatialOrder; }
+		// 棺дʱļ滻Ŀļ
+		bool Save(const std::string& sFile);
+
+	private:
+		std::vector<EntityRecord> m_vecRecords;
+		std::vector<std::string> m_vecLayers;
+		std::map<std::string, uint32_t> m_mapLayers;
+		std::vector<char> m_vecHeap;
+		bool m_bSpatialOrder;
+	};
+
+	// ʵȡӳļһ˳ɨ¼ͷ
+	class EntityStore
+	{
+	public:
+		EntityStore();
+		~EntityStore();
+
+		// ļ
+		bool Open(const std::string& sFile);
+		// رļ
+		void Close();
+		// ǷѴ
+		bool IsOpen() const { return m_pHeader != NULL; }
+
+		// ʵ
+		size_t Size() const;
+		// м¼ͷ
+		const EntityRecord* Records() const { return m_pRecords; }
+		// ңO(log n)Ҳ NULL
+		const EntityRecord* Find(uint64_t nHandle) const;
+		// ʵݣԽ緵 NULL
+		const void* Data(const EntityRecord& rec) const;
+
+		// ͼ
+		size_t NumLayers() const;
+		// ͼƣԽ緵 NULL
+		const char* LayerName(uint32_t nLayer) const;
+		// Ʋͼ
+		bool FindLayer(const std::string& sName, uint32_t& nLayer) const;
+
+		// ɨ裺Ϊ¼±꣬ƥ
+		size_t ScanType(enEntityType enType, std::vector<uint32_t>& vecResult) const;
+		size_t ScanLayer(uint32_t nLayer, std::vector<uint32_t>& vecResult) const;
+		// Χ XY Χཻ
+		size_t ScanExtents(const double dMin[2], const double dMax[2], std::vector<uint32_t>& vecResult) const;
+
+	private:
+		EntityStore(const EntityStore&);
+		EntityStore& operator=(const EntityStore&);
+
+	private:
+		MappedFile m_file;
+		const StoreHeader* m_pHeader;
+		const EntityRecord* m_pRecords;
+		const LayerRecord* m_pLayers;
+	};
+
+}
@@ -4,9 +4,131 @@
 #include <direct.h>
 #include <sstream>
 #include <fstream>
+#include <vector>
+#include <stdint.h>
 
 namespace UserFiles
 {
+	namespace
+	{
+		// xxHash64 ʽ
+		class XXHash64
+		{
+		public:
+			XXHash64()
+				: m_nTotal(0), m_nMemSize(0)
+			{
+				m_v[0] = P1 + P2;
+				m_v[1] = P2;
+				m_v[2] = 0;
+				m_v[3] = 0 - P1;
+			}
+
+			void Update(const unsigned char* p, size_t nSize)
+			{
+				const unsigned char* pEnd = p + nSize;
+				m_nTotal += nSize;
+				// ϴʣ
+				if (m_nMemSize)
+				{
+					size_t n = (32 - m_nMemSize < nSize) ? 32 - m_nMemSize : nSize;
+					memcpy(m_mem + m_nMemSize, p, n);
+					m_nMemSize += n;
+					p += n;
+					if (m_nMemSize < 32)
+					{
+						return;
+					}
+					Stripe(m_mem);
+					m_nMemSize = 0;
+				}
+				for (; p + 32 <= pEnd; p += 32)
+				{
+					Stripe(p);
+				}
+				if (p < pEnd)
+				{
+					memcpy(m_mem, p, pEnd - p);
+					m_nMemSize = pEnd - p;
+				}
+			}
+
+			uint64_t Digest() const
+			{
+				uint64_t h;
+				if (m_nTotal >= 32)
+				{
+					h = Rotl(m_v[0], 1) + Rotl(m_v[1], 7) + Rotl(m_v[2], 12) + Rotl(m_v[3], 18);
+					for (int i = 0; i < 4; i++)
+					{
+						h ^= Round(0, m_v[i]);
+						h = h * P1 + P4;
+					}
+				}
+				else
+				{
+					h = P5;
+				}
+				h += m_nTotal;
+
+				const unsigned char* p = m_mem;
+				const unsigned char* pEnd = m_mem + m_nMemSize;
+				for (; p + 8 <= pEnd; p += 8)
+				{
+					h ^= Round(0, Read64(p));
+					h = Rotl(h, 27) * P1 + P4;
+				}
+				if (p + 4 <= pEnd)
+				{
+					h ^= uint64_t(Read32(p)) * P1;
+					h = Rotl(h, 23) * P2 + P3;
+					p += 4;
+				}
+				for (; p < pEnd; p++)
+				{
+					h ^= (*p) * P5;
+					h = Rotl(h, 11) * P1;
+				}
+				h ^= h >> 33;
+				h *= P2;
+				h ^= h >> 29;
+				h *= P3;
+				h ^= h >> 32;
+				return h;
+			}
+
+		private:
+			static const uint64_t P1 = 11400714785074694791ULL;
+			static const uint64_t P2 = 14029467366897019727ULL;
+			static const uint64_t P3 = 1609587929392839161ULL;
+			static const uint64_t P4 = 9650029242287828579ULL;
+			static const uint64_t P5 = 2870177450012600261ULL;
+
+			static uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+			static uint64_t Read64(const unsigned char* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+			static uint32_t Read32(const unsigned char* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+			static uint64_t Round(uint64_t acc, uint64_t input)
+			{
+				acc += input * P2;
+				acc = Rotl(acc, 31);
+				return acc * P1;
+			}
+
+			void Stripe(const unsigned char* p)
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					m_v[i] = Round(m_v[i], Read64(p + i * 8));
+				}
+			}
+
+			uint64_t      m_v[4];
+			uint64_t      m_nTotal;
+			unsigned char m_mem[32];
+			size_t        m_nMemSize;
+		};
+	}
+
 	std::string FileOperator::GetGenFilePath()
 	{
 		char szFileName[MAX_PATH] = { '\0' };
@@ -132,4 +254,265 @@ namespace UserFiles
 		return strResult;
 
 	}
+
+	// ļݹϣ
+	bool FileOperator::HashFile(const std::string& sFile, std::string& sHash)
+	{
+		HANDLE hFile = CreateFileA(
+			sFile.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ,
+			NULL,
+			OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN,   // ʾϵͳ˳Ԥ
+			NULL
+		);
+		if (hFile == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		std::vector<unsigned char> vecBuf(HASHBLOCKSIZE);
+		XXHash64 hash;
+		unsigned long long nSize = 0;
+		bool bOk = true;
+		for (;;)
+		{
+			DWORD nRead = 0;
+			if (!::ReadFile(hFile, &vecBuf[0], (DWORD)vecBuf.size(), &nRead, NULL))
+			{
+				bOk = false;
+				break;
+			}
+			if (nRead == 0)
+			{
+				break;
+			}
+			hash.Update(&vecBuf[0], nRead);
+			nSize += nRead;
+		}
+		CloseHandle(hFile);
+		if (!bOk)
+		{
+			return false;
+		}
+
+		char szHash[64] = { '\0' };
+		sprintf_s(szHash, "%016llx-%llx", (unsigned long long)hash.Digest(), nSize);
+		sHash = szHash;
+		return true;
+	}
+
+	// ļ
+	bool FileOperator::CopyUserFile(const std::string& sFrom, const std::string& sTo, bool bLink)
+	{
+		if (bLink)
+		{
+			DeleteFileA(sTo.c_str());
+			if (CreateHardLinkA(sTo.c_str(), sFrom.c_str(), NULL))
+			{
+				return true;
+			}
+		}
+		return CopyFileA(sFrom.c_str(), sTo.c_str(), FALSE) != FALSE;
+	}
+
+	// Ŀ¼
+	bool FileOperator::RenameDir(const std::string& sFrom, const std::string& sTo)
+	{
+		return MoveFileExA(sFrom.c_str(), sTo.c_str(), 0) != FALSE;
+	}
+
+	// ɾĿ¼
+	bool FileOperator::RemoveDir(const std::string& strDir)
+	{
+		WIN32_FIND_DATAA data;
+		HANDLE hFind = FindFirstFileA((strDir + "\\*").c_str(), &data);
+		if (hFind != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				std::string strName = data.cFileName;
+				if (strName == "." || strName == "..")
+				{
+					continue;
+				}
+				std::string strPath = strDir + "\\" + strName;
+				if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				{
+					RemoveDir(strPath);
+				}
+				else
+				{
+					DeleteFileA(strPath.c_str());
+				}
+			} while (FindNextFileA(hFind, &data));
+			FindClose(hFind);
+		}
+		return RemoveDirectoryA(strDir.c_str()) != FALSE;
+	}
+
+	// 滻ļ
+	bool FileOperator::ReplaceFile(const std::string& sFrom, const std::string& sTo)
+	{
+		// ɾǰƿѲӳļ
+		std::string strDir = sTo.substr(0, sTo.find_last_of('\\') + 1);
+		WIN32_FIND_DATAA data;
+		HANDLE hFind = FindFirstFileA((sTo + ".*.old").c_str(), &data);
+		if (hFind != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				DeleteFileA((strDir + data.cFileName).c_str());
+			} while (FindNextFileA(hFind, &data));
+			FindClose(hFind);
+		}
+
+		if (MoveFileExA(sFrom.c_str(), sTo.c_str(), MOVEFILE_REPLACE_EXISTING))
+		{
+			return true;
+		}
+		if (!FileExist(sTo))
+		{
+			return false;
+		}
+		// Ŀ걻 MappedFile ӳʱܸǣԸӳ FILE_SHARE_DELETE 򿪣
+		std::string strOld = sTo + "." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(GetTickCount64()) + ".old";
+		if (!MoveFileExA(sTo.c_str(), strOld.c_str(), 0))
+		{
+			return false;
+		}
+		if (!MoveFileExA(sFrom.c_str(), sTo.c_str(), 0))
+		{
+			MoveFileExA(strOld.c_str(), sTo.c_str(), 0);
+			return false;
+		}
+		// Աӳʱɾʧܣ´滻
+		DeleteFileA(strOld.c_str());
+		return true;
+	}
+
+	SafeFileWriter::SafeFileWriter(const std::string& sFile)
+		: m_strFile(sFile)
+		, m_strTmp(sFile + ".tmp")
+		, m_bCommitted(false)
+	{
+		m_out.open(m_strTmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		m_bOpened = m_out.is_open();
+	}
+
+	SafeFileWriter::~SafeFileWriter()
+	{
+		if (m_bOpened && !m_bCommitted)
+		{
+			if (m_out.is_open())
+			{
+				m_out.close();
+			}
+			DeleteFileA(m_strTmp.c_str());
+		}
+	}
+
+	// д
+	void SafeFileWriter::Write(const void* p, uint64_t nSize)
+	{
+		if (nSize)
+		{
+			m_out.write((const char*)p, (std::streamsize)nSize);
+		}
+	}
+
+	// д벢뵽 8 ֽ
+	void SafeFileWriter::WritePadded(const void* p, uint64_t nSize)
+	{
+		static const char szZero[8] = { 0 };
+		Write(p, nSize);
+		m_out.write(szZero, (std::streamsize)(Align8(nSize) - nSize));
+	}
+
+	// ύ
+	bool SafeFileWriter::Commit()
+	{
+		if (!m_bOpened)
+		{
+			return false;
+		}
+		m_out.close();
+		if (m_out.fail())
+		{
+			return false;
+		}
+		// 滻Ŀļȡӳ
+		m_bCommitted = FileOperator::ReplaceFile(m_strTmp, m_strFile);
+		return m_bCommitted;
+	}
+
+	MappedFile::MappedFile()
+		: m_hFile(INVALID_HANDLE_VALUE)
+		, m_hMapping(NULL)
+		, m_pBase(NULL)
+		, m_nSize(0)
+	{
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	// ӳļ
+	bool MappedFile::Open(const std::string& sFile)
+	{
+		Close();
+
+		m_hFile = CreateFileA(sFile.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (m_hFile == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER nFileSize;
+		if (!GetFileSizeEx(m_hFile, &nFileSize) || nFileSize.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+		m_nSize = (uint64_t)nFileSize.QuadPart;
+
+		m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_hMapping == NULL)
+		{
+			Close();
+			return false;
+		}
+		m_pBase = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (m_pBase == NULL)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	// ӳ
+	void MappedFile::Close()
+	{
+		if (m_pBase != NULL)
+		{
+			UnmapViewOfFile(m_pBase);
+			m_pBase = NULL;
+		}
+		if (m_hMapping != NULL)
+		{
+			CloseHandle(m_hMapping);
+			m_hMapping = NULL;
+		}
+		if (m_hFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_hFile);
+			m_hFile = INVALID_HANDLE_VALUE;
+		}
+		m_nSize = 0;
+	}
 }
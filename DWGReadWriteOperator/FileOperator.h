@@ -1,6 +1,9 @@
 #pragma once
 
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <stdint.h>
 
 namespace UserFiles
 {
@@ -13,6 +16,12 @@ namespace UserFiles
 #define LINEDIR "Lines"
 // tͼļ
 #define LAYERDIR "Layers"
+// Ŀ¼
+#define CACHEDIR "DWG2JSON_Cache"
+// 嵥ļ
+#define CACHEMANIFEST "manifest.txt"
+// ϣʱÿ˳ȡĴС
+#define HASHBLOCKSIZE (4 * 1024 * 1024)
 	
 
 	// ͼϢ
@@ -57,6 +66,79 @@ namespace UserFiles
 		static bool SaveFile(const std::string& sFile, const std::string& sInfo);
 		// Ϊ
 		static std::string ReadFile(const std::string& sFile);
+
+		// ļݹϣ˳ȡxxHash64 + ļ
+		static bool HashFile(const std::string& sFile, std::string& sHash);
+		// ļbLink ΪʱȴӲ
+		static bool CopyUserFile(const std::string& sFrom, const std::string& sTo, bool bLink);
+		// Ŀ¼ĿѴʱʧ
+		static bool RenameDir(const std::string& sFrom, const std::string& sTo);
+		// ɾĿ¼еļ
+		static bool RemoveDir(const std::string& strDir);
+		//  sFrom 滻 sTosTo ӳʱȸƿӳرպ´滻ʱɾ
+		static bool ReplaceFile(const std::string& sFrom, const std::string& sTo);
+	};
+
+	// 8 ֽڶ
+	inline uint64_t Align8(uint64_t n)
+	{
+		return (n + 7) & ~(uint64_t)7;
+	}
+
+	// ļд룺дʱļCommit ʱ滻Ŀļδύʱɾʱļ
+	class SafeFileWriter
+	{
+	public:
+		explicit SafeFileWriter(const std::string& sFile);
+		~SafeFileWriter();
+
+		// ʱļǷѴ
+		bool IsOpen() const { return m_bOpened; }
+		// д
+		void Write(const void* p, uint64_t nSize);
+		// д벢뵽 8 ֽ
+		void WritePadded(const void* p, uint64_t nSize);
+		// رʱļ滻Ŀļ
+		bool Commit();
+
+	private:
+		SafeFileWriter(const SafeFileWriter&);
+		SafeFileWriter& operator=(const SafeFileWriter&);
+
+	private:
+		std::string m_strFile;
+		std::string m_strTmp;
+		std::ofstream m_out;
+		bool m_bOpened;
+		bool m_bCommitted;
+	};
+
+	// ֻļӳ
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		// ӳļļʧ
+		bool Open(const std::string& sFile);
+		// ӳ
+		void Close();
+
+		const char* Data() const { return m_pBase; }
+		uint64_t Size() const { return m_nSize; }
+
+	private:
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+	private:
+		// ļӳ
+		void* m_hFile;
+		void* m_hMapping;
+		// ӳַ
+		const char* m_pBase;
+		uint64_t m_nSize;
 	};
 
 }
@@ -2,9 +2,49 @@
 #include "OdaCommon.h"
 #include "ExSystemServices.h"
 #include "ExHostAppServices.h"
+#include "ExAsyncIOService.h"
+#include "ExPageController.h"
+#include <map>
+#include <mutex>
 
 class MyServices : public ExSystemServices, public ExHostAppServices
 {
+public:
+    MyServices() : m_nMemoryBudget(0) {}
+    ~MyServices()
+    {
+        std::lock_guard<std::mutex> lock(m_pageControllersMutex);
+        for (PageControllerMap::iterator it = m_pageControllers.begin(); it != m_pageControllers.end(); ++it)
+        {
+            it->second->m_pOwner = 0;
+        }
+    }
+
+    // Memory budget for database objects, 0 disables paging
+    void setMemoryBudget(OdUInt64 nBytes) { m_nMemoryBudget = nBytes; }
+    OdUInt64 memoryBudget() const { return m_nMemoryBudget; }
+
+    // Page controller of the database, NULL if it was read without a budget.
+    // Every database (main drawing, xrefs, wblock copies) gets its own one.
+    ExBudgetPageController* pageController(OdDbDatabase* pDb)
+    {
+        std::lock_guard<std::mutex> lock(m_pageControllersMutex);
+        PageControllerMap::iterator it = m_pageControllers.find(pDb);
+        return it != m_pageControllers.end() ? it->second : 0;
+    }
+
+    virtual OdDbPageControllerPtr newPageController() ODRX_OVERRIDE
+    {
+        if (!m_nMemoryBudget)
+        {
+            return OdDbPageControllerPtr();
+        }
+        OdSmartPtr<DbPageController> pController = OdRxObjectImpl<DbPageController>::createObject();
+        pController->m_pOwner = this;
+        pController->setBudget(m_nMemoryBudget);
+        return OdDbPageControllerPtr(pController.get());
+    }
+
 protected:
     ODRX_USING_HEAP_OPERATORS(ExSystemServices);
     virtual void warning(const char*, const OdString& msg) ODRX_OVERRIDE
@@ -13,5 +53,51 @@ protected:
         odPrintConsoleString(msg.c_str());
         odPrintConsoleString(L"\n");
     }
+
+private:
+    // Registers itself with the services when the SDK binds it to a database
+    class DbPageController : public ExBudgetPageController
+    {
+    public:
+        DbPageController() : m_pOwner(0) {}
+        ~DbPageController()
+        {
+            if (m_pOwner && database())
+            {
+                m_pOwner->bindPageController(database(), 0, this);
+            }
+        }
+
+        virtual void setDatabase(OdDbDatabase* pDb) ODRX_OVERRIDE
+        {
+            OdDbDatabase* pOldDb = database();
+            ExBudgetPageController::setDatabase(pDb);
+            if (m_pOwner)
+            {
+                m_pOwner->bindPageController(pOldDb, pDb, this);
+            }
+        }
+
+        MyServices* m_pOwner;
+    };
+    typedef std::map<OdDbDatabase*, DbPageController*> PageControllerMap;
+
+    void bindPageController(OdDbDatabase* pOldDb, OdDbDatabase* pDb, DbPageController* pController)
+    {
+        std::lock_guard<std::mutex> lock(m_pageControllersMutex);
+        PageControllerMap::iterator it = m_pageControllers.find(pOldDb);
+        if (pOldDb && it != m_pageControllers.end() && it->second == pController)
+        {
+            m_pageControllers.erase(it);
+        }
+        if (pDb)
+        {
+            m_pageControllers[pDb] = pController;
+        }
+    }
+
+    OdUInt64 m_nMemoryBudget;
+    std::mutex m_pageControllersMutex;
+    PageControllerMap m_pageControllers;
 };
 
@@ -0,0 +1,424 @@
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string.h>
+
+namespace UserFiles
+{
+	namespace
+	{
+		bool Intersects(const IndexBox& a, const IndexBox& b)
+		{
+			return a.dMinX <= b.dMaxX && a.dMaxX >= b.dMinX && a.dMinY <= b.dMaxY && a.dMaxY >= b.dMinY;
+		}
+
+		// 㵽ľ
+		double AxisDist(double d, double dMin, double dMax)
+		{
+			return d < dMin ? dMin - d : (d > dMax ? d - dMax : 0);
+		}
+
+		// ڲѯĺѡĿڵ
+		struct Candidate
+		{
+			double   dDist;
+			uint64_t nIndex;
+			bool     bItem;
+
+			bool operator>(const Candidate& other) const { return dDist > other.dDist; }
+		};
+	}
+
+	// Hilbert ֵ
+	uint32_t HilbertValue(uint32_t x, uint32_t y)
+	{
+		uint32_t a = x ^ y;
+		uint32_t b = 0xFFFF ^ a;
+		uint32_t c = 0xFFFF ^ (x | y);
+		uint32_t d = x & (y ^ 0xFFFF);
+
+		uint32_t A = a | (b >> 1);
+		uint32_t B = (a >> 1) ^ a;
+		uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+		uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+		a = A; b = B; c = C; d = D;
+		A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+		B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+		C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+		D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+		a = A; b = B; c = C; d = D;
+		A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+		B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+		C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+		D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+		a = A; b = B; c = C; d = D;
+		C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+		D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+		a = C ^ (C >> 1);
+		b = D ^ (D >> 1);
+
+		uint32_t i0 = x ^ y;
+		uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+		i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+		i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+		i0 = (i0 | (i0 << 2)) & 0x33333333;
+		i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+		i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+		i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+		i1 = (i1 | (i1 << 2)) & 0x33333333;
+		i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+		return (i1 << 1) | i0;
+	}
+
+	//  Hilbert ֵ
+	void HilbertSort(const std::vector<IndexBox>& vecBoxes, std::vector<uint32_t>& vecOrder)
+	{
+		vecOrder.resize(vecBoxes.size());
+		if (vecBoxes.empty())
+		{
+			return;
+		}
+
+		// ĵ㷶Χ
+		double dMinX = vecBoxes[0].dMinX + vecBoxes[0].dMaxX, dMaxX = dMinX;
+		double dMinY = vecBoxes[0].dMinY + vecBoxes[0].dMaxY, dMaxY = dMinY;
+		for (size_t i = 1; i < vecBoxes.size(); i++)
+		{
+			double cx = vecBoxes[i].dMinX + vecBoxes[i].dMaxX;
+			double cy = vecBoxes[i].dMinY + vecBoxes[i].dMaxY;
+			dMinX = std::min(dMinX, cx);
+			dMaxX = std::max(dMaxX, cx);
+			dMinY = std::min(dMinY, cy);
+			dMaxY = std::max(dMaxY, cy);
+		}
+		double dScaleX = dMaxX > dMinX ? 0xFFFF / (dMaxX - dMinX) : 0;
+		double dScaleY = dMaxY > dMinY ? 0xFFFF / (dMaxY - dMinY) : 0;
+
+		//  32 λΪ Hilbert ֵ 32 λΪ±
+		std::vector<uint64_t> vecKeys(vecBoxes.size());
+		for (size_t i = 0; i < vecBoxes.size(); i++)
+		{
+			uint32_t x = (uint32_t)((vecBoxes[i].dMinX + vecBoxes[i].dMaxX - dMinX) * dScaleX);
+			uint32_t y = (uint32_t)((vecBoxes[i].dMinY + vecBoxes[i].dMaxY - dMinY) * dScaleY);
+			vecKeys[i] = ((uint64_t)HilbertValue(std::min(x, 0xFFFFu), std::min(y, 0xFFFFu)) << 32) | i;
+		}
+		std::sort(vecKeys.begin(), vecKeys.end());
+		for (size_t i = 0; i < vecKeys.size(); i++)
+		{
+			vecOrder[i] = (uint32_t)vecKeys[i];
+		}
+	}
+
+	// 
+	void SpatialIndexWriter::Clear()
+	{
+		m_vecBoxes.clear();
+		m_vecIds.clear();
+	}
+
+	// Ŀ
+	void SpatialIndexWriter::Add(const IndexBox& box, uint32_t nId)
+	{
+		m_vecBoxes.push_back(box);
+		m_vecIds.push_back(nId);
+	}
+
+	// 
+	bool SpatialIndexWriter::Save(const std::string& sFile, uint32_t nNodeSize)
+	{
+		if (nNodeSize < 2)
+		{
+			nNodeSize = 2;
+		}
+
+		// ÿλ
+		uint64_t nItems = m_vecIds.size();
+		std::vector<uint64_t> vecLevels;
+		uint64_t nNodes = nItems;
+		if (nItems)
+		{
+			uint64_t nCount = nItems;
+			vecLevels.push_back(nNodes);
+			do
+			{
+				nCount = (nCount + nNodeSize - 1) / nNodeSize;
+				nNodes += nCount;
+				vecLevels.push_back(nNodes);
+			} while (nCount != 1);
+		}
+		if (nNodes > 0xFFFFFFFFu)
+		{
+			return false;
+		}
+
+		// Ŀ Hilbert ˳
+		std::vector<IndexBox> vecBoxes((size_t)nNodes);
+		std::vector<uint32_t> vecIndices((size_t)nNodes);
+		std::vector<uint32_t> vecOrder;
+		HilbertSort(m_vecBoxes, vecOrder);
+		for (size_t i = 0; i < vecOrder.size(); i++)
+		{
+			vecBoxes[i] = m_vecBoxes[vecOrder[i]];
+			vecIndices[i] = m_vecIds[vecOrder[i]];
+		}
+
+		// Եɽڵ
+		uint64_t nPos = 0;
+		uint64_t nOut = nItems;
+		for (size_t l = 0; l + 1 < vecLevels.size(); l++)
+		{
+			uint64_t nEnd = vecLevels[l];
+			while (nPos < nEnd)
+			{
+				uint64_t nFirst = nPos;
+				IndexBox box = vecBoxes[(size_t)nPos++];
+				for (uint32_t j = 1; j < nNodeSize && nPos < nEnd; j++, nPos++)
+				{
+					const IndexBox& child = vecBoxes[(size_t)nPos];
+					box.dMinX = std::min(box.dMinX, child.dMinX);
+					box.dMinY = std::min(box.dMinY, child.dMinY);
+					box.dMaxX = std::max(box.dMaxX, child.dMaxX);
+					box.dMaxY = std::max(box.dMaxY, child.dMaxY);
+				}
+				vecBoxes[(size_t)nOut] = box;
+				vecIndices[(size_t)nOut] = (uint32_t)nFirst;
+				nOut++;
+			}
+		}
+
+		IndexHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.szMagic, INDEXMAGIC, sizeof(header.szMagic));
+		header.nVersion = INDEXVERSION;
+		header.nNodeSize = nNodeSize;
+		header.nItems = nItems;
+		header.nNodes = nNodes;
+		header.nLevels = vecLevels.size();
+		header.nLevelsOffset = Align8(sizeof(IndexHeader));
+		header.nBoxesOffset = header.nLevelsOffset + Align8(vecLevels.size() * sizeof(uint64_t));
+		header.nIndicesOffset = header.nBoxesOffset + Align8(vecBoxes.size() * sizeof(IndexBox));
+
+		SafeFileWriter out(sFile);
+		if (!out.IsOpen())
+		{
+			return false;
+		}
+		out.WritePadded(&header, sizeof(header));
+		out.WritePadded(vecLevels.empty() ? NULL : &vecLevels[0], vecLevels.size() * sizeof(uint64_t));
+		out.WritePadded(vecBoxes.empty() ? NULL : &vecBoxes[0], vecBoxes.size() * sizeof(IndexBox));
+		out.WritePadded(vecIndices.empty() ? NULL : &vecIndices[0], vecIndices.size() * sizeof(uint32_t));
+		return out.Commit();
+	}
+
+	SpatialIndex::SpatialIndex()
+		: m_pHeader(NULL)
+		, m_pLevels(NULL)
+		, m_pBoxes(NULL)
+		, m_pIndices(NULL)
+	{
+	}
+
+	SpatialIndex::~SpatialIndex()
+	{
+		Close();
+	}
+
+	// ļ
+	bool SpatialIndex::Open(const std::string& sFile)
+	{
+		Close();
+
+		if (!m_file.Open(sFile) || m_file.Size() < sizeof(IndexHeader))
+		{
+			Close();
+			return false;
+		}
+
+		// Уļͷ͸ηΧ
+		uint64_t nSize = m_file.Size();
+		const IndexHeader* pHeader = (const IndexHeader*)m_file.Data();
+		if (memcmp(pHeader->szMagic, INDEXMAGIC, sizeof(pHeader->szMagic)) != 0
+			|| pHeader->nVersion != INDEXVERSION
+			|| pHeader->nNodeSize < 2
+			|| pHeader->nLevelsOffset % 8 || pHeader->nBoxesOffset % 8 || pHeader->nIndicesOffset % 8
+			|| pHeader->nNodes > nSize / sizeof(IndexBox)
+			|| pHeader->nLevels > nSize / sizeof(uint64_t)
+			|| pHeader->nItems > pHeader->nNodes
+			|| pHeader->nLevelsOffset + pHeader->nLevels * sizeof(uint64_t) > nSize
+			|| pHeader->nBoxesOffset + pHeader->nNodes * sizeof(IndexBox) > nSize
+			|| pHeader->nIndicesOffset + pHeader->nNodes * sizeof(uint32_t) > nSize
+			|| (pHeader->nNodes != 0) != (pHeader->nLevels != 0))
+		{
+			Close();
+			return false;
+		}
+
+		// ÿλñһֻиڵ
+		const uint64_t* pLevels = (const uint64_t*)(m_file.Data() + pHeader->nLevelsOffset);
+		if (pHeader->nLevels)
+		{
+			bool bValid = pLevels[0] == pHeader->nItems && pLevels[pHeader->nLevels - 1] == pHeader->nNodes;
+			for (uint64_t i = 1; bValid && i < pHeader->nLevels; i++)
+			{
+				bValid = pLevels[i] > pLevels[i - 1];
+			}
+			if (!bValid || pLevels[pHeader->nLevels - 1] - (pHeader->nLevels > 1 ? pLevels[pHeader->nLevels - 2] : 0) != 1)
+			{
+				Close();
+				return false;
+			}
+		}
+
+		m_pHeader = pHeader;
+		m_pLevels = pLevels;
+		m_pBoxes = (const IndexBox*)(m_file.Data() + pHeader->nBoxesOffset);
+		m_pIndices = (const uint32_t*)(m_file.Data() + pHeader->nIndicesOffset);
+		return true;
+	}
+
+	// رļ
+	void SpatialIndex::Close()
+	{
+		m_file.Close();
+		m_pHeader = NULL;
+		m_pLevels = NULL;
+		m_pBoxes = NULL;
+		m_pIndices = NULL;
+	}
+
+	// Ŀ
+	size_t SpatialIndex::Size() const
+	{
+		return m_pHeader ? (size_t)m_pHeader->nItems : 0;
+	}
+
+	// ܷΧ
+	bool SpatialIndex::Bounds(IndexBox& box) const
+	{
+		if (!m_pHeader || !m_pHeader->nNodes)
+		{
+			return false;
+		}
+		box = m_pBoxes[m_pHeader->nNodes - 1];
+		return true;
+	}
+
+	// ڵڲĽλ
+	uint64_t SpatialIndex::LevelEnd(uint64_t nNode) const
+	{
+		return *std::upper_bound(m_pLevels, m_pLevels + m_pHeader->nLevels, nNode);
+	}
+
+	// ڲѯ
+	size_t SpatialIndex::Search(const IndexBox& window, std::vector<uint32_t>& vecResult) const
+	{
+		if (!m_pHeader || !m_pHeader->nNodes)
+		{
+			return 0;
+		}
+
+		size_t nCount = 0;
+		std::vector<uint64_t> vecStack;
+		uint64_t nNode = m_pHeader->nNodes - 1;
+		for (;;)
+		{
+			uint64_t nEnd = std::min(nNode + m_pHeader->nNodeSize, LevelEnd(nNode));
+			bool bItems = nNode < m_pHeader->nItems;
+			for (uint64_t nPos = nNode; nPos < nEnd; nPos++)
+			{
+				if (!Intersects(window, m_pBoxes[nPos]))
+				{
+					continue;
+				}
+				if (bItems)
+				{
+					vecResult.push_back(m_pIndices[nPos]);
+					nCount++;
+				}
+				else if (m_pIndices[nPos] < nPos)
+				{
+					// ӽڵڸڵ֮ǰֹ𻵵ļѭ
+					vecStack.push_back(m_pIndices[nPos]);
+				}
+			}
+
+			if (vecStack.empty())
+			{
+				break;
+			}
+			nNode = vecStack.back();
+			vecStack.pop_back();
+		}
+		return nCount;
+	}
+
+	// ѯ
+	size_t SpatialIndex::SearchPoint(double x, double y, std::vector<uint32_t>& vecResult) const
+	{
+		IndexBox window = { x, y, x, y };
+		return Search(window, vecResult);
+	}
+
+	// ڲѯ
+	size_t SpatialIndex::Neighbors(double x, double y, size_t nCount, std::vector<uint32_t>& vecResult, double dMaxDist) const
+	{
+		if (!m_pHeader || !m_pHeader->nNodes || !nCount)
+		{
+			return 0;
+		}
+
+		// ȽϾƽ
+		double dMaxDistSq = dMaxDist < 0 ? -1 : dMaxDist * dMaxDist;
+		size_t nFound = 0;
+		std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > queue;
+		uint64_t nNode = m_pHeader->nNodes - 1;
+		for (;;)
+		{
+			uint64_t nEnd = std::min(nNode + m_pHeader->nNodeSize, LevelEnd(nNode));
+			bool bItems = nNode < m_pHeader->nItems;
+			for (uint64_t nPos = nNode; nPos < nEnd; nPos++)
+			{
+				const IndexBox& box = m_pBoxes[nPos];
+				double dx = AxisDist(x, box.dMinX, box.dMaxX);
+				double dy = AxisDist(y, box.dMinY, box.dMaxY);
+				Candidate cand;
+				cand.dDist = dx * dx + dy * dy;
+				cand.nIndex = m_pIndices[nPos];
+				cand.bItem = bItems;
+				if ((dMaxDistSq >= 0 && cand.dDist > dMaxDistSq) || (!bItems && cand.nIndex >= nPos))
+				{
+					continue;
+				}
+				queue.push(cand);
+			}
+
+			// ׵Ŀкѡ
+			while (!queue.empty() && queue.top().bItem)
+			{
+				vecResult.push_back((uint32_t)queue.top().nIndex);
+				queue.pop();
+				if (++nFound == nCount)
+				{
+					return nFound;
+				}
+			}
+
+			if (queue.empty())
+			{
+				break;
+			}
+			nNode = queue.top().nIndex;
+			queue.pop();
+		}
+		return nFound;
+	}
+
+}
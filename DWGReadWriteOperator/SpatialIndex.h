@@ -0,0 +1,115 @@
+#pragma once
+
+#include "FileOperator.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace UserFiles
+{
+
+// ռļ
+#define INDEXFILE "entities.idx"
+// ռļʶ
+#define INDEXMAGIC "DWGRTRE1"
+// ռ汾
+#define INDEXVERSION 1
+// ڵ
+#define INDEXNODESIZE 16
+
+	/*
+	* ̬ Hilbert R һδ޸ġļֽ֣8 ֽڶ룩
+	*   IndexHeader
+	*   uint64_t[nLevels]        ÿλã 0 ΪĿ
+	*   IndexBox[nNodes]         ԵУһΪ
+	*   uint32_t[nNodes]         ĿΪĿţΪһӽڵλ
+	*/
+
+	// ļͷ
+	struct IndexHeader
+	{
+		char     szMagic[8];
+		uint32_t nVersion;
+		uint32_t nNodeSize;
+		uint64_t nItems;
+		uint64_t nNodes;
+		uint64_t nLevels;
+		uint64_t nLevelsOffset;
+		uint64_t nBoxesOffset;
+		uint64_t nIndicesOffset;
+	};
+
+	// άΧ
+	struct IndexBox
+	{
+		double dMinX;
+		double dMinY;
+		double dMaxX;
+		double dMaxY;
+	};
+
+	// Hilbert ֵxy Ϊ 16 λ
+	uint32_t HilbertValue(uint32_t x, uint32_t y);
+	// Χĵ Hilbert ֵvecOrder ±˳
+	void HilbertSort(const std::vector<IndexBox>& vecBoxes, std::vector<uint32_t>& vecOrder);
+
+	// ռд
+	class SpatialIndexWriter
+	{
+	public:
+		// 
+		void Clear();
+		// ĿnId һΪʵеļ¼±
+		void Add(const IndexBox& box, uint32_t nId);
+		// Ŀ
+		size_t Size() const { return m_vecIds.size(); }
+		//  Hilbert ˳棺дʱļ滻Ŀļ
+		bool Save(const std::string& sFile, uint32_t nNodeSize = INDEXNODESIZE);
+
+	private:
+		std::vector<IndexBox> m_vecBoxes;
+		std::vector<uint32_t> m_vecIds;
+	};
+
+	// ռȡӳļֱڽڵϲѯ
+	class SpatialIndex
+	{
+	public:
+		SpatialIndex();
+		~SpatialIndex();
+
+		// ļ
+		bool Open(const std::string& sFile);
+		// رļ
+		void Close();
+		// ǷѴ
+		bool IsOpen() const { return m_pHeader != NULL; }
+
+		// Ŀ
+		size_t Size() const;
+		// ܷΧûĿʱ false
+		bool Bounds(IndexBox& box) const;
+
+		// ڲѯ봰ཻĿƥ
+		size_t Search(const IndexBox& window, std::vector<uint32_t>& vecResult) const;
+		// ѯõĿ
+		size_t SearchPoint(double x, double y, std::vector<uint32_t>& vecResult) const;
+		//  nCount ĿΧеľdMaxDist С 0 ʱ޾
+		size_t Neighbors(double x, double y, size_t nCount, std::vector<uint32_t>& vecResult, double dMaxDist = -1) const;
+
+	private:
+		// ڵڲĽλ
+		uint64_t LevelEnd(uint64_t nNode) const;
+
+		SpatialIndex(const SpatialIndex&);
+		SpatialIndex& operator=(const SpatialIndex&);
+
+	private:
+		MappedFile m_file;
+		const IndexHeader* m_pHeader;
+		const uint64_t* m_pLevels;
+		const IndexBox* m_pBoxes;
+		const uint32_t* m_pIndices;
+	};
+
+}
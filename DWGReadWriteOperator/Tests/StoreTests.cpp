@@ -0,0 +1,287 @@
+// ʵ⡢ռλͼ
+//  EntityStore.cppSpatialIndex.cppBitmapIndex.cppFileOperator.cpp һΪ̨
+// ڵǰĿ¼ʱļʧܵļ
+#include "../EntityStore.h"
+#include "../SpatialIndex.h"
+#include "../BitmapIndex.h"
+#include <algorithm>
+#include <random>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+
+using namespace UserFiles;
+
+namespace
+{
+	int g_nFailed = 0;
+
+#define STORE_CHECK(expr) \
+	do { if (!(expr)) { printf("%s(%d): %s\n", __FILE__, __LINE__, #expr); g_nFailed++; } } while (0)
+
+	// ļ
+	const char* const TESTSTORE = "StoreTests.bin";
+	const char* const TESTINDEX = "StoreTests.idx";
+	const char* const TESTBITMAP = "StoreTests.bmi";
+
+	// ΧǷཻ
+	bool Intersects(const IndexBox& a, const IndexBox& b)
+	{
+		return a.dMinX <= b.dMaxX && a.dMaxX >= b.dMinX && a.dMinY <= b.dMaxY && a.dMaxY >= b.dMinY;
+	}
+
+	// ݣPolyData + 
+	std::vector<char> MakePoly(uint32_t nVerts, int16_t nColorIndex)
+	{
+		std::vector<char> vecData(sizeof(PolyData) + nVerts * 2 * sizeof(double));
+		PolyData* pData = (PolyData*)&vecData[0];
+		pData->nVerts = nVerts;
+		pData->nColorIndex = nColorIndex;
+		pData->dScale = 1.0;
+		double* pPoints = (double*)(pData + 1);
+		for (uint32_t i = 0; i < nVerts * 2; i++)
+		{
+			pPoints[i] = i * 0.5;
+		}
+		return vecData;
+	}
+
+	// ʵ⣺дӳȡ¼ݡͼдһ
+	void TestEntityStore(bool bSpatialOrder)
+	{
+		std::mt19937 rng(1);
+		EntityStoreWriter writer;
+		writer.SetSpatialOrder(bSpatialOrder);
+		uint32_t nLayer0 = writer.AddLayer("0");
+		uint32_t nLayer1 = writer.AddLayer("Walls");
+		STORE_CHECK(writer.AddLayer("0") == nLayer0);
+
+		// ӣӦÿ 7 ʵһûаΧ
+		const uint32_t nCount = 1000;
+		for (uint32_t i = nCount; i > 0; i--)
+		{
+			double dMin[3] = { (double)(rng() % 1000), (double)(rng() % 1000), 0 };
+			double dMax[3] = { dMin[0] + rng() % 10, dMin[1] + rng() % 10, 0 };
+			std::vector<char> vecData = MakePoly(i % 5, (int16_t)(i % 3));
+			bool bExtents = i % 7 != 0;
+			writer.AddEntity(i * 2, i % 2 ? kPoly : kText, i % 2 ? nLayer0 : nLayer1,
+				bExtents ? dMin : NULL, bExtents ? dMax : NULL, &vecData[0], vecData.size());
+		}
+		STORE_CHECK(writer.Save(TESTSTORE));
+
+		EntityStore store;
+		STORE_CHECK(store.Open(TESTSTORE));
+		STORE_CHECK(store.Size() == nCount);
+		if (store.Size() != nCount)
+		{
+			return;
+		}
+		const std::vector<EntityRecord>& vecRecords = writer.Records();
+		for (size_t i = 0; i < nCount; i++)
+		{
+			const EntityRecord& rec = store.Records()[i];
+			STORE_CHECK(i == 0 || store.Records()[i - 1].nHandle < rec.nHandle);
+			STORE_CHECK(memcmp(&rec, &vecRecords[i], sizeof(rec)) == 0);
+			STORE_CHECK(store.Find(rec.nHandle) == &rec);
+			STORE_CHECK(!store.Find(rec.nHandle + 1));
+			STORE_CHECK(((rec.nFlags & kRecNoExtents) != 0) == (rec.nHandle % 14 == 0));
+
+			//  8 ֽڶ룬дһ
+			const PolyData* pData = (const PolyData*)store.Data(rec);
+			STORE_CHECK(pData && ((uintptr_t)pData) % 8 == 0);
+			STORE_CHECK(pData && memcmp(pData, writer.Data(vecRecords[i]), rec.nSize) == 0);
+			STORE_CHECK(pData && pData->nVerts == (rec.nHandle / 2) % 5);
+		}
+
+		// ɨȽһ£ûаΧеʵ岻뷶Χɨ
+		std::vector<uint32_t> vecResult;
+		STORE_CHECK(store.ScanType(kPoly, vecResult) == nCount / 2);
+		vecResult.clear();
+		STORE_CHECK(store.ScanLayer(nLayer1, vecResult) == nCount / 2);
+		double dMin[2] = { 100, 100 }, dMax[2] = { 300, 300 };
+		vecResult.clear();
+		store.ScanExtents(dMin, dMax, vecResult);
+		size_t nExpected = 0;
+		for (size_t i = 0; i < nCount; i++)
+		{
+			const EntityRecord& rec = store.Records()[i];
+			if (!(rec.nFlags & kRecNoExtents) && rec.dMin[0] <= dMax[0] && rec.dMax[0] >= dMin[0]
+				&& rec.dMin[1] <= dMax[1] && rec.dMax[1] >= dMin[1])
+			{
+				nExpected++;
+			}
+		}
+		STORE_CHECK(vecResult.size() == nExpected);
+
+		uint32_t nLayer = 0;
+		STORE_CHECK(store.NumLayers() == 2);
+		STORE_CHECK(store.LayerName(nLayer1) && strcmp(store.LayerName(nLayer1), "Walls") == 0);
+		STORE_CHECK(!store.LayerName(2));
+		STORE_CHECK(store.FindLayer("Walls", nLayer) && nLayer == nLayer1);
+		STORE_CHECK(!store.FindLayer("Doors", nLayer));
+		store.Close();
+	}
+
+	// ռڲѯȽһ£ڰ
+	void TestSpatialIndex()
+	{
+		std::mt19937 rng(2);
+		std::uniform_real_distribution<double> coord(0, 1000);
+		const size_t vecCounts[] = { 0, 1, 16, 17, 3000 };
+		for (size_t c = 0; c < sizeof(vecCounts) / sizeof(vecCounts[0]); c++)
+		{
+			SpatialIndexWriter writer;
+			std::vector<IndexBox> vecBoxes;
+			for (size_t i = 0; i < vecCounts[c]; i++)
+			{
+				double x = coord(rng), y = coord(rng), s = coord(rng) / 50;
+				IndexBox box = { x, y, x + s, y + s };
+				vecBoxes.push_back(box);
+				writer.Add(box, (uint32_t)i);
+			}
+			STORE_CHECK(writer.Save(TESTINDEX, 4));
+
+			SpatialIndex index;
+			STORE_CHECK(index.Open(TESTINDEX));
+			STORE_CHECK(index.Size() == vecBoxes.size());
+			for (int q = 0; q < 50; q++)
+			{
+				double x = coord(rng), y = coord(rng), e = coord(rng) / 5;
+				IndexBox window = { x, y, x + e, y + e };
+				std::vector<uint32_t> vecResult;
+				index.Search(window, vecResult);
+				std::set<uint32_t> setFound(vecResult.begin(), vecResult.end()), setExpected;
+				for (size_t i = 0; i < vecBoxes.size(); i++)
+				{
+					if (Intersects(vecBoxes[i], window))
+					{
+						setExpected.insert((uint32_t)i);
+					}
+				}
+				STORE_CHECK(setFound == setExpected && vecResult.size() == setExpected.size());
+
+				// ڣȷ벻
+				std::vector<uint32_t> vecNear;
+				index.Neighbors(x, y, 5, vecNear);
+				STORE_CHECK(vecNear.size() == std::min<size_t>(5, vecBoxes.size()));
+				double dLast = 0;
+				for (size_t i = 0; i < vecNear.size(); i++)
+				{
+					const IndexBox& b = vecBoxes[vecNear[i]];
+					double dx = x < b.dMinX ? b.dMinX - x : (x > b.dMaxX ? x - b.dMaxX : 0);
+					double dy = y < b.dMinY ? b.dMinY - y : (y > b.dMaxY ? y - b.dMaxY : 0);
+					double d = dx * dx + dy * dy;
+					STORE_CHECK(d >= dLast);
+					dLast = d;
+				}
+			}
+			index.Close();
+		}
+	}
+
+	// λͼ std::set һ£лز
+	void TestBitmap()
+	{
+		std::mt19937 rng(3);
+		const uint32_t nUniverse = 200000;
+		const size_t vecCounts[] = { 100, 20000, 150000 };
+		for (size_t c = 0; c < sizeof(vecCounts) / sizeof(vecCounts[0]); c++)
+		{
+			Bitmap a, b;
+			std::set<uint32_t> setA, setB;
+			for (size_t i = 0; i < vecCounts[c]; i++)
+			{
+				uint32_t n = rng() % nUniverse;
+				a.Add(n);
+				setA.insert(n);
+			}
+			for (uint32_t i = 0; i < 5000; i++)
+			{
+				b.Add(i * 3);
+				setB.insert(i * 3);
+			}
+
+			std::vector<uint32_t> vecValues;
+			a.ToVector(vecValues);
+			STORE_CHECK(std::vector<uint32_t>(setA.begin(), setA.end()) == vecValues);
+			STORE_CHECK(a.Cardinality() == setA.size());
+
+			std::vector<uint32_t> vecExpected;
+			std::set_intersection(setA.begin(), setA.end(), setB.begin(), setB.end(), std::back_inserter(vecExpected));
+			vecValues.clear();
+			a.And(b).ToVector(vecValues);
+			STORE_CHECK(vecValues == vecExpected);
+			vecExpected.clear();
+			vecValues.clear();
+			std::set_union(setA.begin(), setA.end(), setB.begin(), setB.end(), std::back_inserter(vecExpected));
+			a.Or(b).ToVector(vecValues);
+			STORE_CHECK(vecValues == vecExpected);
+			vecExpected.clear();
+			vecValues.clear();
+			std::set_difference(setA.begin(), setA.end(), setB.begin(), setB.end(), std::back_inserter(vecExpected));
+			a.AndNot(b).ToVector(vecValues);
+			STORE_CHECK(vecValues == vecExpected);
+			STORE_CHECK(a.Not(nUniverse).Cardinality() == nUniverse - setA.size());
+
+			std::vector<char> vecOut;
+			a.Write(vecOut);
+			Bitmap r;
+			STORE_CHECK(r.Read(&vecOut[0], vecOut.size()));
+			vecValues.clear();
+			r.ToVector(vecValues);
+			STORE_CHECK(std::vector<uint32_t>(setA.begin(), setA.end()) == vecValues);
+			STORE_CHECK(!r.Read(&vecOut[0], vecOut.size() - 1));
+		}
+	}
+
+	// λͼֵֶȡصλͼдһ
+	void TestBitmapIndex()
+	{
+		const uint32_t nUniverse = 10000;
+		BitmapIndexWriter writer;
+		writer.SetUniverse(nUniverse);
+		for (uint32_t i = 0; i < nUniverse; i++)
+		{
+			writer.Add(kFieldLayer, (int32_t)(i % 10), i);
+			writer.Add(kFieldColorIndex, (int32_t)(i % 256) - 1, i);
+		}
+		STORE_CHECK(writer.Save(TESTBITMAP));
+
+		BitmapIndex index;
+		STORE_CHECK(index.Open(TESTBITMAP));
+		STORE_CHECK(index.Universe() == nUniverse);
+
+		std::vector<int32_t> vecFieldValues;
+		index.Values(kFieldLayer, vecFieldValues);
+		STORE_CHECK(vecFieldValues.size() == 10);
+		Bitmap bitmap;
+		STORE_CHECK(index.Get(kFieldLayer, 3, bitmap));
+		STORE_CHECK(bitmap.Cardinality() == nUniverse / 10);
+		STORE_CHECK(bitmap.Contains(13) && !bitmap.Contains(14));
+		STORE_CHECK(index.Get(kFieldColorIndex, -1, bitmap) && bitmap.Contains(0) && bitmap.Contains(256));
+		STORE_CHECK(!index.Get(kFieldType, 0, bitmap) && bitmap.Empty());
+
+		std::vector<int32_t> vecAny;
+		vecAny.push_back(1);
+		vecAny.push_back(2);
+		STORE_CHECK(index.GetAny(kFieldLayer, vecAny).Cardinality() == nUniverse / 5);
+		STORE_CHECK(index.All().Cardinality() == nUniverse);
+		index.Close();
+	}
+}
+
+int main()
+{
+	TestEntityStore(false);
+	TestEntityStore(true);
+	TestSpatialIndex();
+	TestBitmap();
+	TestBitmapIndex();
+
+	remove(TESTSTORE);
+	remove(TESTINDEX);
+	remove(TESTBITMAP);
+
+	printf(g_nFailed ? "%d checks failed\n" : "All checks passed\n", g_nFailed);
+	return g_nFailed;
+}
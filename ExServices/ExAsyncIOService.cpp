@@ -0,0 +1,1058 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OdaCommon.h"
+#include "ExAsyncIOService.h"
+#include "OdStreamBuf.h"
+#include "RxSystemServices.h"
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#if defined(ODA_WINDOWS) && !defined(_WINRT)
+#include <windows.h>
+#define EXASYNCIO_WIN_FILE
+#elif defined(OD_HAVE_UNISTD_FILE)
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#define EXASYNCIO_UNISTD_FILE
+#endif
+
+#if defined(EXASYNCIO_UNISTD_FILE) && defined(__linux__) && !defined(EMCC) && !defined(EXASYNCIO_NO_IO_URING)
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sched.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define EXASYNCIO_HAVE_IO_URING
+#endif
+#endif
+
+namespace
+{
+  //----------------------------------------------------------
+  //
+  // AsyncFile
+  //
+  //----------------------------------------------------------
+
+  // File requests are performed on. Files opened by name are accessed with
+  // positional I/O and need no locking; streams passed in by the caller are
+  // accessed under m_mutex.
+  class AsyncFile
+  {
+  public:
+#if defined(EXASYNCIO_WIN_FILE)
+    HANDLE         m_hFile;
+#elif defined(EXASYNCIO_UNISTD_FILE)
+    int            m_fd;
+#endif
+    OdStreamBufPtr m_pStream;
+    std::mutex     m_mutex;
+
+    AsyncFile()
+    {
+#if defined(EXASYNCIO_WIN_FILE)
+      m_hFile = INVALID_HANDLE_VALUE;
+#elif defined(EXASYNCIO_UNISTD_FILE)
+      m_fd = -1;
+#endif
+    }
+
+    ~AsyncFile()
+    {
+#if defined(EXASYNCIO_WIN_FILE)
+      if (m_hFile != INVALID_HANDLE_VALUE)
+        ::CloseHandle(m_hFile);
+#elif defined(EXASYNCIO_UNISTD_FILE)
+      if (m_fd >= 0)
+        ::close(m_fd);
+#endif
+    }
+
+    // Returns the descriptor io_uring requests can use, or -1.
+    int descriptor() const
+    {
+#if defined(EXASYNCIO_UNISTD_FILE)
+      return m_fd;
+#else
+      return -1;
+#endif
+    }
+
+    bool open(const OdAsyncOpenFileRequest& request)
+    {
+      if (!request.m_pFileStream.isNull())
+      {
+        m_pStream = request.m_pFileStream;
+        return true;
+      }
+      if (request.m_filename.isEmpty())
+        return false;
+#if defined(EXASYNCIO_WIN_FILE)
+      DWORD dwAccess = 0;
+      if (request.m_accessMode & Oda::kFileRead)
+        dwAccess |= GENERIC_READ;
+      if (request.m_accessMode & Oda::kFileWrite)
+        dwAccess |= GENERIC_WRITE;
+      DWORD dwShare = 0;
+      if (request.m_shareMode != Oda::kShareDenyRead && request.m_shareMode != Oda::kShareDenyReadWrite)
+        dwShare |= FILE_SHARE_READ;
+      if (request.m_shareMode != Oda::kShareDenyWrite && request.m_shareMode != Oda::kShareDenyReadWrite)
+        dwShare |= FILE_SHARE_WRITE;
+      DWORD dwDisposition = OPEN_EXISTING;
+      switch (request.m_creationDisposition)
+      {
+      case Oda::kCreateNew:         dwDisposition = CREATE_NEW;        break;
+      case Oda::kCreateAlways:      dwDisposition = CREATE_ALWAYS;     break;
+      case Oda::kOpenExisting:      dwDisposition = OPEN_EXISTING;     break;
+      case Oda::kOpenAlways:        dwDisposition = OPEN_ALWAYS;       break;
+      case Oda::kTruncateExisting:  dwDisposition = TRUNCATE_EXISTING; break;
+      }
+      m_hFile = ::CreateFileW(request.m_filename.c_str(), dwAccess, dwShare, NULL, dwDisposition, FILE_FLAG_RANDOM_ACCESS, NULL);
+      return m_hFile != INVALID_HANDLE_VALUE;
+#elif defined(EXASYNCIO_UNISTD_FILE)
+      int flags = 0;
+      if ((request.m_accessMode & Oda::kFileRead) && (request.m_accessMode & Oda::kFileWrite))
+        flags = O_RDWR;
+      else if (request.m_accessMode & Oda::kFileWrite)
+        flags = O_WRONLY;
+      else
+        flags = O_RDONLY;
+      switch (request.m_creationDisposition)
+      {
+      case Oda::kCreateNew:         flags |= O_CREAT | O_EXCL;  break;
+      case Oda::kCreateAlways:      flags |= O_CREAT | O_TRUNC; break;
+      case Oda::kOpenAlways:        flags |= O_CREAT;           break;
+      case Oda::kTruncateExisting:  flags |= O_TRUNC;           break;
+      default:                                                  break;
+      }
+#ifdef O_CLOEXEC
+      flags |= O_CLOEXEC;
+#endif
+#ifdef OD_CONVERT_UNICODETOUTF8
+      OdAnsiString nAnsiUtf8(request.m_filename, CP_UTF_8);
+      const char* fName = nAnsiUtf8.c_str();
+#else
+      const char* fName = (const char*)request.m_filename;
+#endif
+      do
+      {
+        m_fd = ::open(fName, flags, 0666);
+      }
+      while (m_fd < 0 && errno == EINTR);
+      return m_fd >= 0;
+#else
+      try
+      {
+        m_pStream = ::odrxSystemServices()->createFile(request.m_filename, request.m_accessMode,
+          request.m_shareMode, request.m_creationDisposition);
+      }
+      catch (const OdError&)
+      {
+        return false;
+      }
+      return !m_pStream.isNull();
+#endif
+    }
+
+    // Reads up to numBytes at offset; nRead is less than numBytes at the end of file.
+    bool readAt(OdUInt8* pBuf, OdUInt32 numBytes, OdUInt64 offset, OdUInt32& nRead)
+    {
+      nRead = 0;
+      if (!m_pStream.isNull())
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        try
+        {
+          OdUInt64 len = m_pStream->length();
+          if (offset < len)
+          {
+            OdUInt32 n = (OdUInt32)odmin(OdUInt64(numBytes), len - offset);
+            m_pStream->seek(offset, OdDb::kSeekFromStart);
+            m_pStream->getBytes(pBuf, n);
+            nRead = n;
+          }
+        }
+        catch (const OdError&)
+        {
+          return false;
+        }
+        return true;
+      }
+#if defined(EXASYNCIO_WIN_FILE)
+      while (nRead < numBytes)
+      {
+        OVERLAPPED ov;
+        ::ZeroMemory(&ov, sizeof(ov));
+        ULARGE_INTEGER pos;
+        pos.QuadPart = offset + nRead;
+        ov.Offset = pos.LowPart;
+        ov.OffsetHigh = pos.HighPart;
+        DWORD n = 0;
+        if (!::ReadFile(m_hFile, pBuf + nRead, numBytes - nRead, &n, &ov))
+          return ::GetLastError() == ERROR_HANDLE_EOF;
+        if (!n)
+          break;
+        nRead += n;
+      }
+      return true;
+#elif defined(EXASYNCIO_UNISTD_FILE)
+      while (nRead < numBytes)
+      {
+        ssize_t n = ::pread(m_fd, pBuf + nRead, numBytes - nRead, (off_t)(offset + nRead));
+        if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+        if (!n)
+          break;
+        nRead += (OdUInt32)n;
+      }
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    bool writeAt(const OdUInt8* pBuf, OdUInt32 numBytes, OdUInt64 offset)
+    {
+      if (!m_pStream.isNull())
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        try
+        {
+          m_pStream->seek(offset, OdDb::kSeekFromStart);
+          m_pStream->putBytes(pBuf, numBytes);
+        }
+        catch (const OdError&)
+        {
+          return false;
+        }
+        return true;
+      }
+#if defined(EXASYNCIO_WIN_FILE)
+      OdUInt32 nWritten = 0;
+      while (nWritten < numBytes)
+      {
+        OVERLAPPED ov;
+        ::ZeroMemory(&ov, sizeof(ov));
+        ULARGE_INTEGER pos;
+        pos.QuadPart = offset + nWritten;
+        ov.Offset = pos.LowPart;
+        ov.OffsetHigh = pos.HighPart;
+        DWORD n = 0;
+        if (!::WriteFile(m_hFile, pBuf + nWritten, numBytes - nWritten, &n, &ov) || !n)
+          return false;
+        nWritten += n;
+      }
+      return true;
+#elif defined(EXASYNCIO_UNISTD_FILE)
+      OdUInt32 nWritten = 0;
+      while (nWritten < numBytes)
+      {
+        ssize_t n = ::pwrite(m_fd, pBuf + nWritten, numBytes - nWritten, (off_t)(offset + nWritten));
+        if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+        if (!n)
+          return false;
+        nWritten += (OdUInt32)n;
+      }
+      return true;
+#else
+      return false;
+#endif
+    }
+  };
+  typedef std::shared_ptr<AsyncFile> AsyncFilePtr;
+
+#ifdef EXASYNCIO_HAVE_IO_URING
+  //----------------------------------------------------------
+  //
+  // IoUring
+  //
+  //----------------------------------------------------------
+
+  // Minimal io_uring instance owned by one I/O thread. run() submits a batch of
+  // reads and writes with a single system call and waits for all of them.
+  class IoUring
+  {
+    int            m_fd;
+    void*          m_pSqRing;
+    size_t         m_sqRingSize;
+    void*          m_pCqRing;
+    size_t         m_cqRingSize;
+    io_uring_sqe*  m_pSqes;
+    size_t         m_sqesSize;
+    unsigned*      m_pSqTail;
+    unsigned*      m_pSqMask;
+    unsigned*      m_pSqArray;
+    unsigned*      m_pCqHead;
+    unsigned*      m_pCqTail;
+    unsigned*      m_pCqMask;
+    io_uring_cqe*  m_pCqes;
+    unsigned       m_entries;
+
+    IoUring(const IoUring&);
+    IoUring& operator = (const IoUring&);
+
+    static int enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+      return (int)::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+    }
+
+  public:
+    struct Op
+    {
+      bool          m_bWrite;
+      int           m_fd;
+      struct iovec  m_iov;
+      OdUInt64      m_offset;
+      int           m_result;  // bytes transferred or -errno
+    };
+
+    IoUring()
+      : m_fd(-1), m_pSqRing(MAP_FAILED), m_sqRingSize(0), m_pCqRing(MAP_FAILED), m_cqRingSize(0)
+      , m_pSqes((io_uring_sqe*)MAP_FAILED), m_sqesSize(0), m_entries(0)
+    {
+    }
+
+    ~IoUring()
+    {
+      if (m_pSqes != MAP_FAILED)
+        ::munmap(m_pSqes, m_sqesSize);
+      if (m_pCqRing != MAP_FAILED && m_pCqRing != m_pSqRing)
+        ::munmap(m_pCqRing, m_cqRingSize);
+      if (m_pSqRing != MAP_FAILED)
+        ::munmap(m_pSqRing, m_sqRingSize);
+      if (m_fd >= 0)
+        ::close(m_fd);
+    }
+
+    unsigned entries() const { return m_entries; }
+
+    // Returns false if the kernel doesn't provide io_uring (or it is disabled).
+    bool init(unsigned entries)
+    {
+      io_uring_params params;
+      ::memset(&params, 0, sizeof(params));
+      m_fd = (int)::syscall(__NR_io_uring_setup, entries, &params);
+      if (m_fd < 0)
+        return false;
+
+      m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      bool bSingleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+      if (bSingleMmap)
+        m_sqRingSize = m_cqRingSize = odmax(m_sqRingSize, m_cqRingSize);
+
+      m_pSqRing = ::mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+      if (m_pSqRing == MAP_FAILED)
+        return false;
+      m_pCqRing = bSingleMmap ? m_pSqRing
+        : ::mmap(NULL, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+      if (m_pCqRing == MAP_FAILED)
+        return false;
+      m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+      m_pSqes = (io_uring_sqe*)::mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+      if (m_pSqes == MAP_FAILED)
+        return false;
+
+      OdUInt8* pSq = (OdUInt8*)m_pSqRing;
+      m_pSqTail  = (unsigned*)(pSq + params.sq_off.tail);
+      m_pSqMask  = (unsigned*)(pSq + params.sq_off.ring_mask);
+      m_pSqArray = (unsigned*)(pSq + params.sq_off.array);
+      OdUInt8* pCq = (OdUInt8*)m_pCqRing;
+      m_pCqHead  = (unsigned*)(pCq + params.cq_off.head);
+      m_pCqTail  = (unsigned*)(pCq + params.cq_off.tail);
+      m_pCqMask  = (unsigned*)(pCq + params.cq_off.ring_mask);
+      m_pCqes    = (io_uring_cqe*)(pCq + params.cq_off.cqes);
+      m_entries  = params.sq_entries;
+      return true;
+    }
+
+    // Moves the available completions to the operations, returns their number.
+    unsigned reap(Op* pOps)
+    {
+      unsigned nReaped = 0;
+      unsigned head = __atomic_load_n(m_pCqHead, __ATOMIC_RELAXED);
+      unsigned cqTail = __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE);
+      for (; head != cqTail; ++head)
+      {
+        const io_uring_cqe& cqe = m_pCqes[head & *m_pCqMask];
+        pOps[cqe.user_data].m_result = cqe.res;
+        ++nReaped;
+      }
+      __atomic_store_n(m_pCqHead, head, __ATOMIC_RELEASE);
+      return nReaped;
+    }
+
+    // Performs at most entries() operations. Returns false if not all of them
+    // could be submitted; m_result of the operations that didn't complete is
+    // left unchanged then. The kernel doesn't reference pOps on return.
+    bool run(Op* pOps, unsigned nOps)
+    {
+      ODA_ASSERT(nOps <= m_entries);
+      unsigned tail = __atomic_load_n(m_pSqTail, __ATOMIC_ACQUIRE);
+      unsigned mask = *m_pSqMask;
+      for (unsigned i = 0; i < nOps; ++i, ++tail)
+      {
+        unsigned idx = tail & mask;
+        io_uring_sqe* pSqe = m_pSqes + idx;
+        ::memset(pSqe, 0, sizeof(*pSqe));
+        pSqe->opcode = pOps[i].m_bWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+        pSqe->fd = pOps[i].m_fd;
+        pSqe->addr = (OdUInt64)(size_t)&pOps[i].m_iov;
+        pSqe->len = 1;
+        pSqe->off = pOps[i].m_offset;
+        pSqe->user_data = i;
+        m_pSqArray[idx] = idx;
+      }
+      __atomic_store_n(m_pSqTail, tail, __ATOMIC_RELEASE);
+
+      unsigned nSubmitted = 0, nCompleted = 0;
+      bool bFailed = false;
+      while (nCompleted < nSubmitted || (!bFailed && nSubmitted < nOps))
+      {
+        // after a failure only wait for the operations already in flight
+        int res = enter(m_fd, bFailed ? 0 : nOps - nSubmitted, 1, IORING_ENTER_GETEVENTS);
+        if (res < 0)
+        {
+          if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+          {
+            if (bFailed)
+              ::sched_yield(); // can't wait in the kernel, poll the completion queue
+            bFailed = true;
+          }
+        }
+        else if (!bFailed)
+          nSubmitted += (unsigned)res;
+        nCompleted += reap(pOps);
+      }
+      if (bFailed)
+      {
+        // take back the entries the kernel didn't consume
+        __atomic_store_n(m_pSqTail, tail - (nOps - nSubmitted), __ATOMIC_RELEASE);
+        return false;
+      }
+      return true;
+    }
+  };
+#endif // EXASYNCIO_HAVE_IO_URING
+}
+
+//----------------------------------------------------------
+//
+// ExAsyncIORequestHandler::Impl
+//
+//----------------------------------------------------------
+
+struct ExAsyncIORequestHandler::Impl
+{
+  enum JobType
+  {
+    kOpenJob,
+    kReadJob,
+    kWriteJob
+  };
+
+  struct Job
+  {
+    JobType        m_type;
+    OdUInt64       m_request;
+    OdUInt64       m_receiver;
+    bool           m_bAsync;
+    AsyncFilePtr   m_pFile;        // NULL if the file descriptor is not valid
+    OdUInt64       m_offset;
+    OdUInt64       m_size;
+    const OdUInt8* m_pData;        // data to write
+    std::shared_ptr<OdAsyncOpenFileRequest> m_pOpen;
+    OdAsyncIO::OdAsyncIOResult m_error;  // reported without processing the job
+
+    Job()
+      : m_type(kReadJob), m_request(0), m_receiver(0), m_bAsync(true)
+      , m_offset(0), m_size(0), m_pData(NULL), m_error(OdAsyncIO::Success)
+    {
+    }
+  };
+
+  struct Request
+  {
+    OdAsyncIO::OdAsyncIOResult m_status;
+    OdUInt64 m_fileDescriptor;
+    OdUInt8* m_pData;
+    OdUInt32 m_dataSize;
+    bool     m_bCancelled;
+  };
+
+  Options                         m_options;
+  std::mutex                      m_mutex;       // protects all members below
+  std::condition_variable         m_jobReady;
+  std::deque<Job>                 m_jobs;
+  std::map<OdUInt64, Request>     m_requests;
+  std::map<OdUInt64, AsyncFilePtr> m_files;
+  OdUInt64                        m_nextRequest;
+  OdUInt64                        m_nextFile;
+  bool                            m_bStop;
+  bool                            m_bIoUring;
+  std::vector<std::thread>        m_threads;
+  bool                            m_bDeleteOnExit;  // set by the worker that destroyed the handler
+
+  Impl()
+    : m_nextRequest(0)
+    , m_nextFile(0)
+    , m_bStop(false)
+    , m_bIoUring(false)
+    , m_bDeleteOnExit(false)
+  {
+    m_options = defaultOptions();
+  }
+
+  ~Impl()
+  {
+    for (std::map<OdUInt64, Request>::iterator it = m_requests.begin(); it != m_requests.end(); ++it)
+      ::odrxFree(it->second.m_pData);
+  }
+
+  void start(const Options& options)
+  {
+    m_options = options;
+    if (!m_options.m_numThreads)
+      m_options.m_numThreads = 1;
+    if (!m_options.m_queueDepth)
+      m_options.m_queueDepth = 1;
+    m_bStop = false;
+    m_bIoUring = false;
+#ifdef EXASYNCIO_HAVE_IO_URING
+    if (m_options.m_bUseIoUring)
+    {
+      // probe once, each thread creates its own instance
+      IoUring probe;
+      m_bIoUring = probe.init(m_options.m_queueDepth);
+    }
+#endif
+    for (OdUInt32 i = 0; i < m_options.m_numThreads; ++i)
+      m_threads.push_back(std::thread(&Impl::run, this));
+  }
+
+  // Stops the workers. Returns false if called on a worker, for example when a
+  // completion callback releases the service: that thread can't join itself, so
+  // it is detached and, with bDeleteOnExit, deletes this object when it leaves run().
+  bool stop(bool bDeleteOnExit)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_bStop = true;
+    }
+    m_jobReady.notify_all();
+    bool bOnWorker = false;
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+      if (m_threads[i].get_id() == std::this_thread::get_id())
+      {
+        m_threads[i].detach();
+        bOnWorker = true;
+      }
+      else
+        m_threads[i].join();
+    }
+    m_threads.clear();
+    m_bDeleteOnExit = bOnWorker && bDeleteOnExit;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_files.clear();
+    return !bOnWorker;
+  }
+
+  AsyncFilePtr file(OdUInt64 fileDescriptor)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<OdUInt64, AsyncFilePtr>::const_iterator it = m_files.find(fileDescriptor);
+    return it != m_files.end() ? it->second : AsyncFilePtr();
+  }
+
+  void post(Job& job)
+  {
+    bool bUnknownFile = false;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::map<OdUInt64, Request>::iterator it = m_requests.find(job.m_request);
+      if (it != m_requests.end() && job.m_type != kOpenJob && !job.m_pFile)
+      {
+        bUnknownFile = true;
+      }
+      else if (it == m_requests.end())
+      {
+        // not returned by newRequestDescriptor(), keep the error for returnResult()
+        Request& request = m_requests[job.m_request];
+        request.m_status = OdAsyncIO::InProgress;
+        request.m_fileDescriptor = 0;
+        request.m_pData = NULL;
+        request.m_dataSize = 0;
+        request.m_bCancelled = false;
+        job.m_error = OdAsyncIO::WrongRequestDescriptor;
+      }
+      if (!bUnknownFile)
+        m_jobs.push_back(job);
+    }
+    if (bUnknownFile)
+    {
+      // nothing for the workers to do, the result is ready on return
+      complete(job, OdAsyncIO::WrongFileDescriptor);
+      return;
+    }
+    m_jobReady.notify_one();
+  }
+
+  bool isCancelled(OdUInt64 requestDescriptor)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<OdUInt64, Request>::const_iterator it = m_requests.find(requestDescriptor);
+    return it == m_requests.end() || it->second.m_bCancelled;
+  }
+
+  // Stores the result of a processed job and passes it to the receiver.
+  void complete(const Job& job, OdAsyncIO::OdAsyncIOResult status, OdUInt64 fileDescriptor = 0,
+    OdUInt8* pData = NULL, OdUInt32 dataSize = 0)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::map<OdUInt64, Request>::iterator it = m_requests.find(job.m_request);
+      if (it == m_requests.end() || it->second.m_bCancelled)
+      {
+        // cancelled or already released with responseParsed()
+        ::odrxFree(pData);
+        pData = NULL;
+        dataSize = 0;
+        if (fileDescriptor)
+          m_files.erase(fileDescriptor);
+        fileDescriptor = 0;
+        status = OdAsyncIO::Cancelled;
+        if (it == m_requests.end())
+          return;
+      }
+      Request& request = it->second;
+      request.m_status = status;
+      request.m_fileDescriptor = fileDescriptor;
+      request.m_pData = pData;
+      request.m_dataSize = dataSize;
+    }
+    if (!job.m_bAsync)
+      return;
+
+    OdAsyncIOService* pService = ::odGetAsyncIOService();
+    if (!pService)
+      return;
+    switch (job.m_type)
+    {
+    case kOpenJob:
+      pService->receiveOpenRequestResponse(job.m_receiver, job.m_request, fileDescriptor, status);
+      break;
+    case kReadJob:
+      pService->receiveReadRequestResponse(job.m_receiver, job.m_request, pData, dataSize, status);
+      break;
+    case kWriteJob:
+      pService->receiveWriteRequestResponse(job.m_receiver, job.m_request, status);
+      break;
+    }
+  }
+
+  // Checks a job before it is processed, completes it if it can't be.
+  bool prepare(const Job& job)
+  {
+    if (isCancelled(job.m_request))
+    {
+      complete(job, OdAsyncIO::Cancelled);
+      return false;
+    }
+    if (job.m_error != OdAsyncIO::Success)
+    {
+      complete(job, job.m_error);
+      return false;
+    }
+    if (job.m_type == kOpenJob)
+      return true;
+    if (!job.m_pFile)
+    {
+      complete(job, OdAsyncIO::WrongFileDescriptor);
+      return false;
+    }
+    if (job.m_type == kWriteJob && !job.m_pData && job.m_size)
+    {
+      complete(job, OdAsyncIO::BufferPtrIsNull);
+      return false;
+    }
+    if (job.m_size > 0xFFFFFFFF)
+    {
+      complete(job, OdAsyncIO::UnknownError);
+      return false;
+    }
+    return true;
+  }
+
+  void processOpen(const Job& job)
+  {
+    AsyncFilePtr pFile = std::make_shared<AsyncFile>();
+    if (!pFile->open(*job.m_pOpen))
+    {
+      complete(job, OdAsyncIO::CanNotOpenFile);
+      return;
+    }
+    OdUInt64 fileDescriptor;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      fileDescriptor = ++m_nextFile;
+      m_files[fileDescriptor] = pFile;
+    }
+    complete(job, OdAsyncIO::Success, fileDescriptor);
+  }
+
+  // Finishes a read or write job whose first nDone bytes were transferred.
+  void finishTransfer(const Job& job, OdUInt8* pData, OdUInt32 nDone, bool bFailed)
+  {
+    OdUInt32 nSize = (OdUInt32)job.m_size;
+    if (job.m_type == kReadJob)
+    {
+      if (!bFailed && nDone < nSize)
+      {
+        // short or failed asynchronous read, read the rest synchronously
+        OdUInt32 nRead = 0;
+        bFailed = !job.m_pFile->readAt(pData + nDone, nSize - nDone, job.m_offset + nDone, nRead);
+        nDone += nRead;
+      }
+      if (bFailed)
+      {
+        ::odrxFree(pData);
+        complete(job, OdAsyncIO::UnknownError);
+      }
+      else
+      {
+        complete(job, OdAsyncIO::Success, 0, pData, nDone);
+      }
+    }
+    else
+    {
+      if (!bFailed && nDone < nSize)
+        bFailed = !job.m_pFile->writeAt(job.m_pData + nDone, nSize - nDone, job.m_offset + nDone);
+      complete(job, bFailed ? OdAsyncIO::UnknownError : OdAsyncIO::Success);
+    }
+  }
+
+  OdUInt8* allocReadBuffer(const Job& job)
+  {
+    OdUInt8* pData = (OdUInt8*)::odrxAlloc(job.m_size ? (size_t)job.m_size : 1);
+    if (!pData)
+      complete(job, OdAsyncIO::UnknownError);
+    return pData;
+  }
+
+  void processTransfer(const Job& job)
+  {
+    if (job.m_type == kReadJob)
+    {
+      OdUInt8* pData = allocReadBuffer(job);
+      if (!pData)
+        return;
+      OdUInt32 nRead = 0;
+      bool bOk = job.m_pFile->readAt(pData, (OdUInt32)job.m_size, job.m_offset, nRead);
+      finishTransfer(job, pData, bOk ? nRead : 0, !bOk);
+    }
+    else
+    {
+      bool bOk = job.m_pFile->writeAt(job.m_pData, (OdUInt32)job.m_size, job.m_offset);
+      finishTransfer(job, NULL, bOk ? (OdUInt32)job.m_size : 0, !bOk);
+    }
+  }
+
+#ifdef EXASYNCIO_HAVE_IO_URING
+  void processBatch(IoUring& ring, std::vector<Job>& batch)
+  {
+    std::vector<IoUring::Op> ops;
+    std::vector<const Job*> opJobs;
+    std::vector<OdUInt8*> opData;
+    ops.reserve(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+      const Job& job = batch[i];
+      if (!prepare(job))
+        continue;
+      if (job.m_pFile->descriptor() < 0 || !job.m_size)
+      {
+        processTransfer(job);
+        continue;
+      }
+      OdUInt8* pData = NULL;
+      if (job.m_type == kReadJob && !(pData = allocReadBuffer(job)))
+        continue;
+      IoUring::Op op;
+      op.m_bWrite = job.m_type == kWriteJob;
+      op.m_fd = job.m_pFile->descriptor();
+      op.m_iov.iov_base = op.m_bWrite ? (void*)job.m_pData : (void*)pData;
+      op.m_iov.iov_len = (size_t)job.m_size;
+      op.m_offset = job.m_offset;
+      op.m_result = -EIO;
+      ops.push_back(op);
+      opJobs.push_back(&job);
+      opData.push_back(pData);
+    }
+    if (ops.empty())
+      return;
+
+    // operations that failed or weren't submitted keep -EIO
+    ring.run(&ops[0], (unsigned)ops.size());
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+      // failed operations are repeated synchronously by finishTransfer()
+      OdUInt32 nDone = ops[i].m_result > 0 ? (OdUInt32)ops[i].m_result : 0;
+      finishTransfer(*opJobs[i], opData[i], nDone, false);
+    }
+  }
+#endif
+
+  void run()
+  {
+    runJobs();
+    if (m_bDeleteOnExit)
+      delete this;
+  }
+
+  void runJobs()
+  {
+#ifdef EXASYNCIO_HAVE_IO_URING
+    std::unique_ptr<IoUring> pRing;
+    if (m_bIoUring)
+    {
+      pRing.reset(new IoUring);
+      if (!pRing->init(m_options.m_queueDepth))
+        pRing.reset();
+    }
+    std::vector<Job> batch;
+#endif
+    for (;;)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_bStop && m_jobs.empty())
+          m_jobReady.wait(lock);
+        if (m_jobs.empty())
+          return;
+        job = m_jobs.front();
+        m_jobs.pop_front();
+#ifdef EXASYNCIO_HAVE_IO_URING
+        if (pRing && job.m_type != kOpenJob)
+        {
+          // take the following reads and writes to submit them together
+          batch.clear();
+          batch.push_back(job);
+          while (batch.size() < pRing->entries() && !m_jobs.empty() && m_jobs.front().m_type != kOpenJob)
+          {
+            batch.push_back(m_jobs.front());
+            m_jobs.pop_front();
+          }
+        }
+#endif
+      }
+
+#ifdef EXASYNCIO_HAVE_IO_URING
+      if (pRing && job.m_type != kOpenJob)
+      {
+        processBatch(*pRing, batch);
+        continue;
+      }
+#endif
+      if (!prepare(job))
+        continue;
+      if (job.m_type == kOpenJob)
+        processOpen(job);
+      else
+        processTransfer(job);
+    }
+  }
+};
+
+//----------------------------------------------------------
+//
+// ExAsyncIORequestHandler
+//
+//----------------------------------------------------------
+
+ExAsyncIORequestHandler::Options ExAsyncIORequestHandler::defaultOptions()
+{
+  Options options;
+  options.m_numThreads = EXASYNCIO_NUM_THREADS;
+  options.m_queueDepth = EXASYNCIO_QUEUE_DEPTH;
+  options.m_bUseIoUring = true;
+  return options;
+}
+
+ExAsyncIORequestHandlerPtr ExAsyncIORequestHandler::createObject()
+{
+  return createObject(defaultOptions());
+}
+
+ExAsyncIORequestHandlerPtr ExAsyncIORequestHandler::createObject(const Options& options)
+{
+  ExAsyncIORequestHandlerPtr pRes = OdRxObjectImpl<ExAsyncIORequestHandler>::createObject();
+  pRes->start(options);
+  return pRes;
+}
+
+void ExAsyncIORequestHandler::initAsyncIOService(const Options& options)
+{
+  ::odInitAsyncIOService(createObject(options));
+}
+
+ExAsyncIORequestHandler::ExAsyncIORequestHandler()
+  : m_pImpl(new Impl)
+{
+}
+
+ExAsyncIORequestHandler::~ExAsyncIORequestHandler()
+{
+  // Released by a completion callback, the worker deletes m_pImpl when it returns
+  if (m_pImpl->stop(true))
+    delete m_pImpl;
+}
+
+void ExAsyncIORequestHandler::start(const Options& options)
+{
+  m_pImpl->start(options);
+}
+
+void ExAsyncIORequestHandler::stop()
+{
+  m_pImpl->stop(false);
+}
+
+bool ExAsyncIORequestHandler::usesIoUring() const
+{
+  return m_pImpl->m_bIoUring;
+}
+
+OdUInt64 ExAsyncIORequestHandler::newRequestDescriptor()
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_mutex);
+  OdUInt64 requestDescriptor = ++m_pImpl->m_nextRequest;
+  Impl::Request& request = m_pImpl->m_requests[requestDescriptor];
+  request.m_status = OdAsyncIO::InProgress;
+  request.m_fileDescriptor = 0;
+  request.m_pData = NULL;
+  request.m_dataSize = 0;
+  request.m_bCancelled = false;
+  return requestDescriptor;
+}
+
+void ExAsyncIORequestHandler::openFile(const OdAsyncOpenFileRequest& request)
+{
+  Impl::Job job;
+  job.m_type = Impl::kOpenJob;
+  job.m_request = request.m_requestDescriptor;
+  job.m_receiver = request.m_receiverDescriptor;
+  job.m_bAsync = request.m_bAsyncNotification;
+  job.m_pOpen = std::make_shared<OdAsyncOpenFileRequest>(request);
+  m_pImpl->post(job);
+}
+
+void ExAsyncIORequestHandler::closeFile(OdUInt64 fileDescriptor)
+{
+  // requests in progress keep the file open until they are processed
+  std::lock_guard<std::mutex> lock(m_pImpl->m_mutex);
+  m_pImpl->m_files.erase(fileDescriptor);
+}
+
+void ExAsyncIORequestHandler::read(const OdAsyncIORequest& request)
+{
+  Impl::Job job;
+  job.m_type = Impl::kReadJob;
+  job.m_request = request.m_requestDescriptor;
+  job.m_receiver = request.m_receiverDescriptor;
+  job.m_bAsync = request.m_bAsyncNotification;
+  job.m_pFile = m_pImpl->file(request.m_fileDescriptor);
+  job.m_offset = request.m_offset;
+  job.m_size = request.m_size;
+  m_pImpl->post(job);
+}
+
+void ExAsyncIORequestHandler::write(const OdAsyncIORequest& request)
+{
+  Impl::Job job;
+  job.m_type = Impl::kWriteJob;
+  job.m_request = request.m_requestDescriptor;
+  job.m_receiver = request.m_receiverDescriptor;
+  job.m_bAsync = request.m_bAsyncNotification;
+  job.m_pFile = m_pImpl->file(request.m_fileDescriptor);
+  job.m_offset = request.m_offset;
+  job.m_size = request.m_size;
+  job.m_pData = request.m_pBuf;
+  m_pImpl->post(job);
+}
+
+OdAsyncIO::OdAsyncIOResult ExAsyncIORequestHandler::returnResult(OdUInt64 requestDescriptor,
+  OdUInt64* pOpenedFileDescriptor, OdUInt8** pDataPtr, OdUInt32* pActualDataSize)
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_mutex);
+  std::map<OdUInt64, Impl::Request>::const_iterator it = m_pImpl->m_requests.find(requestDescriptor);
+  if (it == m_pImpl->m_requests.end())
+    return OdAsyncIO::WrongRequestDescriptor;
+  const Impl::Request& request = it->second;
+  if (request.m_status != OdAsyncIO::InProgress)
+  {
+    if (pOpenedFileDescriptor)
+      *pOpenedFileDescriptor = request.m_fileDescriptor;
+    if (pDataPtr)
+      *pDataPtr = request.m_pData;
+    if (pActualDataSize)
+      *pActualDataSize = request.m_dataSize;
+  }
+  return request.m_status;
+}
+
+void ExAsyncIORequestHandler::cancel(OdUInt64 requestDescriptor)
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_mutex);
+  std::map<OdUInt64, Impl::Request>::iterator it = m_pImpl->m_requests.find(requestDescriptor);
+  if (it != m_pImpl->m_requests.end() && it->second.m_status == OdAsyncIO::InProgress)
+    it->second.m_bCancelled = true;
+}
+
+void ExAsyncIORequestHandler::responseParsed(OdUInt64 requestDescriptor)
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_mutex);
+  std::map<OdUInt64, Impl::Request>::iterator it = m_pImpl->m_requests.find(requestDescriptor);
+  if (it == m_pImpl->m_requests.end())
+    return;
+  ::odrxFree(it->second.m_pData);
+  m_pImpl->m_requests.erase(it);
+}
@@ -0,0 +1,107 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _EX_ASYNCIOSERVICE_H_
+#define _EX_ASYNCIOSERVICE_H_
+
+#include "TD_PackPush.h"
+#include "AsyncIOService/OdAsyncIOService.h"
+#include "RxObjectImpl.h"
+
+#define EXASYNCIO_NUM_THREADS 4   /* default number of I/O threads */
+#define EXASYNCIO_QUEUE_DEPTH 32  /* default number of requests a thread submits at once */
+
+class ExAsyncIORequestHandler;
+typedef OdSmartPtr<ExAsyncIORequestHandler> ExAsyncIORequestHandlerPtr;
+
+/** \details
+  <group ExServices_Classes>
+
+  This class services asynchronous open, read and write requests on a pool of
+  I/O threads with positional reads and writes (pread/pwrite, or ReadFile/WriteFile
+  with an offset on Windows). On Linux each thread can submit its requests
+  through an io_uring instance when the kernel supports it.
+
+  Library: Source code provided.
+
+  \remarks
+  Data returned by read requests stays valid until responseParsed() is called for
+  the request. returnResult() does not wait, it returns OdAsyncIO::InProgress
+  until the request is processed.
+*/
+class ExAsyncIORequestHandler : public OdAsyncIORequestHandler
+{
+public:
+  /** \details
+    Parameters of the I/O thread pool.
+  */
+  struct Options
+  {
+    OdUInt32 m_numThreads;   // number of I/O threads
+    OdUInt32 m_queueDepth;   // maximal number of read/write requests a thread takes at once
+    bool     m_bUseIoUring;  // submit requests through io_uring if the kernel supports it
+  };
+
+  /** \details
+    Returns the default thread pool parameters.
+  */
+  static Options defaultOptions();
+
+  static ExAsyncIORequestHandlerPtr createObject();
+  static ExAsyncIORequestHandlerPtr createObject(const Options& options);
+
+  /** \details
+    Creates a handler and initializes the async I/O service of the SDK with it.
+  */
+  static void initAsyncIOService(const Options& options = defaultOptions());
+
+  virtual OdUInt64 newRequestDescriptor();
+  virtual void openFile(const OdAsyncOpenFileRequest& request);
+  virtual void closeFile(OdUInt64 fileDescriptor);
+  virtual void read(const OdAsyncIORequest& request);
+  virtual void write(const OdAsyncIORequest& request);
+  virtual OdAsyncIO::OdAsyncIOResult returnResult(OdUInt64 requestDescriptor,
+    OdUInt64* pOpenedFileDescriptor = NULL,
+    OdUInt8** pDataPtr = NULL, OdUInt32* pActualDataSize = NULL);
+  virtual void cancel(OdUInt64 requestDescriptor);
+  virtual void responseParsed(OdUInt64 requestDescriptor);
+
+  /** \details
+    Returns true if requests are submitted through io_uring.
+  */
+  bool usesIoUring() const;
+
+protected:
+  ExAsyncIORequestHandler();
+  ~ExAsyncIORequestHandler();
+
+  void start(const Options& options);
+  void stop();
+
+  struct Impl;             /* request table, file table and thread pool, see ExAsyncIOService.cpp */
+  Impl* m_pImpl;
+};
+
+#include "TD_PackPop.h"
+
+#endif // _EX_ASYNCIOSERVICE_H_
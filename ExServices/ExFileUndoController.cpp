@@ -28,9 +28,13 @@
 #define STL_USING_ALGORITHM
 #include "OdaSTL.h"
 #include "RxObjectImpl.h"
+#include "ExLzCompressor.h"
 
 
 ExFileUndoController::ExFileUndoController()
+  : m_nEnd(0)
+  , m_nStorageSize(0)
+  , m_bCompress(false)
 {
 }
 
@@ -41,12 +45,38 @@ void ExFileUndoController::pushData(OdStreamBuf* pStream, OdUInt32 nSize, OdUInt
     throw OdError(eFileAccessErr);
   }
 
-  OdList<UndoRecord>::iterator pNewRecord = m_records.append();
-  pNewRecord->options = opt;
-  pNewRecord->blockSize = nSize;
+  UndoRecord newRecord;
+  newRecord.options = opt;
+  newRecord.blockSize = nSize;
+  newRecord.offset = m_nEnd;
+  newRecord.storedSize = nSize;
 
-  OdUInt64 curPosition = pStream->tell();
-  pStream->copyDataTo(m_pStorage, curPosition, curPosition+nSize);
+  // Records after the logical end were popped, they are overwritten
+  m_pStorage->seek(m_nEnd, OdDb::kSeekFromStart);
+  if (m_bCompress && nSize >= EXUNDO_COMPRESS_MIN)
+  {
+    m_buffRaw.resize(nSize);
+    pStream->getBytes(m_buffRaw.asArrayPtr(), nSize);
+    OdUInt32 capacity = nSize - nSize / EXUNDO_COMPRESS_SAVING;
+    m_buffPacked.resize(capacity);
+    OdUInt32 packedSize = ExLzCompressor::compress(m_buffRaw.getPtr(), nSize, m_buffPacked.asArrayPtr(), capacity);
+    if (packedSize)
+    {
+      m_pStorage->putBytes(m_buffPacked.getPtr(), packedSize);
+      newRecord.storedSize = packedSize;
+    }
+    else
+      m_pStorage->putBytes(m_buffRaw.getPtr(), nSize);
+  }
+  else
+  {
+    OdUInt64 curPosition = pStream->tell();
+    pStream->copyDataTo(m_pStorage, curPosition, curPosition+nSize);
+  }
+
+  m_records.push_back(newRecord);
+  m_nEnd += newRecord.storedSize;
+  m_nStorageSize = odmax(m_nStorageSize, m_nEnd);
 }
 
 bool ExFileUndoController::hasData() const
@@ -59,17 +89,41 @@ OdUInt32 ExFileUndoController::popData(OdStreamBuf* pStream)
   if(!hasData())
     throw OdError(eEndOfFile);
 
-  UndoRecord &backRecord = m_records.back();
+  const UndoRecord &backRecord = m_records.last();
   OdUInt32 opt = backRecord.options;
-  
-  OdUInt64 curPosition = m_pStorage->tell();
-  m_pStorage->copyDataTo(pStream, curPosition - backRecord.blockSize, curPosition);
-  m_pStorage->seek(-(OdInt64)backRecord.blockSize, OdDb::kSeekFromEnd);
-  m_pStorage->truncate();
-  m_records.pop_back();
+
+  if (backRecord.storedSize < backRecord.blockSize)
+  {
+    OdUInt32 nStored = (OdUInt32)backRecord.storedSize;
+    OdUInt32 nSize = (OdUInt32)backRecord.blockSize;
+    m_buffPacked.resize(nStored);
+    m_pStorage->seek(backRecord.offset, OdDb::kSeekFromStart);
+    m_pStorage->getBytes(m_buffPacked.asArrayPtr(), nStored);
+    m_buffRaw.resize(nSize);
+    if (!ExLzCompressor::decompress(m_buffPacked.getPtr(), nStored, m_buffRaw.asArrayPtr(), nSize))
+      throw OdError(eDwgObjectImproperlyRead);
+    pStream->putBytes(m_buffRaw.getPtr(), nSize);
+  }
+  else
+    m_pStorage->copyDataTo(pStream, backRecord.offset, backRecord.offset + backRecord.storedSize);
+
+  // Logical truncation, the space is reused by the next record
+  m_nEnd = backRecord.offset;
+  m_records.removeLast();
+  reclaimSegments();
   return opt;
 }
 
+void ExFileUndoController::reclaimSegments()
+{
+  OdUInt64 nUsed = (m_nEnd + EXUNDO_SEGMENT_SIZE - 1) / EXUNDO_SEGMENT_SIZE * EXUNDO_SEGMENT_SIZE;
+  if (m_nStorageSize < nUsed + 2 * EXUNDO_SEGMENT_SIZE)
+    return;
+  m_nStorageSize = nUsed + EXUNDO_SEGMENT_SIZE;
+  m_pStorage->seek(m_nStorageSize, OdDb::kSeekFromStart);
+  m_pStorage->truncate();
+}
+
 class ExFileUndoControllerRecord : public OdDbUndoControllerRecord
 {
 public:
@@ -83,18 +137,19 @@ public:
 class ExFileUndoControllerIterator : public OdRxIterator
 {
 public:
-  OdList<ExFileUndoController::UndoRecord>::const_reverse_iterator m_iter;
-  OdList<ExFileUndoController::UndoRecord>::const_reverse_iterator m_end;
+  const ExFileUndoController::UndoRecord* m_pRecords;
+  // Records left to visit, newest first
+  unsigned m_nLeft;
 
   bool done() const
   {
-    return (m_iter==m_end);
+    return (m_nLeft==0);
   }
   bool next()
   {
     if(done())
       return false;
-    ++m_iter;
+    --m_nLeft;
     return !done();
   }
   OdRxObjectPtr object() const
@@ -103,7 +158,7 @@ public:
       throw OdError(eIteratorDone);
     OdSmartPtr<ExFileUndoControllerRecord> pRec =
       OdRxObjectImpl<ExFileUndoControllerRecord>::createObject();
-    pRec->m_options = m_iter->options;
+    pRec->m_options = m_pRecords[m_nLeft - 1].options;
     return pRec.get();
   }
 };
@@ -112,14 +167,16 @@ OdRxIteratorPtr ExFileUndoController::newRecordStackIterator() const
 {
   OdSmartPtr<ExFileUndoControllerIterator> pIter =
     OdRxObjectImpl<ExFileUndoControllerIterator>::createObject();
-  pIter->m_iter = m_records.rbegin();
-  pIter->m_end = m_records.rend();
+  pIter->m_pRecords = m_records.getPtr();
+  pIter->m_nLeft = m_records.size();
   return pIter;
 }
 
 void ExFileUndoController::clearData()
 {
   m_records.clear();
+  m_nEnd = 0;
+  m_nStorageSize = 0;
   if (!m_pStorage.isNull())
   {
     m_pStorage->rewind();
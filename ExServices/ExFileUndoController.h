@@ -27,11 +27,22 @@
 #include "TD_PackPush.h"
 #include "DbUndoController.h"
 #include "UInt8Array.h"
-#include "OdList.h"
+#include "OdBinaryData.h"
+
+#define EXUNDO_SEGMENT_SIZE 0x400000   /* journal space is given back to the storage in 4 MB segments */
+#define EXUNDO_COMPRESS_MIN 256        /* smaller records are stored as is */
+#define EXUNDO_COMPRESS_SAVING 8       /* a compressed record must be at least 1/8 smaller */
 
 /** \details
 This class implements platform-independent UndoController objects.
 
+Records are appended to a journal in the storage stream and indexed in memory.
+popData() only moves the logical end of the journal back; the storage is
+truncated when two whole segments of EXUNDO_SEGMENT_SIZE are unused, and
+one of them is kept for the next records. With compression enabled, records
+are compressed with ExLzCompressor and stored as is if that does not save
+at least 1/8.
+
 <group ExServices_Classes> Library: Source provided. 
 */
 class ExFileUndoController : public OdDbUndoController
@@ -41,10 +52,20 @@ public:
   {
     OdUInt32 options;
     OdUInt64 blockSize;
+    OdUInt64 offset;        // position in the journal
+    OdUInt64 storedSize;    // size in the journal, less than blockSize if compressed
   };
 private:
-  OdList<UndoRecord> m_records;
+  OdArray<UndoRecord, OdMemoryAllocator<UndoRecord> > m_records;
   OdStreamBufPtr     m_pStorage;
+  OdUInt64           m_nEnd;           // logical end of the journal
+  OdUInt64           m_nStorageSize;   // physical end of the journal
+  bool               m_bCompress;
+  OdBinaryData       m_buffRaw;
+  OdBinaryData       m_buffPacked;
+
+  /*!DOM*/
+  void reclaimSegments();
 protected:
   ExFileUndoController();
 
@@ -75,6 +96,22 @@ public:
   void clearData();
 
   void setStorage(OdStreamBufPtr pStorage);
+
+  /** \details
+  Enables or disables compression of pushed records.
+  \param bEnable [in]  Compression flag.
+  */
+  void setCompression(bool bEnable) { m_bCompress = bEnable; }
+
+  /** \details
+  Returns true if pushed records are compressed.
+  */
+  bool compression() const { return m_bCompress; }
+
+  /** \details
+  Returns the number of journal bytes in use.
+  */
+  OdUInt64 journalSize() const { return m_nEnd; }
 };
 
 /** \details
@@ -25,6 +25,7 @@
 
 #define STL_USING_IOSTREAM
 #define STL_USING_VECTOR
+#define STL_USING_LIST
 #include "OdaSTL.h"
 
 #include "OdaCommon.h"
@@ -39,6 +40,22 @@
 #include "OdFontServices.h"
 #include "OdCharMapper.h"
 #include "ExTtfFileNameByDescriptor.h"
+#include "DbBaseDatabase.h"
+#include "DbDatabase.h"
+#include "RxSystemServices.h"
+#include "RxEvent.h"
+#include <chrono>
+#include <memory>
+
+#if defined(ODA_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdlib.h>
+#endif
 
 #define  STD(a)  std:: a
 
@@ -122,10 +139,331 @@ const OdGsColor ExHostAppServices::dark_palette[] =
   ODRGB(187, 187, 187),ODRGB(221, 221, 221),ODRGB(255, 255, 255)
 };
 */
+namespace
+{
+  // Returns the canonical path, size and modification time of a regular file.
+  bool canonicalFile(const OdString& path, OdString& canonical, OdInt64& size, OdInt64& mtime)
+  {
+#if defined(ODA_WINDOWS)
+    wchar_t buf[MAX_PATH * 4];
+    DWORD len = ::GetFullPathNameW(path.c_str(), MAX_PATH * 4, buf, NULL);
+    if (!len || len >= MAX_PATH * 4)
+      return false;
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!::GetFileAttributesExW(buf, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+      return false;
+    canonical = buf;
+    canonical.makeLower();
+    size = (OdInt64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    mtime = (OdInt64(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+    char buf[PATH_MAX];
+    if (!::realpath(OdAnsiString(path, CP_UTF_8).c_str(), buf))
+      return false;
+    struct stat st;
+    if (stat(buf, &st) != 0 || !S_ISREG(st.st_mode))
+      return false;
+    canonical = OdString(buf, CP_UTF_8);
+    size = st.st_size;
+#if defined(__linux__)
+    mtime = OdInt64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    mtime = st.st_mtime;
+#endif
+#endif
+    return true;
+  }
+
+  // Returns a string identifying the file independently of the path used to reach it.
+  OdString fileIdentity(const OdString& canonical)
+  {
+    OdString res;
+#if defined(ODA_WINDOWS)
+    HANDLE hFile = ::CreateFileW(canonical.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+      return res;
+    BY_HANDLE_FILE_INFORMATION info;
+    if (::GetFileInformationByHandle(hFile, &info))
+      res.format(OD_T("%x:%x%08x"), info.dwVolumeSerialNumber, info.nFileIndexHigh, info.nFileIndexLow);
+    ::CloseHandle(hFile);
+#else
+    struct stat st;
+    if (stat(OdAnsiString(canonical, CP_UTF_8).c_str(), &st) == 0)
+      res.format(OD_T("%llx:%llx"), (unsigned long long)st.st_dev, (unsigned long long)st.st_ino);
+#endif
+    return res;
+  }
+
+  // Brackets the xref operations of the SDK (attach, overlay, resolve,
+  // reload, ...), so that readFile() can tell the xref loads on this thread
+  // from the drawings opened by the application.
+  class XrefLoadReactor : public OdStaticRxObject<OdRxEventReactor>
+  {
+  public:
+    static int& depth()
+    {
+      static thread_local int s_depth = 0;
+      return s_depth;
+    }
+
+    void xrefSubCommandStart(OdDbDatabase*, OdXrefSubCommand, const OdDbObjectIdArray&,
+                             const OdStringArray&, const OdStringArray&, bool&)
+    {
+      ++depth();
+    }
+    void xrefSubCommandEnd(OdDbDatabase*, OdXrefSubCommand, const OdDbObjectIdArray&,
+                           const OdStringArray&, const OdStringArray&)
+    {
+      leave();
+    }
+    void xrefSubCommandAborted(OdDbDatabase*, OdXrefSubCommand, const OdDbObjectIdArray&,
+                               const OdStringArray&, const OdStringArray&)
+    {
+      leave();
+    }
+
+  private:
+    static void leave()
+    {
+      if (depth() > 0)
+        --depth();
+    }
+  };
+
+  XrefLoadReactor s_xrefLoadReactor;
+  OdMutex         s_xrefLoadMutex;
+  bool            s_bXrefLoadAttached = false;   // guarded by s_xrefLoadMutex
+
+  void attachXrefLoadReactor()
+  {
+    TD_AUTOLOCK(s_xrefLoadMutex);
+    if (s_bXrefLoadAttached)
+      return;
+    OdRxEventPtr pEvent = odrxEvent();
+    if (pEvent.isNull())
+      return;
+    pEvent->addReactor(&s_xrefLoadReactor);
+    s_bXrefLoadAttached = true;
+  }
+
+  void detachXrefLoadReactor()
+  {
+    TD_AUTOLOCK(s_xrefLoadMutex);
+    if (!s_bXrefLoadAttached)
+      return;
+    OdRxEventPtr pEvent = odrxEvent();
+    if (!pEvent.isNull())
+      pEvent->removeReactor(&s_xrefLoadReactor);
+    s_bXrefLoadAttached = false;
+  }
+}
+
+// LRU cache of databases loaded by readFile(). The list is kept in most
+// recently used order.
+struct ExHostAppServices::DatabaseCache
+{
+  struct Entry
+  {
+    OdString                 m_key;
+    OdInt64                  m_size;
+    OdInt64                  m_mtime;
+    OdUInt64                 m_cost;
+    OdDbDatabasePtr          m_pDb;
+    std::shared_ptr<OdMutex> m_pCopyMutex;  // serializes wblock() of m_pDb
+  };
+  typedef std::list<Entry> EntryList;
+
+  // Drops cached databases that report a modification, and forgets
+  // databases that are destroyed.
+  class Reactor : public OdStaticRxObject<OdDbDatabaseReactor>
+  {
+  public:
+    DatabaseCache* m_pCache;
+
+    void objectAppended(const OdDbDatabase* pDb, const OdDbObject*)       { m_pCache->modified(pDb); }
+    void objectModified(const OdDbDatabase* pDb, const OdDbObject*)       { m_pCache->modified(pDb); }
+    void objectErased(const OdDbDatabase* pDb, const OdDbObject*, bool)   { m_pCache->modified(pDb); }
+    void headerSysVarChanged(const OdDbDatabase* pDb, const OdString&)    { m_pCache->modified(pDb); }
+    void goodbye(const OdDbDatabase* pDb)                                 { m_pCache->modified(pDb); }
+  };
+
+  OdMutex                                         m_mutex;
+  DatabaseCacheOptions                            m_options;
+  EntryList                                       m_entries;
+  std::map<OdString, EntryList::iterator>         m_byKey;
+  std::map<const OdDbDatabase*, EntryList::iterator> m_byDb;
+  OdUInt64                                        m_cost;
+  OdArray<OdDbDatabasePtr>                        m_released;  // dropped by reactor notifications
+  Reactor                                         m_reactor;
+  bool                                            m_bPartialLoad;  // xref cache only
+  bool                                            m_bExclusive;    // a database in use is not shared
+
+  DatabaseCache(bool bExclusive)
+    : m_cost(0)
+    , m_bPartialLoad(false)
+    , m_bExclusive(bExclusive)
+  {
+    m_options.m_maxBytes = 0;
+    m_options.m_maxDatabases = 256;
+    m_options.m_bCopyOnOpen = false;
+    m_reactor.m_pCache = this;
+  }
+
+  static OdString key(const OdString& path, bool bAllowCPConversion)
+  {
+    return path + (bAllowCPConversion ? OD_T("|1") : OD_T("|0"));
+  }
+
+  // Removes an entry and returns its database, to be released after m_mutex is
+  // unlocked. Inside a notification the reactor is detached later, by
+  // takeReleased().
+  OdDbDatabasePtr remove(EntryList::iterator it, bool bDetachReactor = true)
+  {
+    OdDbDatabasePtr pDb = it->m_pDb;
+    if (bDetachReactor)
+      pDb->removeReactor(&m_reactor);
+    m_cost -= it->m_cost;
+    m_byKey.erase(it->m_key);
+    m_byDb.erase(pDb.get());
+    m_entries.erase(it);
+    return pDb;
+  }
+
+  // Moves the databases dropped by notifications to released.
+  void takeReleased(OdArray<OdDbDatabasePtr>& released)
+  {
+    released.swap(m_released);
+    for (unsigned i = 0; i < released.size(); ++i)
+      released[i]->removeReactor(&m_reactor);
+  }
+
+  void trim(OdArray<OdDbDatabasePtr>& released)
+  {
+    while (!m_entries.empty() &&
+           (m_cost > m_options.m_maxBytes || m_entries.size() > m_options.m_maxDatabases))
+      released.append(remove(--m_entries.end()));
+  }
+
+  void modified(const OdDbDatabase* pDb)
+  {
+    TD_AUTOLOCK(m_mutex);
+    std::map<const OdDbDatabase*, EntryList::iterator>::iterator it = m_byDb.find(pDb);
+    if (it == m_byDb.end())
+      return;
+    // Released on the next cache access, not inside the notification.
+    m_released.append(remove(it->second, false));
+  }
+
+  // Returns the cached database, or a copy of it, if the file is unchanged.
+  OdDbDatabasePtr open(const OdString& path, bool bAllowCPConversion, OdInt64 size, OdInt64 mtime)
+  {
+    OdDbDatabasePtr pDb;
+    std::shared_ptr<OdMutex> pCopyMutex;
+    OdArray<OdDbDatabasePtr> released;
+    {
+      TD_AUTOLOCK(m_mutex);
+      takeReleased(released);
+      std::map<OdString, EntryList::iterator>::iterator it = m_byKey.find(key(path, bAllowCPConversion));
+      if (it == m_byKey.end())
+        return OdDbDatabasePtr();
+      if (it->second->m_size != size || it->second->m_mtime != mtime)
+      {
+        released.append(remove(it->second));
+        return OdDbDatabasePtr();
+      }
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+      pDb = it->second->m_pDb;
+      pCopyMutex = it->second->m_pCopyMutex;
+      // Referenced by the entry and pDb only: no other caller holds it. The
+      // count is checked under m_mutex, so two callers never both get it.
+      if (!m_options.m_bCopyOnOpen && (!m_bExclusive || pDb->numRefs() <= 2))
+        return pDb;
+    }
+    TD_AUTOLOCK(*pCopyMutex);
+    return pDb->wblock();
+  }
+
+  // Caches a loaded database and returns the instance to give to the caller.
+  OdDbDatabasePtr add(OdDbDatabase* pDb, const OdString& path, bool bAllowCPConversion, OdInt64 size, OdInt64 mtime)
+  {
+    OdUInt64 cost = OdUInt64(size) * EXHOSTAPP_DBCACHE_COST_FACTOR;
+    bool bCopyOnOpen;
+    OdArray<OdDbDatabasePtr> released;
+    {
+      TD_AUTOLOCK(m_mutex);
+      takeReleased(released);
+      bCopyOnOpen = m_options.m_bCopyOnOpen;
+      if (cost > m_options.m_maxBytes)
+        return pDb;
+      OdString sKey = key(path, bAllowCPConversion);
+      std::map<OdString, EntryList::iterator>::iterator it = m_byKey.find(sKey);
+      if (it != m_byKey.end())
+        released.append(remove(it->second));
+
+      Entry entry;
+      entry.m_key = sKey;
+      entry.m_size = size;
+      entry.m_mtime = mtime;
+      entry.m_cost = cost;
+      entry.m_pDb = pDb;
+      entry.m_pCopyMutex.reset(new OdMutex);
+      m_entries.push_front(entry);
+      m_byKey[sKey] = m_entries.begin();
+      m_byDb[pDb] = m_entries.begin();
+      m_cost += cost;
+      pDb->addReactor(&m_reactor);
+      trim(released);
+    }
+    if (!bCopyOnOpen)
+      return pDb;
+    return pDb->wblock();
+  }
+
+  void clear()
+  {
+    OdArray<OdDbDatabasePtr> released;
+    TD_AUTOLOCK(m_mutex);
+    takeReleased(released);
+    while (!m_entries.empty())
+      released.append(remove(m_entries.begin()));
+  }
+
+  // Drops the databases read by a host that is being destroyed, they would
+  // keep pointing to it through appServices().
+  void clear(const OdDbHostAppServices* pHost)
+  {
+    OdArray<OdDbDatabasePtr> released;
+    TD_AUTOLOCK(m_mutex);
+    takeReleased(released);
+    EntryList::iterator it = m_entries.begin();
+    while (it != m_entries.end())
+    {
+      EntryList::iterator cur = it++;
+      if (cur->m_pDb->appServices() == pHost)
+        released.append(remove(cur));
+    }
+  }
+};
+
 ExHostAppServices::ExHostAppServices() 
                  : m_disableOutput(false)
+                 , m_ttfIndexStamp(0)
+                 , m_supportCheckTime(0)
+                 , m_supportCheckInterval(EXHOSTAPP_SUPPORT_INDEX_CHECK)
+                 , m_bSupportIndexed(false)
+                 , m_pDbCache(new DatabaseCache(true))
 //                 , m_bSysFontCollected(false)
 {
+  m_progress.setConsoleOutput(true);
+}
+
+ExHostAppServices::~ExHostAppServices()
+{
+  // Detaches the reactor from databases that outlive the cache
+  m_pDbCache->clear();
+  delete m_pDbCache;
+  xrefCache().clear(this);
 }
 
 OdHatchPatternManager* ExHostAppServices::patternManager()
@@ -185,15 +523,98 @@ void ExHostAppServices::DwgCollection::add(OdDbDatabase* pDb)
 OdDbDatabasePtr ExHostAppServices::readFile(const OdString& fileName,
     bool bAllowCPConversion, bool bPartial, Oda::FileShareMode shmode, const OdPassword& password)
 {
+  OdString sPath;
+  OdInt64 size = 0, mtime = 0;
+  bool bCanonical = password.isEmpty() && canonicalFile(fileName, sPath, size, mtime);
+  DatabaseCache* pCache = NULL;
+  if (bCanonical)
+  {
+    // Xref operations started after this read, for example while
+    // resolving the xrefs of this drawing, are reported to the reactor
+    bool bXrefCache = xrefCacheOptions().m_maxBytes != 0;
+    if (bXrefCache)
+      attachXrefLoadReactor();
+    if (bXrefCache && XrefLoadReactor::depth() > 0)
+    {
+      pCache = &xrefCache();
+      bPartial = bPartial || xrefCacheOptions().m_bPartialLoad;
+      // Paths that reach the same file share the entry
+      OdString sIdentity = fileIdentity(sPath);
+      if (!sIdentity.isEmpty())
+        sPath = sIdentity;
+      sPath += bPartial ? OD_T("|p") : OD_T("|f");
+    }
+    else if (!bPartial && databaseCacheOptions().m_maxBytes)
+      pCache = m_pDbCache;
+  }
   OdDbDatabasePtr pRes;// = m_dwgCollection.lookUp(fileName);
-  //if(pRes.isNull())
+  if (pCache)
+    pRes = pCache->open(sPath, bAllowCPConversion, size, mtime);
+  if(pRes.isNull())
   {
     pRes = OdDbHostAppServices2::readFile(fileName, bAllowCPConversion, bPartial, shmode, password);
     //m_dwgCollection.add(pRes.get());
+    if (pCache && !pRes.isNull())
+      pRes = pCache->add(pRes, sPath, bAllowCPConversion, size, mtime);
   }
   return pRes;
 }
 
+void ExHostAppServices::setDatabaseCacheOptions(const DatabaseCacheOptions& options)
+{
+  OdArray<OdDbDatabasePtr> released;
+  TD_AUTOLOCK(m_pDbCache->m_mutex);
+  m_pDbCache->m_options = options;
+  m_pDbCache->trim(released);
+}
+
+ExHostAppServices::DatabaseCacheOptions ExHostAppServices::databaseCacheOptions() const
+{
+  TD_AUTOLOCK(m_pDbCache->m_mutex);
+  return m_pDbCache->m_options;
+}
+
+void ExHostAppServices::clearDatabaseCache()
+{
+  m_pDbCache->clear();
+}
+
+ExHostAppServices::DatabaseCache& ExHostAppServices::xrefCache()
+{
+  static DatabaseCache cache(false);
+  return cache;
+}
+
+void ExHostAppServices::setXrefCacheOptions(const XrefCacheOptions& options)
+{
+  DatabaseCache& cache = xrefCache();
+  OdArray<OdDbDatabasePtr> released;
+  TD_AUTOLOCK(cache.m_mutex);
+  cache.m_options.m_maxBytes = options.m_maxBytes;
+  cache.m_options.m_maxDatabases = options.m_maxDatabases;
+  cache.m_options.m_bCopyOnOpen = !options.m_bReadOnly;
+  cache.m_bPartialLoad = options.m_bPartialLoad;
+  cache.trim(released);
+}
+
+ExHostAppServices::XrefCacheOptions ExHostAppServices::xrefCacheOptions()
+{
+  DatabaseCache& cache = xrefCache();
+  TD_AUTOLOCK(cache.m_mutex);
+  XrefCacheOptions options;
+  options.m_maxBytes = cache.m_options.m_maxBytes;
+  options.m_maxDatabases = cache.m_options.m_maxDatabases;
+  options.m_bReadOnly = !cache.m_options.m_bCopyOnOpen;
+  options.m_bPartialLoad = cache.m_bPartialLoad;
+  return options;
+}
+
+void ExHostAppServices::clearXrefCache()
+{
+  detachXrefLoadReactor();
+  xrefCache().clear();
+}
+
 
 void ExHostAppServices::start(const OdString& displayString)
 {
@@ -201,42 +622,473 @@ void ExHostAppServices::start(const OdString& displayString)
   {
     odPrintConsoleString(OD_T("%ls------- Started %ls\n"), m_Prefix.c_str(), displayString.c_str());
   }
+  m_progress.start(displayString);
 }
 
 void ExHostAppServices::stop()
 {
+  m_progress.stop();
   if (!m_disableOutput)
   {
     odPrintConsoleString(OD_T("%ls------- Stopped\n"), m_Prefix.c_str());
   }
 }
 
+// Called for every processed object, possibly from several threads, so it only
+// counts. Progress is printed and reported by the reporter's timer thread.
 void ExHostAppServices::meterProgress()
 {
-  m_MeterCurrent++;
+  m_progress.step();
+}
+
+void ExHostAppServices::setLimit(int max)
+{
+  m_progress.setLimit(max);
   if (!m_disableOutput)
   {
-    double  f1, f2;
+    odPrintConsoleString(OD_T("%lsMeter Limit: %d\n"), m_Prefix.c_str(), max);
+  }
+}
 
-    f1 = (double)m_MeterCurrent / m_MeterLimit * 100;
-    f2 = (double)m_MeterOld / m_MeterLimit * 100;
-    if ((f1 - f2) > 0.7)
+namespace
+{
+  OdInt64 steadyMilliseconds()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  bool hasFolderPart(const OdString& path)
+  {
+    return path.find(L'/') != -1 || path.find(L'\\') != -1 || path.find(L':') != -1;
+  }
+
+  OdString lowerCase(const OdString& str)
+  {
+    OdString res(str);
+    res.makeLower();
+    return res;
+  }
+
+  // Returns the modification time of a folder, or -1 if it is not a folder.
+  OdInt64 folderMTime(const OdString& path)
+  {
+#if defined(ODA_WINDOWS)
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data) ||
+        !(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+      return -1;
+    return (OdInt64(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+    OdAnsiString sPath(path, CP_UTF_8);
+    struct stat st;
+    if (stat(sPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+      return -1;
+#if defined(__linux__)
+    return OdInt64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    return st.st_mtime;
+#endif
+#endif
+  }
+
+  // Adds the files of a folder to files as lower case name -> full path.
+  template <class FileMap>
+  void listFolder(const OdString& path, FileMap& files)
+  {
+#if defined(ODA_WINDOWS)
+    WIN32_FIND_DATAW data;
+    HANDLE hFind = ::FindFirstFileW((path + OD_T("\\*")).c_str(), &data);
+    if (hFind == INVALID_HANDLE_VALUE)
+      return;
+    do
     {
-      odPrintConsoleString(OD_T("%lsProgress: %2.2lf%%\n"), m_Prefix.c_str(), f1);
-      m_MeterOld = m_MeterCurrent;
+      if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+      {
+        OdString name(data.cFileName);
+        files.insert(std::make_pair(lowerCase(name), path + OD_T("\\") + name));
+      }
+    }
+    while (::FindNextFileW(hFind, &data));
+    ::FindClose(hFind);
+#else
+    OdAnsiString sPath(path, CP_UTF_8);
+    DIR* pDir = opendir(sPath.c_str());
+    if (!pDir)
+      return;
+    while (struct dirent* pEntry = readdir(pDir))
+    {
+      OdAnsiString sFile = sPath + "/" + pEntry->d_name;
+      struct stat st;
+      if (stat(sFile.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        continue;
+      OdString name(pEntry->d_name, CP_UTF_8);
+      files.insert(std::make_pair(lowerCase(name), path + OD_T("/") + name));
     }
+    closedir(pDir);
+#endif
+  }
+
+  // Strips trailing separators from a folder path.
+  OdString folderPath(const OdString& path)
+  {
+    OdString res(path);
+    res.trimLeft();
+    res.trimRight();
+    while (res.getLength() > 1 && (res.right(1) == OD_T("/") || res.right(1) == OD_T("\\")))
+      res = res.left(res.getLength() - 1);
+    return res;
+  }
+
+  void splitSearchPath(const OdString& searchPath, OdStringArray& paths)
+  {
+    OdString sPath;
+    for (int i = 0; i <= searchPath.getLength(); ++i)
+    {
+      OdChar ch = (i < searchPath.getLength()) ? searchPath.getAt(i) : L';';
+#if defined(ODA_WINDOWS)
+      if (ch == L';')
+#else
+      if (ch == L';' || ch == L':')
+#endif
+      {
+        sPath = folderPath(sPath);
+        if (!sPath.isEmpty())
+          paths.append(sPath);
+        sPath.empty();
+      }
+      else
+        sPath += ch;
+    }
+  }
+
+  const OdChar* defaultExtension(OdDbBaseHostAppServices::FindFileHint hint)
+  {
+    switch (hint)
+    {
+    case OdDbBaseHostAppServices::kFontFile:
+    case OdDbBaseHostAppServices::kCompiledShapeFile:
+      return OD_T(".shx");
+    case OdDbBaseHostAppServices::kTrueTypeFontFile:
+      return OD_T(".ttf");
+    case OdDbBaseHostAppServices::kXRefDrawing:
+      return OD_T(".dwg");
+    case OdDbBaseHostAppServices::kPatternFile:
+      return OD_T(".pat");
+    case OdDbBaseHostAppServices::kTXApplication:
+      return OD_T(".tx");
+    case OdDbBaseHostAppServices::kFontMapFile:
+      return OD_T(".fmp");
+    case OdDbBaseHostAppServices::kPhotometricWebFile:
+      return OD_T(".ies");
+    default:
+      break;
+    }
+    return NULL;
+  }
+
+  // True for the hints whose documented search locations (the current folder,
+  // the drawing folder, the ACAD folders and the system font folders for TrueType
+  // fonts) are all in the support index. Other hints may be resolved by the base
+  // class from folders that are not indexed.
+  bool isIndexedHint(OdDbBaseHostAppServices::FindFileHint hint)
+  {
+    switch (hint)
+    {
+    case OdDbBaseHostAppServices::kFontFile:
+    case OdDbBaseHostAppServices::kCompiledShapeFile:
+    case OdDbBaseHostAppServices::kTrueTypeFontFile:
+    case OdDbBaseHostAppServices::kEmbeddedImageFile:
+    case OdDbBaseHostAppServices::kXRefDrawing:
+    case OdDbBaseHostAppServices::kPatternFile:
+      return true;
+    default:
+      break;
+    }
+    return false;
   }
 }
 
-void ExHostAppServices::setLimit(int max)
+void ExHostAppServices::initSupportIndex()
 {
-  m_MeterLimit = max;
-  m_MeterCurrent = 0;
-  m_MeterOld = 0;
-  if (!m_disableOutput)
   {
-    odPrintConsoleString(OD_T("%lsMeter Limit: %d\n"), m_Prefix.c_str(), max);
+    TD_AUTOLOCK(m_supportMutex);
+    if (m_bSupportIndexed)
+      return;
+  }
+  // Collected without the lock: the font folders come from the font services,
+  // which may call back into this object.
+  OdStringArray supportPaths, fontPaths;
+  OdString sAcad;
+  OdRxSystemServices* pSs = odrxSystemServices();
+  if (pSs && pSs->getEnvVar(OD_T("ACAD"), sAcad) == eOk)
+    splitSearchPath(sAcad, supportPaths);
+  getSystemFontFolders(fontPaths);
+
+  TD_AUTOLOCK(m_supportMutex);
+  if (m_bSupportIndexed)
+    return;
+  m_supportPaths.insert(m_supportPaths.begin(), supportPaths.begin(), supportPaths.end());
+  for (unsigned int i = 0; i < fontPaths.size(); ++i)
+    m_fontPaths.append(folderPath(fontPaths[i]));
+  m_bSupportIndexed = true;
+  refreshSupportIndex(true);
+}
+
+ExHostAppServices::SupportFolder& ExHostAppServices::supportFolder(const OdString& path)
+{
+  std::map<OdString, SupportFolder>::iterator it = m_supportFolders.find(lowerCase(path));
+  if (it == m_supportFolders.end())
+  {
+    it = m_supportFolders.insert(std::make_pair(lowerCase(path), SupportFolder())).first;
+    it->second.m_path = path;
+    it->second.m_mtime = folderMTime(path);
+    if (it->second.m_mtime != -1)
+      listFolder(path, it->second.m_files);
+  }
+  return it->second;
+}
+
+void ExHostAppServices::refreshSupportIndex(bool bForce)
+{
+  OdInt64 now = steadyMilliseconds();
+  if (!bForce && now - m_supportCheckTime < OdInt64(m_supportCheckInterval))
+    return;
+  m_supportCheckTime = now;
+
+  bool bChanged = bForce;
+  std::map<OdString, SupportFolder>::iterator it = m_supportFolders.begin();
+  for (; it != m_supportFolders.end(); ++it)
+  {
+    OdInt64 mtime = folderMTime(it->second.m_path);
+    if (mtime == it->second.m_mtime)
+      continue;
+    it->second.m_mtime = mtime;
+    it->second.m_files.clear();
+    if (mtime != -1)
+      listFolder(it->second.m_path, it->second.m_files);
+    bChanged = true;
+  }
+  if (!bChanged)
+    return;
+
+  // std::map::insert() keeps the first entry, so earlier folders win.
+  m_supportIndex.clear();
+  for (unsigned int i = 0; i < m_supportPaths.size(); ++i)
+  {
+    const SupportFolder& folder = supportFolder(m_supportPaths[i]);
+    m_supportIndex.insert(folder.m_files.begin(), folder.m_files.end());
+  }
+  m_fontIndex.clear();
+  for (unsigned int i = 0; i < m_fontPaths.size(); ++i)
+  {
+    const SupportFolder& folder = supportFolder(m_fontPaths[i]);
+    m_fontIndex.insert(folder.m_files.begin(), folder.m_files.end());
+  }
+  m_findMisses.clear();
+  m_ttfLookups.clear();
+  // A stale index would return fonts that were removed, the lookups fall back
+  // to the font services until setTtfFontIndex() builds the new one
+  if (!m_pTtfIndex.isNull() && fontFoldersStamp() != m_ttfIndexStamp)
+    m_pTtfIndex = NULL;
+}
+
+// FNV-1a hash of the font folder paths and modification times.
+OdUInt64 ExHostAppServices::fontFoldersStamp()
+{
+  OdUInt64 stamp = 14695981039346656037ULL;
+  for (unsigned int i = 0; i < m_fontPaths.size(); ++i)
+  {
+    const SupportFolder& folder = supportFolder(m_fontPaths[i]);
+    OdString sPath = lowerCase(folder.m_path);
+    for (int j = 0; j < sPath.getLength(); ++j)
+      stamp = (stamp ^ OdUInt64(sPath.getAt(j))) * 1099511628211ULL;
+    for (int j = 0; j < 64; j += 8)
+      stamp = (stamp ^ ((OdUInt64(folder.m_mtime) >> j) & 0xFF)) * 1099511628211ULL;
+  }
+  return stamp;
+}
+
+const OdString* ExHostAppServices::lookUpSupportFile(const FileNameMap& index,
+                                                     const OdString& name, FindFileHint hint) const
+{
+  FileNameMap::const_iterator it = index.find(name);
+  if (it != index.end())
+    return &it->second;
+  const OdChar* pExt = defaultExtension(hint);
+  if (pExt && name.find(L'.') == -1)
+  {
+    it = index.find(name + pExt);
+    if (it != index.end())
+      return &it->second;
+  }
+  return NULL;
+}
+
+void ExHostAppServices::addSupportPath(const OdString& path)
+{
+  OdString sPath = folderPath(path);
+  if (sPath.isEmpty())
+    return;
+  TD_AUTOLOCK(m_supportMutex);
+  m_supportPaths.append(sPath);
+  if (m_bSupportIndexed)
+    refreshSupportIndex(true);
+}
+
+void ExHostAppServices::rebuildSupportIndex()
+{
+  initSupportIndex();
+  TD_AUTOLOCK(m_supportMutex);
+  m_supportFolders.clear();
+  refreshSupportIndex(true);
+}
+
+bool ExHostAppServices::setTtfFontIndex(const OdString& indexPath)
+{
+  initSupportIndex();
+  OdUInt64 stamp = 0;
+  OdStringArray fontFiles;
+  {
+    TD_AUTOLOCK(m_supportMutex);
+    refreshSupportIndex(false);
+    m_ttfIndexPath = indexPath;
+    m_ttfLookups.clear();
+    m_pTtfIndex = NULL;
+    if (indexPath.isEmpty())
+      return false;
+    stamp = m_ttfIndexStamp = fontFoldersStamp();
+    for (unsigned int i = 0; i < m_fontPaths.size(); ++i)
+    {
+      const SupportFolder& folder = supportFolder(m_fontPaths[i]);
+      FileNameMap::const_iterator it = folder.m_files.begin();
+      for (; it != folder.m_files.end(); ++it)
+      {
+        OdString sExt = it->first.right(4);
+        if (sExt == OD_T(".ttf") || sExt == OD_T(".ttc") || sExt == OD_T(".otf"))
+          fontFiles.append(it->second);
+      }
+    }
+  }
+
+  // Parsing the fonts can take seconds, so the index is built without the lock.
+  OdSharedPtr<ExTtfFontIndex> pIndex = new ExTtfFontIndex;
+  if (!pIndex->open(indexPath, stamp) &&
+      !(ExTtfFontIndex::build(indexPath, stamp, fontFiles) && pIndex->open(indexPath, stamp)))
+    return false;
+
+  TD_AUTOLOCK(m_supportMutex);
+  if (m_ttfIndexPath != indexPath || m_ttfIndexStamp != stamp)
+    return false;
+  m_pTtfIndex = pIndex;
+  m_ttfLookups.clear();
+  return true;
+}
+
+OdString ExHostAppServices::findFile(const OdString& filename, OdDbBaseDatabase* pDb, FindFileHint hint)
+{
+  if (filename.isEmpty() || hasFolderPart(filename))
+    return OdDbHostAppServices2::findFile(filename, pDb, hint);
+
+  // The current folder is not indexed, so it is probed on every call.
+  OdRxSystemServices* pSs = odrxSystemServices();
+  if (pSs && pSs->accessFile(filename, Oda::kFileRead))
+    return filename;
+  const OdChar* pExt = defaultExtension(hint);
+  if (pSs && pExt && filename.find(L'.') == -1 && pSs->accessFile(filename + pExt, Oda::kFileRead))
+    return filename + pExt;
+
+  OdString sDbFolder;
+  if (pDb)
+  {
+    OdDbBaseDatabasePEPtr pDbPE = OdDbBaseDatabasePE::cast(pDb);
+    if (pDbPE.get())
+    {
+      sDbFolder = pDbPE->getFilename(pDb);
+      sDbFolder.replace(L'\\', L'/');
+      int pos = sDbFolder.reverseFind(L'/');
+      sDbFolder = (pos > 0) ? folderPath(sDbFolder.left(pos)) : OdString::kEmpty;
+    }
+  }
+
+  initSupportIndex();
+  OdString sName = lowerCase(filename);
+  OdString sMissKey;
+  {
+    TD_AUTOLOCK(m_supportMutex);
+    refreshSupportIndex(false);
+
+    const OdString* pPath = NULL;
+    if (!sDbFolder.isEmpty())
+      pPath = lookUpSupportFile(supportFolder(sDbFolder).m_files, sName, hint);
+    if (!pPath)
+      pPath = lookUpSupportFile(m_supportIndex, sName, hint);
+    if (!pPath && (hint == kFontFile || hint == kTrueTypeFontFile))
+      pPath = lookUpSupportFile(m_fontIndex, sName, hint);
+    if (pPath)
+      return *pPath;
+
+    // A miss is remembered only when every folder the base class searches for
+    // this hint is indexed: the index refresh is what forgets it again.
+    if (isIndexedHint(hint))
+    {
+      sMissKey.format(OD_T("%d|%ls|%ls"), int(hint), lowerCase(sDbFolder).c_str(), sName.c_str());
+      if (m_findMisses.find(sMissKey) != m_findMisses.end())
+        return OdString::kEmpty;
+    }
+  }
+
+  OdString res = OdDbHostAppServices2::findFile(filename, pDb, hint);
+  if (res.isEmpty() && !sMissKey.isEmpty())
+  {
+    TD_AUTOLOCK(m_supportMutex);
+    m_findMisses.insert(sMissKey);
+  }
+  return res;
+}
+
+bool ExHostAppServices::ttfFileNameByDescriptor(const OdTtfDescriptor& descr, OdString& fileName)
+{
+  initSupportIndex();
+  OdString sKey;
+  sKey.format(OD_T("%ls|%d|%d|%d|%ls"), lowerCase(descr.typeface()).c_str(),
+    int(descr.isBold()), int(descr.isItalic()), int(descr.charSet()), lowerCase(fileName).c_str());
+  OdString sFile = fileName;
+  TtfLookup lookup;
+  {
+    TD_AUTOLOCK(m_supportMutex);
+    refreshSupportIndex(false);
+    std::map<OdString, TtfLookup>::const_iterator it = m_ttfLookups.find(sKey);
+    if (it != m_ttfLookups.end())
+    {
+      if (it->second.m_bFound)
+        fileName = it->second.m_fileName;
+      return it->second.m_bFound;
+    }
+    lookup.m_bFound = !m_pTtfIndex.isNull() &&
+      m_pTtfIndex->lookUp(descr.typeface(), descr.isBold(), descr.isItalic(), descr.charSet(), sFile);
+    if (lookup.m_bFound)
+    {
+      lookup.m_fileName = sFile;
+      m_ttfLookups[sKey] = lookup;
+      fileName = sFile;
+      return true;
+    }
+  }
+  lookup.m_bFound = OdDbHostAppServices2::ttfFileNameByDescriptor(descr, sFile);
+
+  TD_AUTOLOCK(m_supportMutex);
+  if (lookup.m_bFound && !sFile.isEmpty() && !hasFolderPart(sFile))
+  {
+    const OdString* pPath = lookUpSupportFile(m_fontIndex, lowerCase(sFile), kTrueTypeFontFile);
+    if (pPath)
+      sFile = *pPath;
   }
+  lookup.m_fileName = sFile;
+  m_ttfLookups[sKey] = lookup;
+  if (lookup.m_bFound)
+    fileName = sFile;
+  return lookup.m_bFound;
 }
 
 #if 0
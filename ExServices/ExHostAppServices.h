@@ -32,14 +32,35 @@
 #include "StaticRxObject.h"
 #include "DbDatabaseReactor.h"
 #include "Gi/TtfDescriptor.h"
+#include "OdMutex.h"
+#include "SharedPtr.h"
+#include "ExTtfFontIndex.h"
+#include "ExProgressReporter.h"
 
 #define STL_USING_MAP
+#define STL_USING_SET
 #include "OdaSTL.h"
+#include <unordered_map>
 
 #include "ExPrintConsole.h"
 
 typedef OdArray<OdTtfDescriptor> mapTrueTypeFont;
 
+/** \details
+  Default interval in milliseconds between checks of the indexed support folders
+  for added, removed or renamed files.
+*/
+#ifndef EXHOSTAPP_SUPPORT_INDEX_CHECK
+#define EXHOSTAPP_SUPPORT_INDEX_CHECK 2000 /* 2 sec */
+#endif
+
+/** \details
+  Estimated memory of a cached database, in multiples of its file size.
+*/
+#ifndef EXHOSTAPP_DBCACHE_COST_FACTOR
+#define EXHOSTAPP_DBCACHE_COST_FACTOR 4
+#endif
+
 /** \details
   This class implements platform-dependent operations and progress metering.
   <group ExServices_Classes> 
@@ -61,17 +82,95 @@ class ExHostAppServices : public OdDbHostAppServices2, public OdDbHostAppProgres
   */
   
   OdString  m_Prefix;
-  long      m_MeterLimit;
-  long      m_MeterCurrent;
-  long      m_MeterOld;
   bool      m_disableOutput;
+  ExProgressReporter m_progress;
 //   mapTrueTypeFont m_mapTTF;
 //   OdMutex   m_TTFMapMutex;
 //   bool      m_bSysFontCollected;
 
+  // Support file index: folder listings keyed by lower case folder path, and
+  // lower case file name -> full path maps merged in search order.
+  struct FileNameHash
+  {
+    size_t operator()(const OdString& name) const
+    {
+      // FNV-1a
+      size_t res = 2166136261U;
+      for (const OdChar* p = name.c_str(); *p; ++p)
+        res = (res ^ size_t(*p)) * 16777619U;
+      return res;
+    }
+  };
+  typedef std::unordered_map<OdString, OdString, FileNameHash> FileNameMap;
+  struct SupportFolder
+  {
+    OdString m_path;
+    OdInt64  m_mtime;
+    FileNameMap m_files;
+    SupportFolder() : m_mtime(-1) {}
+  };
+  struct TtfLookup
+  {
+    bool     m_bFound;
+    OdString m_fileName;
+  };
+  std::map<OdString, SupportFolder> m_supportFolders;
+  OdStringArray                     m_supportPaths;
+  OdStringArray                     m_fontPaths;
+  FileNameMap                       m_supportIndex;
+  FileNameMap                       m_fontIndex;
+  std::set<OdString>                m_findMisses;
+  std::map<OdString, TtfLookup>     m_ttfLookups;
+  OdSharedPtr<ExTtfFontIndex>       m_pTtfIndex;
+  OdString                          m_ttfIndexPath;
+  OdUInt64                          m_ttfIndexStamp;
+  OdInt64                           m_supportCheckTime;
+  OdUInt32                          m_supportCheckInterval;
+  bool                              m_bSupportIndexed;
+  OdMutex                           m_supportMutex;
+
   OdHatchPatternManagerPtr m_patternManager;
+
+  struct DatabaseCache;    /* loaded databases, see ExHostAppServices.cpp */
+  DatabaseCache* m_pDbCache;
+
+  /*!DOM*/
+  static DatabaseCache& xrefCache();
+
+  /*!DOM*/
+  void initSupportIndex();
+  /*!DOM*/
+  void refreshSupportIndex(bool bForce);
+  /*!DOM*/
+  SupportFolder& supportFolder(const OdString& path);
+  /*!DOM*/
+  OdUInt64 fontFoldersStamp();
+  /*!DOM*/
+  const OdString* lookUpSupportFile(const FileNameMap& index, const OdString& name, FindFileHint hint) const;
 public:
+  /** \details
+    Parameters of the database cache used by readFile().
+  */
+  struct DatabaseCacheOptions
+  {
+    OdUInt64 m_maxBytes;      // estimated memory of cached databases, 0 disables the cache
+    OdUInt32 m_maxDatabases;  // maximal number of cached databases
+    bool     m_bCopyOnOpen;   // return private copies instead of the cached databases
+  };
+
+  /** \details
+    Parameters of the xref database cache shared by all ExHostAppServices objects.
+  */
+  struct XrefCacheOptions
+  {
+    OdUInt64 m_maxBytes;      // estimated memory of cached xref databases, 0 disables the cache
+    OdUInt32 m_maxDatabases;  // maximal number of cached xref databases
+    bool     m_bReadOnly;     // share the cached databases instead of returning copies
+    bool     m_bPartialLoad;  // load xref databases partially
+  };
+
   ExHostAppServices();
+  ~ExHostAppServices();
 
   OdDbHostAppProgressMeter* newProgressMeter();
 
@@ -96,17 +195,91 @@ public:
 
   //bool ttfFileNameByDescriptor(const OdTtfDescriptor& description, OdString& filename);
 
+  /** \details
+    Returns the fully qualified path to the specified file.
+
+    \param filename [in]  Name of the file to find.
+    \param pDb [in]  Pointer to the database context.
+    \param hint [in]  Hint that indicates the type of file that is required.
+
+    \remarks
+    Names without a folder part are answered from an index of the drawing folder,
+    the folders listed in the ACAD environment variable, the folders added by
+    addSupportPath() and the system font folders. The index is built once and
+    re-validated by folder modification times. Names missing from the index are
+    passed to OdDbHostAppServices2::findFile(). Its failures are remembered until
+    the index changes, for the font, shape, TrueType, image, xref and pattern
+    hints only: the other hints may be searched for in folders that are not indexed.
+  */
+  OdString findFile(const OdString& filename,
+    OdDbBaseDatabase* pDb = 0,
+    FindFileHint hint = kDefault);
+
+  /** \details
+    Returns the TrueType font file for the specified descriptor. The font index
+    set by setTtfFontIndex() is consulted before the font services. Results are
+    remembered until the support file index changes.
+
+    \param description [in]  TrueType font descriptor.
+    \param filename [out]  Receives the font file name.
+  */
+  bool ttfFileNameByDescriptor(const OdTtfDescriptor& description, OdString& filename);
+
+  /** \details
+    Appends a folder to the folders indexed by findFile().
+    \param path [in]  Folder path.
+  */
+  void addSupportPath(const OdString& path);
+
+  /** \details
+    Rescans all indexed folders and drops remembered lookups.
+  */
+  void rebuildSupportIndex();
+
+  /** \details
+    Maps the TrueType font index file used by ttfFileNameByDescriptor(). The file
+    is built from the system font folders when it is missing or was built from
+    different folder contents. Building parses every font, so call this at setup
+    time. When the folders change, lookups stop using the index until this
+    function is called again.
+
+    \param indexPath [in]  Index file path. An empty path stops using the index.
+    \returns
+    Returns true if the index is mapped.
+  */
+  bool setTtfFontIndex(const OdString& indexPath);
+
+  /** \details
+    Sets the interval between checks of the indexed folders for changes.
+    \param milliseconds [in]  Interval in milliseconds. 0 checks on every lookup.
+  */
+  void setSupportIndexCheckInterval(OdUInt32 milliseconds) { m_supportCheckInterval = milliseconds; }
+
   /** \details
     Controls display of this ProgressMeter.
     \param disable [in]  Disables this ProgressMeter. 
   */
-  void disableOutput(bool disable) { m_disableOutput = disable; }
+  void disableOutput(bool disable)
+  {
+    m_disableOutput = disable;
+    m_progress.setConsoleOutput(!disable, m_Prefix);
+  }
 
   /** \details
     Sets the prefix for this ProgressMeter.
     \param prefix [in]  Prefix for this ProgressMeter.
   */
-  void setPrefix(const OdString& prefix) { m_Prefix = prefix; }
+  void setPrefix(const OdString& prefix)
+  {
+    m_Prefix = prefix;
+    m_progress.setConsoleOutput(!m_disableOutput, m_Prefix);
+  }
+
+  /** \details
+    Returns the reporter that counts meterProgress() steps. Use it to set the
+    report interval and the JSON report outputs.
+  */
+  ExProgressReporter& progressReporter() { return m_progress; }
 
   OdHatchPatternManager* patternManager();
 
@@ -117,6 +290,74 @@ public:
     const OdPassword& password = OdPassword());
 
   TD_USING(OdDbHostAppServices2::readFile);
+
+  /** \details
+    Enables, resizes or disables the database cache used by readFile().
+
+    \param options [in]  Cache parameters.
+
+    \remarks
+    The cache is disabled by default. Databases are keyed by canonical path, file
+    size and modification time, and evicted in least recently used order.
+    Partial loads and password protected files are not cached.
+
+    Without m_bCopyOnOpen a caller receives the cached database itself while no
+    other caller holds a reference to it, and must not modify it. A concurrent or
+    overlapping caller receives a copy made by OdDbDatabase::wblock() instead, so
+    one instance is never used by two callers at a time. A cached database that
+    reports a modification through OdDbDatabaseReactor is dropped from the cache.
+    With m_bCopyOnOpen each caller receives a copy, which it may modify.
+
+    Call clearDatabaseCache() before odUninitialize().
+  */
+  void setDatabaseCacheOptions(const DatabaseCacheOptions& options);
+
+  /** \details
+    Returns the parameters of the database cache.
+  */
+  DatabaseCacheOptions databaseCacheOptions() const;
+
+  /** \details
+    Releases all cached databases.
+  */
+  void clearDatabaseCache();
+
+  /** \details
+    Enables, resizes or disables the xref database cache.
+
+    \param options [in]  Cache parameters.
+
+    \remarks
+    The cache is shared by all ExHostAppServices objects of the process, so
+    sheets loaded one after another, or by different jobs, load a common xref
+    once. readFile() uses it for the files read while an xref operation of the
+    SDK (OdRxEventReactor::xrefSubCommandStart() to xrefSubCommandEnd()) runs
+    on the calling thread; other reads of the same file are not affected. Databases are keyed by file identity (device and inode,
+    or volume serial and file index), so different paths to one file share the
+    entry, or by canonical path where the identity is not available, and by
+    size, modification time and partial load flag. The cache holds a reference
+    to each database, and releases it in least recently used order.
+
+    With m_bReadOnly all hosts share the xref database. Xref resolution that
+    modifies the shared database drops it from the cache, like
+    setDatabaseCacheOptions() describes. Partially loaded databases read objects
+    on demand, so they must not be shared by hosts used on different threads.
+    Without m_bReadOnly each host receives an OdDbDatabase::wblock() copy.
+
+    Destroying an ExHostAppServices object drops the cached databases it read.
+    The cache is disabled by default. Call clearXrefCache() before odUninitialize().
+  */
+  static void setXrefCacheOptions(const XrefCacheOptions& options);
+
+  /** \details
+    Returns the parameters of the xref database cache.
+  */
+  static XrefCacheOptions xrefCacheOptions();
+
+  /** \details
+    Releases all cached xref databases.
+  */
+  static void clearXrefCache();
 };
 
 #include "TD_PackPop.h"
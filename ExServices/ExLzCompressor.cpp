@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OdaCommon.h"
+#include "ExLzCompressor.h"
+#include <string.h>
+
+namespace
+{
+  const int      kHashLog = 12;
+  const OdUInt32 kMinMatch = 4;
+  const OdUInt32 kMaxOffset = 65535;
+  // The last match starts at least 12 bytes before the end, and the last 5 bytes are literals
+  const OdUInt32 kMatchStartLimit = 12;
+  const OdUInt32 kLastLiterals = 5;
+
+  inline OdUInt32 read32(const OdUInt8* p)
+  {
+    OdUInt32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  inline OdUInt32 hashOf(OdUInt32 v)
+  {
+    return (v * 2654435761U) >> (32 - kHashLog);
+  }
+
+  // Writes a 4-bit length overflow as a run of 255s and the remainder
+  inline bool putLength(OdUInt8*& pOut, const OdUInt8* pOutEnd, OdUInt32 len)
+  {
+    for (; len >= 255; len -= 255)
+    {
+      if (pOut >= pOutEnd)
+        return false;
+      *pOut++ = 255;
+    }
+    if (pOut >= pOutEnd)
+      return false;
+    *pOut++ = OdUInt8(len);
+    return true;
+  }
+
+  inline bool getLength(const OdUInt8*& pIn, const OdUInt8* pInEnd, OdUInt32& len)
+  {
+    OdUInt8 b;
+    do
+    {
+      if (pIn >= pInEnd)
+        return false;
+      b = *pIn++;
+      len += b;
+    } while (b == 255);
+    return true;
+  }
+
+  // Emits a sequence: literals, then a match unless matchLen is 0
+  bool putSequence(OdUInt8*& pOut, const OdUInt8* pOutEnd, const OdUInt8* pLiterals, OdUInt32 litLen,
+                   OdUInt32 offset, OdUInt32 matchLen)
+  {
+    if (pOut >= pOutEnd)
+      return false;
+    OdUInt8* pToken = pOut++;
+    OdUInt32 matchCode = matchLen ? matchLen - kMinMatch : 0;
+    *pToken = OdUInt8(((litLen < 15 ? litLen : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+    if (litLen >= 15 && !putLength(pOut, pOutEnd, litLen - 15))
+      return false;
+    if (OdUInt32(pOutEnd - pOut) < litLen)
+      return false;
+    memcpy(pOut, pLiterals, litLen);
+    pOut += litLen;
+    if (!matchLen)
+      return true;
+    if (pOutEnd - pOut < 2)
+      return false;
+    *pOut++ = OdUInt8(offset);
+    *pOut++ = OdUInt8(offset >> 8);
+    return matchCode < 15 || putLength(pOut, pOutEnd, matchCode - 15);
+  }
+}
+
+OdUInt32 ExLzCompressor::compress(const OdUInt8* pSrc, OdUInt32 srcLen, OdUInt8* pDst, OdUInt32 dstCapacity)
+{
+  OdUInt8* pOut = pDst;
+  const OdUInt8* pOutEnd = pDst + dstCapacity;
+  OdUInt32 anchor = 0;
+
+  if (srcLen > kMatchStartLimit)
+  {
+    OdUInt32 table[1 << kHashLog];
+    memset(table, 0, sizeof(table));
+
+    const OdUInt32 matchStartLimit = srcLen - kMatchStartLimit;
+    const OdUInt32 matchEndLimit = srcLen - kLastLiterals;
+    OdUInt32 pos = 1;
+    OdUInt32 misses = 0;
+    while (pos < matchStartLimit)
+    {
+      OdUInt32 seq = read32(pSrc + pos);
+      OdUInt32 h = hashOf(seq);
+      OdUInt32 ref = table[h];
+      table[h] = pos;
+      if (pos - ref > kMaxOffset || read32(pSrc + ref) != seq)
+      {
+        // Step faster through data that does not match
+        pos += 1 + (misses++ >> 6);
+        continue;
+      }
+      misses = 0;
+
+      // Extend the match backwards over pending literals, then forwards
+      while (pos > anchor && ref > 0 && pSrc[pos - 1] == pSrc[ref - 1])
+      {
+        --pos;
+        --ref;
+      }
+      OdUInt32 len = kMinMatch;
+      while (pos + len < matchEndLimit && pSrc[ref + len] == pSrc[pos + len])
+        ++len;
+
+      if (!putSequence(pOut, pOutEnd, pSrc + anchor, pos - anchor, pos - ref, len))
+        return 0;
+      pos += len;
+      anchor = pos;
+      if (pos - 2 < matchStartLimit)
+        table[hashOf(read32(pSrc + pos - 2))] = pos - 2;
+    }
+  }
+
+  if (!putSequence(pOut, pOutEnd, pSrc + anchor, srcLen - anchor, 0, 0))
+    return 0;
+  return OdUInt32(pOut - pDst);
+}
+
+bool ExLzCompressor::decompress(const OdUInt8* pSrc, OdUInt32 srcLen, OdUInt8* pDst, OdUInt32 dstLen)
+{
+  const OdUInt8* pIn = pSrc;
+  const OdUInt8* pInEnd = pSrc + srcLen;
+  OdUInt8* pOut = pDst;
+  OdUInt8* pOutEnd = pDst + dstLen;
+
+  for (;;)
+  {
+    if (pIn >= pInEnd)
+      return false;
+    OdUInt8 token = *pIn++;
+
+    OdUInt32 litLen = token >> 4;
+    if (litLen == 15 && !getLength(pIn, pInEnd, litLen))
+      return false;
+    if (OdUInt32(pInEnd - pIn) < litLen || OdUInt32(pOutEnd - pOut) < litLen)
+      return false;
+    memcpy(pOut, pIn, litLen);
+    pIn += litLen;
+    pOut += litLen;
+
+    // The last sequence has literals only
+    if (pIn == pInEnd)
+      return pOut == pOutEnd;
+
+    if (pInEnd - pIn < 2)
+      return false;
+    OdUInt32 offset = OdUInt32(pIn[0]) | (OdUInt32(pIn[1]) << 8);
+    pIn += 2;
+    OdUInt32 matchLen = token & 15;
+    if (matchLen == 15 && !getLength(pIn, pInEnd, matchLen))
+      return false;
+    matchLen += kMinMatch;
+    if (offset == 0 || offset > OdUInt32(pOut - pDst) || OdUInt32(pOutEnd - pOut) < matchLen)
+      return false;
+
+    // Overlapping copy when the offset is shorter than the match
+    const OdUInt8* pMatch = pOut - offset;
+    if (offset >= matchLen)
+    {
+      memcpy(pOut, pMatch, matchLen);
+      pOut += matchLen;
+    }
+    else
+    {
+      for (OdUInt32 i = 0; i < matchLen; ++i)
+        *pOut++ = *pMatch++;
+    }
+  }
+}
@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _EX_LZCOMPRESSOR_H_
+#define _EX_LZCOMPRESSOR_H_
+
+#include "TD_PackPush.h"
+#include "OdaCommon.h"
+
+/** \details
+  <group ExServices_Classes>
+
+  This class implements a fast LZ77 compressor for in-memory blocks, using the
+  LZ4 block format: 4-byte minimum matches, 64 KB window, and a single hash
+  probe per position. It trades ratio for speed and needs no external library.
+
+  Library: Source code provided.
+*/
+class ExLzCompressor
+{
+public:
+  /** \details
+    Returns the largest compressed size for a block of the specified length.
+  */
+  static OdUInt32 compressBound(OdUInt32 srcLen) { return srcLen + srcLen / 255 + 16; }
+
+  /** \details
+    Compresses a block. Returns the compressed size, or 0 if the result does not
+    fit into the destination buffer.
+
+    \param pSrc [in]  Source data.
+    \param srcLen [in]  Source length.
+    \param pDst [out]  Destination buffer.
+    \param dstCapacity [in]  Destination buffer size.
+  */
+  static OdUInt32 compress(const OdUInt8* pSrc, OdUInt32 srcLen, OdUInt8* pDst, OdUInt32 dstCapacity);
+
+  /** \details
+    Decompresses a block. Returns false if the compressed data is damaged or
+    does not decompress to exactly dstLen bytes.
+
+    \param pSrc [in]  Compressed data.
+    \param srcLen [in]  Compressed length.
+    \param pDst [out]  Destination buffer.
+    \param dstLen [in]  Decompressed length.
+  */
+  static bool decompress(const OdUInt8* pSrc, OdUInt32 srcLen, OdUInt8* pDst, OdUInt32 dstLen);
+};
+
+#include "TD_PackPop.h"
+
+#endif // _EX_LZCOMPRESSOR_H_
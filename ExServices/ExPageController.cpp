@@ -28,6 +28,38 @@
 #include "DbDatabase.h"
 #include "OdString.h"
 #include "FlatMemStream.h"
+#include "DbObject.h"
+#include "ExLzCompressor.h"
+#include <string.h>
+
+namespace
+{
+  enum
+  {
+    // Page tag: data is the raw length followed by ExLzCompressor output
+    kPageCompressed = 1
+  };
+
+  // Staging buffers of the calling thread, see ExPageController::writeCompressed()
+  struct StagingBuffers
+  {
+    OdBinaryData m_raw;
+    OdBinaryData m_packed;
+  };
+
+  StagingBuffers& threadStagingBuffers()
+  {
+    static thread_local StagingBuffers s_buffers;
+    return s_buffers;
+  }
+
+  // Object passed to subPage() on the calling thread, its page is written next
+  OdDbStub*& threadPagingObject()
+  {
+    static thread_local OdDbStub* s_pObject = 0;
+    return s_pObject;
+  }
+}
 
 //----------------------------------------------------------
 //
@@ -66,151 +98,457 @@ int ExUnloadController::pagingType() const
 
 
 
-class MyPageStream : public OdStreamBuf
+//----------------------------------------------------------
+//
+// ExPageController
+//
+//----------------------------------------------------------
+ExPageController::ExPageController()
+  : m_bCompress(false)
+  , m_nMisses(0)
+  , m_nPages(0)
+  , m_nCompressedPages(0)
+  , m_nSkippedPages(0)
+  , m_nRawBytes(0)
+  , m_nStoredBytes(0)
+  , m_nTierCapacity(0)
+  , m_nTierSeq(0)
+  , m_nTierBytes(0)
+  , m_nTierHits(0)
+  , m_nTierMisses(0)
+  , m_nWriteBacks(0)
 {
-  OdFlatMemStreamPtr m_pMemStream;
-  OdBinaryData          m_buff;
+  m_clockHand = m_clock.end();
+}
 
-public:
-  bool init(OdStreamBufPtr pBuf)
-  {
-    OdUInt32 len;
-    pBuf->getBytes(&len, sizeof(OdUInt32));
-    
-    m_buff.resize(len);
-    pBuf->getBytes(m_buff.asArrayPtr(), len);
+ExPageController::~ExPageController()
+{
+}
 
-    m_pMemStream = OdFlatMemStream::createNew(m_buff.asArrayPtr(), len);
-    return true;
-  }
+OdResult ExPageController::subPage(const OdDbObjectId& objectId)
+{
+  threadPagingObject() = objectId;
+  return ExUnloadController::subPage(objectId);
+}
 
-  OdUInt8 getByte()
+OdStreamBufPtr ExPageController::read(Key key)
+{
+  if (key < EXPAGE_TIER_KEY_BASE)
   {
-    return m_pMemStream->getByte();
+    // Pages larger than the tier go to the store directly
+    if (m_nTierCapacity)
+      ++m_nTierMisses;
+    return readStored(key);
   }
 
-  void getBytes(void* buffer, OdUInt32 nLen)
+  OdStreamBufPtr pStream;
+  Key storedKey = -1;
   {
-    m_pMemStream->getBytes(buffer, nLen);
+    TD_AUTOLOCK(m_tierMutex);
+    std::map<Key, TierPage>::iterator it = m_tierPages.find(key);
+    if (it == m_tierPages.end())
+      return (OdStreamBuf*)0;
+    TierPage& page = it->second;
+    // The next page of the object starts with the reference bit
+    if (page.m_pObject)
+      m_referenced.insert(page.m_pObject);
+    if (page.m_pData.isNull())
+    {
+      ++m_nTierMisses;
+      storedKey = page.m_storedKey;
+      m_tierPages.erase(it);
+    }
+    else
+    {
+      ++m_nTierHits;
+      pStream = page.m_pData.get();
+      if (page.m_bWriting)
+      {
+        // writeBack() frees the stored copy when it finds the data gone
+        page.m_pData.release();
+      }
+      else
+      {
+        m_nTierBytes -= pStream->length();
+        if (m_clockHand == page.m_clockPos)
+          m_clockHand = m_clock.erase(page.m_clockPos);
+        else
+          m_clock.erase(page.m_clockPos);
+        m_tierPages.erase(it);
+      }
+    }
   }
+  if (pStream.isNull())
+    return readStored(storedKey);
+  pStream->rewind();
+  return pStream;
+}
 
-  OdUInt64 seek(OdInt64 offset, OdDb::FilerSeekType whence)
-  {
-    return m_pMemStream->seek(offset, whence);
-  } 
+bool ExPageController::write(Key& key, OdStreamBuf* pStreamSrc)
+{
+  OdUInt64 len = pStreamSrc->length();
+  OdDbStub* pObject = threadPagingObject();
+  threadPagingObject() = 0;
+  if (m_pStore.isNull() || !m_nTierCapacity || len > m_nTierCapacity)
+    return writeStored(key, pStreamSrc);
 
-  OdUInt64 tell()
+  OdFlatMemStreamPtr pPage = OdFlatMemStreamManaged::createNew(len);
+  pStreamSrc->getBytes(pPage->data(), (OdUInt32)len);
+
+  std::vector<std::pair<Key, OdFlatMemStreamPtr> > victims;
   {
-    return m_pMemStream->tell();
+    TD_AUTOLOCK(m_tierMutex);
+    key = EXPAGE_TIER_KEY_BASE + m_nTierSeq++;
+    TierPage& page = m_tierPages[key];
+    page.m_pData = pPage;
+    page.m_storedKey = -1;
+    page.m_pObject = pObject;
+    page.m_bRef = pObject && m_referenced.erase(pObject) != 0;
+    page.m_bWriting = false;
+    // New pages go behind the hand, so they are the last to be visited
+    page.m_clockPos = m_clock.insert(m_clockHand, key);
+    m_nTierBytes += len;
+
+    while (m_nTierBytes > m_nTierCapacity && !m_clock.empty())
+    {
+      if (m_clockHand == m_clock.end())
+        m_clockHand = m_clock.begin();
+      TierPage& victim = m_tierPages[*m_clockHand];
+      if (victim.m_bRef)
+      {
+        victim.m_bRef = false;
+        ++m_clockHand;
+        continue;
+      }
+      victim.m_bWriting = true;
+      m_nTierBytes -= victim.m_pData->length();
+      victims.push_back(std::make_pair(*m_clockHand, victim.m_pData));
+      m_clockHand = m_clock.erase(m_clockHand);
+    }
   }
 
-
-};
-
-typedef OdSmartPtr<MyPageStream> MyPageStreamPtr;
-
-//----------------------------------------------------------
-//
-// ExPageController
-//
-//----------------------------------------------------------
-ExPageController::ExPageController()
-{
+  // Written outside of the lock, readers take the data from memory meanwhile
+  for (size_t i = 0; i < victims.size(); ++i)
+    writeBack(victims[i].first, victims[i].second);
+  return true;
 }
 
-ExPageController::~ExPageController()
+void ExPageController::writeBack(Key key, OdFlatMemStream* pPage)
 {
-  if (!pPagingFile.isNull())
+  // A reader may take pPage meanwhile, so the data is copied through a view with its own position
+  OdUInt64 len = pPage->length();
+  OdFlatMemStreamPtr pView = OdFlatMemStream::createNew(pPage->data(), len);
+  Key storedKey = -1;
+  bool bStored = writeStored(storedKey, pView);
+
+  TD_AUTOLOCK(m_tierMutex);
+  std::map<Key, TierPage>::iterator it = m_tierPages.find(key);
+  TierPage& page = it->second;
+  if (page.m_pData.isNull())
   {
-    OdAnsiString fName(pPagingFile->fileName());
-    pPagingFile.release();
-#ifdef OD_HAVE_REMOVE_FUNC
-    remove(fName.c_str());
-#else
-    OdString tmp(fName.c_str());
-    DeleteFile(tmp.c_str());
-#endif
+    // Read while it was written
+    if (bStored)
+      m_pStore->free(storedKey);
+    m_tierPages.erase(it);
+    return;
   }
+  page.m_bWriting = false;
+  if (!bStored)
+  {
+    // Stays in memory, over the tier size until the next write
+    page.m_clockPos = m_clock.insert(m_clockHand, key);
+    m_nTierBytes += len;
+    return;
+  }
+  page.m_pData.release();
+  page.m_storedKey = storedKey;
+  ++m_nWriteBacks;
 }
 
-OdStreamBufPtr ExPageController::read(Key key)
+ExPageController::TierStats ExPageController::tierStats() const
 {
-  if ( pPagingFile.isNull() )
-    return (OdStreamBuf*)0;
-  
-  if (pPagingFile->seek(key, OdDb::kSeekFromStart) != (OdUInt64)key)
-    return (OdStreamBuf*)0;
+  TierStats stats;
+  stats.m_hits = m_nTierHits;
+  stats.m_misses = m_nTierMisses;
+  stats.m_writeBacks = m_nWriteBacks;
+  TD_AUTOLOCK(m_tierMutex);
+  stats.m_residentPages = m_clock.size();
+  stats.m_residentBytes = m_nTierBytes;
+  return stats;
+}
 
-  OdUInt32 len(0);
-  pPagingFile->getBytes(&len, sizeof(OdUInt32)); 
-  pPagingFile->seek(-(int)sizeof(OdUInt32), OdDb::kSeekFromCurrent);
-  m_mFreeOffsets[len].append(key);
+OdStreamBufPtr ExPageController::readStored(Key key)
+{
+  if (m_pStore.isNull())
+    return (OdStreamBuf*)0;
 
-  MyPageStreamPtr pRet = OdRxObjectImpl<MyPageStream>::createObject();
-  if (!pRet->init(pPagingFile))
+  OdUInt32 length = 0;
+  OdUInt8 tag = 0;
+  const OdUInt8* pData = m_pStore->data(key, length, tag);
+  if (!pData)
     return (OdStreamBuf*)0;
+  if (!(tag & kPageCompressed))
+  {
+    // The page is freed when the returned stream is released
+    return m_pStore->read(key);
+  }
 
-  return pRet;
+  OdUInt32 rawLen = 0;
+  if (length < sizeof(rawLen))
+    throw OdError(eDwgObjectImproperlyRead);
+  ::memcpy(&rawLen, pData, sizeof(rawLen));
+  OdFlatMemStreamPtr pStream = OdFlatMemStreamManaged::createNew(rawLen);
+  if (!ExLzCompressor::decompress(pData + sizeof(rawLen), length - sizeof(rawLen), pStream->data(), rawLen))
+    throw OdError(eDwgObjectImproperlyRead);
+  m_pStore->free(key);
+  return OdStreamBufPtr(pStream.get());
 }
 
-OdInt64 ExPageController::getOffsetInPageFile(OdUInt32 length)
+bool ExPageController::writeStored(Key& key, OdStreamBuf* pStreamSrc)
 {
-  if (m_mFreeOffsets.empty())
+  if (m_pStore.isNull())
+    return false;
+
+  OdUInt32 len = (OdUInt32)pStreamSrc->length();
+  ++m_nPages;
+  m_nRawBytes += len;
+  if (m_bCompress && len >= EXPAGE_COMPRESS_MIN)
   {
-    pPagingFile->seek(0, OdDb::kSeekFromEnd);
-    return pPagingFile->tell();
+    OdUInt32 nMisses = m_nMisses;
+    if (nMisses < EXPAGE_COMPRESS_BACKOFF || nMisses % EXPAGE_COMPRESS_BACKOFF == 0)
+      return writeCompressed(key, pStreamSrc, len);
+    ++m_nMisses;
   }
 
-  std::map<OdUInt32, Offsets>::iterator itr;
-  itr = m_mFreeOffsets.find(length);
-  if (itr == m_mFreeOffsets.end())
+  m_nStoredBytes += len;
+  OdUInt8* pData = m_pStore->allocate(len, key);
+  if (!pData)
+    return false;
+  try
   {
-    pPagingFile->seek(0, OdDb::kSeekFromEnd);
-    return pPagingFile->tell();
+    pStreamSrc->getBytes(pData, len);
   }
-  else
+  catch (...)
   {
-    Offsets &offsets = itr->second; 
-    OdInt64 offset = offsets.last();
-    offsets.removeLast();
-    if (offsets.isEmpty())
-      m_mFreeOffsets.erase(itr);
-   
-    return offset;
+    m_pStore->free(key);
+    throw;
   }
+  return true;
 }
 
-bool ExPageController::write(Key& key, OdStreamBuf* pStreamSrc)
+bool ExPageController::writeCompressed(Key& key, OdStreamBuf* pStreamSrc, OdUInt32 len)
 {
-  if ( pPagingFile.isNull() )
-    return false;
-
-  OdUInt32 len = (OdUInt32)pStreamSrc->length();
-  key = getOffsetInPageFile(len);
-  pPagingFile->seek(key, OdDb::kSeekFromStart);
-  pPagingFile->putBytes(&len, sizeof(OdUInt32));
-
-  m_buffTmp.resize(len);
-  pStreamSrc->getBytes(m_buffTmp.asArrayPtr(), len);
-  pPagingFile->putBytes(m_buffTmp.asArrayPtr(), len);
+  StagingBuffers& buffers = threadStagingBuffers();
+  buffers.m_raw.resize(len);
+  pStreamSrc->getBytes(buffers.m_raw.asArrayPtr(), len);
+
+  // Keep the compressed page only if it saves enough and fits into a smaller block
+  OdUInt32 capacity = len - len / EXPAGE_COMPRESS_SAVING - sizeof(OdUInt32);
+  buffers.m_packed.resize(capacity);
+  OdUInt32 packedLen = ExLzCompressor::compress(buffers.m_raw.getPtr(), len, buffers.m_packed.asArrayPtr(), capacity);
+  if (packedLen &&
+      ExPageStore::blockCapacity(packedLen + sizeof(OdUInt32)) < ExPageStore::blockCapacity(len))
+  {
+    OdUInt8* pData = m_pStore->allocate(packedLen + sizeof(OdUInt32), key, kPageCompressed);
+    if (!pData)
+      return false;
+    ::memcpy(pData, &len, sizeof(len));
+    ::memcpy(pData + sizeof(len), buffers.m_packed.getPtr(), packedLen);
+    ++m_nCompressedPages;
+    m_nStoredBytes += packedLen + sizeof(OdUInt32);
+    m_nMisses = 0;
+    return true;
+  }
 
+  OdUInt8* pData = m_pStore->allocate(len, key);
+  if (!pData)
+    return false;
+  ::memcpy(pData, buffers.m_raw.getPtr(), len);
+  ++m_nSkippedPages;
+  m_nStoredBytes += len;
+  ++m_nMisses;
   return true;
 }
 
+ExPageController::CompressionStats ExPageController::compressionStats() const
+{
+  CompressionStats stats;
+  stats.m_pages = m_nPages;
+  stats.m_compressedPages = m_nCompressedPages;
+  stats.m_skippedPages = m_nSkippedPages;
+  stats.m_rawBytes = m_nRawBytes;
+  stats.m_storedBytes = m_nStoredBytes;
+  return stats;
+}
+
 void ExPageController::setDatabase(OdDbDatabase* pDb)
 {
   ExUnloadController::setDatabase(pDb);
+  {
+    TD_AUTOLOCK(m_tierMutex);
+    m_referenced.clear();
+  }
   OdString tmpDir = pDb->appServices()->getTempPath();
   OdString tmpName = odrxSystemServices()->getTempFileName();
   tmpDir += OdString().format(L"page%ls.tmp", tmpName.c_str());
   
-  pPagingFile = odrxSystemServices()->createFile(tmpDir, Oda::FileAccessMode(Oda::kFileRead | Oda::kFileWrite),
-                                                         Oda::kShareDenyReadWrite, Oda::kCreateAlways);
-  if ( pPagingFile.isNull() )
+  m_pStore = OdRxObjectImpl<ExPageStore>::createObject();
+  if (!m_pStore->open(tmpDir))
+  {
+    m_pStore.release();
     throw OdError(eFileAccessErr);
+  }
 }
 
 int ExPageController::pagingType() const
 {
   return OdDb::kUnload|OdDb::kPage;
 }
+
+
+
+//----------------------------------------------------------
+//
+// ExBudgetPageController
+//
+//----------------------------------------------------------
+void ExBudgetPageController::Reactor::objectAppended(const OdDbDatabase*, const OdDbObject* pObject)
+{
+  m_pOwner->touch(pObject->objectId());
+}
+
+void ExBudgetPageController::Reactor::objectOpenedForModify(const OdDbDatabase*, const OdDbObject* pObject)
+{
+  m_pOwner->touch(pObject->objectId());
+}
+
+void ExBudgetPageController::Reactor::objectModified(const OdDbDatabase*, const OdDbObject* pObject)
+{
+  m_pOwner->touch(pObject->objectId());
+}
+
+void ExBudgetPageController::Reactor::goodbye(const OdDbDatabase*)
+{
+  m_pOwner->clearTracking();
+}
+
+ExBudgetPageController::ExBudgetPageController()
+  : m_nBudget(0)
+  , m_nTracked(0)
+  , m_nObjectBytes(EXBUDGET_OBJECT_BYTES)
+  , m_nPageIns(0)
+  , m_nPageOuts(0)
+  , m_nUnloadRequests(0)
+{
+  m_reactor.m_pOwner = this;
+}
+
+ExBudgetPageController::~ExBudgetPageController()
+{
+}
+
+int ExBudgetPageController::pagingType() const
+{
+  // Objects are paged by applyBudget() only
+  return ExPageController::pagingType() | OdDb::kDoNotEnqueuePagingOnClose;
+}
+
+OdStreamBufPtr ExBudgetPageController::read(Key key)
+{
+  OdStreamBufPtr pStream = ExPageController::read(key);
+  if (!pStream.isNull())
+    ++m_nPageIns;
+  return pStream;
+}
+
+bool ExBudgetPageController::write(Key& key, OdStreamBuf* pStreamBuf)
+{
+  OdUInt64 len = pStreamBuf->length();
+  if (!ExPageController::write(key, pStreamBuf))
+    return false;
+  ++m_nPageOuts;
+  // Running average of the object size, updates lost to races do not matter
+  OdUInt64 avg = m_nObjectBytes;
+  m_nObjectBytes = odmax(OdUInt64(1), avg - avg / 8 + len / 8);
+  return true;
+}
+
+void ExBudgetPageController::setDatabase(OdDbDatabase* pDb)
+{
+  OdDbDatabase* pOldDb = database();
+  if (pOldDb)
+    pOldDb->removeReactor(&m_reactor);
+  clearTracking();
+  ExPageController::setDatabase(pDb);
+  if (pDb)
+    pDb->addReactor(&m_reactor);
+}
+
+void ExBudgetPageController::touch(const OdDbObjectId& id)
+{
+  if (!m_nBudget || id.isNull())
+    return;
+  OdDbStub* pStub = id;
+  TD_AUTOLOCK(m_lruMutex);
+  std::map<OdDbStub*, LruList::iterator>::iterator it = m_lruIndex.find(pStub);
+  if (it != m_lruIndex.end())
+  {
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return;
+  }
+  m_lru.push_front(pStub);
+  m_lruIndex[pStub] = m_lru.begin();
+  m_nTracked = m_lru.size();
+}
+
+void ExBudgetPageController::clearTracking()
+{
+  TD_AUTOLOCK(m_lruMutex);
+  m_lru.clear();
+  m_lruIndex.clear();
+  m_nTracked = 0;
+}
+
+OdUInt64 ExBudgetPageController::residentBytes() const
+{
+  return m_nTracked * m_nObjectBytes;
+}
+
+bool ExBudgetPageController::applyBudget()
+{
+  OdDbDatabase* pDb = database();
+  if (!pDb || !m_nBudget || residentBytes() <= m_nBudget)
+    return false;
+
+  // Take objects from the cold end until the rest fits under the low water mark
+  OdUInt64 nKeep = m_nBudget / 100 * EXBUDGET_LOW_WATER / m_nObjectBytes;
+  OdDbObjectIdArray ids;
+  {
+    TD_AUTOLOCK(m_lruMutex);
+    while (m_lru.size() > nKeep)
+    {
+      ids.push_back(OdDbObjectId(m_lru.back()));
+      m_lruIndex.erase(m_lru.back());
+      m_lru.pop_back();
+    }
+    m_nTracked = m_lru.size();
+  }
+  if (ids.isEmpty())
+    return false;
+
+  for (unsigned i = 0; i < ids.size(); ++i)
+    pDb->enqueuePaging(ids[i]);
+  m_nUnloadRequests += ids.size();
+  return pDb->pageObjects();
+}
+
+ExBudgetPageController::BudgetStats ExBudgetPageController::budgetStats() const
+{
+  BudgetStats stats;
+  stats.m_pageIns = m_nPageIns;
+  stats.m_pageOuts = m_nPageOuts;
+  stats.m_unloadRequests = m_nUnloadRequests;
+  stats.m_trackedObjects = m_nTracked;
+  stats.m_residentBytes = residentBytes();
+  return stats;
+}
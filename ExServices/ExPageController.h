@@ -28,8 +28,15 @@
 #include "DbPageController.h"
 #include "OdBinaryData.h"
 #include "OdStreamBuf.h"
+#include "FlatMemStream.h"
 #include "Int64Array.h"
+#include "ExPageStore.h"
+#include "DbDatabaseReactor.h"
+#include "OdMutex.h"
+#include <atomic>
 #define STL_USING_MAP
+#define STL_USING_LIST
+#define STL_USING_SET
 #include "OdaSTL.h"
 
 /** \details
@@ -56,6 +63,15 @@ private:
 
 typedef OdInt64Array Offsets;
 
+#define EXPAGE_COMPRESS_MIN     256  /* smaller pages are stored as is */
+#define EXPAGE_COMPRESS_SAVING  8    /* a compressed page must be at least 1/8 smaller */
+#define EXPAGE_COMPRESS_BACKOFF 8    /* after this many incompressible pages in a row, only every 8th page is tried */
+
+#define EXPAGE_TIER_KEY_BASE    (OdInt64(1) << 62)  /* memory tier keys start here, above any paging file offset */
+
+#define EXBUDGET_OBJECT_BYTES   512  /* assumed object size until pages have been written */
+#define EXBUDGET_LOW_WATER      90   /* unloading stops at this percentage of the budget */
+
 /** \details
    <group ExServices_Classes> 
 
@@ -64,7 +80,33 @@ typedef OdInt64Array Offsets;
    Library: Source code provided. 
 
    \remarks
-   This class contains a very simple implementation of paging, with consecutive writing in a file.
+   Pages are kept in an ExPageStore, a memory-mapped paging file in the temporary
+   folder. Pages of any size reuse freed space, and read() returns the page data
+   without copying it.
+
+   With compression enabled, pages are compressed with ExLzCompressor and are
+   decompressed by read(). A page is stored as is when compression does not let
+   it fit into a smaller block, and pages are only sampled for a while after a
+   run of incompressible ones.
+
+   read() and write() can be called concurrently, for example while objects
+   are loaded by several threads. The store has no shared file position, and
+   every thread compresses in its own staging buffers.
+
+   With a memory tier set, written pages are first kept in memory, so objects
+   paged in and out repeatedly during a traversal do not go through the file.
+   When the tier is full, pages are picked with a clock. read() hands a page
+   back to the database, which writes the object again when it is paged out
+   the next time, so a reference is remembered for the object (known from
+   subPage()) and becomes the reference bit of its next page. The hand clears
+   bits as it passes and writes the first page without one back to the store,
+   compressed if enabled, so objects that are paged in repeatedly stay in
+   memory longer than objects paged out once. Compression counters cover the
+   pages written to the store.
+
+   Store pages are keyed by their offset in the paging file and tier pages
+   from EXPAGE_TIER_KEY_BASE up, so all keys given to the database are
+   non-negative.
 */
 class ExPageController : public ExUnloadController
 {
@@ -76,13 +118,225 @@ public:
   OdStreamBufPtr read(Key key);
   bool write(Key& key, OdStreamBuf* pStreamBuf);
   void setDatabase(OdDbDatabase* pDb);
+  OdResult subPage(const OdDbObjectId& objectId);
+
+  /** \details
+    Page compression counters, accumulated over all written pages.
+  */
+  struct CompressionStats
+  {
+    OdUInt64 m_pages;            // pages written
+    OdUInt64 m_compressedPages;  // pages stored compressed
+    OdUInt64 m_skippedPages;     // pages tried and stored as is
+    OdUInt64 m_rawBytes;         // page bytes before compression
+    OdUInt64 m_storedBytes;      // page bytes written to the store
+  };
+
+  /** \details
+    Enables or disables compression of written pages. Pages already written
+    are read back either way. Call it before pages are written by several
+    threads.
+
+    \param bEnable [in]  Compression flag.
+  */
+  void setCompression(bool bEnable) { m_bCompress = bEnable; }
+
+  /** \details
+    Returns true if written pages are compressed.
+  */
+  bool compression() const { return m_bCompress; }
+
+  /** \details
+    Returns the page compression counters.
+  */
+  CompressionStats compressionStats() const;
+
+  /** \details
+    Memory tier counters.
+  */
+  struct TierStats
+  {
+    OdUInt64 m_hits;             // pages read from memory
+    OdUInt64 m_misses;           // pages read from the store
+    OdUInt64 m_writeBacks;       // pages moved from memory to the store
+    OdUInt64 m_residentPages;    // pages in memory
+    OdUInt64 m_residentBytes;    // bytes of the pages in memory
+  };
+
+  /** \details
+    Sets the size of the memory tier in front of the paging file. 0, the
+    default, writes all pages to the file. Call it before pages are written.
+
+    \param nBytes [in]  Tier size in bytes.
+  */
+  void setMemoryTier(OdUInt64 nBytes) { m_nTierCapacity = nBytes; }
+
+  /** \details
+    Returns the size of the memory tier in bytes.
+  */
+  OdUInt64 memoryTier() const { return m_nTierCapacity; }
+
+  /** \details
+    Returns the memory tier counters. The hit rate is m_hits / (m_hits + m_misses).
+    Without a memory tier all counters stay 0.
+  */
+  TierStats tierStats() const;
 
 private:
-  std::map<OdUInt32, Offsets> m_mFreeOffsets;
-  OdStreamBufPtr pPagingFile;
-  OdBinaryData  m_buffTmp;
+  /*!DOM*/
+  struct TierPage
+  {
+    OdFlatMemStreamPtr       m_pData;      // page data while in memory
+    Key                      m_storedKey;  // key in the store after write-back
+    OdDbStub*                m_pObject;    // object paged out, NULL if unknown
+    bool                     m_bRef;       // clock reference bit
+    bool                     m_bWriting;   // taken off the clock, being written back
+    std::list<Key>::iterator m_clockPos;
+  };
+
+  /*!DOM*/
+  OdStreamBufPtr readStored(Key key);
+  /*!DOM*/
+  bool writeStored(Key& key, OdStreamBuf* pStreamSrc);
+  /*!DOM*/
+  void writeBack(Key key, OdFlatMemStream* pPage);
+  /*!DOM*/
+  bool writeCompressed(Key& key, OdStreamBuf* pStreamSrc, OdUInt32 len);
+
+  ExPageStorePtr        m_pStore;
+  bool                  m_bCompress;
+  std::atomic<OdUInt32> m_nMisses;
+  std::atomic<OdUInt64> m_nPages;
+  std::atomic<OdUInt64> m_nCompressedPages;
+  std::atomic<OdUInt64> m_nSkippedPages;
+  std::atomic<OdUInt64> m_nRawBytes;
+  std::atomic<OdUInt64> m_nStoredBytes;
+
+  // Memory tier, pages in it have keys from EXPAGE_TIER_KEY_BASE up
+  OdUInt64                 m_nTierCapacity;
+  mutable OdMutex          m_tierMutex;
+  std::map<Key, TierPage>  m_tierPages;
+  std::set<OdDbStub*>      m_referenced;  // objects paged in since their last page out
+  std::list<Key>           m_clock;
+  std::list<Key>::iterator m_clockHand;
+  OdInt64                  m_nTierSeq;
+  OdUInt64                 m_nTierBytes;
+  std::atomic<OdUInt64>    m_nTierHits;
+  std::atomic<OdUInt64>    m_nTierMisses;
+  std::atomic<OdUInt64>    m_nWriteBacks;
+};
+
+/** \details
+   <group ExServices_Classes>
+
+   This class pages objects out of a database to keep it within a memory budget.
+
+   Library: Source code provided.
+
+   \remarks
+   Objects are not paged when they are closed. Instead, the controller keeps
+   the objects in least-recently-used order. Objects appended, opened for modify
+   or modified are tracked through a database reactor; objects opened for read
+   are tracked by calling touch(). The resident size is estimated as the number
+   of tracked objects times the average size of the pages written so far.
+
+   applyBudget() pages out the least recently used objects when the estimate
+   exceeds the budget, until it drops to EXBUDGET_LOW_WATER percent of it.
+   Objects that are still open stay in memory. Call applyBudget() from the
+   thread that owns the database, between object accesses, for example every
+   few hundred objects of an iteration.
+
+   Objects can only be unloaded from a partially opened database.
+*/
+class ExBudgetPageController : public ExPageController
+{
+public:
+  ExBudgetPageController();
+  ~ExBudgetPageController();
+
+  int pagingType() const;
+  OdStreamBufPtr read(Key key);
+  bool write(Key& key, OdStreamBuf* pStreamBuf);
+  void setDatabase(OdDbDatabase* pDb);
+
+  /** \details
+    Budget counters.
+  */
+  struct BudgetStats
+  {
+    OdUInt64 m_pageIns;          // pages read back
+    OdUInt64 m_pageOuts;         // pages written
+    OdUInt64 m_unloadRequests;   // objects queued for paging by applyBudget()
+    OdUInt64 m_trackedObjects;   // objects assumed to be in memory
+    OdUInt64 m_residentBytes;    // estimated size of the tracked objects
+  };
+
+  /** \details
+    Sets the memory budget for database objects. 0 disables the budget and
+    object tracking.
+
+    \param nBytes [in]  Budget in bytes.
+  */
+  void setBudget(OdUInt64 nBytes) { m_nBudget = nBytes; }
+
+  /** \details
+    Returns the memory budget in bytes.
+  */
+  OdUInt64 budget() const { return m_nBudget; }
+
+  /** \details
+    Marks an object as the most recently used one.
+
+    \param id [in]  Object ID.
+  */
+  void touch(const OdDbObjectId& id);
+
+  /** \details
+    Pages out least recently used objects if the resident size estimate
+    exceeds the budget. Returns true if objects were paged.
+  */
+  bool applyBudget();
+
+  /** \details
+    Returns the estimated size of the tracked objects in bytes.
+  */
+  OdUInt64 residentBytes() const;
+
+  /** \details
+    Returns the budget counters.
+  */
+  BudgetStats budgetStats() const;
+
+private:
+  /*!DOM*/
+  class Reactor : public OdDbDatabaseReactor
+  {
+  public:
+    ExBudgetPageController* m_pOwner;
+
+    void objectAppended(const OdDbDatabase* pDb, const OdDbObject* pObject);
+    void objectOpenedForModify(const OdDbDatabase* pDb, const OdDbObject* pObject);
+    void objectModified(const OdDbDatabase* pDb, const OdDbObject* pObject);
+    void goodbye(const OdDbDatabase* pDb);
+  };
+  friend class Reactor;
+
+  /*!DOM*/
+  void clearTracking();
+
+  typedef std::list<OdDbStub*> LruList;
 
-  OdInt64 getOffsetInPageFile(OdUInt32 length);
+  OdUInt64                            m_nBudget;
+  OdStaticRxObject<Reactor>           m_reactor;
+  // Most recently used objects first, m_lruIndex maps objects to their entries
+  OdMutex                             m_lruMutex;
+  LruList                             m_lru;
+  std::map<OdDbStub*, LruList::iterator> m_lruIndex;
+  std::atomic<OdUInt64>               m_nTracked;
+  std::atomic<OdUInt64>               m_nObjectBytes;
+  std::atomic<OdUInt64>               m_nPageIns;
+  std::atomic<OdUInt64>               m_nPageOuts;
+  std::atomic<OdUInt64>               m_nUnloadRequests;
 };
 #include "TD_PackPop.h"
 
@@ -0,0 +1,355 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OdaCommon.h"
+#include "ExPageStore.h"
+#include "FlatMemStream.h"
+#include "RxObjectImpl.h"
+
+#if defined(ODA_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "OdAnsiString.h"
+#endif
+
+namespace
+{
+  // Stored in front of every block
+  struct BlockHeader
+  {
+    OdUInt32 m_length;
+    OdUInt16 m_order;
+    OdUInt8  m_flags;
+    OdUInt8  m_tag;
+  };
+
+  enum
+  {
+    kBlockAllocated = 1
+  };
+
+  int blockOrder(OdUInt64 size)
+  {
+    int order = EXPAGESTORE_MIN_ORDER;
+    while ((OdUInt64(1) << order) < size)
+      ++order;
+    return order;
+  }
+
+  // Home shard of the calling thread, threads are spread round-robin
+  std::atomic<unsigned> s_nextShard(0);
+
+  int threadShard()
+  {
+    static thread_local int s_shard = int(s_nextShard++ % EXPAGESTORE_SHARDS);
+    return s_shard;
+  }
+
+  // Page stream over a block in the mapping, frees the block when released
+  class ExPageView : public OdFlatMemStream
+  {
+    ExPageStorePtr   m_pStore;
+    ExPageStore::Key m_key;
+  public:
+    ExPageView() : m_key(0) {}
+    ~ExPageView()
+    {
+      if (!m_pStore.isNull())
+        m_pStore->free(m_key);
+    }
+    void setPage(ExPageStore* pStore, ExPageStore::Key key, OdUInt8* pData, OdUInt32 length)
+    {
+      m_pStore = pStore;
+      m_key = key;
+      init(pData, length);
+    }
+  };
+}
+
+ExPageStore::ExPageStore()
+  : m_nSegments(0)
+  , m_fileSize(0)
+  , m_usedBytes(0)
+#if defined(ODA_WINDOWS)
+  , m_hFile(INVALID_HANDLE_VALUE)
+#else
+  , m_fd(-1)
+#endif
+{
+}
+
+ExPageStore::~ExPageStore()
+{
+  close();
+}
+
+void ExPageStore::close()
+{
+  size_t nSegments = m_nSegments;
+  for (size_t i = 0; i < nSegments; ++i)
+  {
+#if defined(ODA_WINDOWS)
+    ::UnmapViewOfFile(m_segments[i].m_pData);
+    ::CloseHandle(m_segments[i].m_hMapping);
+#else
+    ::munmap(m_segments[i].m_pData, size_t(1) << m_segments[i].m_order);
+#endif
+  }
+  m_segments.clear();
+  m_nSegments = 0;
+  for (int i = 0; i < EXPAGESTORE_SHARDS; ++i)
+  {
+    for (int j = 0; j < 64; ++j)
+      m_shards[i].m_freeBlocks[j].clear();
+  }
+#if defined(ODA_WINDOWS)
+  if (m_hFile != INVALID_HANDLE_VALUE)
+    ::CloseHandle(m_hFile);
+  m_hFile = INVALID_HANDLE_VALUE;
+#else
+  if (m_fd != -1)
+    ::close(m_fd);
+  m_fd = -1;
+#endif
+  m_fileSize = m_usedBytes = 0;
+}
+
+bool ExPageStore::open(const OdString& path)
+{
+  close();
+#if defined(ODA_WINDOWS)
+  HANDLE hFile = ::CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+  m_hFile = hFile;
+#else
+  OdAnsiString sPath(path, CP_UTF_8);
+  m_fd = ::open(sPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (m_fd == -1)
+    return false;
+  // Nobody opens the file by name, it goes away with the descriptor
+  ::unlink(sPath.c_str());
+#endif
+  m_segments.resize(EXPAGESTORE_MAX_SEGMENTS);
+  return true;
+}
+
+ExPageStore::Segment* ExPageStore::addSegment(int order, int shard)
+{
+  TD_AUTOLOCK(m_growMutex);
+  size_t n = m_nSegments;
+  if (n == m_segments.size())
+    return NULL;
+  OdUInt64 offset = m_fileSize;
+  OdUInt64 size = OdUInt64(1) << order;
+  Segment seg;
+  seg.m_offset = offset;
+  seg.m_order = order;
+  seg.m_shard = shard;
+#if defined(ODA_WINDOWS)
+  if (m_hFile == INVALID_HANDLE_VALUE)
+    return NULL;
+  OdUInt64 end = offset + size;
+  seg.m_hMapping = ::CreateFileMappingW(m_hFile, NULL, PAGE_READWRITE, DWORD(end >> 32), DWORD(end), NULL);
+  if (!seg.m_hMapping)
+    return NULL;
+  seg.m_pData = (OdUInt8*)::MapViewOfFile(seg.m_hMapping, FILE_MAP_WRITE, DWORD(offset >> 32), DWORD(offset), SIZE_T(size));
+  if (!seg.m_pData)
+  {
+    ::CloseHandle(seg.m_hMapping);
+    return NULL;
+  }
+#else
+  if (m_fd == -1 || ::ftruncate(m_fd, off_t(offset + size)) != 0)
+    return NULL;
+  void* pData = ::mmap(NULL, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, off_t(offset));
+  if (pData == MAP_FAILED)
+    return NULL;
+  seg.m_pData = (OdUInt8*)pData;
+#endif
+  // Publish the segment after its entry is complete, lookups read m_nSegments first
+  m_segments[n] = seg;
+  m_nSegments.store(n + 1, std::memory_order_release);
+  m_fileSize = offset + size;
+  return &m_segments[n];
+}
+
+ExPageStore::Segment* ExPageStore::segment(OdUInt64 offset)
+{
+  // Segments are appended in file order
+  size_t lo = 0, hi = m_nSegments.load(std::memory_order_acquire);
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    if (m_segments[mid].m_offset <= offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return NULL;
+  Segment* pSeg = &m_segments[lo - 1];
+  return offset - pSeg->m_offset < (OdUInt64(1) << pSeg->m_order) ? pSeg : NULL;
+}
+
+OdUInt32 ExPageStore::blockCapacity(OdUInt32 length)
+{
+  OdUInt64 size = OdUInt64(1) << blockOrder(OdUInt64(length) + sizeof(BlockHeader));
+  return OdUInt32(odmin(size - sizeof(BlockHeader), OdUInt64(0xFFFFFFFF)));
+}
+
+void ExPageStore::splitBlock(Shard& shard, OdUInt64 offset, int from, int to)
+{
+  while (from > to)
+  {
+    --from;
+    shard.m_freeBlocks[from].insert(offset + (OdUInt64(1) << from));
+  }
+}
+
+bool ExPageStore::takeBlock(int shard, int order, OdUInt64& offset)
+{
+  Shard& sh = m_shards[shard];
+  TD_AUTOLOCK(sh.m_mutex);
+  int k = order;
+  while (k < 64 && sh.m_freeBlocks[k].empty())
+    ++k;
+  if (k == 64)
+    return false;
+
+  // Take the lowest free block and split it down to the requested order
+  offset = *sh.m_freeBlocks[k].begin();
+  sh.m_freeBlocks[k].erase(sh.m_freeBlocks[k].begin());
+  splitBlock(sh, offset, k, order);
+  return true;
+}
+
+OdUInt8* ExPageStore::allocate(OdUInt32 length, Key& key, OdUInt8 tag)
+{
+  int order = blockOrder(OdUInt64(length) + sizeof(BlockHeader));
+  int home = threadShard();
+  OdUInt64 offset = 0;
+  bool bFound = false;
+  for (int i = 0; i < EXPAGESTORE_SHARDS && !bFound; ++i)
+    bFound = takeBlock((home + i) % EXPAGESTORE_SHARDS, order, offset);
+  if (!bFound)
+  {
+    // The new segment goes to the home shard, the rest of it stays free there
+    Segment* pSeg = addSegment(odmax(order, EXPAGESTORE_SEGMENT_ORDER), home);
+    if (!pSeg)
+      return NULL;
+    offset = pSeg->m_offset;
+    TD_AUTOLOCK(m_shards[home].m_mutex);
+    splitBlock(m_shards[home], offset, pSeg->m_order, order);
+  }
+
+  Segment* pSeg = segment(offset);
+  BlockHeader* pHeader = (BlockHeader*)(pSeg->m_pData + (offset - pSeg->m_offset));
+  pHeader->m_length = length;
+  pHeader->m_order = OdUInt16(order);
+  pHeader->m_flags = kBlockAllocated;
+  pHeader->m_tag = tag;
+  m_usedBytes += OdUInt64(1) << order;
+  key = Key(offset);
+  return (OdUInt8*)(pHeader + 1);
+}
+
+OdUInt8* ExPageStore::block(Key key, OdUInt32& length)
+{
+  if (key < 0)
+    return NULL;
+  OdUInt64 offset = OdUInt64(key);
+  Segment* pSeg = segment(offset);
+  if (!pSeg)
+    return NULL;
+  OdUInt64 rel = offset - pSeg->m_offset;
+  if (rel & ((OdUInt64(1) << EXPAGESTORE_MIN_ORDER) - 1))
+    return NULL;
+  BlockHeader* pHeader = (BlockHeader*)(pSeg->m_pData + rel);
+  if (pHeader->m_flags != kBlockAllocated || pHeader->m_order < EXPAGESTORE_MIN_ORDER || pHeader->m_order > pSeg->m_order ||
+      (rel & ((OdUInt64(1) << pHeader->m_order) - 1)) ||
+      OdUInt64(pHeader->m_length) + sizeof(BlockHeader) > (OdUInt64(1) << pHeader->m_order))
+    return NULL;
+  length = pHeader->m_length;
+  return (OdUInt8*)(pHeader + 1);
+}
+
+const OdUInt8* ExPageStore::data(Key key, OdUInt32& length, OdUInt8& tag)
+{
+  OdUInt8* pData = block(key, length);
+  if (!pData)
+    return NULL;
+  tag = ((BlockHeader*)pData - 1)->m_tag;
+  return pData;
+}
+
+OdStreamBufPtr ExPageStore::read(Key key)
+{
+  OdUInt32 length = 0;
+  OdUInt8* pData = block(key, length);
+  if (!pData)
+    return (OdStreamBuf*)0;
+  OdSmartPtr<ExPageView> pView = OdRxObjectImpl<ExPageView>::createObject();
+  pView->setPage(this, key, pData, length);
+  return OdStreamBufPtr(pView.get());
+}
+
+void ExPageStore::free(Key key)
+{
+  if (key < 0)
+    return;
+  OdUInt64 offset = OdUInt64(key);
+  Segment* pSeg = segment(offset);
+  if (!pSeg)
+    return;
+  Shard& sh = m_shards[pSeg->m_shard];
+  TD_AUTOLOCK(sh.m_mutex);
+
+  // Checked under the lock, so that a page freed twice is only released once
+  OdUInt32 length = 0;
+  OdUInt8* pData = block(key, length);
+  if (!pData)
+    return;
+  BlockHeader* pHeader = (BlockHeader*)pData - 1;
+  int order = pHeader->m_order;
+  pHeader->m_flags = 0;
+  m_usedBytes -= OdUInt64(1) << order;
+
+  // Merge with free buddies up to the segment size
+  while (order < pSeg->m_order)
+  {
+    OdUInt64 buddy = pSeg->m_offset + ((offset - pSeg->m_offset) ^ (OdUInt64(1) << order));
+    std::set<OdUInt64>::iterator it = sh.m_freeBlocks[order].find(buddy);
+    if (it == sh.m_freeBlocks[order].end())
+      break;
+    sh.m_freeBlocks[order].erase(it);
+    offset = odmin(offset, buddy);
+    ++order;
+  }
+  sh.m_freeBlocks[order].insert(offset);
+}
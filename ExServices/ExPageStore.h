@@ -0,0 +1,194 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _EX_PAGESTORE_H_
+#define _EX_PAGESTORE_H_
+
+#include "TD_PackPush.h"
+#include "RxObject.h"
+#include "OdStreamBuf.h"
+#include "OdString.h"
+#include "OdMutex.h"
+#include <atomic>
+#define STL_USING_SET
+#define STL_USING_VECTOR
+#include "OdaSTL.h"
+
+#define EXPAGESTORE_MIN_ORDER     6    /* smallest slab is 64 bytes, including the block header */
+#define EXPAGESTORE_SEGMENT_ORDER 24   /* the paging file grows in mapped 16 MB segments */
+#define EXPAGESTORE_SHARDS        8    /* independent allocators, each with its own lock */
+#define EXPAGESTORE_MAX_SEGMENTS  16384 /* the segment table is reserved by open(), so lookups take no lock */
+
+/** \details
+  <group ExServices_Classes>
+
+  This class keeps pages in a memory-mapped paging file.
+
+  Space is handed out as power-of-two blocks, from 64 bytes up to the segment
+  size. Blocks are carved from segments with a buddy allocator. A freed block is
+  merged with its free buddy, so space released by pages of one size can be
+  reused by pages of any other size. Pages larger than a segment get a dedicated
+  segment, which is reused the same way once it is freed.
+
+  Segments are mapped once and stay mapped until the store is destroyed, so
+  read() can return a stream that points directly into the mapping. The block
+  is freed when that stream is released.
+
+  allocate(), read() and free() can be called from any number of threads. Each
+  segment belongs to one of EXPAGESTORE_SHARDS shards, which keeps the free
+  lists of its segments behind its own mutex. Buddies never cross a segment,
+  so a shard splits and merges blocks without touching other shards. Threads
+  allocate from their own shard first and fall back to the others before
+  growing the file. Page data is accessed through the mapping only, with no
+  shared file position.
+
+  Library: Source code provided.
+*/
+class ExPageStore : public OdRxObject
+{
+public:
+  typedef OdInt64 Key;
+
+  ExPageStore();
+  ~ExPageStore();
+
+  /** \details
+    Creates the paging file. The file is removed when the store is destroyed,
+    or when the process exits.
+
+    \param path [in]  Paging file path.
+  */
+  bool open(const OdString& path);
+
+  /** \details
+    Allocates a block for a page of the specified length, and returns a
+    pointer to its data, to be filled by the caller.
+
+    \param length [in]  Page length in bytes.
+    \param key [out]  Key of the new page.
+    \param tag [in]  Caller-defined bits kept with the page.
+  */
+  OdUInt8* allocate(OdUInt32 length, Key& key, OdUInt8 tag = 0);
+
+  /** \details
+    Returns a pointer to the page data in the mapping, or NULL if the key does
+    not refer to a page. The page stays allocated.
+
+    \param key [in]  Page key returned by allocate().
+    \param length [out]  Page length in bytes.
+    \param tag [out]  Bits passed to allocate().
+  */
+  const OdUInt8* data(Key key, OdUInt32& length, OdUInt8& tag);
+
+  /** \details
+    Returns the number of bytes a page of the specified length can hold
+    without taking a larger block.
+
+    \param length [in]  Page length in bytes.
+  */
+  static OdUInt32 blockCapacity(OdUInt32 length);
+
+  /** \details
+    Returns a stream over the page data in the mapping. The page is freed
+    when the returned stream is released. Returns a null pointer if the key
+    does not refer to a page.
+
+    \param key [in]  Page key returned by allocate().
+  */
+  OdStreamBufPtr read(Key key);
+
+  /** \details
+    Frees a page without reading it.
+
+    \param key [in]  Page key returned by allocate().
+  */
+  void free(Key key);
+
+  /** \details
+    Returns the size of the paging file in bytes.
+  */
+  OdUInt64 fileSize() const { return m_fileSize.load(std::memory_order_relaxed); }
+
+  /** \details
+    Returns the number of bytes in allocated blocks, including block headers
+    and rounding.
+  */
+  OdUInt64 usedBytes() const { return m_usedBytes.load(std::memory_order_relaxed); }
+
+private:
+  /*!DOM*/
+  struct Segment
+  {
+    OdUInt8* m_pData;
+    OdUInt64 m_offset;
+    int      m_order;
+    int      m_shard;
+#if defined(ODA_WINDOWS)
+    void*    m_hMapping;
+#endif
+  };
+
+  /*!DOM*/
+  struct Shard
+  {
+    OdMutex            m_mutex;
+    // Free block offsets in the paging file, indexed by block order
+    std::set<OdUInt64> m_freeBlocks[64];
+  };
+
+  /*!DOM*/
+  Segment* segment(OdUInt64 offset);
+  /*!DOM*/
+  Segment* addSegment(int order, int shard);
+  /*!DOM*/
+  bool takeBlock(int shard, int order, OdUInt64& offset);
+  /*!DOM*/
+  void splitBlock(Shard& shard, OdUInt64 offset, int from, int to);
+  /*!DOM*/
+  OdUInt8* block(Key key, OdUInt32& length);
+  /*!DOM*/
+  void close();
+
+  // Sized once by open(), the first m_nSegments entries are in use
+  std::vector<Segment>   m_segments;
+  std::atomic<size_t>    m_nSegments;
+  Shard                  m_shards[EXPAGESTORE_SHARDS];
+  // Serializes growth of the paging file
+  OdMutex                m_growMutex;
+  std::atomic<OdUInt64>  m_fileSize;
+  std::atomic<OdUInt64>  m_usedBytes;
+#if defined(ODA_WINDOWS)
+  void*                  m_hFile;
+#else
+  int                    m_fd;
+#endif
+};
+
+/** \details
+  This template class is a specialization of the OdSmartPtr class for ExPageStore object pointers.
+*/
+typedef OdSmartPtr<ExPageStore> ExPageStorePtr;
+
+#include "TD_PackPop.h"
+
+#endif // _EX_PAGESTORE_H_
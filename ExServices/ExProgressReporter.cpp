@@ -0,0 +1,253 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OdaCommon.h"
+#include "ExProgressReporter.h"
+#include "OdAnsiString.h"
+#include "ExPrintConsole.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#if defined(ODA_WINDOWS)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+struct ExProgressReporter::Impl
+{
+  typedef std::chrono::steady_clock Clock;
+
+  std::mutex              m_mutex;      // guards the members below
+  std::condition_variable m_wake;
+  std::thread             m_thread;
+  bool                    m_bRunning;   // timer thread started
+  int                     m_depth;      // started phases not stopped yet
+  OdUInt32                m_interval;
+  OdAnsiString            m_phase;      // UTF-8, JSON escaped
+  std::vector<std::pair<OdAnsiString, Clock::time_point> > m_outer;  // phases of the outer start() calls
+  Clock::time_point       m_startTime;  // time the limit was set
+  OdInt64                 m_reported;   // counter value of the last progress report
+
+  std::mutex              m_outMutex;   // serializes reports
+  EventFunc               m_pFunc;
+  void*                   m_pUserData;
+  int                     m_fd;
+  bool                    m_bConsole;
+  OdString                m_consolePrefix;
+
+  Impl()
+    : m_bRunning(false), m_depth(0), m_interval(EXPROGRESS_INTERVAL), m_reported(-1)
+    , m_pFunc(NULL), m_pUserData(NULL), m_fd(-1), m_bConsole(false)
+  {
+  }
+
+  static OdAnsiString escape(const OdString& str)
+  {
+    OdAnsiString sUtf8(str, CP_UTF_8), res;
+    for (const char* p = sUtf8.c_str(); *p; ++p)
+    {
+      switch (*p)
+      {
+      case '"':  res += "\\\""; break;
+      case '\\': res += "\\\\"; break;
+      case '\n': res += "\\n";  break;
+      case '\r': res += "\\r";  break;
+      case '\t': res += "\\t";  break;
+      default:
+        if ((unsigned char)*p < 0x20)
+        {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)(unsigned char)*p);
+          res += buf;
+        }
+        else
+          res += *p;
+      }
+    }
+    return res;
+  }
+
+  void report(const char* sEvent, OdInt64 current, OdInt64 limit, const OdAnsiString& phase, Clock::time_point startTime)
+  {
+    double seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+    double rate = (seconds > 0.) ? double(current) / seconds : 0.;
+    char sEta[32] = "null";
+    if (limit > 0 && rate > 0.)
+      snprintf(sEta, sizeof(sEta), "%.2f", double(odmax(limit - current, OdInt64(0))) / rate);
+    OdAnsiString sJson;
+    sJson.format("{\"event\":\"%s\",\"phase\":\"%s\",\"current\":%lld,\"limit\":%lld,\"rate\":%.1f,\"eta\":%s}",
+      sEvent, phase.c_str(), (long long)current, (long long)limit, rate, sEta);
+
+    std::lock_guard<std::mutex> lock(m_outMutex);
+    if (!hasOutput())
+      return;
+    if (m_bConsole && limit > 0 && !strcmp(sEvent, "progress"))
+      odPrintConsoleString(OD_T("%lsProgress: %2.2lf%%\n"), m_consolePrefix.c_str(), double(current) / limit * 100);
+    if (m_pFunc)
+      m_pFunc(sJson.c_str(), m_pUserData);
+    if (m_fd != -1)
+    {
+      sJson += '\n';
+#if defined(ODA_WINDOWS)
+      ::_write(m_fd, sJson.c_str(), (unsigned)sJson.getLength());
+#else
+      ssize_t res = ::write(m_fd, sJson.c_str(), size_t(sJson.getLength()));
+      (void)res;
+#endif
+    }
+  }
+
+  // Call with m_outMutex locked
+  bool hasOutput() const
+  {
+    return m_bConsole || m_pFunc || m_fd != -1;
+  }
+
+  void run(ExProgressReporter* pOwner)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_bRunning)
+    {
+      m_wake.wait_for(lock, std::chrono::milliseconds(m_interval));
+      if (!m_bRunning)
+        break;
+      OdInt64 current = pOwner->current();
+      if (current == m_reported)
+        continue;
+      m_reported = current;
+      OdAnsiString phase = m_phase;
+      Clock::time_point startTime = m_startTime;
+      lock.unlock();
+      report("progress", current, pOwner->limit(), phase, startTime);
+      lock.lock();
+    }
+  }
+};
+
+ExProgressReporter::ExProgressReporter()
+  : m_current(0)
+  , m_limit(0)
+  , m_pImpl(new Impl)
+{
+}
+
+ExProgressReporter::~ExProgressReporter()
+{
+  while (m_pImpl->m_depth > 0)
+    stop();
+  delete m_pImpl;
+}
+
+void ExProgressReporter::start(const OdString& phase)
+{
+  bool bOutput;
+  {
+    std::lock_guard<std::mutex> outLock(m_pImpl->m_outMutex);
+    bOutput = m_pImpl->hasOutput();
+  }
+  std::unique_lock<std::mutex> lock(m_pImpl->m_mutex);
+  if (m_pImpl->m_depth++ > 0)
+    m_pImpl->m_outer.push_back(std::make_pair(m_pImpl->m_phase, m_pImpl->m_startTime));
+  m_pImpl->m_phase = Impl::escape(phase);
+  m_pImpl->m_startTime = Impl::Clock::now();
+  m_pImpl->m_reported = -1;
+  OdAnsiString sPhase = m_pImpl->m_phase;
+  Impl::Clock::time_point startTime = m_pImpl->m_startTime;
+  // Without an output there is nobody to report to
+  if (!m_pImpl->m_bRunning && bOutput)
+  {
+    m_pImpl->m_bRunning = true;
+    m_pImpl->m_thread = std::thread(&Impl::run, m_pImpl, this);
+  }
+  lock.unlock();
+  m_pImpl->report("start", current(), limit(), sPhase, startTime);
+}
+
+void ExProgressReporter::stop()
+{
+  std::unique_lock<std::mutex> lock(m_pImpl->m_mutex);
+  if (m_pImpl->m_depth == 0)
+    return;
+  OdAnsiString sPhase = m_pImpl->m_phase;
+  Impl::Clock::time_point startTime = m_pImpl->m_startTime;
+  if (--m_pImpl->m_depth > 0)
+  {
+    // A nested phase ends, the outer one continues
+    m_pImpl->m_phase = m_pImpl->m_outer.back().first;
+    m_pImpl->m_startTime = m_pImpl->m_outer.back().second;
+    m_pImpl->m_outer.pop_back();
+    lock.unlock();
+    m_pImpl->report("stop", current(), limit(), sPhase, startTime);
+    return;
+  }
+  bool bRunning = m_pImpl->m_bRunning;
+  m_pImpl->m_bRunning = false;
+  lock.unlock();
+  if (bRunning)
+  {
+    m_pImpl->m_wake.notify_all();
+    m_pImpl->m_thread.join();
+  }
+  m_pImpl->report("stop", current(), limit(), sPhase, startTime);
+}
+
+void ExProgressReporter::setLimit(OdInt64 limit)
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_mutex);
+  m_limit.store(limit, std::memory_order_relaxed);
+  m_current.store(0, std::memory_order_relaxed);
+  m_pImpl->m_startTime = Impl::Clock::now();
+  m_pImpl->m_reported = -1;
+}
+
+void ExProgressReporter::setInterval(OdUInt32 milliseconds)
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_mutex);
+  m_pImpl->m_interval = odmax(milliseconds, OdUInt32(1));
+}
+
+void ExProgressReporter::setEventFunc(EventFunc pFunc, void* pUserData)
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_outMutex);
+  m_pImpl->m_pFunc = pFunc;
+  m_pImpl->m_pUserData = pUserData;
+}
+
+void ExProgressReporter::setFd(int fd)
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_outMutex);
+  m_pImpl->m_fd = fd;
+}
+
+void ExProgressReporter::setConsoleOutput(bool bEnable, const OdString& prefix)
+{
+  std::lock_guard<std::mutex> lock(m_pImpl->m_outMutex);
+  m_pImpl->m_bConsole = bEnable;
+  m_pImpl->m_consolePrefix = prefix;
+}
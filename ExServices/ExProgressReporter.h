@@ -0,0 +1,129 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _EX_PROGRESSREPORTER_H_
+#define _EX_PROGRESSREPORTER_H_
+
+#include "TD_PackPush.h"
+#include "OdString.h"
+#include <atomic>
+
+#define EXPROGRESS_INTERVAL 250   /* default milliseconds between progress reports */
+
+/** \details
+  <group ExServices_Classes>
+
+  This class counts progress steps and reports them from a timer thread at a
+  fixed rate. A step costs a single relaxed atomic increment, so it can be
+  called from any number of threads.
+
+  Each report is a JSON object on one line:
+
+  {"event":"progress","phase":"Loading objects","current":1200,"limit":5000,"rate":4100.5,"eta":0.93}
+
+  event is "start", "progress" or "stop". rate is in steps per second since
+  the limit was set. eta is in seconds, null if the limit or rate is unknown.
+  Reports go to the event function and to the file descriptor, when set.
+  Progress reports can also be printed to the console as percentages. With no
+  output set when the outermost phase starts, no timer thread is started.
+
+  Library: Source code provided.
+*/
+class ExProgressReporter
+{
+public:
+  /** \details
+    Receives a JSON report, without a trailing new line.
+    Called on the timer thread, or on the thread calling start() or stop().
+  */
+  typedef void (*EventFunc)(const char* sJson, void* pUserData);
+
+  ExProgressReporter();
+  ~ExProgressReporter();
+
+  /** \details
+    Reports the start of a phase, and starts the timer thread if an output is
+    set. Phases can be nested: each start() is matched by a stop().
+    \param phase [in]  Phase name.
+  */
+  void start(const OdString& phase);
+
+  /** \details
+    Reports the final state of the innermost phase. Stopping the outermost
+    phase stops the timer thread.
+  */
+  void stop();
+
+  /** \details
+    Sets the number of steps of the phase and resets the step counter.
+    \param limit [in]  Number of steps.
+  */
+  void setLimit(OdInt64 limit);
+
+  /** \details
+    Counts one step.
+  */
+  void step() { m_current.fetch_add(1, std::memory_order_relaxed); }
+
+  OdInt64 current() const { return m_current.load(std::memory_order_relaxed); }
+  OdInt64 limit() const { return m_limit.load(std::memory_order_relaxed); }
+
+  /** \details
+    Sets the interval between reports.
+    \param milliseconds [in]  Interval in milliseconds.
+  */
+  void setInterval(OdUInt32 milliseconds);
+
+  /** \details
+    Sets the function receiving the reports. NULL disables it.
+  */
+  void setEventFunc(EventFunc pFunc, void* pUserData = NULL);
+
+  /** \details
+    Sets the file descriptor the reports are written to, one per line.
+    -1 disables it.
+  */
+  void setFd(int fd);
+
+  /** \details
+    Controls printing of progress reports to the console.
+    \param bEnable [in]  Prints "<prefix>Progress: <percent>%" lines if true.
+    \param prefix [in]  Prefix of the printed lines.
+  */
+  void setConsoleOutput(bool bEnable, const OdString& prefix = OdString::kEmpty);
+
+protected:
+  std::atomic<OdInt64> m_current;
+  std::atomic<OdInt64> m_limit;
+
+  struct Impl;             /* timer thread and outputs, see ExProgressReporter.cpp */
+  Impl* m_pImpl;
+
+private:
+  ExProgressReporter(const ExProgressReporter&);
+  ExProgressReporter& operator=(const ExProgressReporter&);
+};
+
+#include "TD_PackPop.h"
+
+#endif // _EX_PROGRESSREPORTER_H_
@@ -0,0 +1,618 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OdaCommon.h"
+#include "ExTtfFontIndex.h"
+#include "OdFileBuf.h"
+#include "OdAnsiString.h"
+
+#define STL_USING_ALGORITHM
+#define STL_USING_VECTOR
+#define STL_USING_SET
+#include "OdaSTL.h"
+#include <string.h>
+#include <stdio.h>
+
+#if defined(ODA_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+namespace
+{
+  // Index file layout: Header, Entry[m_numEntries] sorted by name,
+  // FileRec[m_numFiles], then UTF-8 strings. Names are lower case.
+  const char     kIndexMagic[8] = { 'O', 'D', 'T', 'T', 'F', 'I', 'D', 'X' };
+  const OdUInt32 kIndexVersion  = 1;
+
+  struct Header
+  {
+    char     m_magic[8];
+    OdUInt32 m_version;
+    OdUInt32 m_numEntries;
+    OdUInt64 m_stamp;
+    OdUInt32 m_numFiles;
+    OdUInt32 m_stringsSize;
+  };
+
+  enum EntryFlags
+  {
+    kBold   = 1,
+    kItalic = 2
+  };
+
+  struct Entry
+  {
+    OdUInt32 m_nameOffset;
+    OdUInt32 m_nameLength;
+    OdUInt32 m_file;
+    OdUInt32 m_codePages;  // OS/2 ulCodePageRange1, 0 if unknown
+    OdUInt32 m_flags;
+  };
+
+  struct FileRec
+  {
+    OdUInt32 m_pathOffset;
+    OdUInt32 m_pathLength;
+  };
+
+  // Maps a Windows character set to its OS/2 ulCodePageRange1 bit.
+  OdUInt32 codePageBit(int charset)
+  {
+    switch (charset)
+    {
+    case 0:   return 1u << 0;   // ANSI
+    case 238: return 1u << 1;   // EASTEUROPE
+    case 204: return 1u << 2;   // RUSSIAN
+    case 161: return 1u << 3;   // GREEK
+    case 162: return 1u << 4;   // TURKISH
+    case 177: return 1u << 5;   // HEBREW
+    case 178: return 1u << 6;   // ARABIC
+    case 186: return 1u << 7;   // BALTIC
+    case 163: return 1u << 8;   // VIETNAMESE
+    case 222: return 1u << 16;  // THAI
+    case 128: return 1u << 17;  // SHIFTJIS
+    case 134: return 1u << 18;  // GB2312
+    case 129: return 1u << 19;  // HANGUL
+    case 136: return 1u << 20;  // CHINESEBIG5
+    case 130: return 1u << 21;  // JOHAB
+    case 2:   return 1u << 31;  // SYMBOL
+    default:  break;
+    }
+    return 0;
+  }
+
+  OdAnsiString indexKey(const OdString& name)
+  {
+    OdString sLower(name);
+    sLower.makeLower();
+    return OdAnsiString(sLower, CP_UTF_8);
+  }
+
+  //----------------------------------------------------------
+  //
+  // Font file parsing
+  //
+  //----------------------------------------------------------
+
+  inline OdUInt16 be16(const OdUInt8* p) { return OdUInt16((p[0] << 8) | p[1]); }
+  inline OdUInt32 be32(const OdUInt8* p) { return (OdUInt32(p[0]) << 24) | (OdUInt32(p[1]) << 16) | (OdUInt32(p[2]) << 8) | p[3]; }
+
+  bool readAt(OdStreamBuf* pFile, OdUInt64 pos, OdUInt32 numBytes, std::vector<OdUInt8>& buf)
+  {
+    if (pos + numBytes > pFile->length())
+      return false;
+    buf.resize(numBytes);
+    pFile->seek(OdInt64(pos), OdDb::kSeekFromStart);
+    if (numBytes)
+      pFile->getBytes(&buf[0], numBytes);
+    return true;
+  }
+
+  struct FontFace
+  {
+    std::set<OdString> m_families;
+    OdUInt32           m_codePages;
+    OdUInt32           m_flags;
+  };
+
+  // Reads the family names (nameID 1) of a name table. Macintosh Roman names
+  // are used only when there is no Windows Unicode name.
+  void readFamilyNames(const std::vector<OdUInt8>& name, std::set<OdString>& families)
+  {
+    if (name.size() < 6)
+      return;
+    const OdUInt8* p = &name[0];
+    OdUInt32 count = be16(p + 2), strings = be16(p + 4);
+    std::set<OdString> macNames;
+    for (OdUInt32 i = 0; i < count && 6 + (i + 1) * 12 <= name.size(); ++i)
+    {
+      const OdUInt8* pRec = p + 6 + i * 12;
+      OdUInt16 platform = be16(pRec), encoding = be16(pRec + 2), nameId = be16(pRec + 6);
+      OdUInt32 length = be16(pRec + 8), offset = strings + be16(pRec + 10);
+      if (nameId != 1 || offset + length > name.size() || !length)
+        continue;
+      const OdUInt8* pStr = p + offset;
+      OdString sName;
+      if (platform == 3 && (encoding == 0 || encoding == 1 || encoding == 10))
+      {
+        for (OdUInt32 j = 0; j + 1 < length; j += 2)
+          sName += OdChar(be16(pStr + j));
+        if (!sName.isEmpty())
+          families.insert(sName);
+      }
+      else if (platform == 1 && encoding == 0)
+      {
+        for (OdUInt32 j = 0; j < length; ++j)
+          sName += OdChar(pStr[j]);
+        macNames.insert(sName);
+      }
+    }
+    if (families.empty())
+      families.swap(macNames);
+  }
+
+  bool readFace(OdStreamBuf* pFile, OdUInt64 base, FontFace& face)
+  {
+    std::vector<OdUInt8> buf;
+    if (!readAt(pFile, base, 12, buf))
+      return false;
+    OdUInt32 numTables = be16(&buf[4]);
+    if (!numTables || !readAt(pFile, base + 12, numTables * 16, buf))
+      return false;
+    OdUInt32 nameOff = 0, nameLen = 0, os2Off = 0, os2Len = 0, headOff = 0, headLen = 0;
+    for (OdUInt32 i = 0; i < numTables; ++i)
+    {
+      const OdUInt8* pRec = &buf[i * 16];
+      OdUInt32 offset = be32(pRec + 8), length = be32(pRec + 12);
+      if (!memcmp(pRec, "name", 4))      { nameOff = offset; nameLen = length; }
+      else if (!memcmp(pRec, "OS/2", 4)) { os2Off = offset;  os2Len = length; }
+      else if (!memcmp(pRec, "head", 4)) { headOff = offset; headLen = length; }
+    }
+    // Table offsets are relative to the file, also in collections.
+    if (!nameOff || !readAt(pFile, nameOff, odmin(nameLen, OdUInt32(0x100000)), buf))
+      return false;
+    face.m_families.clear();
+    readFamilyNames(buf, face.m_families);
+    if (face.m_families.empty())
+      return false;
+
+    face.m_codePages = 0;
+    face.m_flags = 0;
+    if (os2Off && os2Len >= 64 && readAt(pFile, os2Off, odmin(os2Len, OdUInt32(86)), buf))
+    {
+      OdUInt16 fsSelection = be16(&buf[62]);
+      if (fsSelection & 0x20) face.m_flags |= kBold;
+      if (fsSelection & 0x01) face.m_flags |= kItalic;
+      if (be16(&buf[0]) >= 1 && buf.size() >= 86)
+        face.m_codePages = be32(&buf[78]);
+    }
+    else if (headOff && headLen >= 46 && readAt(pFile, headOff, 46, buf))
+    {
+      OdUInt16 macStyle = be16(&buf[44]);
+      if (macStyle & 0x01) face.m_flags |= kBold;
+      if (macStyle & 0x02) face.m_flags |= kItalic;
+    }
+    return true;
+  }
+
+  // Reads all faces of a TTF, OTF or TTC file.
+  void readFontFile(const OdString& path, std::vector<FontFace>& faces)
+  {
+    faces.clear();
+    try
+    {
+      // Opened directly, so that building the index does not fill the
+      // system services file cache with every installed font.
+      OdStreamBufPtr pFile = OdRdFileBuf::createObject(path, Oda::kShareDenyNo);
+      std::vector<OdUInt8> buf;
+      if (!readAt(pFile, 0, 12, buf))
+        return;
+      if (!memcmp(&buf[0], "ttcf", 4))
+      {
+        OdUInt32 numFonts = odmin(be32(&buf[8]), OdUInt32(256));
+        std::vector<OdUInt8> offsets;
+        if (!readAt(pFile, 12, numFonts * 4, offsets))
+          return;
+        for (OdUInt32 i = 0; i < numFonts; ++i)
+        {
+          FontFace face;
+          if (readFace(pFile, be32(&offsets[i * 4]), face))
+            faces.push_back(face);
+        }
+      }
+      else
+      {
+        FontFace face;
+        if (readFace(pFile, 0, face))
+          faces.push_back(face);
+      }
+    }
+    catch (const OdError&)
+    {
+      faces.clear();
+    }
+  }
+
+  struct BuildEntry
+  {
+    OdAnsiString m_name;
+    Entry        m_entry;
+    bool operator<(const BuildEntry& other) const { return strcmp(m_name.c_str(), other.m_name.c_str()) < 0; }
+  };
+
+  // Splits "dir/name.ext" into "dir/", "name" and ".ext".
+  void splitIndexPath(const OdString& indexPath, OdString& dir, OdString& name, OdString& ext)
+  {
+    int nSep = odmax(indexPath.reverseFind(L'/'), indexPath.reverseFind(L'\\'));
+    dir = indexPath.left(nSep + 1);
+    name = indexPath.mid(nSep + 1);
+    int nDot = name.reverseFind(L'.');
+    ext = nDot > 0 ? name.mid(nDot) : OdString();
+    if (nDot > 0)
+      name = name.left(nDot);
+  }
+
+  // Each stamp has its own file, "dir/name.<stamp>.ext", so a rebuild never
+  // replaces a file that other processes have mapped.
+  OdString versionFileName(const OdString& name, const OdString& ext, OdUInt64 stamp)
+  {
+    OdString res;
+    res.format(OD_T("%ls.%016llx%ls"), name.c_str(), (unsigned long long)stamp, ext.c_str());
+    return res;
+  }
+
+  OdString versionPath(const OdString& indexPath, OdUInt64 stamp)
+  {
+    OdString dir, name, ext;
+    splitIndexPath(indexPath, dir, name, ext);
+    return dir + versionFileName(name, ext, stamp);
+  }
+
+  bool isVersionFileName(const OdString& fileName, const OdString& name, const OdString& ext)
+  {
+    int nName = name.getLength();
+    if (fileName.getLength() != nName + 17 + ext.getLength() || fileName[nName] != L'.' ||
+        fileName.left(nName) != name || fileName.right(ext.getLength()) != ext)
+      return false;
+    for (int i = nName + 1; i < nName + 17; ++i)
+    {
+      OdChar ch = fileName[i];
+      if (!((ch >= L'0' && ch <= L'9') || (ch >= L'a' && ch <= L'f')))
+        return false;
+    }
+    return true;
+  }
+
+  // Windows can't replace a file that another process has mapped, so it fails
+  // if the target exists. POSIX mappings keep the replaced file.
+  bool publishFile(const OdString& from, const OdString& to)
+  {
+#if defined(ODA_WINDOWS)
+    return ::MoveFileExW(from.c_str(), to.c_str(), 0) != 0;
+#else
+    return ::rename(OdAnsiString(from, CP_UTF_8).c_str(), OdAnsiString(to, CP_UTF_8).c_str()) == 0;
+#endif
+  }
+
+  bool fileExists(const OdString& path)
+  {
+#if defined(ODA_WINDOWS)
+    return ::GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+#else
+    return ::access(OdAnsiString(path, CP_UTF_8).c_str(), F_OK) == 0;
+#endif
+  }
+
+  void removeFile(const OdString& path)
+  {
+#if defined(ODA_WINDOWS)
+    ::DeleteFileW(path.c_str());
+#else
+    ::unlink(OdAnsiString(path, CP_UTF_8).c_str());
+#endif
+  }
+
+  OdUInt32 processId()
+  {
+#if defined(ODA_WINDOWS)
+    return ::GetCurrentProcessId();
+#else
+    return OdUInt32(::getpid());
+#endif
+  }
+
+  // Removes the index files of other stamps. A file still mapped by another
+  // process goes away when it is unmapped.
+  void removeOtherVersions(const OdString& indexPath, OdUInt64 stamp)
+  {
+    OdString dir, name, ext;
+    splitIndexPath(indexPath, dir, name, ext);
+    OdString keep = versionFileName(name, ext, stamp);
+    OdStringArray files;
+#if defined(ODA_WINDOWS)
+    WIN32_FIND_DATAW data;
+    HANDLE hFind = ::FindFirstFileW((dir + name + OD_T(".*") + ext).c_str(), &data);
+    if (hFind == INVALID_HANDLE_VALUE)
+      return;
+    do
+      files.append(OdString(data.cFileName));
+    while (::FindNextFileW(hFind, &data));
+    ::FindClose(hFind);
+#else
+    DIR* pDir = ::opendir(dir.isEmpty() ? "." : OdAnsiString(dir, CP_UTF_8).c_str());
+    if (!pDir)
+      return;
+    while (struct dirent* pEntry = ::readdir(pDir))
+      files.append(OdString(pEntry->d_name, CP_UTF_8));
+    ::closedir(pDir);
+#endif
+    for (unsigned int i = 0; i < files.size(); ++i)
+    {
+      if (files[i] != keep && isVersionFileName(files[i], name, ext))
+        removeFile(dir + files[i]);
+    }
+  }
+}
+
+ExTtfFontIndex::ExTtfFontIndex()
+  : m_pData(NULL)
+  , m_size(0)
+#if defined(ODA_WINDOWS)
+  , m_hFile(NULL)
+  , m_hMapping(NULL)
+#endif
+{
+}
+
+ExTtfFontIndex::~ExTtfFontIndex()
+{
+  close();
+}
+
+void ExTtfFontIndex::close()
+{
+#if defined(ODA_WINDOWS)
+  if (m_pData)
+    ::UnmapViewOfFile(m_pData);
+  if (m_hMapping)
+    ::CloseHandle(m_hMapping);
+  if (m_hFile)
+    ::CloseHandle(m_hFile);
+  m_hMapping = m_hFile = NULL;
+#else
+  if (m_pData)
+    ::munmap((void*)m_pData, size_t(m_size));
+#endif
+  m_pData = NULL;
+  m_size = 0;
+}
+
+bool ExTtfFontIndex::open(const OdString& indexPath, OdUInt64 stamp)
+{
+  close();
+  OdString sPath = versionPath(indexPath, stamp);
+#if defined(ODA_WINDOWS)
+  HANDLE hFile = ::CreateFileW(sPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                               NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+  m_hFile = hFile;
+  LARGE_INTEGER size;
+  if (!::GetFileSizeEx(hFile, &size) || size.QuadPart < LONGLONG(sizeof(Header)))
+  {
+    close();
+    return false;
+  }
+  m_hMapping = ::CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (m_hMapping)
+    m_pData = (const OdUInt8*)::MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+  m_size = OdUInt64(size.QuadPart);
+#else
+  int fd = ::open(OdAnsiString(sPath, CP_UTF_8).c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size >= off_t(sizeof(Header)))
+  {
+    void* pData = ::mmap(NULL, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (pData != MAP_FAILED)
+    {
+      m_pData = (const OdUInt8*)pData;
+      m_size = OdUInt64(st.st_size);
+    }
+  }
+  ::close(fd);
+#endif
+  if (!m_pData)
+  {
+    close();
+    return false;
+  }
+
+  const Header* pHeader = (const Header*)m_pData;
+  if (memcmp(pHeader->m_magic, kIndexMagic, sizeof(kIndexMagic)) || pHeader->m_version != kIndexVersion ||
+      pHeader->m_stamp != stamp ||
+      sizeof(Header) + OdUInt64(pHeader->m_numEntries) * sizeof(Entry) +
+      OdUInt64(pHeader->m_numFiles) * sizeof(FileRec) + pHeader->m_stringsSize != m_size)
+  {
+    close();
+    return false;
+  }
+
+  // lookUp() trusts the offsets, so a damaged file is rejected here
+  const Entry* pEntries = (const Entry*)(pHeader + 1);
+  const FileRec* pFiles = (const FileRec*)(pEntries + pHeader->m_numEntries);
+  const OdUInt64 stringsSize = pHeader->m_stringsSize;
+  for (OdUInt32 i = 0; i < pHeader->m_numEntries; ++i)
+  {
+    if (OdUInt64(pEntries[i].m_nameOffset) + pEntries[i].m_nameLength > stringsSize ||
+        pEntries[i].m_file >= pHeader->m_numFiles)
+    {
+      close();
+      return false;
+    }
+  }
+  for (OdUInt32 i = 0; i < pHeader->m_numFiles; ++i)
+  {
+    if (OdUInt64(pFiles[i].m_pathOffset) + pFiles[i].m_pathLength > stringsSize)
+    {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+OdUInt32 ExTtfFontIndex::numEntries() const
+{
+  return m_pData ? ((const Header*)m_pData)->m_numEntries : 0;
+}
+
+bool ExTtfFontIndex::lookUp(const OdString& typeface, bool bBold, bool bItalic, int charset, OdString& fileName) const
+{
+  if (!m_pData || typeface.isEmpty())
+    return false;
+  const Header* pHeader = (const Header*)m_pData;
+  const Entry* pEntries = (const Entry*)(pHeader + 1);
+  const FileRec* pFiles = (const FileRec*)(pEntries + pHeader->m_numEntries);
+  const char* pStrings = (const char*)(pFiles + pHeader->m_numFiles);
+
+  OdAnsiString sKey = indexKey(typeface);
+  OdUInt32 keyLength = sKey.getLength();
+  struct Less
+  {
+    const char* m_pStrings;
+    OdUInt32    m_keyLength;
+    bool operator()(const Entry& entry, const char* pKey) const
+    {
+      int res = memcmp(m_pStrings + entry.m_nameOffset, pKey, odmin(entry.m_nameLength, m_keyLength));
+      return res < 0 || (res == 0 && entry.m_nameLength < m_keyLength);
+    }
+  } less = { pStrings, keyLength };
+  const Entry* pEnd = pEntries + pHeader->m_numEntries;
+  const Entry* pEntry = std::lower_bound(pEntries, pEnd, sKey.c_str(), less);
+
+  OdUInt32 flags = (bBold ? kBold : 0) | (bItalic ? kItalic : 0);
+  OdUInt32 codePage = codePageBit(charset);
+  const Entry* pBest = NULL;
+  int bestScore = -1;
+  for (; pEntry != pEnd && pEntry->m_nameLength == keyLength &&
+         !memcmp(pStrings + pEntry->m_nameOffset, sKey.c_str(), keyLength); ++pEntry)
+  {
+    int score = (pEntry->m_flags == flags) ? 2 : 0;
+    if (!codePage || !pEntry->m_codePages || (pEntry->m_codePages & codePage))
+      ++score;
+    if (score > bestScore)
+    {
+      pBest = pEntry;
+      bestScore = score;
+    }
+  }
+  if (!pBest)
+    return false;
+  const FileRec& file = pFiles[pBest->m_file];
+  fileName = OdString(pStrings + file.m_pathOffset, int(file.m_pathLength), CP_UTF_8);
+  return true;
+}
+
+bool ExTtfFontIndex::build(const OdString& indexPath, OdUInt64 stamp, const OdStringArray& fontFiles)
+{
+  std::vector<BuildEntry> entries;
+  std::vector<FileRec> files;
+  OdAnsiString strings;
+  std::vector<FontFace> faces;
+  for (unsigned int i = 0; i < fontFiles.size(); ++i)
+  {
+    readFontFile(fontFiles[i], faces);
+    if (faces.empty())
+      continue;
+    OdAnsiString sPath(fontFiles[i], CP_UTF_8);
+    FileRec file = { OdUInt32(strings.getLength()), OdUInt32(sPath.getLength()) };
+    strings += sPath;
+    for (size_t j = 0; j < faces.size(); ++j)
+    {
+      std::set<OdString>::const_iterator it = faces[j].m_families.begin();
+      for (; it != faces[j].m_families.end(); ++it)
+      {
+        BuildEntry entry;
+        entry.m_name = indexKey(*it);
+        entry.m_entry.m_file = OdUInt32(files.size());
+        entry.m_entry.m_codePages = faces[j].m_codePages;
+        entry.m_entry.m_flags = faces[j].m_flags;
+        entries.push_back(entry);
+      }
+    }
+    files.push_back(file);
+  }
+  // Stable, so that fonts from earlier folders win ties in lookUp().
+  std::stable_sort(entries.begin(), entries.end());
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    entries[i].m_entry.m_nameOffset = OdUInt32(strings.getLength());
+    entries[i].m_entry.m_nameLength = OdUInt32(entries[i].m_name.getLength());
+    strings += entries[i].m_name;
+  }
+
+  Header header;
+  memcpy(header.m_magic, kIndexMagic, sizeof(kIndexMagic));
+  header.m_version = kIndexVersion;
+  header.m_numEntries = OdUInt32(entries.size());
+  header.m_stamp = stamp;
+  header.m_numFiles = OdUInt32(files.size());
+  header.m_stringsSize = OdUInt32(strings.getLength());
+
+  OdString sPath = versionPath(indexPath, stamp);
+  OdString sTmpPath;
+  sTmpPath.format(OD_T("%ls.%u.tmp"), sPath.c_str(), processId());
+  try
+  {
+    OdWrFileBufPtr pFile = OdWrFileBuf::createObject(sTmpPath, Oda::kShareDenyReadWrite);
+    pFile->putBytes(&header, sizeof(header));
+    for (size_t i = 0; i < entries.size(); ++i)
+      pFile->putBytes(&entries[i].m_entry, sizeof(Entry));
+    if (!files.empty())
+      pFile->putBytes(&files[0], OdUInt32(files.size() * sizeof(FileRec)));
+    pFile->putBytes(strings.c_str(), OdUInt32(strings.getLength()));
+  }
+  catch (const OdError&)
+  {
+    removeFile(sTmpPath);
+    return false;
+  }
+  if (!publishFile(sTmpPath, sPath))
+  {
+    removeFile(sTmpPath);
+    // Another process published the index of the same stamp first
+    if (!fileExists(sPath))
+      return false;
+  }
+  removeOtherVersions(indexPath, stamp);
+  return true;
+}
@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _EX_TTFFONTINDEX_H_
+#define _EX_TTFFONTINDEX_H_
+
+#include "TD_PackPush.h"
+#include "OdString.h"
+#include "StringArray.h"
+
+/** \details
+  <group ExServices_Classes>
+
+  This class keeps an on-disk index of TrueType and OpenType font files keyed by
+  family name, style and supported character sets. The index is built once by
+  reading the name, OS/2 and head tables of each font, and is memory mapped
+  read-only afterwards, so processes that open the same index file share its pages.
+
+  Library: Source code provided.
+
+  \remarks
+  The index records a caller-defined stamp of the font folders it was built from.
+  Each stamp is kept in its own file, "name.<stamp>.ext" next to the index path,
+  so a rebuild never replaces a file that other processes have mapped. open()
+  fails when there is no file for the stamp or its offsets are out of range, and
+  the caller is expected to build it.
+*/
+class ExTtfFontIndex
+{
+  const OdUInt8* m_pData;
+  OdUInt64       m_size;
+#if defined(ODA_WINDOWS)
+  void*          m_hFile;
+  void*          m_hMapping;
+#endif
+
+  ExTtfFontIndex(const ExTtfFontIndex&);
+  ExTtfFontIndex& operator=(const ExTtfFontIndex&);
+public:
+  ExTtfFontIndex();
+  ~ExTtfFontIndex();
+
+  /** \details
+    Maps the index file of the stamp. Returns false if the file is missing,
+    damaged or was built with a different stamp.
+
+    \param indexPath [in]  Index file path, without the stamp.
+    \param stamp [in]  Stamp of the font folders the index must match.
+  */
+  bool open(const OdString& indexPath, OdUInt64 stamp);
+
+  /** \details
+    Unmaps the index file.
+  */
+  void close();
+
+  /** \details
+    Returns true if an index file is mapped.
+  */
+  bool isOpen() const { return m_pData != NULL; }
+
+  /** \details
+    Returns the number of family name entries in the mapped index.
+  */
+  OdUInt32 numEntries() const;
+
+  /** \details
+    Finds the font file for a typeface. An entry with the requested style is
+    preferred over other styles of the family, and an entry supporting the
+    character set over one that does not.
+
+    \param typeface [in]  Family name, compared case-insensitively.
+    \param bBold [in]  Bold style.
+    \param bItalic [in]  Italic style.
+    \param charset [in]  Windows character set, DEFAULT_CHARSET (1) matches any.
+    \param fileName [out]  Receives the full font file path.
+  */
+  bool lookUp(const OdString& typeface, bool bBold, bool bItalic, int charset, OdString& fileName) const;
+
+  /** \details
+    Parses font files and writes the index file of the stamp. The file is
+    written under a temporary name and renamed; if another process has
+    published the file of the same stamp meanwhile, that file is kept. Files
+    of other stamps are removed, processes that map them keep their view.
+
+    \param indexPath [in]  Index file path, without the stamp.
+    \param stamp [in]  Stamp of the font folders the files come from.
+    \param fontFiles [in]  Full paths of TTF, TTC and OTF files, in priority order.
+  */
+  static bool build(const OdString& indexPath, OdUInt64 stamp, const OdStringArray& fontFiles);
+};
+
+#include "TD_PackPop.h"
+
+#endif // _EX_TTFFONTINDEX_H_
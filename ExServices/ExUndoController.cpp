@@ -29,12 +29,104 @@
 #include "OdaSTL.h"
 #include "RxObjectImpl.h"
 
+namespace
+{
+  void putCount(OdUInt8*& pOut, OdUInt32 n)
+  {
+    while(n >= 0x80)
+    {
+      *pOut++ = OdUInt8(n | 0x80);
+      n >>= 7;
+    }
+    *pOut++ = OdUInt8(n);
+  }
+
+  bool getCount(const OdUInt8*& pIn, const OdUInt8* pEnd, OdUInt32& n)
+  {
+    n = 0;
+    for(int nShift = 0; nShift < 32; nShift += 7)
+    {
+      if(pIn == pEnd)
+        return false;
+      OdUInt8 b = *pIn++;
+      n |= OdUInt32(b & 0x7F) << nShift;
+      if(!(b & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  // Encodes pData against pBase as (copy count, literal count, literals) runs.
+  // Returns the encoded size, or 0 if it does not fit into nCapacity bytes.
+  OdUInt32 encodeDelta(const OdUInt8* pBase, OdUInt32 nBase,
+                       const OdUInt8* pData, OdUInt32 nData,
+                       OdUInt8* pOut, OdUInt32 nCapacity)
+  {
+    const OdUInt32 nMinCopy = 4; // shorter matches are cheaper as literals
+    OdUInt8* pStart = pOut;
+    OdUInt32 nPos = 0;
+    while(nPos < nData)
+    {
+      OdUInt32 nCopy = 0;
+      while(nPos + nCopy < nData && nPos + nCopy < nBase && pData[nPos + nCopy] == pBase[nPos + nCopy])
+        ++nCopy;
+      OdUInt32 nLiteral = 0;
+      for(OdUInt32 i = nPos + nCopy; i < nData; )
+      {
+        OdUInt32 nMatch = 0;
+        while(i + nMatch < nData && i + nMatch < nBase && nMatch < nMinCopy && pData[i + nMatch] == pBase[i + nMatch])
+          ++nMatch;
+        if(nMatch == nMinCopy || (nMatch && i + nMatch == nData))
+          break;
+        i += odmax(nMatch, 1U);
+        nLiteral = i - nPos - nCopy;
+      }
+      // Each count takes at most 5 bytes
+      if(OdUInt32(pOut - pStart) + 10 + nLiteral > nCapacity)
+        return 0;
+      putCount(pOut, nCopy);
+      putCount(pOut, nLiteral);
+      ::memcpy(pOut, pData + nPos + nCopy, nLiteral);
+      pOut += nLiteral;
+      nPos += nCopy + nLiteral;
+    }
+    return OdUInt32(pOut - pStart);
+  }
+
+  bool decodeDelta(const OdUInt8* pBase, OdUInt32 nBase,
+                   const OdUInt8* pDelta, OdUInt32 nDelta,
+                   OdUInt8* pData, OdUInt32 nData)
+  {
+    const OdUInt8* pEnd = pDelta + nDelta;
+    OdUInt32 nPos = 0;
+    while(nPos < nData)
+    {
+      OdUInt32 nCopy, nLiteral;
+      if(!getCount(pDelta, pEnd, nCopy) || nCopy > nData - nPos || nPos + nCopy > nBase)
+        return false;
+      ::memcpy(pData + nPos, pBase + nPos, nCopy);
+      nPos += nCopy;
+      if(!getCount(pDelta, pEnd, nLiteral) || nLiteral > nData - nPos || nLiteral > OdUInt32(pEnd - pDelta))
+        return false;
+      ::memcpy(pData + nPos, pDelta, nLiteral);
+      pDelta += nLiteral;
+      nPos += nLiteral;
+    }
+    return pDelta == pEnd;
+  }
+}
+
 
 ExUndoController::ExUndoController()
-  : m_nMaxSteps(0xFFFFFFFF)
+  : m_nFirst(0)
+  , m_nRecords(0)
+  , m_nMemoryUsed(0)
+  , m_nRawBytes(0)
+  , m_nDeltaRecords(0)
+  , m_nMaxSteps(0xFFFFFFFF)
   , m_nMaxMemory(0x01000000)
+  , m_bDeltaMode(false)
 {
-  m_nMemoryUsed = sizeof(ExUndoController);
 }
 
 void ExUndoController::setLimits(OdUInt32 nMaxSteps, OdUInt32 nMaxMemory)
@@ -44,97 +136,272 @@ void ExUndoController::setLimits(OdUInt32 nMaxSteps, OdUInt32 nMaxMemory)
   freeExtra();
 }
 
+void ExUndoController::setDeltaMode(bool bDeltaMode)
+{
+  m_bDeltaMode = bDeltaMode;
+  if(!m_bDeltaMode)
+  {
+    m_buffData.setPhysicalLength(0);
+    m_buffBase.setPhysicalLength(0);
+    m_buffTemp.setPhysicalLength(0);
+    m_buffDelta.setPhysicalLength(0);
+  }
+}
+
+ExUndoController::MemoryStats ExUndoController::memoryStats() const
+{
+  MemoryStats stats;
+  stats.m_records = m_nRecords;
+  stats.m_deltaRecords = m_nDeltaRecords;
+  stats.m_memoryUsed = m_nMemoryUsed;
+  stats.m_rawBytes = m_nRawBytes;
+  return stats;
+}
+
 OdUInt32 ExUndoController::recordMemory(OdUInt32 nDataSize)
 {
-  return sizeof(OdUInt8Array) + sizeof(OdArrayBuffer) + sizeof(void*) * 2 + nDataSize;
+  return nDataSize;
 }
 
 OdUInt32 ExUndoController::frontRecordMemory() const
 {
-  return recordMemory(m_records.front().size());
+  return recordMemory(record(0).m_size);
 }
 
 OdUInt32 ExUndoController::backRecordMemory() const
 {
-  return recordMemory(m_records.back().size());
+  return recordMemory(record(m_nRecords - 1).m_size);
 }
 
 void ExUndoController::freeFrontRecord()
 {
-  ODA_ASSERT(m_records.size());
-  m_nMemoryUsed -= frontRecordMemory();
-  m_records.pop_front();
+  ODA_ASSERT(m_nRecords);
+  do
+  {
+    // Delta records following the freed one can no longer be restored
+    const Record& rec = record(0);
+    m_nMemoryUsed -= frontRecordMemory();
+    m_nRawBytes -= rec.m_rawSize;
+    if(rec.m_chain)
+      --m_nDeltaRecords;
+    m_nFirst = (m_nFirst + 1) & (m_records.size() - 1);
+    --m_nRecords;
+  }
+  while(m_nRecords && record(0).m_chain);
 }
 
 void ExUndoController::freeBackRecord()
 {
-  ODA_ASSERT(m_records.size());
+  ODA_ASSERT(m_nRecords);
+  const Record& rec = record(m_nRecords - 1);
   m_nMemoryUsed -= backRecordMemory();
-  m_records.pop_back();
+  m_nRawBytes -= rec.m_rawSize;
+  if(rec.m_chain)
+    --m_nDeltaRecords;
+  --m_nRecords;
+}
+
+void ExUndoController::markBackDelta(OdUInt32 nRawSize, OdUInt32 nChain)
+{
+  Record& rec = m_records[(m_nFirst + m_nRecords - 1) & (m_records.size() - 1)];
+  m_nRawBytes += nRawSize - rec.m_rawSize;
+  rec.m_rawSize = nRawSize;
+  rec.m_chain = nChain;
+  ++m_nDeltaRecords;
+}
+
+OdBinaryData& ExUndoController::restoreRecord(OdUInt32 nIndex)
+{
+  // Starts from the full record and applies the deltas up to nIndex
+  OdUInt32 nFull = nIndex - record(nIndex).m_chain;
+  const Record& full = record(nFull);
+  m_buffBase.resize(full.m_size - sizeof(OdUInt32));
+  ::memcpy(m_buffBase.asArrayPtr(), m_arena.getPtr() + full.m_offset + sizeof(OdUInt32), m_buffBase.size());
+  for(OdUInt32 i = nFull + 1; i <= nIndex; ++i)
+  {
+    const Record& rec = record(i);
+    m_buffTemp.resize(rec.m_rawSize - sizeof(OdUInt32));
+    if(!decodeDelta(m_buffBase.getPtr(), m_buffBase.size(),
+                    m_arena.getPtr() + rec.m_offset + sizeof(OdUInt32), rec.m_size - sizeof(OdUInt32),
+                    m_buffTemp.asArrayPtr(), m_buffTemp.size()))
+      throw OdError(eDwgObjectImproperlyRead);
+    m_buffBase.swap(m_buffTemp);
+  }
+  return m_buffBase;
 }
 
 void ExUndoController::freeExtra()
 {
-  while(m_records.size())
+  while(m_nRecords)
   {
-    if(m_nMemoryUsed <= m_nMaxMemory && m_records.size() <= m_nMaxSteps)
-      return ;
+    if(m_nMemoryUsed <= m_nMaxMemory && m_nRecords <= m_nMaxSteps)
+      break;
     freeFrontRecord();
   }
+  if(m_arena.size() > m_nMaxMemory)
+    resizeArena(m_nMaxMemory);
+}
+
+bool ExUndoController::findSpace(OdUInt32 nSize, OdUInt32& nOffset) const
+{
+  OdUInt32 nCapacity = m_arena.size();
+  if(!m_nRecords)
+  {
+    nOffset = 0;
+    return nSize <= nCapacity;
+  }
+  const Record& front = record(0);
+  const Record& back = record(m_nRecords - 1);
+  OdUInt32 nHead = back.m_offset + back.m_size;
+  if(back.m_offset >= front.m_offset)
+  {
+    // Free space is after the newest record and before the oldest one
+    if(nCapacity - nHead >= nSize)
+    {
+      nOffset = nHead;
+      return true;
+    }
+    nOffset = 0;
+    return front.m_offset >= nSize;
+  }
+  // Wrapped around, free space is between the newest and the oldest record
+  nOffset = nHead;
+  return front.m_offset - nHead >= nSize;
+}
+
+void ExUndoController::resizeArena(OdUInt32 nCapacity)
+{
+  // Copies the records to the start of the new arena, oldest first
+  ODA_ASSERT(nCapacity >= m_nMemoryUsed);
+  OdUInt8Array arena;
+  arena.resize(nCapacity);
+  OdUInt32 nOffset = 0;
+  for(OdUInt32 i = 0; i < m_nRecords; ++i)
+  {
+    Record& rec = m_records[(m_nFirst + i) & (m_records.size() - 1)];
+    ::memcpy(arena.asArrayPtr() + nOffset, m_arena.getPtr() + rec.m_offset, rec.m_size);
+    rec.m_offset = nOffset;
+    nOffset += rec.m_size;
+  }
+  m_arena = arena;
+}
+
+void ExUndoController::growRecords()
+{
+  OdArray<Record, OdMemoryAllocator<Record> > records;
+  records.resize(odmax(m_records.size() * 2, 16U));
+  for(OdUInt32 i = 0; i < m_nRecords; ++i)
+    records[i] = record(i);
+  m_records = records;
+  m_nFirst = 0;
 }
 
 bool ExUndoController::pushRecord(OdUInt32 nSizeOfRecToAppend)
 {
-  if(m_records.size() + 1 <= m_nMaxSteps && m_nMemoryUsed + nSizeOfRecToAppend <= m_nMaxMemory)
+  if(nSizeOfRecToAppend > m_nMaxMemory || !m_nMaxSteps)
   {
-    OdUInt8Array data(nSizeOfRecToAppend);
-    data.resize(nSizeOfRecToAppend);
-    m_records.push_back(data);
-    m_nMemoryUsed += backRecordMemory();
-    return true;
+    clearData();
+    return false;
   }
+  while(m_nRecords >= m_nMaxSteps)
+    freeFrontRecord();
 
-  while(m_records.size())
+  OdUInt32 nOffset = 0;
+  while(!findSpace(nSizeOfRecToAppend, nOffset))
   {
-    if(m_nMemoryUsed + nSizeOfRecToAppend - frontRecordMemory() <= m_nMaxMemory)
+    OdUInt32 nCapacity = m_arena.size();
+    if(nCapacity < m_nMaxMemory)
     {
-      OdUInt8Array data = m_records.front();
-      m_records.pop_front();
-      m_nMemoryUsed -= data.size();
-      data.setPhysicalLength(nSizeOfRecToAppend);
-      data.resize(nSizeOfRecToAppend);
-      m_records.push_back(data);
-      m_nMemoryUsed += nSizeOfRecToAppend;
-      return true;
+      OdUInt64 nNewCapacity = odmax(OdUInt64(nCapacity) * 2, OdUInt64(m_nMemoryUsed) + nSizeOfRecToAppend);
+      nNewCapacity = odmax(nNewCapacity, OdUInt64(EXUNDO_ARENA_MIN));
+      resizeArena(OdUInt32(odmin(nNewCapacity, OdUInt64(m_nMaxMemory))));
+      continue;
     }
+    // The arena is at the limit and the record fits into it when empty
     freeFrontRecord();
   }
-  return false;
+
+  if(m_nRecords == m_records.size())
+    growRecords();
+  Record& rec = m_records[(m_nFirst + m_nRecords) & (m_records.size() - 1)];
+  rec.m_offset = nOffset;
+  rec.m_size = nSizeOfRecToAppend;
+  rec.m_rawSize = nSizeOfRecToAppend;
+  rec.m_chain = 0;
+  ++m_nRecords;
+  m_nMemoryUsed += backRecordMemory();
+  m_nRawBytes += nSizeOfRecToAppend;
+  return true;
 }
 
 void ExUndoController::pushData(OdStreamBuf* pStream, OdUInt32 nSize, OdUInt32 opt)
 {
+  if(!m_bDeltaMode || !m_nRecords || nSize < EXUNDO_DELTA_MIN
+    || record(m_nRecords - 1).m_chain + 1 >= EXUNDO_DELTA_CHAIN)
+  {
+    if(pushRecord(nSize + sizeof(OdUInt32)))
+    {
+      OdStaticRxObject<OdFlatMemStream> ms;
+      ms.init(m_arena.asArrayPtr() + record(m_nRecords - 1).m_offset, nSize + sizeof(OdUInt32));
+      ms.putBytes(&opt, sizeof(opt));
+      pStream->copyDataTo(&ms, pStream->tell(), pStream->tell()+nSize);
+    }
+    return;
+  }
+
+  m_buffData.resize(nSize);
+  pStream->getBytes(m_buffData.asArrayPtr(), nSize);
+  OdUInt32 nChain = record(m_nRecords - 1).m_chain + 1;
+  const OdBinaryData& base = restoreRecord(m_nRecords - 1);
+  OdUInt32 nCapacity = nSize - nSize / EXUNDO_DELTA_SAVING;
+  m_buffDelta.resize(nCapacity);
+  OdUInt32 nDelta = encodeDelta(base.getPtr(), base.size(), m_buffData.getPtr(), nSize,
+                                m_buffDelta.asArrayPtr(), nCapacity);
+  if(nDelta)
+  {
+    if(!pushRecord(nDelta + sizeof(OdUInt32)))
+      return;
+    if(m_nRecords > 1)
+    {
+      OdUInt8* pRec = m_arena.asArrayPtr() + record(m_nRecords - 1).m_offset;
+      ::memcpy(pRec, &opt, sizeof(opt));
+      ::memcpy(pRec + sizeof(opt), m_buffDelta.getPtr(), nDelta);
+      markBackDelta(nSize + sizeof(OdUInt32), nChain);
+      return;
+    }
+    // The previous record has been evicted to make room, store this one in full
+    freeBackRecord();
+  }
   if(pushRecord(nSize + sizeof(OdUInt32)))
   {
-    OdStaticRxObject<OdFlatMemStream> ms;
-    ms.init(m_records.back().asArrayPtr(), nSize + sizeof(OdUInt32));
-    ms.putBytes(&opt, sizeof(opt));
-    pStream->copyDataTo(&ms, pStream->tell(), pStream->tell()+nSize);
+    OdUInt8* pRec = m_arena.asArrayPtr() + record(m_nRecords - 1).m_offset;
+    ::memcpy(pRec, &opt, sizeof(opt));
+    ::memcpy(pRec + sizeof(opt), m_buffData.getPtr(), nSize);
   }
 }
 
 bool ExUndoController::hasData() const
 {
-  return !m_records.empty();
+  return m_nRecords != 0;
 }
 
 OdUInt32 ExUndoController::popData(OdStreamBuf* pStream)
 {
   if(!hasData())
     throw OdError(eEndOfFile);
-  OdUInt32 nSize = m_records.back().size();
+  const Record& rec = record(m_nRecords - 1);
+  if(rec.m_chain)
+  {
+    OdUInt32 opt;
+    ::memcpy(&opt, m_arena.getPtr() + rec.m_offset, sizeof(opt));
+    const OdBinaryData& data = restoreRecord(m_nRecords - 1);
+    pStream->putBytes(data.getPtr(), data.size());
+    freeBackRecord();
+    return opt;
+  }
+  OdUInt32 nSize = rec.m_size;
   OdStaticRxObject<OdFlatMemStream> ms;
-  ms.init(const_cast<OdUInt8*>(m_records.back().getPtr()), nSize);
+  ms.init(const_cast<OdUInt8*>(m_arena.getPtr()) + rec.m_offset, nSize);
   OdUInt32 opt;
   ms.getBytes(&opt, sizeof(opt));
   ms.copyDataTo(pStream, ms.tell(), nSize);
@@ -155,18 +422,19 @@ public:
 class ExUndoControllerIterator : public OdRxIterator
 {
 public:
-  OdList<OdUInt8Array>::const_reverse_iterator m_iter;
-  OdList<OdUInt8Array>::const_reverse_iterator m_end;
+  const ExUndoController* m_pController;
+  // Records left to visit, newest first
+  OdUInt32 m_nLeft;
 
   bool done() const
   {
-    return (m_iter==m_end);
+    return (m_nLeft==0);
   }
   bool next()
   {
     if(done())
       return false;
-    ++m_iter;
+    --m_nLeft;
     return !done();
   }
   OdRxObjectPtr object() const
@@ -175,8 +443,8 @@ public:
       throw OdError(eIteratorDone);
     OdSmartPtr<ExUndoControllerRecord> pRec =
       OdRxObjectImpl<ExUndoControllerRecord>::createObject();
-    for (unsigned i = 0; i < sizeof(pRec->m_options); ++i)
-      ((OdUInt8*)&pRec->m_options)[i] = m_iter->at(i);
+    const ExUndoController::Record& rec = m_pController->record(m_nLeft - 1);
+    ::memcpy(&pRec->m_options, m_pController->m_arena.getPtr() + rec.m_offset, sizeof(pRec->m_options));
     return pRec.get();
   }
 };
@@ -185,13 +453,17 @@ OdRxIteratorPtr ExUndoController::newRecordStackIterator() const
 {
   OdSmartPtr<ExUndoControllerIterator> pIter =
     OdRxObjectImpl<ExUndoControllerIterator>::createObject();
-  pIter->m_iter = m_records.rbegin();
-  pIter->m_end = m_records.rend();
+  pIter->m_pController = this;
+  pIter->m_nLeft = m_nRecords;
   return pIter;
 }
 
 void ExUndoController::clearData()
 {
-  m_records.clear();
+  // The arena is kept for the next records
+  m_nFirst = 0;
+  m_nRecords = 0;
   m_nMemoryUsed = 0;
+  m_nRawBytes = 0;
+  m_nDeltaRecords = 0;
 }
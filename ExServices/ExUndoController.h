@@ -27,24 +27,76 @@
 #include "TD_PackPush.h"
 #include "DbUndoController.h"
 #include "UInt8Array.h"
-#include "OdList.h"
+#include "OdBinaryData.h"
+
+#define EXUNDO_ARENA_MIN 0x10000   /* the record arena starts at 64 KB and doubles up to the memory limit */
+#define EXUNDO_DELTA_CHAIN 8       /* in delta mode every 8th record is stored in full */
+#define EXUNDO_DELTA_MIN 64        /* smaller records are always stored in full */
+#define EXUNDO_DELTA_SAVING 8      /* a delta is kept only if it saves at least 1/8 of the record */
+
 /** \details
   This class implements platform-independent UndoController objects.
+
+  Records are kept in one ring-buffer arena, each in a contiguous range of it.
+  A record that does not fit before the end of the arena starts over at its
+  beginning. Appending a record, evicting the oldest one and popping the newest
+  one take constant time and do not allocate, except when the arena grows.
+  Memory use is the exact number of record bytes; the arena never grows beyond
+  the memory limit.
+
+  In delta mode a record is stored as the difference from the previous one:
+  runs of bytes equal to the previous record are copied, the rest is stored
+  as is. Every EXUNDO_DELTA_CHAIN-th record is stored in full, and evicting it
+  also evicts the delta records that depend on it.
   
   <group ExServices_Classes> Library: Source provided. 
 */
 class ExUndoController : public OdDbUndoController
 {
-  OdList<OdUInt8Array>  m_records;
+  // Position of a record in the arena
+  struct Record
+  {
+    OdUInt32 m_offset;
+    OdUInt32 m_size;
+    // Size of the record data before delta encoding
+    OdUInt32 m_rawSize;
+    // Number of delta records since the last full one, 0 for a full record
+    OdUInt32 m_chain;
+  };
+  friend class ExUndoControllerIterator;
+
+  OdUInt8Array          m_arena;
+  // Ring of records, oldest first, the size is a power of 2
+  OdArray<Record, OdMemoryAllocator<Record> > m_records;
+  OdUInt32              m_nFirst;
+  OdUInt32              m_nRecords;
   OdUInt32              m_nMemoryUsed;
+  OdUInt64              m_nRawBytes;
+  OdUInt32              m_nDeltaRecords;
 
   OdUInt32              m_nMaxSteps;
   OdUInt32              m_nMaxMemory;
+
+  bool                  m_bDeltaMode;
+  // Scratch buffers of delta mode
+  OdBinaryData          m_buffData;
+  OdBinaryData          m_buffBase;
+  OdBinaryData          m_buffTemp;
+  OdBinaryData          m_buffDelta;
+
+  const Record& record(OdUInt32 nIndex) const { return m_records[(m_nFirst + nIndex) & (m_records.size() - 1)]; }
+  bool findSpace(OdUInt32 nSize, OdUInt32& nOffset) const;
+  void resizeArena(OdUInt32 nCapacity);
+  void growRecords();
+  void markBackDelta(OdUInt32 nRawSize, OdUInt32 nChain);
+  OdBinaryData& restoreRecord(OdUInt32 nIndex);
 protected:
   ExUndoController();
 
   /** \details
     Frees the first record of this UndoController object.
+    \remarks
+    The delta records that depend on it are freed as well.
   */
   void freeFrontRecord();
   
@@ -66,6 +118,8 @@ protected:
   /** \details
     Returns the memory size (in bytes) required for a record with the specified data size.
     \param dataSize [in]  Data size (in bytes).
+    \remarks
+    Records carry no per-record allocation, so this is the data size.
   */
   static OdUInt32 recordMemory(OdUInt32 dataSize);
   
@@ -91,6 +145,37 @@ public:
   */
   void setLimits(OdUInt32 maxSteps, OdUInt32 maxMemory);
 
+  /** \details
+    Controls delta encoding of the records of this UndoController object.
+    \param deltaMode [in]  True to store records as differences from the previous ones.
+    \remarks
+    Records already stored are not changed. Delta mode is off by default.
+  */
+  void setDeltaMode(bool deltaMode);
+
+  /** \details
+    Returns true if and only if the records of this UndoController object are delta encoded.
+  */
+  bool deltaMode() const { return m_bDeltaMode; }
+
+  /** \details
+    Memory statistics of an UndoController object.
+  */
+  struct MemoryStats
+  {
+    OdUInt32 m_records;       // Records held
+    OdUInt32 m_deltaRecords;  // Records held as deltas
+    OdUInt32 m_memoryUsed;    // Bytes stored for the records
+    OdUInt64 m_rawBytes;      // Bytes the records would take stored in full
+  };
+
+  /** \details
+    Returns the memory statistics of this UndoController object.
+    \remarks
+    m_rawBytes - m_memoryUsed is the memory saved by delta encoding.
+  */
+  MemoryStats memoryStats() const;
+
   /** \details
     Adds the specified number of bytes from the specified StreamBuf object
     to the end of this UndoController object.
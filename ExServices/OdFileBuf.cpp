@@ -25,6 +25,195 @@
 #include "OdaCommon.h"
 #include "OdFileBuf.h"
 
+#define COPYDATA_BUFFER_SIZE 262144 /* size of the buffer copyDataTo streams data through */
+
+namespace
+{
+  // Buffer reused by all copyDataTo calls made on one thread
+  class CopyDataBuffer
+  {
+    OdUInt8* m_pBuf;
+  public:
+    CopyDataBuffer() : m_pBuf(NULL) {}
+    ~CopyDataBuffer() { ::odrxFree(m_pBuf); }
+    OdUInt8* get()
+    {
+      if (!m_pBuf)
+        m_pBuf = (OdUInt8*)::odrxAlloc(COPYDATA_BUFFER_SIZE);
+      return m_pBuf;
+    }
+  };
+}
+
+// Copies nLen bytes from the current position of pSrc to pDest through
+// a buffer of limited size. Returns false if the buffer can't be allocated.
+static bool copyStreamData(OdStreamBuf* pSrc, OdStreamBuf* pDest, OdUInt64 nLen)
+{
+  if (!nLen)
+    return true;   // e.g. everything was copied by the kernel
+  static thread_local CopyDataBuffer s_buffer;
+  OdUInt8* pBuf = s_buffer.get();
+  if (!pBuf)
+    return false;
+  while (nLen)
+  {
+    OdUInt32 n = (OdUInt32)odmin(nLen, OdUInt64(COPYDATA_BUFFER_SIZE));
+    pSrc->getBytes(pBuf, n);
+    pDest->putBytes(pBuf, n);
+    nLen -= n;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////
+// OdFileBufStats
+////////////////////////////////////////////////////////////////////
+
+static bool           s_bStatsEnabled = false;
+static OdString       s_statsDumpFile;
+static OdFileBufStats s_statsTotal;
+static OdMutex        s_statsMutex;
+
+void OdFileBufStats::reset()
+{
+  ::memset(this, 0, sizeof(OdFileBufStats));
+}
+
+void OdFileBufStats::add(const OdFileBufStats& stats)
+{
+  m_getByteCalls  += stats.m_getByteCalls;
+  m_getBytesCalls += stats.m_getBytesCalls;
+  m_putByteCalls  += stats.m_putByteCalls;
+  m_putBytesCalls += stats.m_putBytesCalls;
+  m_bytesRead     += stats.m_bytesRead;
+  m_bytesWritten  += stats.m_bytesWritten;
+  m_seeks         += stats.m_seeks;
+  m_backwardSeeks += stats.m_backwardSeeks;
+  for (int i = 0; i < kSeekBuckets; ++i)
+    m_seekDistance[i] += stats.m_seekDistance[i];
+  m_cacheHits     += stats.m_cacheHits;
+  m_cacheMisses   += stats.m_cacheMisses;
+  m_files         += stats.m_files;
+}
+
+void OdFileBufStats::addSeek(OdUInt64 from, OdUInt64 to)
+{
+  ++m_seeks;
+  if (to < from)
+    ++m_backwardSeeks;
+  OdUInt64 dist = to < from ? from - to : to - from;
+  int i = 0;
+  if (dist)
+  {
+    // buckets grow 16 times starting from 256 bytes
+    OdUInt64 limit = 256;
+    for (i = 1; i < kSeekBuckets - 1 && dist >= limit; ++i)
+      limit <<= 4;
+  }
+  ++m_seekDistance[i];
+}
+
+bool OdFileBufStats::isEmpty() const
+{
+  return !(m_getByteCalls | m_getBytesCalls | m_putByteCalls | m_putBytesCalls |
+           m_bytesRead | m_bytesWritten | m_seeks | m_cacheHits | m_cacheMisses);
+}
+
+OdAnsiString OdFileBufStats::toJson(const OdString& fileName) const
+{
+  static const char* bucketNames[kSeekBuckets] = { "0", "<256", "<4K", "<64K", "<1M", "<16M", "<256M", ">=256M" };
+  OdAnsiString res("{"), tmp;
+  if (!fileName.isEmpty())
+  {
+    OdAnsiString name(fileName, CP_UTF_8);
+    res += "\"file\":\"";
+    for (const char* p = name.c_str(); *p; ++p)
+    {
+      unsigned char c = (unsigned char)*p;
+      if (c == '"' || c == '\\')
+      {
+        res += '\\';
+        res += (char)c;
+      }
+      else if (c < 0x20)
+        res += tmp.format("\\u%04x", (unsigned)c);
+      else
+        res += (char)c;
+    }
+    res += "\",";
+  }
+  res += tmp.format("\"getByte\":%llu,\"getBytes\":%llu,\"putByte\":%llu,\"putBytes\":%llu,",
+    (unsigned long long)m_getByteCalls, (unsigned long long)m_getBytesCalls,
+    (unsigned long long)m_putByteCalls, (unsigned long long)m_putBytesCalls);
+  res += tmp.format("\"bytesRead\":%llu,\"bytesWritten\":%llu,\"seeks\":%llu,\"backwardSeeks\":%llu,\"seekDistance\":{",
+    (unsigned long long)m_bytesRead, (unsigned long long)m_bytesWritten,
+    (unsigned long long)m_seeks, (unsigned long long)m_backwardSeeks);
+  for (int i = 0; i < kSeekBuckets; ++i)
+    res += tmp.format("%s\"%s\":%llu", i ? "," : "", bucketNames[i], (unsigned long long)m_seekDistance[i]);
+  res += tmp.format("},\"cacheHits\":%llu,\"cacheMisses\":%llu",
+    (unsigned long long)m_cacheHits, (unsigned long long)m_cacheMisses);
+  if (m_files)
+    res += tmp.format(",\"files\":%llu", (unsigned long long)m_files);
+  res += "}";
+  return res;
+}
+
+void OdFileBufStats::setEnabled(bool bEnable)
+{
+  s_bStatsEnabled = bEnable;
+}
+
+bool OdFileBufStats::isEnabled()
+{
+  return s_bStatsEnabled;
+}
+
+void OdFileBufStats::setDumpFile(const OdString& fileName)
+{
+  TD_AUTOLOCK(s_statsMutex);
+  s_statsDumpFile = fileName;
+}
+
+OdFileBufStats OdFileBufStats::total()
+{
+  TD_AUTOLOCK(s_statsMutex);
+  return s_statsTotal;
+}
+
+void OdFileBufStats::resetTotal()
+{
+  TD_AUTOLOCK(s_statsMutex);
+  s_statsTotal.reset();
+}
+
+void OdFileBufStats::commit(OdFileBufStats& stats, const OdString& fileName)
+{
+  if (stats.isEmpty())
+    return;
+  stats.m_files = 1;
+  TD_AUTOLOCK(s_statsMutex);
+  s_statsTotal.add(stats);
+  if (!s_statsDumpFile.isEmpty())
+  {
+#if defined(ODA_WINDOWS)
+    FILE* fp = NULL;
+    if (_wfopen_s(&fp, s_statsDumpFile.c_str(), L"ab") != 0)
+      fp = NULL;
+#else
+    FILE* fp = fopen(OdAnsiString(s_statsDumpFile, CP_UTF_8).c_str(), "ab");
+#endif
+    if (fp)
+    {
+      stats.m_files = 0;
+      OdAnsiString json = stats.toJson(fileName);
+      fputs(json.c_str(), fp);
+      fputc('\n', fp);
+      fclose(fp);
+    }
+  }
+  stats.reset();
+}
+
 #if defined(ODA_WINDOWS) && !defined(_WINRT)
 
 #define ODA_NON_TRACING   // Comment it to have trace
@@ -147,6 +336,7 @@ void OdBaseFileBuf::close()
 		::CloseHandle(m_hFile);
 		m_hFile = INVALID_HANDLE_VALUE;
 	}
+	if( m_pStats ) OdFileBufStats::commit(*m_pStats, m_sFileName);
 	m_sFileName.empty();
 	m_iFileShare = 0;
 	m_bFileWritten = false;
@@ -171,6 +361,7 @@ OdUInt64 OdBaseFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
 {
 	ODA_TRACE(OD_T("seek(%d, %d)"), offset, whence);
 
+	OdUInt64 nFrom = m_pStats ? OdBaseFileBuf::tell() : 0;
 	DWORD dwMethod = 0;
 	switch( whence )
 	{
@@ -193,6 +384,7 @@ OdUInt64 OdBaseFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
     li.QuadPart = -1;
     throw OdError_FileException(eFileInternalErr, m_sFileName);
   }
+  if( m_pStats ) m_pStats->addSeek(nFrom, li.QuadPart);
   return li.QuadPart;
 }
 
@@ -227,6 +419,11 @@ OdUInt8 OdBaseFileBuf::getByte()
 		ODA_TRACE(OD_T("getByte() can't read byte due to end-of-file"));
 		throw OdError_FileException(eEndOfFile, m_sFileName);
 	}
+	if( m_pStats )
+	{
+		++m_pStats->m_getByteCalls;
+		++m_pStats->m_bytesRead;
+	}
 	
 	return b;
 }
@@ -246,6 +443,11 @@ void OdBaseFileBuf::getBytes(void* buffer, OdUInt32 nLen)
 		ODA_TRACE(OD_T("getBytes() read only %u bytes due to end-of-file"), dwBytes);
 		throw OdError_FileException(eEndOfFile, m_sFileName);
 	}
+	if( m_pStats )
+	{
+		++m_pStats->m_getBytesCalls;
+		m_pStats->m_bytesRead += nLen;
+	}
 }
 
 void OdBaseFileBuf::putByte(OdUInt8 val)
@@ -260,9 +462,24 @@ void OdBaseFileBuf::putByte(OdUInt8 val)
 		throwOdError(OdError_FileException(eFileWriteError, m_sFileName));
 	}
 	m_bFileWritten = true;
+	if( m_pStats )
+	{
+		++m_pStats->m_putByteCalls;
+		++m_pStats->m_bytesWritten;
+	}
 }
 
 void OdBaseFileBuf::putBytes(const void* buffer, OdUInt32 nLen)
+{
+	writeBytes(buffer, nLen);
+	if( m_pStats )
+	{
+		++m_pStats->m_putBytesCalls;
+		m_pStats->m_bytesWritten += nLen;
+	}
+}
+
+void OdBaseFileBuf::writeBytes(const void* buffer, OdUInt32 nLen)
 {
 	ODA_TRACE(OD_T("putBytes(%p, %u)"), buffer, nLen);
 
@@ -315,35 +532,14 @@ void OdBaseFileBuf::copyDataTo(OdStreamBuf* pDest, OdUInt64 nSrcStart, OdUInt64
 		}
 	}
 
-	// Allocate temporary buffer
-	OdUInt32 nLen = OdUInt32(nSrcEnd - nSrcStart);
-	
-	HLOCAL hBuf = ::LocalAlloc(LHND, nLen);
-	if( hBuf == NULL )
+	// Read and write through a buffer of limited size
+	// (current position will be set to nSrcEnd after)
+	if( !copyStreamData(this, pDest, nSrcEnd - nSrcStart) )
 	{
 		ODA_TRACE(OD_T("copyDataTo() can't allocate temporary buffer"));
 		seek(nPos, OdDb::kSeekFromStart);
 		throw OdError_FileException(eOutOfMemory, m_sFileName);
 	}
-
-	void* pBuf = LocalLock(hBuf);
-	if( pBuf == NULL )
-	{
-		ODA_TRACE(OD_T("copyDataTo() can't access to temporary buffer"));
-		::LocalFree(hBuf);
-		seek(nPos, OdDb::kSeekFromStart);
-		throw OdError_FileException(eOutOfMemory, m_sFileName);
-	}
-
-	// Read to buffer (current position will be set to nSrcEnd after)
-	getBytes(pBuf, nLen);
-	//seek(nPos, OdDb::kSeekFromStart);
-
-	// Write to destination
-	pDest->putBytes(pBuf, nLen);
-
-	LocalUnlock(hBuf);
-	::LocalFree(hBuf);
 }
 
 OdWrFileBuf::OdWrFileBuf() : m_nBufferedSize(0)
@@ -407,6 +603,8 @@ OdRdFileBuf::OdRdFileBuf()
 	m_pFileMap = NULL;
 	m_ulSize.QuadPart = 0;
 	m_ulPos.QuadPart = 0;
+	m_pWindowBuf = NULL;
+	m_WindowBufSize = 0;
 }
 
 void OdRdFileBuf::close()
@@ -423,6 +621,7 @@ void OdRdFileBuf::close()
 	}
 	m_ulSize.QuadPart = 0;
 	m_ulPos.QuadPart = 0;
+	releaseWindow();
 
 	OdBaseFileBuf::close();
 }
@@ -437,6 +636,7 @@ OdUInt64 OdRdFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
   if (!memBufferUsed())
     return OdBaseFileBuf::seek(offset, whence);
 
+  OdUInt64 nFrom = m_ulPos.QuadPart;
 	switch( whence )
 	{
     // it is ok to seek beyond the end of a file, read() will return 0 in this case
@@ -453,6 +653,7 @@ OdUInt64 OdRdFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
 			m_ulPos.QuadPart = m_ulSize.QuadPart + offset;
 			break;
 	}
+	if( m_pStats ) m_pStats->addSeek(nFrom, m_ulPos.QuadPart);
 
 	return m_ulPos.QuadPart;
 }
@@ -479,6 +680,11 @@ OdUInt8 OdRdFileBuf::getByte()
     return OdBaseFileBuf::getByte();
 
   if( m_ulPos.QuadPart >= m_ulSize.QuadPart ) throw OdError_FileException(eEndOfFile, m_sFileName);
+  if( m_pStats )
+  {
+    ++m_pStats->m_getByteCalls;
+    ++m_pStats->m_bytesRead;
+  }
 
 	return ((OdUInt8*)m_pFileMap)[m_ulPos.QuadPart++];
 }
@@ -496,6 +702,59 @@ void OdRdFileBuf::getBytes(void* buffer, OdUInt32 nLen)
 	::CopyMemory(buffer, ((OdUInt8*)m_pFileMap) + m_ulPos.QuadPart, nLen);
 
 	m_ulPos.QuadPart += nLen;
+  if( m_pStats )
+  {
+    ++m_pStats->m_getBytesCalls;
+    m_pStats->m_bytesRead += nLen;
+  }
+}
+
+const OdUInt8* OdRdFileBuf::getWindow(OdUInt32 nLen, OdUInt32* pAvailable)
+{
+  if (!nLen)
+    nLen = 1;
+  if (memBufferUsed())
+  {
+    if (m_ulPos.QuadPart + nLen > m_ulSize.QuadPart)
+      return NULL;
+    if (pAvailable)
+      *pAvailable = OdUInt32(odmin(OdUInt64(m_ulSize.QuadPart - m_ulPos.QuadPart), OdUInt64(0xFFFFFFFF)));
+    return ((const OdUInt8*)m_pFileMap) + m_ulPos.QuadPart;
+  }
+
+  if (tell() + nLen > length())
+    return NULL;
+  if (pAvailable)
+    *pAvailable = nLen;
+  return copyWindow(nLen, m_pWindowBuf, m_WindowBufSize);
+}
+
+void OdRdFileBuf::advanceWindow(OdUInt32 nLen)
+{
+  if (!memBufferUsed())
+  {
+    // moved directly: not a seek from the caller's point of view
+    if (OdBaseFileBuf::tell() + nLen > OdBaseFileBuf::length()) throw OdError_FileException(eEndOfFile, m_sFileName);
+    LARGE_INTEGER li;
+    li.QuadPart = nLen;
+    li.LowPart = ::SetFilePointer(m_hFile, li.LowPart, &li.HighPart, FILE_CURRENT);
+    if (li.LowPart == INVALID_SET_FILE_POINTER && ::GetLastError() != NO_ERROR)
+      throw OdError_FileException(eFileInternalErr, m_sFileName);
+  }
+  else
+  {
+    if (m_ulPos.QuadPart + nLen > m_ulSize.QuadPart) throw OdError_FileException(eEndOfFile, m_sFileName);
+    m_ulPos.QuadPart += nLen;
+  }
+  if( m_pStats )
+    m_pStats->m_bytesRead += nLen;
+}
+
+void OdRdFileBuf::releaseWindow()
+{
+  ::odrxFree(m_pWindowBuf);
+  m_pWindowBuf = NULL;
+  m_WindowBufSize = 0;
 }
 
 void OdRdFileBuf::putByte(OdUInt8 val)
@@ -568,6 +827,7 @@ void OdRdFileBuf::copyDataTo(OdStreamBuf* pDest, OdUInt64 nSrcStart, OdUInt64 nS
 	if( nSrcEnd > m_ulSize.QuadPart ) throw OdError_FileException(eEndOfFile, m_sFileName);
 
 	pDest->putBytes(((OdUInt8*)m_pFileMap) + nSrcStart, OdUInt32(nSrcEnd - nSrcStart));
+  if( m_pStats ) m_pStats->m_bytesRead += nSrcEnd - nSrcStart;
 }
 
 OdUInt64 OdWrFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
@@ -578,6 +838,11 @@ OdUInt64 OdWrFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
 
  void OdWrFileBuf::putByte(OdUInt8 val)
 {
+  if ( m_pStats )
+  {
+    ++m_pStats->m_putByteCalls;
+    ++m_pStats->m_bytesWritten;
+  }
   if ( m_nBufferedSize >= WRITING_BUFFER_LENGTH )
   {
     flush();
@@ -588,10 +853,15 @@ OdUInt64 OdWrFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
 
 void OdWrFileBuf::putBytes(const void* buffer, OdUInt32 nLen)
 {
+  if ( m_pStats )
+  {
+    ++m_pStats->m_putBytesCalls;
+    m_pStats->m_bytesWritten += nLen;
+  }
   if (nLen > WRITING_BUFFER_LENGTH)
   {
     flush();
-    OdBaseFileBuf::putBytes(buffer, nLen);
+    writeBytes(buffer, nLen);
     return;
   }
   if ( (m_nBufferedSize + nLen) > WRITING_BUFFER_LENGTH )
@@ -650,10 +920,33 @@ OdUInt64 OdWrFileBuf::length()
 #else // #ifdef WIN32
 
 #include <stdlib.h>
+#include <errno.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#ifdef OD_RDFILEBUF_READAHEAD
+#include <thread>
+#endif
 #ifdef OD_HAVE_UNISTD_FILE
   #include <unistd.h>
 #endif
 
+#ifdef OD_HAVE_UNISTD_FILE
+  #include <fcntl.h>
+  #include <sys/uio.h>
+#endif
+
+// File to file copies done by the kernel
+#if defined(__linux__) && defined(OD_HAVE_UNISTD_FILE)
+  #include <sys/sendfile.h>
+  #define OD_HAVE_KERNEL_FILE_COPY
+  #if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    #define OD_HAVE_COPY_FILE_RANGE_FUNC
+  #endif
+#endif
+
 #ifdef OD_HAVE_SYS_STAT_FILE
   #include <sys/stat.h>
 #endif
@@ -694,12 +987,15 @@ OdBaseFileBuf::OdBaseFileBuf()
     , m_position(ERR_VAL)
     , m_shMode(Oda::kShareDenyNo)
     , m_prevWasRead(false)
+    , m_pStats(NULL)
 {
   m_accessMode = (Oda::FileAccessMode)0;
 }
 
 void OdBaseFileBuf::close()
 {
+  if (m_pStats)
+    OdFileBufStats::commit(*m_pStats, m_FileName);
   m_length = ERR_VAL;
   m_position = ERR_VAL;
   m_FileName = "";
@@ -838,16 +1134,21 @@ void OdBaseFileBuf::open(const OdString& filename,
   if (m_fp)
   {
     //printf("m_fp!");
+    // Files open for writing get no stdio buffer: OdWrFileBuf collects writes
+    // in its own buffer and issues them with pwrite/pwritev.
     // special preparation for "temporary files" : enable optimal caching + "delete on close"
     // Windows FILE_ATTRIBUTE_TEMPORARY attribute causes file systems to avoid writing data back 
     // to mass storage if sufficient cache memory is available, so here we imitate "sufficient cache memory"
-    if (accessMode & Oda::kFileTmp)
+    if ((accessMode & Oda::kFileWrite) == 0)
     {
-      setvbuf(m_fp, 0, _IOFBF, 8388608); //8MB cache
-    }
-    else
-    {
-      setvbuf(m_fp, 0, _IOFBF, 524288); //512K
+      if (accessMode & Oda::kFileTmp)
+      {
+        setvbuf(m_fp, 0, _IOFBF, 8388608); //8MB cache
+      }
+      else
+      {
+        setvbuf(m_fp, 0, _IOFBF, 524288); //512K
+      }
     }
 
     // special preparation for "temporary files" : enable optimal caching + "delete on close"
@@ -880,6 +1181,11 @@ OdUInt8 OdBaseFileBuf::getByte()
 
   ++m_position;
   m_prevWasRead = true;
+  if (m_pStats)
+  {
+    ++m_pStats->m_getByteCalls;
+    ++m_pStats->m_bytesRead;
+  }
 
   return nCh;
 }
@@ -891,6 +1197,11 @@ void OdBaseFileBuf::getBytes(void* buffer, OdUInt32 numBytes)
 
   m_position += numBytes;
   m_prevWasRead = true;
+  if (m_pStats)
+  {
+    ++m_pStats->m_getBytesCalls;
+    m_pStats->m_bytesRead += numBytes;
+  }
 }
 
 void OdBaseFileBuf::putByte(OdUInt8 value)
@@ -906,6 +1217,11 @@ void OdBaseFileBuf::putByte(OdUInt8 value)
 	}
   if (++m_position > m_length)
     m_length = m_position;
+  if (m_pStats)
+  {
+    ++m_pStats->m_putByteCalls;
+    ++m_pStats->m_bytesWritten;
+  }
 }
 
 void OdBaseFileBuf::putBytes(const void* buffer, OdUInt32 numBytes)
@@ -922,10 +1238,16 @@ void OdBaseFileBuf::putBytes(const void* buffer, OdUInt32 numBytes)
   m_position += numBytes;
   if (m_position > m_length)
     m_length = m_position;
+  if (m_pStats)
+  {
+    ++m_pStats->m_putBytesCalls;
+    m_pStats->m_bytesWritten += numBytes;
+  }
 }
 
 OdUInt64 OdBaseFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
 {
+  OdUInt64 nFrom = m_position;
   switch (whence) {
   case OdDb::kSeekFromStart:
     if( offset < 0 ) throw OdError_FileException(eFileInternalErr, m_FileName);
@@ -943,6 +1265,8 @@ OdUInt64 OdBaseFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
 
   if (FSEEK(m_fp, OFFSETTYPE(m_position), SEEK_SET) != 0)
     m_position = ERR_VAL;  // Error
+  else if (m_pStats)
+    m_pStats->addSeek(nFrom, m_position);
   return m_position;
 }
 
@@ -976,185 +1300,577 @@ OdUInt64 OdBaseFileBuf::length()
   return len;
 };
 #endif
-////////////////////////////////////////////////////////////////////
-const int OdRdFileBuf::m_BufSize = 8192;
-const int OdRdFileBuf::m_PosMask(~(8192-1));
-
-
-OdRdFileBuf::OdRdFileBuf()
-    : m_PhysFilePos(0), m_BufPos(0), 
-      m_BytesLeft(0), m_BufBytes(0), m_pNextChar(nullptr), 
-      m_pCurBuf(0), m_UsingBlock(-1), m_Counter(0L)
-{
-  init();
-}
-
-void OdRdFileBuf::init()
+#ifdef OD_HAVE_UNISTD_FILE
+// Reads up to numBytes at the given offset without moving the file position.
+// Returns the number of bytes read, which is less than requested only at
+// the end of file or on error.
+static OdUInt32 preadFully(int fd, void* buffer, OdUInt32 numBytes, OdUInt64 offset)
 {
-  for (int i = 0; i < NUM_BUFFERS; i++)
+  OdUInt8* buf = (OdUInt8*)buffer;
+  OdUInt32 total = 0;
+  while (total < numBytes)
   {
-    m_DataBlock[i].buf = NULL;
-    m_DataBlock[i].counter = -1L;
-    m_DataBlock[i].validbytes=0;
-    m_DataBlock[i].startaddr = ERR_VAL;
+    ssize_t n = ::pread(fd, buf + total, numBytes - total, (off_t)(offset + total));
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (n == 0)
+      break;
+    total += (OdUInt32)n;
   }
+  return total;
 }
+#endif
 
-void OdRdFileBuf::close()
+#ifdef OD_HAVE_KERNEL_FILE_COPY
+// Copies numBytes from fdIn at inPos to fdOut at outPos without passing the
+// data through user space. Returns the number of bytes copied, which is less
+// than requested if the files don't support it (the caller copies the rest).
+static OdUInt64 kernelFileCopy(int fdIn, OdUInt64 inPos, int fdOut, OdUInt64 outPos, OdUInt64 numBytes)
 {
-  // indicate buffers no longer in use
-  for (int i = 0; i < NUM_BUFFERS; i++)
+  OdUInt64 total = 0;
+#ifdef OD_HAVE_COPY_FILE_RANGE_FUNC
+  bool bCopyRange = true;
+#endif
+  while (total < numBytes)
   {
-    if (m_DataBlock[i].buf)
-      ::odrxFree(m_DataBlock[i].buf);
-    m_DataBlock[i].buf = NULL;
-    m_DataBlock[i].counter = -1L;
-    m_DataBlock[i].validbytes=0;
-    m_DataBlock[i].startaddr = ERR_VAL;
+    size_t chunk = (size_t)odmin(numBytes - total, OdUInt64(0x40000000));
+    ssize_t n;
+#ifdef OD_HAVE_COPY_FILE_RANGE_FUNC
+    if (bCopyRange)
+    {
+      loff_t offIn = loff_t(inPos + total), offOut = loff_t(outPos + total);
+      n = ::copy_file_range(fdIn, &offIn, fdOut, &offOut, chunk, 0);
+      if (n < 0 && errno != EINTR)
+      {
+        // not supported for these files (old kernel, different file systems), try sendfile
+        bCopyRange = false;
+        continue;
+      }
+    }
+    else
+#endif
+    {
+      if (::lseek(fdOut, off_t(outPos + total), SEEK_SET) < 0)
+        break;
+      off_t offIn = off_t(inPos + total);
+      n = ::sendfile(fdOut, fdIn, &offIn, chunk);
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    total += (OdUInt64)n;
   }
-  OdBaseFileBuf::close();
+  return total;
 }
+#endif
 
-void OdRdFileBuf::open(
-  const OdString& fname, 
-  Oda::FileShareMode shMode,
-  Oda::FileAccessMode nDesiredAccess, 
-  Oda::FileCreationDisposition nCreationDisposition)
+// Current method behavior description (so required behavior isn't documented yet):
+//  - Copy (nSrcEnd-nSrcStart) bytes from nSrcStart position to the current position of target stream
+//  - Set source stream to nSrcEnd position
+void OdBaseFileBuf::copyDataTo(OdStreamBuf* pDest, OdUInt64 nSrcStart, OdUInt64 nSrcEnd)
 {
-  if (nDesiredAccess & Oda::kFileWrite)
-    throw OdError_CantOpenFile(fname);
-
-  OdBaseFileBuf::open(fname, shMode, nDesiredAccess, nCreationDisposition);
+  if (!pDest)
+    throw OdError_FileException(eNullObjectPointer, m_FileName);
 
-	if( nCreationDisposition == Oda::kOpenExisting || nCreationDisposition == Oda::kOpenAlways )
+  if (nSrcStart == 0 && nSrcEnd == 0)
   {
-    // Get file length
-    OdUInt64 curLoc = FTELL(m_fp);
-	  FSEEK(m_fp, 0, SEEK_END);
-	  m_length = FTELL(m_fp);
-    FSEEK(m_fp, OFFSETTYPE(curLoc), 0);
+    nSrcStart = tell();
+    nSrcEnd = length();
+  }
 
-    if (m_length > 0)
-    {
-      m_BufBytes= 0;
-      m_BytesLeft= 0;
-      m_BufPos=0;  // to start reads from 0
-      m_pCurBuf=NULL;
-      m_pNextChar = m_pCurBuf;
-      m_UsingBlock = -1;
-      m_PhysFilePos=0;
+  // Do nothing if incorrect positions passed
+  if (nSrcEnd <= nSrcStart)
+    return;
 
-      for (int i = 0; i < NUM_BUFFERS; i++)
-      {
-        m_DataBlock[i].buf = (OdUInt8*)::odrxAlloc(m_BufSize);
-        if (!m_DataBlock[i].buf)
-          throw OdError(eOutOfMemory);
-        m_DataBlock[i].validbytes=0;
-        m_DataBlock[i].counter = -1L;
-        m_DataBlock[i].startaddr = ERR_VAL;
-      }
-      seek(0, OdDb::kSeekFromStart);  // initial seek, gets a buffer & stuff
+  OdUInt64 nLen = nSrcEnd - nSrcStart;
+#ifdef OD_HAVE_KERNEL_FILE_COPY
+  OdBaseFileBuf* pFile = dynamic_cast<OdBaseFileBuf*>(pDest);
+  int fdIn = fileDescriptor();
+  if (pFile && pFile != this && pFile->m_fp && (pFile->m_accessMode & Oda::kFileWrite) && fdIn != -1)
+  {
+    // both descriptors must see all buffered data
+    flush();
+    pFile->flush();
+    OdUInt64 nDestPos = pFile->tell();
+    OdUInt64 nCopied = kernelFileCopy(fdIn, nSrcStart, fileno(pFile->m_fp), nDestPos, nLen);
+    if (nCopied)
+    {
+      if (nDestPos + nCopied > pFile->m_length)
+        pFile->m_length = nDestPos + nCopied;
+      pFile->seek(nDestPos + nCopied, OdDb::kSeekFromStart);
+      if (m_pStats)
+        m_pStats->m_bytesRead += nCopied;
+      if (pFile->m_pStats)
+        pFile->m_pStats->m_bytesWritten += nCopied;
+      nSrcStart += nCopied;
+      nLen -= nCopied;
     }
   }
-  return;
+#endif
+
+  if (seek(nSrcStart, OdDb::kSeekFromStart) != nSrcStart)
+    throw OdError_FileException(eEndOfFile, m_FileName);
+  if (!copyStreamData(this, pDest, nLen))
+    throw OdError_FileException(eOutOfMemory, m_FileName);
 }
 
-bool OdRdFileBuf::filbuf( )
+////////////////////////////////////////////////////////////////////
+// OdRdFileBuf block cache
+//
+// Blocks are found through a hash index keyed by their file offset and
+// replaced with the CLOCK algorithm. When the reader walks consecutive
+// blocks, the following blocks are read by a worker thread so that
+// parsing overlaps disk I/O. The block in use by the reader and blocks
+// being loaded are never replaced.
+////////////////////////////////////////////////////////////////////
+
+static OdRdFileBuf::CacheOptions s_defaultCacheOptions = { RDFILEBUF_BLOCK_SIZE, NUM_BUFFERS, RDFILEBUF_READ_AHEAD };
+static std::mutex s_defaultCacheOptionsMutex;   /* guards s_defaultCacheOptions */
+
+static OdRdFileBuf::CacheOptions validateCacheOptions(const OdRdFileBuf::CacheOptions& options)
 {
-  int i, minindex;
-  OdInt32 minlru;
-  struct blockstru *minptr;
+  OdRdFileBuf::CacheOptions res = options;
+  OdUInt32 blockSize = 4096;
+  while (blockSize < res.m_blockSize && blockSize < 0x10000000)
+    blockSize <<= 1;
+  res.m_blockSize = blockSize;
+  if (res.m_numBlocks < 4)
+    res.m_numBlocks = 4;
+  // keep room for the block in use and the blocks the reader returns to
+  if (res.m_readAheadBlocks > res.m_numBlocks / 2)
+    res.m_readAheadBlocks = res.m_numBlocks / 2;
+  return res;
+}
 
-  m_UsingBlock = -1;
-  /* see if we are holding it already */
-  for (i = 0; i < NUM_BUFFERS; i++)
+struct OdRdFileBuf::BlockCache
+{
+  enum BlockState
   {
-    if (m_DataBlock[i].startaddr==m_BufPos)
-      break;
-  }
+    kBlockEmpty,
+    kBlockLoading,
+    kBlockReady
+  };
 
-  if (i < NUM_BUFFERS)   // we are already holding this part of the file
+  struct blockstru
   {
-    m_pCurBuf=m_DataBlock[i].buf;
-    m_BufPos=m_DataBlock[i].startaddr;
-    m_BytesLeft=m_BufBytes=m_DataBlock[i].validbytes;
-    m_pNextChar=m_pCurBuf;
-    m_DataBlock[i].counter=m_Counter++;
-    m_UsingBlock=i;
-    return true;
-  }
+    OdUInt8*  buf;        /* this buffer */
+    OdUInt64  startaddr;  /* address from which it came in the file */
+    int       validbytes; /* number of valid bytes it holds */
+    int       state;      /* BlockState */
+    bool      referenced; /* CLOCK reference bit */
+  };
+
+  std::vector<blockstru>            m_blocks;
+  std::unordered_map<OdUInt64, int> m_index;      /* startaddr -> block */
+  int                               m_clockHand;
+  int                               m_usingBlock; /* block in use by the reader */
+  OdUInt32                          m_blockSize;
+  OdUInt32                          m_readAhead;
+  FILE*                             m_fp;
+  OdUInt64                          m_length;
+
+  OdUInt64                          m_lastAddr;      /* block requested last time */
+  int                               m_seqStreak;     /* number of consecutive blocks requested */
+  OdUInt64                          m_readAheadEnd;  /* end of the range already scheduled */
+
+  std::mutex                        m_mutex;
+  std::condition_variable           m_loaded;
+#ifdef OD_RDFILEBUF_READAHEAD
+  std::thread                       m_worker;
+  std::condition_variable           m_wake;
+  std::deque<OdUInt64>              m_queue;
+  bool                              m_bStop;
+#endif
 
-  /* not holding it, so look for a buffer to read into */
-  /* first see if any are not yet loaded */
-  minptr=NULL;
-  minindex=0;
+  BlockCache(FILE* fp, OdUInt64 length, const OdRdFileBuf::CacheOptions& options)
+    : m_blocks(options.m_numBlocks)
+    , m_clockHand(0)
+    , m_usingBlock(-1)
+    , m_blockSize(options.m_blockSize)
+    , m_readAhead(options.m_readAheadBlocks)
+    , m_fp(fp)
+    , m_length(length)
+    , m_lastAddr(ERR_VAL)
+    , m_seqStreak(0)
+    , m_readAheadEnd(0)
+#ifdef OD_RDFILEBUF_READAHEAD
+    , m_bStop(false)
+#endif
+  {
+    for (size_t i = 0; i < m_blocks.size(); i++)
+    {
+      m_blocks[i].buf = NULL;
+      m_blocks[i].startaddr = ERR_VAL;
+      m_blocks[i].validbytes = 0;
+      m_blocks[i].state = kBlockEmpty;
+      m_blocks[i].referenced = false;
+    }
+    m_index.reserve(m_blocks.size() * 2);
+  }
 
-  for (i = 0; i < NUM_BUFFERS; i++)
+  ~BlockCache()
   {
-    if (m_DataBlock[i].startaddr==ERR_VAL)
+    stopWorker();
+    for (size_t i = 0; i < m_blocks.size(); i++)
     {
-      minindex=i;
-      minptr=&m_DataBlock[i];
-      break;
+      if (m_blocks[i].buf)
+        ::odrxFree(m_blocks[i].buf);
     }
   }
 
-  /* if all were used, then look for the least recently used one */
-  if (minptr==NULL)
+  void stopWorker()
   {
-    minlru=0x7FFFFFFF;
-    minptr=NULL;
-    minindex=0;
+#ifdef OD_RDFILEBUF_READAHEAD
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_bStop = true;
+      m_queue.clear();
+    }
+    m_wake.notify_all();
+    if (m_worker.joinable())
+      m_worker.join();
+#endif
+  }
 
-    for (i = 0; i < NUM_BUFFERS; i++) {
-      if (m_DataBlock[i].counter<0L)
-        m_DataBlock[i].counter=0L;
-      if (m_DataBlock[i].counter<minlru) {
-        minlru=m_DataBlock[i].counter;
-        minptr=&m_DataBlock[i];
-        minindex=i;
-      }
+  // drops all cached data, used when the file is changed
+  void reset(OdUInt64 length)
+  {
+    stopWorker();
+    for (size_t i = 0; i < m_blocks.size(); i++)
+    {
+      m_blocks[i].startaddr = ERR_VAL;
+      m_blocks[i].validbytes = 0;
+      m_blocks[i].state = kBlockEmpty;
+      m_blocks[i].referenced = false;
     }
+    m_index.clear();
+    m_usingBlock = -1;
+    m_length = length;
+    m_lastAddr = ERR_VAL;
+    m_seqStreak = 0;
+    m_readAheadEnd = 0;
+#ifdef OD_RDFILEBUF_READAHEAD
+    m_bStop = false;
+#endif
   }
 
-  if (minptr==NULL)
+  int readBlock(OdUInt8* buf, OdUInt64 addr)
   {
-    ODA_FAIL();
-    return false;  /* couldn't find one */
+#ifdef OD_HAVE_UNISTD_FILE
+    return (int)preadFully(fileno(m_fp), buf, m_blockSize, addr);
+#else
+    if (FSEEK(m_fp, OFFSETTYPE(addr), SEEK_SET) != 0)
+      return 0;
+    return (int)fread(buf, 1, m_blockSize, m_fp);
+#endif
   }
-  /* if we are not already physically at the read location, move there */
-  /* then read into the buffer */
-  if (m_PhysFilePos!=m_BufPos /*|| readerror*/)
+
+  // Looks for a block to replace. Must be called with m_mutex locked.
+  int victim()
   {
-    FSEEK(m_fp, OFFSETTYPE(m_BufPos), SEEK_SET);
+    const int nBlocks = (int)m_blocks.size();
+    for (int pass = 0; pass < nBlocks * 2; pass++)
+    {
+      int i = m_clockHand;
+      m_clockHand = (m_clockHand + 1) % nBlocks;
+      blockstru& block = m_blocks[i];
+      if (block.state == kBlockEmpty)
+        return i;
+      if (block.state == kBlockLoading || i == m_usingBlock)
+        continue;
+      if (block.referenced)
+      {
+        block.referenced = false;
+        continue;
+      }
+      m_index.erase(block.startaddr);
+      block.state = kBlockEmpty;
+      block.startaddr = ERR_VAL;
+      block.validbytes = 0;
+      return i;
+    }
+    return -1;
   }
-  m_BufBytes = m_BytesLeft =
-    (short) fread(minptr->buf, 1, m_BufSize, m_fp);
-  m_PhysFilePos=m_BufPos+m_BufBytes;
-  if (m_BufBytes > 0)
+
+  // Marks the block as being loaded from addr. Must be called with m_mutex locked.
+  bool claim(int i, OdUInt64 addr)
   {
-    minptr->validbytes = m_BufBytes;
-    minptr->startaddr = m_BufPos;
-    minptr->counter=m_Counter++;
-    m_pCurBuf=minptr->buf;
-    m_pNextChar = m_pCurBuf;
-    m_UsingBlock=minindex;
+    blockstru& block = m_blocks[i];
+    if (!block.buf)
+    {
+      block.buf = (OdUInt8*)::odrxAlloc(m_blockSize);
+      if (!block.buf)
+        return false;
+    }
+    block.startaddr = addr;
+    block.validbytes = 0;
+    block.state = kBlockLoading;
+    block.referenced = true;
+    m_index[addr] = i;
     return true;
   }
-  return false;
-}
-
-OdUInt64 OdRdFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
-{
-  int bytestoadvance;
 
-  switch (whence)
+  // Publishes the result of a block load. Must be called with m_mutex locked.
+  void complete(int i, OdUInt64 addr, int nBytes)
   {
-  case OdDb::kSeekFromStart:
-    if( offset < 0 ) throw OdError_FileException(eFileInternalErr, m_FileName);
-    break;
-  case OdDb::kSeekFromCurrent:
-    if( offset < 0 && m_BufPos+(m_pNextChar - m_pCurBuf) < (OdUInt64)(-offset)) 
+    blockstru& block = m_blocks[i];
+    if (nBytes > 0)
+    {
+      block.validbytes = nBytes;
+      block.state = kBlockReady;
+    }
+    else
+    {
+      m_index.erase(addr);
+      block.startaddr = ERR_VAL;
+      block.state = kBlockEmpty;
+    }
+    m_loaded.notify_all();
+  }
+
+  // Returns the block holding addr, reading it if needed, or -1 at end of file.
+  int acquire(OdUInt64 addr, OdFileBufStats* pStats)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+      std::unordered_map<OdUInt64, int>::iterator iter = m_index.find(addr);
+      if (iter == m_index.end())
+        break;
+      blockstru& block = m_blocks[iter->second];
+      if (block.state == kBlockLoading)
+      {
+        // being prefetched, wait for it and look again
+        m_loaded.wait(lock);
+        continue;
+      }
+      block.referenced = true;
+      m_usingBlock = iter->second;
+      noteAccess(addr);
+      if (pStats)
+        ++pStats->m_cacheHits;
+      return m_usingBlock;
+    }
+
+    if (addr >= m_length)
+      return -1;
+
+    m_usingBlock = -1;
+    int i = victim();
+    if (i < 0 || !claim(i, addr))
+      throw OdError(eOutOfMemory);
+    m_usingBlock = i;
+    if (pStats)
+      ++pStats->m_cacheMisses;
+
+    OdUInt8* buf = m_blocks[i].buf;
+    lock.unlock();
+    int nBytes = readBlock(buf, addr);
+    lock.lock();
+    complete(i, addr, nBytes);
+    if (nBytes <= 0)
+    {
+      m_usingBlock = -1;
+      return -1;
+    }
+    noteAccess(addr);
+    return i;
+  }
+
+  // Tracks sequential access and schedules read-ahead. Must be called with m_mutex locked.
+  void noteAccess(OdUInt64 addr)
+  {
+    if (m_lastAddr != ERR_VAL && addr == m_lastAddr + m_blockSize)
+    {
+      ++m_seqStreak;
+    }
+    else if (addr != m_lastAddr)
+    {
+      m_seqStreak = 0;
+      m_readAheadEnd = 0;
+    }
+    m_lastAddr = addr;
+
+#ifdef OD_RDFILEBUF_READAHEAD
+    if (m_readAhead == 0 || m_seqStreak < 2)
+      return;
+
+    OdUInt64 from = odmax(addr + m_blockSize, m_readAheadEnd);
+    OdUInt64 to = odmin(addr + OdUInt64(m_readAhead + 1) * m_blockSize, m_length);
+    bool bScheduled = false;
+    for (OdUInt64 next = from; next < to; next += m_blockSize)
+    {
+      if (m_index.find(next) == m_index.end())
+      {
+        m_queue.push_back(next);
+        bScheduled = true;
+      }
+    }
+    if (to > m_readAheadEnd)
+      m_readAheadEnd = to;
+    if (bScheduled)
+    {
+      if (!m_worker.joinable())
+        m_worker = std::thread(&BlockCache::prefetchProc, this);
+      m_wake.notify_one();
+    }
+#endif
+  }
+
+#ifdef OD_RDFILEBUF_READAHEAD
+  void prefetchProc()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+      while (!m_bStop && m_queue.empty())
+        m_wake.wait(lock);
+      if (m_bStop)
+        return;
+
+      OdUInt64 addr = m_queue.front();
+      m_queue.pop_front();
+      if (addr >= m_length || m_index.find(addr) != m_index.end())
+        continue;
+
+      int i = victim();
+      if (i < 0 || !claim(i, addr))
+        continue;
+
+      OdUInt8* buf = m_blocks[i].buf;
+      lock.unlock();
+      int nBytes = readBlock(buf, addr);
+      lock.lock();
+      complete(i, addr, nBytes);
+    }
+  }
+#endif
+};
+
+void OdRdFileBuf::setDefaultCacheOptions(const CacheOptions& options)
+{
+  CacheOptions validated = validateCacheOptions(options);
+  std::lock_guard<std::mutex> lock(s_defaultCacheOptionsMutex);
+  s_defaultCacheOptions = validated;
+}
+
+OdRdFileBuf::CacheOptions OdRdFileBuf::defaultCacheOptions()
+{
+  std::lock_guard<std::mutex> lock(s_defaultCacheOptionsMutex);
+  return s_defaultCacheOptions;
+}
+
+void OdRdFileBuf::setCacheOptions(const CacheOptions& options)
+{
+  m_Options = validateCacheOptions(options);
+}
+
+OdRdFileBuf::OdRdFileBuf()
+{
+  init();
+}
+
+void OdRdFileBuf::init()
+{
+  m_BufPos = 0;
+  m_BytesLeft = 0;
+  m_BufBytes = 0;
+  m_pNextChar = NULL;
+  m_pCurBuf = NULL;
+  m_UsingBlock = -1;
+  m_pCache = NULL;
+  m_Options = defaultCacheOptions();
+  m_PosMask = ~OdUInt64(m_Options.m_blockSize - 1);
+  m_pWindowBuf = NULL;
+  m_WindowBufSize = 0;
+}
+
+void OdRdFileBuf::close()
+{
+  // indicate buffers no longer in use
+  delete m_pCache;
+  m_pCache = NULL;
+  m_BufPos = 0;
+  m_BytesLeft = m_BufBytes = 0;
+  m_pNextChar = m_pCurBuf = NULL;
+  m_UsingBlock = -1;
+  releaseWindow();
+  OdBaseFileBuf::close();
+}
+
+void OdRdFileBuf::open(
+  const OdString& fname, 
+  Oda::FileShareMode shMode,
+  Oda::FileAccessMode nDesiredAccess, 
+  Oda::FileCreationDisposition nCreationDisposition)
+{
+  if (nDesiredAccess & Oda::kFileWrite)
+    throw OdError_CantOpenFile(fname);
+
+  OdBaseFileBuf::open(fname, shMode, nDesiredAccess, nCreationDisposition);
+
+	if( nCreationDisposition == Oda::kOpenExisting || nCreationDisposition == Oda::kOpenAlways )
+  {
+    // Get file length
+    OdUInt64 curLoc = FTELL(m_fp);
+	  FSEEK(m_fp, 0, SEEK_END);
+	  m_length = FTELL(m_fp);
+    FSEEK(m_fp, OFFSETTYPE(curLoc), 0);
+
+    if (m_length > 0)
+    {
+      m_BufBytes= 0;
+      m_BytesLeft= 0;
+      m_BufPos=0;  // to start reads from 0
+      m_pCurBuf=NULL;
+      m_pNextChar = m_pCurBuf;
+      m_UsingBlock = -1;
+      m_PosMask = ~OdUInt64(m_Options.m_blockSize - 1);
+
+      m_pCache = new BlockCache(m_fp, m_length, m_Options);
+      seek(0, OdDb::kSeekFromStart);  // initial seek, gets a buffer & stuff
+    }
+  }
+  return;
+}
+
+bool OdRdFileBuf::filbuf( )
+{
+  m_UsingBlock = -1;
+  int i = m_pCache ? m_pCache->acquire(m_BufPos, m_pStats) : -1;
+  if (i < 0)
+  {
+    // nothing is held at this position (end of file)
+    m_pCurBuf = m_pNextChar = NULL;
+    m_BytesLeft = m_BufBytes = 0;
+    return false;
+  }
+
+  const BlockCache::blockstru& block = m_pCache->m_blocks[i];
+  m_pCurBuf = block.buf;
+  m_BytesLeft = m_BufBytes = block.validbytes;
+  m_pNextChar = m_pCurBuf;
+  m_UsingBlock = i;
+  return true;
+}
+
+OdUInt64 OdRdFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
+{
+  int bytestoadvance;
+  OdUInt64 nFrom = tell();
+
+  switch (whence)
+  {
+  case OdDb::kSeekFromStart:
+    if( offset < 0 ) throw OdError_FileException(eFileInternalErr, m_FileName);
+    break;
+  case OdDb::kSeekFromCurrent:
+    if( offset < 0 && m_BufPos+(m_pNextChar - m_pCurBuf) < (OdUInt64)(-offset)) 
        throw OdError_FileException(eFileInternalErr, m_FileName);
     offset += (m_BufPos+(m_pNextChar - m_pCurBuf));
     break;
@@ -1174,6 +1890,8 @@ OdUInt64 OdRdFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
     {
       if (isEof())
       {
+        if (m_pStats)
+          m_pStats->addSeek(nFrom, offset);
         return offset;
       }
 
@@ -1184,8 +1902,10 @@ OdUInt64 OdRdFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
       //return ERR_VAL;
     }
   }
-  m_pNextChar = (m_pCurBuf + (bytestoadvance=(OdUInt16)(offset - m_BufPos)));
+  m_pNextChar = (m_pCurBuf + (bytestoadvance=(int)(offset - m_BufPos)));
   m_BytesLeft = m_BufBytes - bytestoadvance;
+  if (m_pStats)
+    m_pStats->addSeek(nFrom, offset);
   return(offset);
 }
 
@@ -1199,16 +1919,81 @@ bool OdRdFileBuf::isEof()
 {
   if (m_BytesLeft > 0)
     return false;
+  return !nextBlock();
+}
+
+bool OdRdFileBuf::nextBlock()
+{
   if (m_length == 0)
-    return true;
+    return false;
   m_BufPos += m_BufBytes;
-  return !filbuf();
+  return filbuf();
 }
 
 
+const OdUInt8* OdRdFileBuf::getWindow(OdUInt32 nLen, OdUInt32* pAvailable)
+{
+  if (!nLen)
+    nLen = 1;
+  if (m_BytesLeft <= 0)
+    nextBlock();
+  if (m_BytesLeft > 0 && OdUInt32(m_BytesLeft) >= nLen)
+  {
+    // served in place from the block currently in use
+    if (pAvailable)
+      *pAvailable = OdUInt32(m_BytesLeft);
+    return m_pNextChar;
+  }
+
+  if (tell() + nLen > length())
+    return NULL;
+  if (pAvailable)
+    *pAvailable = nLen;
+  return copyWindow(nLen, m_pWindowBuf, m_WindowBufSize);
+}
+
+void OdRdFileBuf::advanceWindow(OdUInt32 nLen)
+{
+  if (m_BytesLeft >= 0 && OdUInt32(m_BytesLeft) >= nLen)
+  {
+    m_pNextChar += nLen;
+    m_BytesLeft -= nLen;
+  }
+  else
+  {
+    if (tell() + nLen > length())
+      throw OdError(eEndOfFile);
+    OdFileBufStats* pStats = m_pStats;
+    m_pStats = NULL; // not a seek from the caller's point of view
+    try
+    {
+      seek(nLen, OdDb::kSeekFromCurrent);
+    }
+    catch (...)
+    {
+      m_pStats = pStats;
+      throw;
+    }
+    m_pStats = pStats;
+  }
+  if (m_pStats)
+    m_pStats->m_bytesRead += nLen;
+}
+
+void OdRdFileBuf::releaseWindow()
+{
+  ::odrxFree(m_pWindowBuf);
+  m_pWindowBuf = NULL;
+  m_WindowBufSize = 0;
+}
+
 OdUInt8 OdRdFileBuf::getByte()
 {
-  m_DataBlock[m_UsingBlock].counter=m_Counter++;
+  if (m_pStats)
+  {
+    ++m_pStats->m_getByteCalls;
+    ++m_pStats->m_bytesRead;
+  }
   if (m_BytesLeft<=0) {
     m_BufPos+=m_BufBytes;
     if (!filbuf())
@@ -1224,19 +2009,23 @@ void OdRdFileBuf::getBytes(void* buffer, OdUInt32 nLen)
 {
   if (tell() + nLen > length())
       throw OdError(eEndOfFile);
+  if (m_pStats)
+  {
+    ++m_pStats->m_getBytesCalls;
+    m_pStats->m_bytesRead += nLen;
+  }
 
-  OdInt32 bytesleft;
-  OdUInt16 bytestoread;
+  OdInt64 bytesleft;
+  OdUInt32 bytestoread;
   unsigned char *buf=(unsigned char *)buffer;
 
   if (nLen > 0)
   {
-    m_DataBlock[m_UsingBlock].counter=m_Counter++;
     bytesleft = nLen;
 
     while (bytesleft > 0L && !isEof( )) {
-      if ((OdInt32)m_BytesLeft<bytesleft) bytestoread=(OdUInt16)m_BytesLeft;
-      else bytestoread=(OdUInt16)bytesleft;
+      if ((OdInt64)m_BytesLeft<bytesleft) bytestoread=(OdUInt32)m_BytesLeft;
+      else bytestoread=(OdUInt32)bytesleft;
 
       memcpy(buf,m_pNextChar,bytestoread);
       m_BytesLeft -= bytestoread;
@@ -1251,11 +2040,128 @@ void OdRdFileBuf::getBytes(void* buffer, OdUInt32 nLen)
 
 void OdRdFileBuf::truncate()
 {
-  init();
+  OdUInt64 pos = tell();
+  m_UsingBlock = -1;
+  m_BytesLeft = m_BufBytes = 0;
+  m_pNextChar = m_pCurBuf = NULL;
+  if (m_pCache)
+    m_pCache->reset(pos);
+  m_position = pos;
   OdBaseFileBuf::truncate();
 
-  if (!filbuf())
-    throw OdError_FileException(eFileWriteError, m_FileName);
+  m_BufPos = pos & m_PosMask;
+  if (filbuf())
+  {
+    m_pNextChar = m_pCurBuf + (pos - m_BufPos);
+    m_BytesLeft = m_BufBytes - (int)(pos - m_BufPos);
+  }
+  else
+  {
+    m_BufPos = pos;
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+// OdWrFileBuf write-behind buffer
+//
+// Each segment of the buffer starts at the same offset modulo
+// WRFILEBUF_ALIGNMENT as its data in the file, so aligned parts of the
+// file are also aligned in memory and can be written with O_DIRECT.
+// Segments never overlap: a write partly overlapping buffered data
+// flushes the buffer first.
+////////////////////////////////////////////////////////////////////
+
+#define WRFILEBUF_MAX_IOV 64 /* segments written by one pwritev() call */
+
+static OdWrFileBuf::WriteOptions s_defaultWriteOptions = { WRFILEBUF_BUFFER_SIZE, false };
+static std::mutex s_defaultWriteOptionsMutex;   /* guards s_defaultWriteOptions */
+
+static OdWrFileBuf::WriteOptions validateWriteOptions(const OdWrFileBuf::WriteOptions& options)
+{
+  OdWrFileBuf::WriteOptions res = options;
+  if (res.m_bufferSize < WRFILEBUF_ALIGNMENT)
+    res.m_bufferSize = WRFILEBUF_ALIGNMENT;
+  res.m_bufferSize = (res.m_bufferSize + WRFILEBUF_ALIGNMENT - 1) & ~OdUInt32(WRFILEBUF_ALIGNMENT - 1);
+  return res;
+}
+
+// Writes all iov entries as a contiguous range at the given offset.
+static bool writeVectorAt(FILE* fp, int fd, struct iovec* iov, int nIov, OdUInt64 offset)
+{
+#ifdef OD_HAVE_UNISTD_FILE
+  while (nIov > 0)
+  {
+    ssize_t n = ::pwritev(fd, iov, nIov, (off_t)offset);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    offset += (OdUInt64)n;
+    while (nIov > 0 && (size_t)n >= iov->iov_len)
+    {
+      n -= iov->iov_len;
+      ++iov;
+      --nIov;
+    }
+    if (nIov > 0)
+    {
+      iov->iov_base = (char*)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return true;
+#else
+  if (FSEEK(fp, OFFSETTYPE(offset), SEEK_SET) != 0)
+    return false;
+  for (int i = 0; i < nIov; ++i)
+  {
+    if (::fwrite(iov[i].iov_base, 1, iov[i].iov_len, fp) < iov[i].iov_len)
+      return false;
+  }
+  return fflush(fp) == 0;
+#endif
+}
+
+void OdWrFileBuf::setDefaultWriteOptions(const WriteOptions& options)
+{
+  WriteOptions validated = validateWriteOptions(options);
+  std::lock_guard<std::mutex> lock(s_defaultWriteOptionsMutex);
+  s_defaultWriteOptions = validated;
+}
+
+OdWrFileBuf::WriteOptions OdWrFileBuf::defaultWriteOptions()
+{
+  std::lock_guard<std::mutex> lock(s_defaultWriteOptionsMutex);
+  return s_defaultWriteOptions;
+}
+
+void OdWrFileBuf::setWriteOptions(const WriteOptions& options)
+{
+  m_Options = validateWriteOptions(options);
+}
+
+void OdWrFileBuf::init()
+{
+  m_pBuffer = NULL;
+  m_BufSize = 0;
+  m_BufUsed = 0;
+  m_pLast = m_Segments.end();
+  m_DirectFd = -1;
+  m_Options = defaultWriteOptions();
+}
+
+OdWrFileBuf::~OdWrFileBuf()
+{
+  try
+  {
+    close();
+  }
+  catch (...)
+  {
+    ODA_ASSERT_ONCE(!L"Exception in ~OdWrFileBuf");
+  }
 }
 
 void OdWrFileBuf::open(const OdString& filename,
@@ -1270,7 +2176,683 @@ void OdWrFileBuf::open(const OdString& filename,
     shareMode,
     accessMode,
     creationDisposition);
+
+#if defined(OD_HAVE_UNISTD_FILE) && defined(O_DIRECT)
+  if (m_Options.m_bDirectIO)
+  {
+#ifdef OD_CONVERT_UNICODETOUTF8
+    OdAnsiString nAnsiUtf8(filename, CP_UTF_8);
+    const char* fName = nAnsiUtf8.c_str();
+#else
+    const char* fName = (const char*)filename;
+#endif
+    // a second descriptor for aligned writes; if the file system doesn't
+    // support O_DIRECT all data is written through the regular one
+    m_DirectFd = ::open(fName, O_WRONLY | O_DIRECT);
+  }
+#endif
+}
+
+void OdWrFileBuf::close()
+{
+  bool bFlushed = true;
+  try
+  {
+    flush();
+  }
+  catch (...)
+  {
+    bFlushed = false;
+  }
+#ifdef OD_HAVE_UNISTD_FILE
+  free(m_pBuffer);
+  if (m_DirectFd != -1)
+    ::close(m_DirectFd);
+#else
+  ::odrxFree(m_pBuffer);
+#endif
+  m_pBuffer = NULL;
+  m_BufSize = 0;
+  m_DirectFd = -1;
+  OdString fileName = m_FileName;
+  OdBaseFileBuf::close();
+  if (!bFlushed)
+    throw OdError_FileWriteError(fileName);
+}
+
+void OdWrFileBuf::writeAt(OdUInt64 pos, const OdUInt8* pData, OdUInt32 numBytes, bool bDirect)
+{
+  if (!numBytes)
+    return;
+  struct iovec iov;
+  iov.iov_base = (void*)pData;
+  iov.iov_len = numBytes;
+  if (bDirect && m_DirectFd != -1)
+  {
+    if (writeVectorAt(m_fp, m_DirectFd, &iov, 1, pos))
+      return;
+    // O_DIRECT refused (alignment or file system), continue without it
+    ::close(m_DirectFd);
+    m_DirectFd = -1;
+    iov.iov_base = (void*)pData;
+    iov.iov_len = numBytes;
+  }
+  if (!writeVectorAt(m_fp, fileno(m_fp), &iov, 1, pos))
+    throw OdError_FileWriteError(m_FileName);
+}
+
+void OdWrFileBuf::flush()
+{
+  if (m_Segments.empty())
+    return;
+
+  SegmentMap segments;
+  segments.swap(m_Segments);
+  m_BufUsed = 0;
+  m_pLast = m_Segments.end();
+
+  SegmentMap::iterator it = segments.begin();
+  if (m_DirectFd != -1)
+  {
+    // aligned middle of each segment goes around the page cache
+    for (; it != segments.end(); ++it)
+    {
+      OdUInt64 start = it->first;
+      OdUInt64 end = start + it->second.m_size;
+      const OdUInt8* pData = m_pBuffer + it->second.m_bufOffset;
+      OdUInt64 alignedStart = (start + WRFILEBUF_ALIGNMENT - 1) & ~OdUInt64(WRFILEBUF_ALIGNMENT - 1);
+      OdUInt64 alignedEnd = end & ~OdUInt64(WRFILEBUF_ALIGNMENT - 1);
+      if (alignedStart >= alignedEnd)
+      {
+        writeAt(start, pData, it->second.m_size, false);
+        continue;
+      }
+      writeAt(start, pData, OdUInt32(alignedStart - start), false);
+      writeAt(alignedStart, pData + (alignedStart - start), OdUInt32(alignedEnd - alignedStart), true);
+      writeAt(alignedEnd, pData + (alignedEnd - start), OdUInt32(end - alignedEnd), false);
+    }
+    return;
+  }
+
+  while (it != segments.end())
+  {
+    // segments adjacent in the file are written by one call
+    struct iovec iov[WRFILEBUF_MAX_IOV];
+    int nIov = 0;
+    OdUInt64 start = it->first;
+    OdUInt64 end = start;
+    while (it != segments.end() && it->first == end && nIov < WRFILEBUF_MAX_IOV)
+    {
+      iov[nIov].iov_base = m_pBuffer + it->second.m_bufOffset;
+      iov[nIov].iov_len = it->second.m_size;
+      end += it->second.m_size;
+      ++nIov;
+      ++it;
+    }
+    if (!writeVectorAt(m_fp, fileno(m_fp), iov, nIov, start))
+      throw OdError_FileWriteError(m_FileName);
+  }
 }
+
+// Makes the buffer hold at least nRequired bytes, keeping buffered data.
+// Returns false if that exceeds the size limit or memory is short.
+bool OdWrFileBuf::growBuffer(OdUInt64 nRequired)
+{
+  if (nRequired <= m_BufSize)
+    return true;
+  if (nRequired > m_Options.m_bufferSize)
+    return false;
+  OdUInt64 newSize = m_BufSize ? m_BufSize : WRFILEBUF_INITIAL_SIZE;
+  while (newSize < nRequired)
+    newSize *= 2;
+  if (newSize > m_Options.m_bufferSize)
+    newSize = m_Options.m_bufferSize;
+#ifdef OD_HAVE_UNISTD_FILE
+  void* pBuf = NULL;
+  if (posix_memalign(&pBuf, WRFILEBUF_ALIGNMENT, (size_t)newSize) != 0)
+    return false;
+  OdUInt8* pNew = (OdUInt8*)pBuf;
+#else
+  OdUInt8* pNew = (OdUInt8*)::odrxAlloc((size_t)newSize);
+  if (!pNew)
+    return false;
+#endif
+  if (m_BufUsed)
+    ::memcpy(pNew, m_pBuffer, m_BufUsed);
+#ifdef OD_HAVE_UNISTD_FILE
+  free(m_pBuffer);
+#else
+  ::odrxFree(m_pBuffer);
+#endif
+  m_pBuffer = pNew;
+  m_BufSize = OdUInt32(newSize);
+  return true;
+}
+
+void OdWrFileBuf::addSegment(OdUInt64 pos, const OdUInt8* pData, OdUInt32 numBytes)
+{
+  OdUInt32 align = OdUInt32(pos % WRFILEBUF_ALIGNMENT);
+  OdUInt32 offset = m_BufUsed + (align + WRFILEBUF_ALIGNMENT - m_BufUsed % WRFILEBUF_ALIGNMENT) % WRFILEBUF_ALIGNMENT;
+  if (!growBuffer(OdUInt64(offset) + numBytes))
+  {
+    flush();
+    offset = align;
+  }
+  if (!growBuffer(OdUInt64(offset) + numBytes))
+  {
+    // larger than the buffer, nothing to gain by copying it
+    writeAt(pos, pData, numBytes, false);
+    return;
+  }
+  ::memcpy(m_pBuffer + offset, pData, numBytes);
+  Segment seg = { offset, numBytes };
+  m_pLast = m_Segments.insert(std::make_pair(pos, seg)).first;
+  m_BufUsed = offset + numBytes;
+}
+
+void OdWrFileBuf::putBytes(const void* buffer, OdUInt32 numBytes)
+{
+  if (m_pStats)
+  {
+    ++m_pStats->m_putBytesCalls;
+    m_pStats->m_bytesWritten += numBytes;
+  }
+  bufferBytes((const OdUInt8*)buffer, numBytes);
+}
+
+void OdWrFileBuf::bufferBytes(const OdUInt8* pData, OdUInt32 numBytes)
+{
+  if (!numBytes)
+    return;
+  if (!m_fp)
+    throw OdError_FileWriteError(m_FileName);
+
+  OdUInt64 pos = m_position;
+  OdUInt64 end = pos + numBytes;
+
+  SegmentMap::iterator next = m_Segments.upper_bound(pos);
+  SegmentMap::iterator prev = m_Segments.end();
+  if (next != m_Segments.begin())
+    prev = std::prev(next);
+
+  if (prev != m_Segments.end() && end <= prev->first + prev->second.m_size)
+  {
+    // rewriting buffered data
+    ::memcpy(m_pBuffer + prev->second.m_bufOffset + (pos - prev->first), pData, numBytes);
+  }
+  else if ((prev != m_Segments.end() && prev->first + prev->second.m_size > pos) ||
+           (next != m_Segments.end() && next->first < end))
+  {
+    // partly overlaps buffered data
+    flush();
+    addSegment(pos, pData, numBytes);
+  }
+  else if (prev != m_Segments.end() && prev->first + prev->second.m_size == pos &&
+           prev->second.m_bufOffset + prev->second.m_size == m_BufUsed &&
+           growBuffer(OdUInt64(m_BufUsed) + numBytes))
+  {
+    // continues the segment at the end of the buffer
+    ::memcpy(m_pBuffer + m_BufUsed, pData, numBytes);
+    prev->second.m_size += numBytes;
+    m_BufUsed += numBytes;
+    m_pLast = prev;
+  }
+  else
+  {
+    addSegment(pos, pData, numBytes);
+  }
+
+  m_position = end;
+  if (m_position > m_length)
+    m_length = m_position;
+}
+
+void OdWrFileBuf::putByte(OdUInt8 value)
+{
+  if (m_pStats)
+  {
+    ++m_pStats->m_putByteCalls;
+    ++m_pStats->m_bytesWritten;
+  }
+  if (m_pLast != m_Segments.end() && m_BufUsed < m_BufSize)
+  {
+    Segment& seg = m_pLast->second;
+    if (m_position == m_pLast->first + seg.m_size && seg.m_bufOffset + seg.m_size == m_BufUsed)
+    {
+      SegmentMap::iterator next = std::next(m_pLast);
+      if (next == m_Segments.end() || next->first > m_position)
+      {
+        m_pBuffer[m_BufUsed++] = value;
+        ++seg.m_size;
+        if (++m_position > m_length)
+          m_length = m_position;
+        return;
+      }
+    }
+  }
+  bufferBytes(&value, 1);
+}
+
+OdUInt64 OdWrFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
+{
+  // buffered data stays in place, the next write decides whether to flush it
+  OdUInt64 nFrom = m_position;
+  switch (whence) {
+  case OdDb::kSeekFromStart:
+    if( offset < 0 ) throw OdError_FileException(eFileInternalErr, m_FileName);
+    m_position = offset;
+    break;
+  case OdDb::kSeekFromCurrent:
+    if( offset < 0 && m_position < (OdUInt64)(-offset) ) throw OdError_FileException(eFileInternalErr, m_FileName);
+    m_position += offset;
+    break;
+  case OdDb::kSeekFromEnd:
+    if( offset < 0 && m_length < (OdUInt64)(-offset) ) throw OdError_FileException(eFileInternalErr, m_FileName);
+    m_position = m_length + offset;
+    break;
+  }
+  if (m_pStats)
+    m_pStats->addSeek(nFrom, m_position);
+  return m_position;
+}
+
+void OdWrFileBuf::readBytes(void* buffer, OdUInt32 numBytes)
+{
+  flush();
+#ifdef OD_HAVE_UNISTD_FILE
+  // stdio may still hold data read before the last flush
+  if (preadFully(fileno(m_fp), buffer, numBytes, m_position) < numBytes)
+    throw OdError_FileException(eEndOfFile, m_FileName);
+#else
+  fflush(m_fp);
+  if (FSEEK(m_fp, OFFSETTYPE(m_position), SEEK_SET) != 0 || ::fread(buffer, 1, numBytes, m_fp) < numBytes)
+    throw OdError_FileException(eEndOfFile, m_FileName);
+#endif
+  m_position += numBytes;
+}
+
+OdUInt8 OdWrFileBuf::getByte()
+{
+  if (m_pStats)
+  {
+    ++m_pStats->m_getByteCalls;
+    ++m_pStats->m_bytesRead;
+  }
+  OdUInt8 value;
+  readBytes(&value, 1);
+  return value;
+}
+
+void OdWrFileBuf::getBytes(void* buffer, OdUInt32 numBytes)
+{
+  if (m_pStats)
+  {
+    ++m_pStats->m_getBytesCalls;
+    m_pStats->m_bytesRead += numBytes;
+  }
+  readBytes(buffer, numBytes);
+}
+
+void OdWrFileBuf::truncate()
+{
+  flush();
+  OdBaseFileBuf::truncate();
+}
+
+void OdWrFileBuf::copyDataTo(OdStreamBuf* pDest, OdUInt64 nSrcStart, OdUInt64 nSrcEnd)
+{
+  flush();
+  OdBaseFileBuf::copyDataTo(pDest, nSrcStart, nSrcEnd);
+}
+
+#if defined(OD_HAVE_UNISTD_FILE)
+////////////////////////////////////////////////////////////////////
+// OdRdSharedFileBuf
+//
+// The descriptor and the block cache belong to a SharedFile object which
+// is referenced by the stream and all its clones. Cached blocks are never
+// modified after they are read, so a stream may keep using its block after
+// the cache has dropped it. The cache is split into shards, each with its
+// own lock, which is held only to look up or insert a block; disk reads
+// are done without any lock held. Two streams missing the same block may
+// both read it, the first one inserted is kept.
+////////////////////////////////////////////////////////////////////
+
+#define SHAREDFILEBUF_NUM_SHARDS 16
+
+struct OdRdSharedFileBuf::Block
+{
+  OdUInt64 m_start;
+  OdUInt32 m_size;
+  OdUInt8* m_data;
+
+  Block(OdUInt64 start, OdUInt32 capacity)
+    : m_start(start)
+    , m_size(0)
+    , m_data((OdUInt8*)::odrxAlloc(capacity))
+  {
+    if (!m_data)
+      throw OdError(eOutOfMemory);
+  }
+  ~Block() { ::odrxFree(m_data); }
+};
+
+struct OdRdSharedFileBuf::SharedFile
+{
+  typedef std::shared_ptr<const Block> BlockPtr;
+
+  struct Slot
+  {
+    BlockPtr m_pBlock;
+    bool     m_referenced;
+    Slot() : m_referenced(false) {}
+  };
+
+  struct Shard
+  {
+    std::mutex                        m_mutex;
+    std::unordered_map<OdUInt64, int> m_index;
+    std::vector<Slot>                 m_slots;
+    int                               m_hand;
+    Shard() : m_hand(0) {}
+  };
+
+  FILE*    m_fp;
+  int      m_fd;
+  OdUInt64 m_length;
+  OdUInt32 m_blockSize;
+  Shard    m_shards[SHAREDFILEBUF_NUM_SHARDS];
+
+  SharedFile(FILE* fp, OdUInt64 length, const OdRdFileBuf::CacheOptions& options)
+    : m_fp(fp)
+    , m_fd(fileno(fp))
+    , m_length(length)
+    , m_blockSize(options.m_blockSize)
+  {
+    OdUInt32 perShard = odmax(options.m_numBlocks / SHAREDFILEBUF_NUM_SHARDS, 1u);
+    for (int i = 0; i < SHAREDFILEBUF_NUM_SHARDS; ++i)
+      m_shards[i].m_slots.resize(perShard);
+  }
+  ~SharedFile()
+  {
+    if (m_fp)
+      fclose(m_fp);
+  }
+
+  Shard& shard(OdUInt64 addr)
+  {
+    return m_shards[(addr / m_blockSize) % SHAREDFILEBUF_NUM_SHARDS];
+  }
+
+  BlockPtr find(OdUInt64 addr)
+  {
+    Shard& sh = shard(addr);
+    std::lock_guard<std::mutex> lock(sh.m_mutex);
+    std::unordered_map<OdUInt64, int>::iterator it = sh.m_index.find(addr);
+    if (it == sh.m_index.end())
+      return BlockPtr();
+    Slot& slot = sh.m_slots[it->second];
+    slot.m_referenced = true;
+    return slot.m_pBlock;
+  }
+
+  // Adds a block to the cache replacing an unreferenced one (CLOCK).
+  // Returns the cached block, which is not pBlock if another stream was faster.
+  BlockPtr insert(const BlockPtr& pBlock)
+  {
+    Shard& sh = shard(pBlock->m_start);
+    std::lock_guard<std::mutex> lock(sh.m_mutex);
+    std::unordered_map<OdUInt64, int>::iterator it = sh.m_index.find(pBlock->m_start);
+    if (it != sh.m_index.end())
+      return sh.m_slots[it->second].m_pBlock;
+    int nSlots = (int)sh.m_slots.size();
+    for (;;)
+    {
+      Slot& slot = sh.m_slots[sh.m_hand];
+      int i = sh.m_hand;
+      sh.m_hand = (sh.m_hand + 1) % nSlots;
+      if (slot.m_pBlock && slot.m_referenced)
+      {
+        slot.m_referenced = false;
+        continue;
+      }
+      if (slot.m_pBlock)
+        sh.m_index.erase(slot.m_pBlock->m_start);
+      slot.m_pBlock = pBlock;
+      slot.m_referenced = true;
+      sh.m_index[pBlock->m_start] = i;
+      return pBlock;
+    }
+  }
+
+  BlockPtr acquire(OdUInt64 addr, OdFileBufStats* pStats)
+  {
+    BlockPtr pBlock = find(addr);
+    if (pBlock)
+    {
+      if (pStats)
+        ++pStats->m_cacheHits;
+      return pBlock;
+    }
+    if (pStats)
+      ++pStats->m_cacheMisses;
+    std::shared_ptr<Block> pNew = std::make_shared<Block>(addr, m_blockSize);
+    pNew->m_size = preadFully(m_fd, pNew->m_data, m_blockSize, addr);
+    if (pNew->m_size == 0)
+      return BlockPtr();
+    return insert(pNew);
+  }
+};
+
+OdRdSharedFileBuf::OdRdSharedFileBuf()
+  : m_pBlockData(NULL)
+  , m_BlockStart(0)
+  , m_BlockBytes(0)
+  , m_Options(OdRdFileBuf::defaultCacheOptions())
+  , m_pWindowBuf(NULL)
+  , m_WindowBufSize(0)
+{
+  m_Options.m_blockSize = SHAREDFILEBUF_BLOCK_SIZE;
+  m_Options.m_numBlocks = SHAREDFILEBUF_NUM_BLOCKS;
+}
+
+void OdRdSharedFileBuf::setCacheOptions(const OdRdFileBuf::CacheOptions& options)
+{
+  m_Options = validateCacheOptions(options);
+}
+
+int OdRdSharedFileBuf::fileDescriptor() const
+{
+  return m_pShared ? m_pShared->m_fd : -1;
+}
+
+void OdRdSharedFileBuf::setBlock(const std::shared_ptr<const Block>& pBlock)
+{
+  m_pBlock = pBlock;
+  if (pBlock)
+  {
+    m_pBlockData = pBlock->m_data;
+    m_BlockStart = pBlock->m_start;
+    m_BlockBytes = pBlock->m_size;
+  }
+  else
+  {
+    m_pBlockData = NULL;
+    m_BlockStart = 0;
+    m_BlockBytes = 0;
+  }
+}
+
+void OdRdSharedFileBuf::open(
+  const OdString& fname,
+  Oda::FileShareMode shMode,
+  Oda::FileAccessMode nDesiredAccess,
+  Oda::FileCreationDisposition nCreationDisposition)
+{
+  if (nDesiredAccess & Oda::kFileWrite)
+    throw OdError_CantOpenFile(fname);
+
+  OdBaseFileBuf::open(fname, shMode, nDesiredAccess, nCreationDisposition);
+
+  FSEEK(m_fp, 0, SEEK_END);
+  m_length = FTELL(m_fp);
+  FSEEK(m_fp, 0, SEEK_SET);
+
+  // the descriptor now belongs to the shared part, it is closed with the last clone
+  m_pShared = std::make_shared<SharedFile>(m_fp, m_length, m_Options);
+  m_fp = NULL;
+  m_position = 0;
+}
+
+void OdRdSharedFileBuf::close()
+{
+  setBlock(std::shared_ptr<const Block>());
+  m_pShared.reset();
+  releaseWindow();
+  OdBaseFileBuf::close();
+}
+
+OdRxObjectPtr OdRdSharedFileBuf::clone() const
+{
+  OdRdSharedFileBufPtr pClone = createObject();
+  pClone->m_pShared = m_pShared;
+  pClone->m_FileName = m_FileName;
+  pClone->m_length = m_length;
+  pClone->m_position = m_position;
+  pClone->m_accessMode = m_accessMode;
+  pClone->m_shMode = m_shMode;
+  pClone->m_Options = m_Options;
+  pClone->setBlock(m_pBlock);
+  return OdRxObjectPtr(pClone.get());
+}
+
+bool OdRdSharedFileBuf::loadBlock()
+{
+  if (!m_pShared)
+    return false;
+  OdUInt64 addr = m_position - m_position % m_pShared->m_blockSize;
+  setBlock(m_pShared->acquire(addr, m_pStats));
+  return m_position - m_BlockStart < m_BlockBytes;
+}
+
+OdUInt64 OdRdSharedFileBuf::seek(OdInt64 offset, OdDb::FilerSeekType whence)
+{
+  OdInt64 newPos;
+  switch (whence)
+  {
+  case OdDb::kSeekFromEnd:
+    newPos = (OdInt64)m_length + offset;
+    break;
+  case OdDb::kSeekFromCurrent:
+    newPos = (OdInt64)m_position + offset;
+    break;
+  case OdDb::kSeekFromStart:
+    newPos = offset;
+    break;
+  default:
+    throw OdError(eInvalidInput);
+  }
+  if (newPos < 0 || (OdUInt64)newPos > m_length)
+    throw OdError(eEndOfFile);
+  if (m_pStats)
+    m_pStats->addSeek(m_position, (OdUInt64)newPos);
+  m_position = (OdUInt64)newPos;
+  return m_position;
+}
+
+OdUInt8 OdRdSharedFileBuf::getByte()
+{
+  if (m_pStats)
+  {
+    ++m_pStats->m_getByteCalls;
+    ++m_pStats->m_bytesRead;
+  }
+  // the unsigned difference is out of range when m_position is before the block
+  if (m_position - m_BlockStart >= m_BlockBytes)
+  {
+    if (m_position >= m_length || !loadBlock())
+      throw OdError(eEndOfFile);
+  }
+  return m_pBlockData[m_position++ - m_BlockStart];
+}
+
+void OdRdSharedFileBuf::getBytes(void* buffer, OdUInt32 numBytes)
+{
+  if (!numBytes)
+    return;
+  if (m_position + numBytes > m_length)
+    throw OdError(eEndOfFile);
+  if (m_pStats)
+  {
+    ++m_pStats->m_getBytesCalls;
+    m_pStats->m_bytesRead += numBytes;
+  }
+
+  OdUInt8* pDest = (OdUInt8*)buffer;
+  while (numBytes)
+  {
+    if (m_position - m_BlockStart < m_BlockBytes)
+    {
+      OdUInt32 nAvail = OdUInt32(m_BlockBytes - (m_position - m_BlockStart));
+      OdUInt32 n = odmin(nAvail, numBytes);
+      ::memcpy(pDest, m_pBlockData + (m_position - m_BlockStart), n);
+      pDest += n;
+      m_position += n;
+      numBytes -= n;
+    }
+    else if (numBytes >= m_pShared->m_blockSize)
+    {
+      // large reads go straight to the caller's buffer and bypass the cache
+      OdUInt32 n = preadFully(m_pShared->m_fd, pDest, numBytes, m_position);
+      m_position += n;
+      if (n < numBytes)
+        throw OdError(eEndOfFile);
+      numBytes = 0;
+    }
+    else if (!loadBlock())
+    {
+      throw OdError(eEndOfFile);
+    }
+  }
+}
+
+const OdUInt8* OdRdSharedFileBuf::getWindow(OdUInt32 numBytes, OdUInt32* pAvailable)
+{
+  if (!numBytes)
+    numBytes = 1;
+  if (m_position + numBytes > m_length)
+    return NULL;
+  if (m_position - m_BlockStart >= m_BlockBytes && !loadBlock())
+    return NULL;
+
+  OdUInt32 nAvail = OdUInt32(m_BlockBytes - (m_position - m_BlockStart));
+  if (nAvail >= numBytes)
+  {
+    if (pAvailable)
+      *pAvailable = nAvail;
+    return m_pBlockData + (m_position - m_BlockStart);
+  }
+  if (pAvailable)
+    *pAvailable = numBytes;
+  return copyWindow(numBytes, m_pWindowBuf, m_WindowBufSize);
+}
+
+void OdRdSharedFileBuf::advanceWindow(OdUInt32 numBytes)
+{
+  if (m_position + numBytes > m_length)
+    throw OdError(eEndOfFile);
+  m_position += numBytes;
+  if (m_pStats)
+    m_pStats->m_bytesRead += numBytes;
+}
+
+void OdRdSharedFileBuf::releaseWindow()
+{
+  ::odrxFree(m_pWindowBuf);
+  m_pWindowBuf = NULL;
+  m_WindowBufSize = 0;
+}
+#endif // OD_HAVE_UNISTD_FILE
  
 #endif // #ifdef WIN32
 
@@ -1278,3 +2860,49 @@ OdUInt32 OdBaseFileBuf::getAccessMode() const
 {
   return (OdUInt32)m_accessMode;
 }
+
+const OdUInt8* OdBaseFileBuf::copyWindow(OdUInt32 numBytes, OdUInt8*& pBuf, OdUInt32& bufSize)
+{
+  if (bufSize < numBytes)
+  {
+    ::odrxFree(pBuf);
+    pBuf = NULL;
+    bufSize = 0;
+    pBuf = (OdUInt8*)::odrxAlloc(numBytes);
+    if (!pBuf)
+      throw OdError(eOutOfMemory);
+    bufSize = numBytes;
+  }
+
+  // the bytes are counted when the window is advanced
+  OdFileBufStats* pStats = m_pStats;
+  m_pStats = NULL;
+  try
+  {
+    OdUInt64 nPos = tell();
+    getBytes(pBuf, numBytes);
+    seek(nPos, OdDb::kSeekFromStart);
+  }
+  catch (...)
+  {
+    m_pStats = pStats;
+    throw;
+  }
+  m_pStats = pStats;
+  return pBuf;
+}
+
+void OdBaseFileBuf::enableStats(bool bEnable)
+{
+  if (bEnable)
+  {
+    if (!m_pStats)
+      m_pStats = new OdFileBufStats;
+  }
+  else if (m_pStats)
+  {
+    OdFileBufStats::commit(*m_pStats, fileName());
+    delete m_pStats;
+    m_pStats = NULL;
+  }
+}
@@ -26,6 +26,105 @@
 
 #include "TD_PackPush.h"
 #include "OdaCommon.h"
+#include "OdString.h"
+
+/** \details
+  I/O counters of a file stream.
+  \remarks
+  Counters are collected only by streams for which OdBaseFileBuf::enableStats()
+  was called; other streams just test a null pointer. RxSystemServicesImpl::createFile()
+  enables them for every file it creates while isEnabled() returns true.
+  When such a stream is closed its counters are added to the process totals
+  (see total()) and, if a dump file is set, appended to it as a JSON line.
+  <group ExServices_Classes>
+*/
+struct OdFileBufStats
+{
+  enum { kSeekBuckets = 8 };
+
+  OdUInt64 m_getByteCalls;
+  OdUInt64 m_getBytesCalls;
+  OdUInt64 m_putByteCalls;
+  OdUInt64 m_putBytesCalls;
+  OdUInt64 m_bytesRead;
+  OdUInt64 m_bytesWritten;
+  OdUInt64 m_seeks;
+  OdUInt64 m_backwardSeeks;
+  OdUInt64 m_seekDistance[kSeekBuckets]; /* seeks by distance: 0, <256, <4K, <64K, <1M, <16M, <256M, larger */
+  OdUInt64 m_cacheHits;                  /* blocks found in the read cache */
+  OdUInt64 m_cacheMisses;                /* blocks read from the file */
+  OdUInt64 m_files;                      /* streams counted (in totals) */
+
+  OdFileBufStats() { reset(); }
+
+  void reset();
+  void add(const OdFileBufStats& stats);
+  void addSeek(OdUInt64 from, OdUInt64 to);
+  bool isEmpty() const;
+
+  /** \details
+    Returns the counters as a JSON object. fileName is included if not empty.
+  */
+  OdAnsiString toJson(const OdString& fileName = OdString::kEmpty) const;
+
+  /** \details
+    Enables collecting counters for files created by RxSystemServicesImpl.
+  */
+  static void setEnabled(bool bEnable);
+  static bool isEnabled();
+
+  /** \details
+    Sets the file to which closed streams append their counters, one JSON object
+    per line. An empty name disables dumping.
+  */
+  static void setDumpFile(const OdString& fileName);
+
+  /** \details
+    Returns the sum of the counters of all streams closed so far.
+  */
+  static OdFileBufStats total();
+  static void resetTotal();
+
+  /** \details
+    Adds counters of a closed stream to the totals and dumps them.
+  */
+  static void commit(OdFileBufStats& stats, const OdString& fileName);
+};
+
+/** \details
+  This interface gives direct read-only access to the data of a stream at its
+  current position, so bulk parsers can decode without copying into their own
+  buffers. Obtain it with dynamic_cast from an OdStreamBuf pointer.
+
+  <group Other_Classes>
+*/
+class OdStreamBufWindow
+{
+public:
+  /** \details
+    Returns a pointer to at least numBytes contiguous bytes starting at the current
+    position, or NULL if fewer than numBytes bytes remain in the stream.
+    \param numBytes [in]  Minimal number of bytes the window must hold.
+    \param pAvailable [out]  Receives the number of bytes available through the returned pointer.
+    \remarks
+    The current position is not changed. The data stays valid until the next call
+    to any method of the stream other than advanceWindow() within the window.
+  */
+  virtual const OdUInt8* getWindow(OdUInt32 numBytes, OdUInt32* pAvailable = NULL) = 0;
+
+  /** \details
+    Moves the current position numBytes forward past data read through the window.
+  */
+  virtual void advanceWindow(OdUInt32 numBytes) = 0;
+
+  /** \details
+    Frees memory held for windows that could not be served in place.
+  */
+  virtual void releaseWindow() = 0;
+
+protected:
+  virtual ~OdStreamBufWindow() {}
+};
 
 #if defined(ODA_WINDOWS) && !defined(_WINRT)
 
@@ -74,6 +173,7 @@ protected:
   int       m_iFileShare;
   bool      m_bFileWritten;
   Oda::FileAccessMode m_accessMode;
+  OdFileBufStats* m_pStats;
 
   OdBaseFileBuf()
   {
@@ -82,7 +182,15 @@ protected:
     m_bFileWritten = false;
     m_bError = false;
     m_accessMode = (Oda::FileAccessMode)0;
+    m_pStats = NULL;
   }
+  virtual ~OdBaseFileBuf() { delete m_pStats; }
+
+  /*!DOM*/
+  void writeBytes(const void* buffer, OdUInt32 numBytes);
+
+  /*!DOM*/
+  const OdUInt8* copyWindow(OdUInt32 numBytes, OdUInt8*& pBuf, OdUInt32& bufSize);
 
 public:
   //ODRX_DECLARE_MEMBERS(OdBaseFileBuf);
@@ -207,6 +315,15 @@ public:
 */
  virtual OdUInt32 getAccessMode() const;
 
+  /** \details
+    Starts or stops collecting I/O counters for this stream (see OdFileBufStats).
+  */
+  void enableStats(bool bEnable = true);
+
+  /** \details
+    Returns the I/O counters of this stream, or NULL if they are not collected.
+  */
+  const OdFileBufStats* stats() const { return m_pStats; }
 };
 
 class OdRdFileBuf;
@@ -222,7 +339,7 @@ typedef OdSmartPtr<OdRdFileBuf> OdRdFileBufPtr;
   Source code provided.
   <group ExServices_Classes>
 */
-class OdRdFileBuf : public OdBaseFileBuf
+class OdRdFileBuf : public OdBaseFileBuf, public OdStreamBufWindow
 {
   OdRdFileBuf(const OdRdFileBuf& source);
   OdRdFileBuf& operator = (const OdRdFileBuf& source);
@@ -232,6 +349,8 @@ protected:
   LPVOID      m_pFileMap;
   ULARGE_INTEGER  m_ulSize;
   ULARGE_INTEGER  m_ulPos;
+  OdUInt8*        m_pWindowBuf;
+  OdUInt32        m_WindowBufSize;
 
   /*!DOM*/
   inline bool memBufferUsed() const { return m_pFileMap != 0; }
@@ -245,6 +364,8 @@ public:
     m_pFileMap = NULL;
     m_ulSize.QuadPart = 0;
     m_ulPos.QuadPart = 0;
+    m_pWindowBuf = NULL;
+    m_WindowBufSize = 0;
 
     open(filename);
   }
@@ -267,6 +388,8 @@ public:
     m_pFileMap = NULL;
     m_ulSize.QuadPart = 0;
     m_ulPos.QuadPart = 0;
+    m_pWindowBuf = NULL;
+    m_WindowBufSize = 0;
 
     open(filename, shareMode, accessMode, creationDisposition);
   }
@@ -320,6 +443,10 @@ public:
   virtual void truncate();
 
   virtual void copyDataTo(OdStreamBuf* pDestination, OdUInt64 sourceStart, OdUInt64 sourceEnd);
+
+  virtual const OdUInt8* getWindow(OdUInt32 numBytes, OdUInt32* pAvailable = NULL);
+  virtual void advanceWindow(OdUInt32 numBytes);
+  virtual void releaseWindow();
 };
 
 #define WRITING_BUFFER_LENGTH 1024*8
@@ -350,7 +477,7 @@ class OdWrFileBuf : public OdBaseFileBuf
   {
     if ( m_nBufferedSize == 0 )
       return;
-    OdBaseFileBuf::putBytes(m_pBuffer, m_nBufferedSize);
+    writeBytes(m_pBuffer, m_nBufferedSize);
     m_nBufferedSize = 0;
   }
 
@@ -434,6 +561,7 @@ public:
 
 #include <stdio.h>
 #include <memory>
+#include <map>
 #include "OdString.h"
 #include "RxObjectImpl.h"
 #include "OdStreamBuf.h"
@@ -476,7 +604,7 @@ public:
   //ODRX_DECLARE_MEMBERS(OdBaseFileBuf);
 
           OdBaseFileBuf();
-  virtual ~OdBaseFileBuf(){ close(); };
+  virtual ~OdBaseFileBuf(){ close(); delete m_pStats; };
 
   virtual void      open(
     const OdString& filename,
@@ -498,12 +626,47 @@ public:
          virtual OdUInt64  seek(OdInt64 offset, OdDb::FilerSeekType seekType);
          virtual void      truncate();
 
+  /** \details
+    Copies the specified bytes from this StreamBuf object to the specified StreamBuf object.
+    \param pDestination [in]  Pointer to the StreamBuf object to receive the data.
+    \param sourceStart [in]  Starting position of the file pointer of this StreamBuf object.
+    \param sourceEnd [in]  Ending position of the file pointer of this StreamBuf object.
+    \remarks
+    If pDestination is a file opened for writing, the data is copied by the kernel
+    (copy_file_range or sendfile) where available. Otherwise it is streamed
+    through a buffer of limited size.
+  */
+         virtual void      copyDataTo(OdStreamBuf* pDestination, OdUInt64 sourceStart, OdUInt64 sourceEnd);
+
 /** \details
  Returns the access mode for this file object.
 */
          virtual OdUInt32 getAccessMode() const;
 
+  /** \details
+    Starts or stops collecting I/O counters for this stream (see OdFileBufStats).
+  */
+  void enableStats(bool bEnable = true);
+
+  /** \details
+    Returns the I/O counters of this stream, or NULL if they are not collected.
+  */
+  const OdFileBufStats* stats() const { return m_pStats; }
+
 protected:
+  /** \details
+    Returns the descriptor positional reads of this file can use, or -1.
+  */
+  virtual int fileDescriptor() const { return m_fp ? fileno(m_fp) : -1; }
+
+  /** \details
+    Writes all buffered data to the file.
+  */
+  virtual void flush() { if (m_fp) fflush(m_fp); }
+
+  /*!DOM*/
+  const OdUInt8* copyWindow(OdUInt32 numBytes, OdUInt8*& pBuf, OdUInt32& bufSize);
+
   std::unique_ptr<FileToRemoveOnClose> m_pFtr;
   Oda::FileAccessMode m_accessMode;
   FILE *              m_fp;
@@ -512,6 +675,7 @@ protected:
   OdUInt64            m_position;
   Oda::FileShareMode  m_shMode;
   bool                m_prevWasRead;
+  OdFileBufStats*     m_pStats;
 
   void Unlink(const char* fileName){ m_pFtr->setFileName(fileName); }
 };
@@ -519,6 +683,21 @@ protected:
 class OdWrFileBuf;
 typedef OdSmartPtr<OdWrFileBuf> OdWrFileBufPtr;
 
+#define WRFILEBUF_BUFFER_SIZE 4194304 /* default size limit of the write-behind buffer */
+#define WRFILEBUF_INITIAL_SIZE 65536  /* first allocation of the write-behind buffer */
+#define WRFILEBUF_ALIGNMENT   4096    /* alignment of the buffer and of O_DIRECT writes */
+
+/** \details
+  This class implements file output.
+  \remarks
+  Data is collected in an aligned write-behind buffer as segments, each holding
+  bytes for a contiguous range of the file. Writing at the end of the last
+  segment extends it, and writing inside a segment (patching a value written
+  before) updates the buffer, so seeking does not flush. Segments are written
+  in file order with pwritev(), adjacent ones in one call.
+  The buffer is allocated at the first write and doubled as data is added,
+  up to WriteOptions::m_bufferSize, so small files use a small buffer.
+*/
 class OdWrFileBuf : public OdBaseFileBuf
 {
 public:
@@ -526,14 +705,37 @@ public:
   OdWrFileBuf& operator = (const OdWrFileBuf& source) = delete;
   //ODRX_DECLARE_MEMBERS(OdWrFileBuf);
 
-  OdWrFileBuf(const OdString& filename) { open(filename); }
-  OdWrFileBuf(const OdString& filename, Oda::FileShareMode shareMode) { open(filename, shareMode); }
+  /** \details
+    Parameters of the write-behind buffer.
+  */
+  struct WriteOptions
+  {
+    OdUInt32 m_bufferSize;  /* size limit of the write-behind buffer, rounded up to WRFILEBUF_ALIGNMENT */
+    bool     m_bDirectIO;   /* write aligned parts of the data with O_DIRECT, bypassing the page cache */
+  };
+
+  /** \details
+    Sets the write-behind buffer parameters used by files opened after this call.
+  */
+  static void setDefaultWriteOptions(const WriteOptions& options);
+  static WriteOptions defaultWriteOptions();
+
+  /** \details
+    Sets the write-behind buffer parameters of this object.
+    \remarks
+    New parameters take effect at the next open() call.
+  */
+  void setWriteOptions(const WriteOptions& options);
+
+  OdWrFileBuf(const OdString& filename) { init(); open(filename); }
+  OdWrFileBuf(const OdString& filename, Oda::FileShareMode shareMode) { init(); open(filename, shareMode); }
   OdWrFileBuf(const OdString& filename, Oda::FileShareMode shareMode, Oda::FileAccessMode accessMode, Oda::FileCreationDisposition creationDisposition) 
   { 
+    init();
     open(filename, shareMode, accessMode, creationDisposition); 
   }
-  OdWrFileBuf(){};
-  ~OdWrFileBuf(){ close(); };
+  OdWrFileBuf() { init(); }
+  ~OdWrFileBuf();
 
   static OdWrFileBufPtr createObject()
   {
@@ -548,15 +750,55 @@ public:
     Oda::FileShareMode shareMode = Oda::kShareDenyNo,
     Oda::FileAccessMode accessMode = Oda::kFileWrite,
     Oda::FileCreationDisposition creationDisposition = Oda::kCreateAlways);
+
+  virtual void      close();
+  virtual OdUInt64  seek(OdInt64 offset, OdDb::FilerSeekType seekType);
+  virtual OdUInt8   getByte();
+  virtual void      getBytes(void* buffer, OdUInt32 numBytes);
+  virtual void      putByte(OdUInt8 value);
+  virtual void      putBytes(const void* buffer, OdUInt32 numBytes);
+  virtual void      truncate();
+  virtual void      copyDataTo(OdStreamBuf* pDestination, OdUInt64 sourceStart, OdUInt64 sourceEnd);
+
+protected:
+  struct Segment
+  {
+    OdUInt32 m_bufOffset;   /* position of the data in m_pBuffer */
+    OdUInt32 m_size;
+  };
+  typedef std::map<OdUInt64, Segment> SegmentMap;  /* keyed by file offset */
+
+  OdUInt8*     m_pBuffer;
+  OdUInt32     m_BufSize;
+  OdUInt32     m_BufUsed;
+  SegmentMap   m_Segments;
+  SegmentMap::iterator m_pLast;  /* segment written last, extended by sequential writes */
+  int          m_DirectFd;       /* descriptor opened with O_DIRECT or -1 */
+  WriteOptions m_Options;
+
+  void init();
+  virtual void flush();
+  bool growBuffer(OdUInt64 nRequired);
+  void addSegment(OdUInt64 pos, const OdUInt8* pData, OdUInt32 numBytes);
+  void bufferBytes(const OdUInt8* pData, OdUInt32 numBytes);
+  void readBytes(void* buffer, OdUInt32 numBytes);
+  void writeAt(OdUInt64 pos, const OdUInt8* pData, OdUInt32 numBytes, bool bDirect);
 };
 
 
-#define NUM_BUFFERS 8
+#define NUM_BUFFERS 32            /* default number of cached read blocks */
+#define RDFILEBUF_BLOCK_SIZE 32768 /* default size of a cached read block */
+#define RDFILEBUF_READ_AHEAD 4     /* default number of blocks prefetched on sequential reads */
+
+// Read-ahead needs positional reads and a worker thread
+#if defined(OD_HAVE_UNISTD_FILE) && !defined(EMCC) && !defined(OD_RDFILEBUF_NO_READAHEAD)
+#define OD_RDFILEBUF_READAHEAD
+#endif
 
 class OdRdFileBuf;
 typedef OdSmartPtr<OdRdFileBuf> OdRdFileBufPtr;
 
-class OdRdFileBuf : public OdBaseFileBuf
+class OdRdFileBuf : public OdBaseFileBuf, public OdStreamBufWindow
 {
   OdRdFileBuf(const OdRdFileBuf&);
   OdRdFileBuf& operator = (const OdRdFileBuf&);
@@ -564,13 +806,23 @@ class OdRdFileBuf : public OdBaseFileBuf
 public:
   //ODRX_DECLARE_MEMBERS(OdRdFileBuf);
 
-  OdRdFileBuf(const OdString& filename) : m_Counter(0L) { init(); open(filename); }
-  OdRdFileBuf(const OdString& filename, Oda::FileShareMode shareMode) : m_Counter(0L)
+  /** \details
+    Block cache parameters of OdRdFileBuf objects.
+  */
+  struct CacheOptions
+  {
+    OdUInt32 m_blockSize;       // size of each cached block in bytes (rounded up to a power of two)
+    OdUInt32 m_numBlocks;       // maximum number of blocks held by the cache
+    OdUInt32 m_readAheadBlocks; // blocks prefetched once sequential reading is detected, 0 disables read-ahead
+  };
+
+  OdRdFileBuf(const OdString& filename) { init(); open(filename); }
+  OdRdFileBuf(const OdString& filename, Oda::FileShareMode shareMode)
   {
     init();
     open(filename, shareMode);
   }
-  OdRdFileBuf(const OdString& filename, Oda::FileShareMode shareMode, Oda::FileAccessMode accessMode, Oda::FileCreationDisposition creationDisposition) : m_Counter(0L)
+  OdRdFileBuf(const OdString& filename, Oda::FileShareMode shareMode, Oda::FileAccessMode accessMode, Oda::FileCreationDisposition creationDisposition)
   {
     init();
     open(filename, shareMode, accessMode, creationDisposition);
@@ -586,6 +838,25 @@ public:
   }
   ~OdRdFileBuf(){ close(); };
 
+  /** \details
+    Sets the block cache parameters used by OdRdFileBuf objects created afterwards.
+    \param options [in]  Cache parameters.
+  */
+  static void setDefaultCacheOptions(const CacheOptions& options);
+
+  /** \details
+    Returns the block cache parameters used by newly created OdRdFileBuf objects.
+  */
+  static CacheOptions defaultCacheOptions();
+
+  /** \details
+    Sets the block cache parameters of this StreamBuf object.
+    \param options [in]  Cache parameters.
+    \remarks
+    New parameters take effect at the next open() call.
+  */
+  void setCacheOptions(const CacheOptions& options);
+
   virtual void open(
     const OdString& filename,
     Oda::FileShareMode shareMode = Oda::kShareDenyNo,
@@ -603,33 +874,122 @@ public:
   virtual void      putBytes(const void* buffer, OdUInt32 numBytes) { ODA_FAIL();  throw OdError(eNotApplicable); };
   virtual void      truncate();
 
+  virtual const OdUInt8* getWindow(OdUInt32 numBytes, OdUInt32* pAvailable = NULL);
+  virtual void advanceWindow(OdUInt32 numBytes);
+  virtual void releaseWindow();
+
 protected:
-  struct blockstru
-  {
-    OdUInt8*  buf;        /* this buffer */
-    OdUInt64  startaddr;  /* address from which it came in the file */
-    int       validbytes; /* number of valid bytes it holds */
-    OdInt32   counter;    /* least recently used counter */
-  };
+  struct BlockCache;       /* hashed CLOCK cache of file blocks, see OdFileBuf.cpp */
 
-  OdUInt64  m_PhysFilePos; /* where the file pointer is */
   OdUInt64  m_BufPos;      /* position from which buf was filled */
   int       m_BytesLeft;   /* bytes left in buf */
   int       m_BufBytes;    /* valid bytes read into buffer */
   OdUInt8*  m_pNextChar;   /* pointer to next char in buffer */
   OdUInt8*  m_pCurBuf;     /* pointer to the buffer currently being used */
   int       m_UsingBlock;  /* which block is currently in use */
-  struct blockstru         /* the data being held */
-            m_DataBlock[NUM_BUFFERS];
-
-  static const int m_BufSize; /* size of each read buffer */
-  static const int m_PosMask; /* mask to allow position check */
-  OdInt32    m_Counter;
+  BlockCache* m_pCache;    /* the data being held */
+  CacheOptions m_Options;  /* cache parameters applied at open() */
+  OdUInt64  m_PosMask;     /* mask to allow position check */
+  OdUInt8*  m_pWindowBuf;  /* copy of data for windows crossing blocks */
+  OdUInt32  m_WindowBufSize;
 
   bool filbuf();
+  bool nextBlock();        /* moves to the block following the one in use, false at end of file */
   void init();
 };
 
+#if defined(OD_HAVE_UNISTD_FILE)
+
+#define SHAREDFILEBUF_BLOCK_SIZE 65536 /* default size of a shared cache block */
+#define SHAREDFILEBUF_NUM_BLOCKS 256   /* default number of blocks in the shared cache */
+
+class OdRdSharedFileBuf;
+typedef OdSmartPtr<OdRdSharedFileBuf> OdRdSharedFileBufPtr;
+
+/** \details
+  This class implements file input for concurrent readers.
+  \remarks
+  Data is read with pread() at explicit offsets, so no file position is shared.
+  clone() returns a new stream over the same file descriptor with its own position.
+  All clones share one cache of immutable blocks, and each stream keeps a reference
+  to the block it is reading from. A stream object must be used by one thread
+  at a time; other threads should work with their own clones.
+*/
+class OdRdSharedFileBuf : public OdBaseFileBuf, public OdStreamBufWindow
+{
+public:
+  OdRdSharedFileBuf(const OdRdSharedFileBuf&) = delete;
+  OdRdSharedFileBuf& operator = (const OdRdSharedFileBuf&) = delete;
+
+  OdRdSharedFileBuf();
+  ~OdRdSharedFileBuf(){ close(); };
+
+  static OdRdSharedFileBufPtr createObject()
+  {
+    return OdRdSharedFileBufPtr(new OdRdSharedFileBuf(), kOdRxObjAttach);
+  }
+  static OdRdSharedFileBufPtr createObject(const OdString& filename, Oda::FileShareMode shareMode = Oda::kShareDenyNo)
+  {
+    OdRdSharedFileBufPtr pRes = createObject();
+    pRes->open(filename, shareMode);
+    return pRes;
+  }
+
+  /** \details
+    Sets the parameters of the block cache shared by this stream and its clones.
+    \param options [in]  Cache parameters.
+    \remarks
+    New parameters take effect at the next open() call. Read-ahead is not used.
+  */
+  void setCacheOptions(const OdRdFileBuf::CacheOptions& options);
+
+  virtual void open(
+    const OdString& filename,
+    Oda::FileShareMode shareMode = Oda::kShareDenyNo,
+    Oda::FileAccessMode accessMode = Oda::kFileRead,
+    Oda::FileCreationDisposition creationDisposition = Oda::kOpenExisting);
+
+  virtual void close();
+
+  /** \details
+    Returns a new stream over the same file, positioned where this stream is.
+    \remarks
+    The clone shares the file descriptor and the block cache with this stream.
+  */
+  virtual OdRxObjectPtr clone() const;
+
+  virtual OdUInt64  seek(OdInt64 offset, OdDb::FilerSeekType seekType);
+  virtual OdUInt8   getByte();
+  virtual void      getBytes(void* buffer, OdUInt32 numBytes);
+  virtual void      putByte(OdUInt8 value) { ODA_FAIL();  throw OdError(eNotApplicable); };
+  virtual void      putBytes(const void* buffer, OdUInt32 numBytes) { ODA_FAIL();  throw OdError(eNotApplicable); };
+  virtual void      truncate() { ODA_FAIL();  throw OdError(eNotApplicable); };
+
+  virtual const OdUInt8* getWindow(OdUInt32 numBytes, OdUInt32* pAvailable = NULL);
+  virtual void advanceWindow(OdUInt32 numBytes);
+  virtual void releaseWindow();
+
+protected:
+  struct SharedFile;       /* descriptor and block cache shared by clones, see OdFileBuf.cpp */
+  struct Block;            /* immutable cached part of the file */
+
+  std::shared_ptr<SharedFile>  m_pShared;
+  std::shared_ptr<const Block> m_pBlock;      /* block the stream is reading from */
+  const OdUInt8*               m_pBlockData;
+  OdUInt64                     m_BlockStart;
+  OdUInt32                     m_BlockBytes;
+  OdRdFileBuf::CacheOptions    m_Options;
+  OdUInt8*                     m_pWindowBuf;  /* copy of data for windows crossing blocks */
+  OdUInt32                     m_WindowBufSize;
+
+  virtual int fileDescriptor() const;
+
+  void setBlock(const std::shared_ptr<const Block>& pBlock);
+  bool loadBlock();
+};
+
+#endif // OD_HAVE_UNISTD_FILE
+
 #endif // #ifdef WIN32
 #include "TD_PackPop.h"
 #endif // ODFILEBUF_DEFINED
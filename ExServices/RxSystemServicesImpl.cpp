@@ -75,7 +75,12 @@
 #endif
 
 #define STL_USING_ALGORITHM
+#define STL_USING_MAP
+#define STL_USING_LIST
 #include "OdaSTL.h"
+#include "OdMutex.h"
+#include <memory>
+#include <chrono>
 #include "DynamicLinker.h"
 #include "Ed/EdCommandContext.h"
 #include "Ed/EdUserIO.h"
@@ -202,12 +207,451 @@ RxSystemServicesImpl::RxSystemServicesImpl()
 }
 
 
+template <class TChar>
+inline bool isRxFSPath(const TChar* s) { if (*s == '\0') return false; return (s[2]==':' && s[0]=='r' && s[1]=='x'); }
+
+struct OdString_Access : OdString {
+  inline static bool isConvertedToWide(const OdString& ws) { return !((OdString_Access&)ws).isUnicodeNotInSync(); }
+};
+
+inline bool isRxFSPath(const OdString& path) {
+  if(OdString_Access::isConvertedToWide(path))
+    return isRxFSPath<OdChar>(path);
+  return isRxFSPath<char>(path);
+}
+
+//----------------------------------------------------------
+//
+// Support file cache
+//
+//----------------------------------------------------------
+
+namespace
+{
+  // Returns the lower case extension of a file name, or an empty string.
+  OdString fileType(const OdString& path)
+  {
+    int nDot = path.reverseFind(L'.');
+    if (nDot < 0 || path.find(L'/', nDot) >= 0 || path.find(L'\\', nDot) >= 0)
+      return OdString::kEmpty;
+    OdString sExt = path.mid(nDot + 1);
+    sExt.makeLower();
+    return sExt;
+  }
+
+  // Converts a ';'-separated extension list to the form searched by hasFileType().
+  OdString fileTypeList(const OdString& fileTypes)
+  {
+    OdString res = L";" + fileTypes + L";";
+    res.remove(L' ');
+    res.remove(L'.');
+    res.makeLower();
+    return res;
+  }
+
+  bool hasFileType(const OdString& typeList, const OdString& path)
+  {
+    OdString sExt = fileType(path);
+    return !sExt.isEmpty() && typeList.find(L";" + sExt + L";") >= 0;
+  }
+
+  // Contents of a cached file. Streams keep it alive after it is evicted.
+  struct CachedFile
+  {
+    OdString  m_path;
+    OdInt64   m_mtime;
+    OdInt64   m_size;
+    OdUInt8*  m_pData;
+
+    CachedFile() : m_mtime(0), m_size(0), m_pData(NULL) {}
+    ~CachedFile() { ::odrxFree(m_pData); }
+  };
+  typedef std::shared_ptr<const CachedFile> CachedFilePtr;
+
+  // Read-only stream over cached file contents.
+  class CachedFileStream : public OdFlatMemStreamImpl<OdStreamBuf>
+  {
+    CachedFilePtr m_pFile;
+  public:
+    void init(const CachedFilePtr& pFile)
+    {
+      m_pFile = pFile;
+      OdFlatMemStreamImpl<OdStreamBuf>::init(pFile->m_pData, (OdUInt64)pFile->m_size);
+    }
+    OdString fileName() { return m_pFile->m_path; }
+    void putByte(OdUInt8) { throw OdError(eNotOpenForWrite); }
+    void putBytes(const void*, OdUInt32) { throw OdError(eNotOpenForWrite); }
+    void truncate() { throw OdError(eNotOpenForWrite); }
+  };
+
+  // Returns the modification time and size of a regular file.
+  bool statFile(const OdString& path, OdInt64& mtime, OdInt64& size)
+  {
+#if defined(ODA_WINDOWS)
+    struct _stat64 st;
+    if (_wstati64(path.c_str(), &st) != 0 || (st.st_mode & _S_IFDIR))
+      return false;
+    mtime = st.st_mtime;
+    size = st.st_size;
+#elif defined(OD_HAVE_SYS_STAT_FILE) || defined(__linux__)
+#ifdef OD_CONVERT_UNICODETOUTF8
+    OdAnsiString nAnsiUtf8(path, CP_UTF_8);
+    const char* fName = nAnsiUtf8.c_str();
+#else
+    const char* fName = (const char*)path;
+#endif
+    struct stat st;
+    if (stat(fName, &st) != 0 || !S_ISREG(st.st_mode))
+      return false;
+#if defined(__linux__)
+    mtime = OdInt64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    mtime = st.st_mtime;
+#endif
+    size = st.st_size;
+#else
+    return false;
+#endif
+    return true;
+  }
+
+  class SupportFileCache
+  {
+    typedef std::list<CachedFilePtr> FileList;
+
+    // accessFile() results by access mode and file size of one path
+    struct Attributes
+    {
+      std::chrono::steady_clock::time_point m_time;
+      signed char m_access[4];  // -1 if not known yet
+      OdInt64     m_size;       // -2 if not known yet
+    };
+    typedef std::map<OdString, Attributes> AttributeMap;
+
+    OdMutex      m_mutex;
+    RxSystemServicesImpl::FileCacheOptions m_options;
+    OdString     m_fileTypes;   // lower case, enclosed in ';'
+    FileList     m_lru;         // most recently used first
+    std::map<OdString, FileList::iterator> m_files;
+    OdUInt64     m_bytes;
+    AttributeMap m_attributes;
+
+    static OdString key(const OdString& path)
+    {
+      OdString res(path);
+#if defined(ODA_WINDOWS)
+      res.makeLower();
+#endif
+      return res;
+    }
+
+    static int accessIndex(int mode)
+    {
+      return (GETBIT(mode, Oda::kFileRead) ? 1 : 0) | (GETBIT(mode, Oda::kFileWrite) ? 2 : 0);
+    }
+
+    Attributes* attributes(const OdString& path)
+    {
+      if (!m_options.m_attrTimeout)
+        return NULL;
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      AttributeMap::iterator it = m_attributes.find(key(path));
+      if (it == m_attributes.end())
+      {
+        if (m_attributes.size() >= 4096)
+          m_attributes.clear();
+        it = m_attributes.insert(AttributeMap::value_type(key(path), Attributes())).first;
+      }
+      else if (now - it->second.m_time < std::chrono::milliseconds(m_options.m_attrTimeout))
+      {
+        return &it->second;
+      }
+      Attributes& attr = it->second;
+      attr.m_time = now;
+      attr.m_access[0] = attr.m_access[1] = attr.m_access[2] = attr.m_access[3] = -1;
+      attr.m_size = -2;
+      return &attr;
+    }
+
+    void evict()
+    {
+      while (m_bytes > m_options.m_maxBytes && !m_lru.empty())
+      {
+        const CachedFilePtr& pFile = m_lru.back();
+        m_bytes -= (OdUInt64)pFile->m_size;
+        m_files.erase(key(pFile->m_path));
+        m_lru.pop_back();
+      }
+    }
+
+  public:
+    SupportFileCache()
+      : m_bytes(0)
+    {
+      RxSystemServicesImpl::FileCacheOptions options;
+      options.m_maxBytes = RXSYSTEMSERVICES_FILECACHE_SIZE;
+      options.m_maxFileSize = RXSYSTEMSERVICES_FILECACHE_MAX_FILE;
+      options.m_attrTimeout = RXSYSTEMSERVICES_FILECACHE_TIMEOUT;
+      options.m_fileTypes = RXSYSTEMSERVICES_FILECACHE_TYPES;
+      setOptions(options);
+    }
+
+    void setOptions(const RxSystemServicesImpl::FileCacheOptions& options)
+    {
+      TD_AUTOLOCK(m_mutex);
+      m_options = options;
+      m_fileTypes = fileTypeList(options.m_fileTypes);
+      m_attributes.clear();
+      evict();
+    }
+
+    RxSystemServicesImpl::FileCacheOptions options()
+    {
+      TD_AUTOLOCK(m_mutex);
+      return m_options;
+    }
+
+    void clear()
+    {
+      TD_AUTOLOCK(m_mutex);
+      m_lru.clear();
+      m_files.clear();
+      m_bytes = 0;
+      m_attributes.clear();
+    }
+
+    // Returns true if the contents of the file may be cached.
+    bool isCacheable(const OdString& path)
+    {
+      if (isRxFSPath(path))
+        return false;
+      TD_AUTOLOCK(m_mutex);
+      return m_options.m_maxBytes && hasFileType(m_fileTypes, path);
+    }
+
+    // Returns a stream over the cached contents, or NULL if the file is not cached
+    // or has changed. mtime and size receive the current file attributes.
+    OdStreamBufPtr open(const OdString& path, OdInt64& mtime, OdInt64& size)
+    {
+      if (!statFile(path, mtime, size))
+        return OdStreamBufPtr();
+      CachedFilePtr pFile;
+      {
+        TD_AUTOLOCK(m_mutex);
+        std::map<OdString, FileList::iterator>::iterator it = m_files.find(key(path));
+        if (it == m_files.end())
+          return OdStreamBufPtr();
+        pFile = *it->second;
+        if (pFile->m_mtime != mtime || pFile->m_size != size)
+        {
+          m_bytes -= (OdUInt64)pFile->m_size;
+          m_lru.erase(it->second);
+          m_files.erase(it);
+          return OdStreamBufPtr();
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+      }
+      OdSmartPtr<CachedFileStream> pStream = OdRxObjectImpl<CachedFileStream>::createObject();
+      pStream->init(pFile);
+      return OdStreamBufPtr(pStream);
+    }
+
+    // Reads an opened file into the cache. Returns a stream over the cached
+    // contents, or NULL if the file is not to be cached.
+    OdStreamBufPtr add(OdStreamBuf* pSource, const OdString& path, OdInt64 mtime, OdInt64 size)
+    {
+      {
+        TD_AUTOLOCK(m_mutex);
+        if (size < 0 || (OdUInt64)size > m_options.m_maxFileSize || (OdUInt64)size > m_options.m_maxBytes)
+          return OdStreamBufPtr();
+      }
+      if (pSource->length() != (OdUInt64)size)
+        return OdStreamBufPtr();   // changed since stat
+
+      std::shared_ptr<CachedFile> pFile = std::make_shared<CachedFile>();
+      pFile->m_path = path;
+      pFile->m_mtime = mtime;
+      pFile->m_size = size;
+      pFile->m_pData = (OdUInt8*)::odrxAlloc(size ? (size_t)size : 1);
+      if (!pFile->m_pData)
+        return OdStreamBufPtr();
+      OdUInt64 nPos = pSource->tell();
+      pSource->seek(0, OdDb::kSeekFromStart);
+      for (OdUInt64 nDone = 0; nDone < (OdUInt64)size; )
+      {
+        OdUInt32 n = (OdUInt32)odmin((OdUInt64)size - nDone, OdUInt64(0x40000000));
+        pSource->getBytes(pFile->m_pData + nDone, n);
+        nDone += n;
+      }
+      pSource->seek(nPos, OdDb::kSeekFromStart);
+
+      {
+        TD_AUTOLOCK(m_mutex);
+        OdString sKey = key(path);
+        std::map<OdString, FileList::iterator>::iterator it = m_files.find(sKey);
+        if (it != m_files.end())
+        {
+          m_bytes -= (OdUInt64)(*it->second)->m_size;
+          m_lru.erase(it->second);
+          m_files.erase(it);
+        }
+        m_lru.push_front(pFile);
+        m_files[sKey] = m_lru.begin();
+        m_bytes += (OdUInt64)size;
+        evict();
+      }
+      OdSmartPtr<CachedFileStream> pStream = OdRxObjectImpl<CachedFileStream>::createObject();
+      pStream->init(pFile);
+      return OdStreamBufPtr(pStream);
+    }
+
+    // Forgets everything known about a file that is about to be modified.
+    void invalidate(const OdString& path)
+    {
+      TD_AUTOLOCK(m_mutex);
+      OdString sKey = key(path);
+      std::map<OdString, FileList::iterator>::iterator it = m_files.find(sKey);
+      if (it != m_files.end())
+      {
+        m_bytes -= (OdUInt64)(*it->second)->m_size;
+        m_lru.erase(it->second);
+        m_files.erase(it);
+      }
+      m_attributes.erase(sKey);
+    }
+
+    // Returns 1 or 0 if the accessFile() result is known, -1 otherwise.
+    int access(const OdString& path, int mode)
+    {
+      TD_AUTOLOCK(m_mutex);
+      Attributes* pAttr = attributes(path);
+      return pAttr ? pAttr->m_access[accessIndex(mode)] : -1;
+    }
+
+    // Failures are not remembered: a file created meanwhile must be found at once
+    void setAccess(const OdString& path, int mode, bool bRes)
+    {
+      if (!bRes)
+        return;
+      TD_AUTOLOCK(m_mutex);
+      if (Attributes* pAttr = attributes(path))
+        pAttr->m_access[accessIndex(mode)] = bRes ? 1 : 0;
+    }
+
+    // Returns true if the getFileSize() result is known.
+    bool size(const OdString& path, OdInt64& size)
+    {
+      TD_AUTOLOCK(m_mutex);
+      Attributes* pAttr = attributes(path);
+      if (!pAttr || pAttr->m_size == -2)
+        return false;
+      size = pAttr->m_size;
+      return true;
+    }
+
+    void setSize(const OdString& path, OdInt64 size)
+    {
+      if (size < 0)
+        return;
+      TD_AUTOLOCK(m_mutex);
+      if (Attributes* pAttr = attributes(path))
+        pAttr->m_size = size;
+    }
+  };
+
+  SupportFileCache& fileCache()
+  {
+    static SupportFileCache s_fileCache;
+    return s_fileCache;
+  }
+
+  // Extensions of the files opened for concurrent readers
+  class SharedReadTypes
+  {
+    OdMutex  m_mutex;
+    OdString m_fileTypes;
+    OdString m_typeList;    // lower case, enclosed in ';'
+  public:
+    SharedReadTypes() { set(RXSYSTEMSERVICES_SHARED_READ_TYPES); }
+
+    void set(const OdString& fileTypes)
+    {
+      TD_AUTOLOCK(m_mutex);
+      m_fileTypes = fileTypes;
+      m_typeList = fileTypeList(fileTypes);
+    }
+
+    OdString get()
+    {
+      TD_AUTOLOCK(m_mutex);
+      return m_fileTypes;
+    }
+
+    bool contains(const OdString& path)
+    {
+      if (isRxFSPath(path))
+        return false;
+      TD_AUTOLOCK(m_mutex);
+      return hasFileType(m_typeList, path);
+    }
+  };
+
+  SharedReadTypes& sharedReadTypes()
+  {
+    static SharedReadTypes s_sharedReadTypes;
+    return s_sharedReadTypes;
+  }
+}
+
+void RxSystemServicesImpl::setFileCacheOptions(const FileCacheOptions& options)
+{
+  fileCache().setOptions(options);
+}
+
+RxSystemServicesImpl::FileCacheOptions RxSystemServicesImpl::fileCacheOptions()
+{
+  return fileCache().options();
+}
+
+void RxSystemServicesImpl::clearFileCache()
+{
+  fileCache().clear();
+}
+
+void RxSystemServicesImpl::setSharedReadFileTypes(const OdString& fileTypes)
+{
+  sharedReadTypes().set(fileTypes);
+}
+
+OdString RxSystemServicesImpl::sharedReadFileTypes()
+{
+  return sharedReadTypes().get();
+}
+
 OdStreamBufPtr RxSystemServicesImpl::createFile(
     const OdString& path,
     Oda::FileAccessMode access,
     Oda::FileShareMode share,
     Oda::FileCreationDisposition dispos)
 {
+  // support files opened for reading are served from memory
+  bool bCache = false;
+  OdInt64 mtime = 0, size = 0;
+  if ((access & Oda::kFileWrite) == 0)
+  {
+    if (dispos == Oda::kOpenExisting && fileCache().isCacheable(path))
+    {
+      OdStreamBufPtr pCached = fileCache().open(path, mtime, size);
+      if (!pCached.isNull())
+        return pCached;
+      bCache = size > 0;
+    }
+  }
+  else if (!path.isEmpty())
+  {
+    fileCache().invalidate(path);
+  }
+
   OdSmartPtr<OdBaseFileBuf> pFile = OdRxSystemServices::createFile(path, access, share, dispos);
   if(pFile.isNull()) {
     // MKU 19.02.2004   It was corrected after debugging with BORLANDC. It hangs on open() statement 
@@ -225,6 +669,12 @@ OdStreamBufPtr RxSystemServicesImpl::createFile(
       {
         pFile = OdWrFileBuf::createObject();
       }
+#if defined(OD_HAVE_UNISTD_FILE) && !defined(ODA_WINDOWS)
+      else if (sharedReadTypes().contains(path))
+      {
+        pFile = OdRdSharedFileBuf::createObject();
+      }
+#endif
       else
       {
         pFile = OdRdFileBuf::createObject();
@@ -236,6 +686,14 @@ OdStreamBufPtr RxSystemServicesImpl::createFile(
       throw OdError(eNoFileName);
     }
   }
+  if (bCache)
+  {
+    OdStreamBufPtr pCached = fileCache().add(pFile, path, mtime, size);
+    if (!pCached.isNull())
+      return pCached;
+  }
+  if (OdFileBufStats::isEnabled())
+    pFile->enableStats();
 #if  (defined(__linux__) || defined(EMCC))  && !defined(ANDROID)
   if (access == (Oda::kFileRead | Oda::kFileWrite))
     m_CodePageId = CP_UNDEFINED;
@@ -244,24 +702,22 @@ OdStreamBufPtr RxSystemServicesImpl::createFile(
 }
 
 
-template <class TChar>
-inline bool isRxFSPath(const TChar* s) { if (*s == '\0') return false; return (s[2]==':' && s[0]=='r' && s[1]=='x'); }
-
-struct OdString_Access : OdString {
-  inline static bool isConvertedToWide(const OdString& ws) { return !((OdString_Access&)ws).isUnicodeNotInSync(); }
-};
-
-inline bool isRxFSPath(const OdString& path) {
-  if(OdString_Access::isConvertedToWide(path))
-    return isRxFSPath<OdChar>(path);
-  return isRxFSPath<char>(path);
-}
-
 bool RxSystemServicesImpl::accessFile(const OdString& pcFilename, int mode)
 {
   if(isRxFSPath(pcFilename))
     return OdRxSystemServices::accessFile(pcFilename, mode);
 
+  int cached = fileCache().access(pcFilename, mode);
+  if (cached >= 0)
+    return cached != 0;
+  bool res = accessFileImpl(pcFilename, mode);
+  fileCache().setAccess(pcFilename, mode, res);
+  return res;
+}
+
+bool RxSystemServicesImpl::accessFileImpl(const OdString& pcFilename, int mode)
+{
+
 #if defined(ODA_WINDOWS) && !defined(OD_HAVE_GETFILEATTRIBUTES_FUNC)
   // SetErrorMode() function is used to avoid the message box
   // if there is no floppy disk in the floppy drive (CR 2122).
@@ -357,6 +813,17 @@ OdInt64 RxSystemServicesImpl::getFileMTime(const OdString&)
 #endif  // OD_HAVE_WSTAT_FUNC
 
 OdInt64 RxSystemServicesImpl::getFileSize(const OdString& name)
+{
+  OdInt64 size;
+  if (!fileCache().size(name, size))
+  {
+    size = getFileSizeImpl(name);
+    fileCache().setSize(name, size);
+  }
+  return size;
+}
+
+OdInt64 RxSystemServicesImpl::getFileSizeImpl(const OdString& name)
 {
 #ifdef OD_HAVE_FINDFIRSTFILE_FUNC
   WIN32_FIND_DATA fd;
@@ -28,6 +28,12 @@
 
 #include "RxSystemServices.h"
 
+#define RXSYSTEMSERVICES_FILECACHE_SIZE     268435456  /* default limit of cached support file data */
+#define RXSYSTEMSERVICES_FILECACHE_MAX_FILE 33554432   /* default size limit of a cached file */
+#define RXSYSTEMSERVICES_FILECACHE_TIMEOUT  5000       /* default lifetime of cached file attributes, ms */
+#define RXSYSTEMSERVICES_FILECACHE_TYPES    OD_T("shx;ttf;ttc;otf;pfb;pat;lin;shp")
+#define RXSYSTEMSERVICES_SHARED_READ_TYPES  OD_T("dwg")   /* default extensions of files opened for concurrent readers */
+
 /** \details
   This class implements platform-dependent file operations for Kernel API.
   <group ExServices_Classes> 
@@ -80,7 +86,59 @@ public:
   */
   virtual OdResult setEnvVar(const OdString &varName, const OdString &newValue);
 
+  /** \details
+    Parameters of the process-wide cache of read-only support files.
+  */
+  struct FileCacheOptions
+  {
+    OdUInt64 m_maxBytes;      // limit of cached file data, 0 disables caching of file contents
+    OdUInt64 m_maxFileSize;   // larger files are always read from disk
+    OdUInt32 m_attrTimeout;   // milliseconds successful accessFile() and getFileSize() results are reused, 0 disables
+    OdString m_fileTypes;     // ';'-separated extensions of cached files, e.g. "shx;ttf;dwg"
+  };
+
+  /** \details
+    Sets the parameters of the support file cache.
+    \param options [in]  Cache parameters.
+    \remarks
+    Files opened by createFile() for reading only whose extension is listed in
+    options.m_fileTypes are read into memory once and served from memory until
+    their modification time or size changes. Add "dwg" to cache xrefs.
+  */
+  static void setFileCacheOptions(const FileCacheOptions& options);
+
+  /** \details
+    Returns the parameters of the support file cache.
+  */
+  static FileCacheOptions fileCacheOptions();
+
+  /** \details
+    Drops all cached file contents and attributes.
+  */
+  static void clearFileCache();
+
+  /** \details
+    Sets the extensions of the files createFile() opens for concurrent readers.
+    \param fileTypes [in]  ';'-separated extensions, e.g. "dwg;dxf". An empty string disables it.
+    \remarks
+    Where positional reads are available, such files opened for reading only are
+    returned as OdRdSharedFileBuf streams. Threads that load or decode the drawing
+    in parallel clone() the stream and read with their own positions over one
+    shared block cache. Other platforms open these files as before.
+  */
+  static void setSharedReadFileTypes(const OdString& fileTypes);
+
+  /** \details
+    Returns the extensions of the files createFile() opens for concurrent readers.
+  */
+  static OdString sharedReadFileTypes();
+
 protected:
+  /*!DOM*/
+  bool accessFileImpl(const OdString& filename, int accessMode);
+  /*!DOM*/
+  OdInt64 getFileSizeImpl(const OdString& filename);
+
   OdCodePageId m_CodePageId;
 };
 
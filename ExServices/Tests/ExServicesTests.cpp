@@ -0,0 +1,266 @@
+/////////////////////////////////////////////////////////////////////////////// 
+// Copyright (C) 2002-2024, Open Design Alliance (the "Alliance"). 
+// All rights reserved. 
+// 
+// This software and its documentation and related materials are owned by 
+// the Alliance. The software may only be incorporated into application 
+// programs owned by members of the Alliance, subject to a signed 
+// Membership Agreement and Supplemental Software License Agreement with the
+// Alliance. The structure and organization of this software are the valuable  
+// trade secrets of the Alliance and its suppliers. The software is also 
+// protected by copyright law and international treaty provisions. Application  
+// programs incorporating this software must include the following statement 
+// with their copyright notices:
+//   
+//   This application incorporates Open Design Alliance software pursuant to a license 
+//   agreement with Open Design Alliance.
+//   Open Design Alliance Copyright (C) 2002-2024 by Open Design Alliance. 
+//   All rights reserved.
+//
+// By use of this software, its documentation or related materials, you 
+// acknowledge and accept the above terms.
+///////////////////////////////////////////////////////////////////////////////
+
+// Round-trip checks for ExLzCompressor, ExPageStore and ExUndoController.
+// Built as a console application with the ExServices sources and the Teigha
+// libraries; returns the number of failed checks. The optional argument is
+// the paging file path.
+
+#include "OdaCommon.h"
+#include "RxObjectImpl.h"
+#include "MemoryStream.h"
+#include "../ExLzCompressor.h"
+#include "../ExPageStore.h"
+#include "../ExUndoController.h"
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+static int s_nFailed = 0;
+
+#define EXTEST_CHECK(expr) \
+  do { if (!(expr)) { printf("%s(%d): %s\n", __FILE__, __LINE__, #expr); ++s_nFailed; } } while (0)
+
+typedef std::vector<OdUInt8> Bytes;
+
+// Random data of one of several kinds: noise, short runs, repeated phrases, one byte
+static Bytes makeData(std::mt19937& rng, OdUInt32 len, int kind)
+{
+  Bytes data(len);
+  for (OdUInt32 i = 0; i < len; ++i)
+  {
+    switch (kind)
+    {
+    case 0:  data[i] = (OdUInt8)rng(); break;
+    case 1:  data[i] = (i % 37) < 20 ? 0 : (OdUInt8)(rng() % 4); break;
+    case 2:  data[i] = (i >= 8 && rng() % 8) ? data[i - 1 - rng() % 8] : (OdUInt8)rng(); break;
+    default: data[i] = 'a'; break;
+    }
+  }
+  return data;
+}
+
+static void testLzCompressor()
+{
+  std::mt19937 rng(1);
+  const OdUInt32 lengths[] = { 1, 4, 12, 13, 255, 4096, 65535, 65536, 200000 };
+  for (int kind = 0; kind < 4; ++kind)
+  {
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+    {
+      OdUInt32 len = lengths[i];
+      Bytes data = makeData(rng, len, kind);
+      Bytes packed(ExLzCompressor::compressBound(len));
+      OdUInt32 packedLen = ExLzCompressor::compress(data.data(), len, packed.data(), (OdUInt32)packed.size());
+      EXTEST_CHECK(packedLen != 0);
+      if (!packedLen)
+        continue;
+
+      Bytes out(len + 1);
+      EXTEST_CHECK(ExLzCompressor::decompress(packed.data(), packedLen, out.data(), len));
+      EXTEST_CHECK(!memcmp(out.data(), data.data(), len));
+      // The length must match exactly
+      EXTEST_CHECK(!ExLzCompressor::decompress(packed.data(), packedLen, out.data(), len - 1));
+
+      // A destination that is too small gives 0 or a complete block
+      OdUInt32 capacity = len / 2;
+      Bytes small(capacity + 1);
+      OdUInt32 smallLen = ExLzCompressor::compress(data.data(), len, small.data(), capacity);
+      EXTEST_CHECK(smallLen <= capacity);
+      if (smallLen)
+      {
+        EXTEST_CHECK(ExLzCompressor::decompress(small.data(), smallLen, out.data(), len));
+        EXTEST_CHECK(!memcmp(out.data(), data.data(), len));
+      }
+
+      // Damaged data is rejected or decoded within the buffer, never overrun
+      if (packedLen > 4)
+      {
+        packed[rng() % packedLen] ^= (OdUInt8)(1 << (rng() % 8));
+        ExLzCompressor::decompress(packed.data(), packedLen, out.data(), len);
+      }
+    }
+  }
+}
+
+static void testPageStore(const OdString& path)
+{
+  ExPageStorePtr pStore = OdRxObjectImpl<ExPageStore>::createObject();
+  EXTEST_CHECK(pStore->open(path));
+  if (!pStore->fileSize())
+    return;
+
+  std::mt19937 rng(2);
+  std::map<ExPageStore::Key, std::pair<Bytes, OdUInt8> > pages;
+  for (int i = 0; i < 5000; ++i)
+  {
+    if (pages.empty() || rng() % 3)
+    {
+      OdUInt32 len = rng() % 10 ? rng() % 3000 : rng() % 200000;
+      OdUInt8 tag = (OdUInt8)(rng() % 4);
+      ExPageStore::Key key;
+      OdUInt8* pData = pStore->allocate(len, key, tag);
+      EXTEST_CHECK(pData != NULL);
+      EXTEST_CHECK(!pages.count(key));
+      if (!pData)
+        continue;
+      Bytes data = makeData(rng, len, 0);
+      if (len)
+        memcpy(pData, data.data(), len);
+      pages[key] = std::make_pair(data, tag);
+      continue;
+    }
+
+    std::map<ExPageStore::Key, std::pair<Bytes, OdUInt8> >::iterator it = pages.begin();
+    std::advance(it, rng() % pages.size());
+    const Bytes& data = it->second.first;
+    OdUInt32 len = 0;
+    OdUInt8 tag = 0xFF;
+    const OdUInt8* pData = pStore->data(it->first, len, tag);
+    EXTEST_CHECK(pData && len == data.size() && tag == it->second.second);
+    EXTEST_CHECK(ExPageStore::blockCapacity(len) >= len);
+    if (rng() % 2)
+    {
+      // Reading frees the page once the stream is released
+      OdStreamBufPtr pStream = pStore->read(it->first);
+      EXTEST_CHECK(!pStream.isNull() && pStream->length() == data.size());
+      if (!pStream.isNull() && pStream->length() == data.size() && !data.empty())
+      {
+        Bytes out(data.size());
+        pStream->getBytes(out.data(), (OdUInt32)out.size());
+        EXTEST_CHECK(out == data);
+      }
+    }
+    else
+      pStore->free(it->first);
+    EXTEST_CHECK(pStore->read(it->first).isNull());
+    pages.erase(it);
+  }
+
+  std::map<ExPageStore::Key, std::pair<Bytes, OdUInt8> >::iterator it;
+  for (it = pages.begin(); it != pages.end(); ++it)
+    pStore->free(it->first);
+  EXTEST_CHECK(pStore->usedBytes() == 0);
+
+  // Freed buddies are merged, so a whole segment fits without growing the file
+  OdUInt64 fileSize = pStore->fileSize();
+  ExPageStore::Key key;
+  EXTEST_CHECK(pStore->allocate((1 << EXPAGESTORE_SEGMENT_ORDER) - 8, key) != NULL);
+  EXTEST_CHECK(pStore->fileSize() == fileSize);
+  pStore->free(key);
+  pStore->free(key);
+  EXTEST_CHECK(pStore->usedBytes() == 0);
+}
+
+namespace
+{
+  class TestUndoController : public ExUndoController
+  {
+  public:
+    TestUndoController() {}
+  };
+}
+
+static void testUndoController(bool bDeltaMode)
+{
+  OdSmartPtr<TestUndoController> pUndo = OdRxObjectImpl<TestUndoController>::createObject();
+  const OdUInt32 maxSteps = 50;
+  const OdUInt32 maxMemory = 0x100000;
+  pUndo->setLimits(maxSteps, maxMemory);
+  pUndo->setDeltaMode(bDeltaMode);
+
+  // Each record is the previous one with a few bytes changed and a new length,
+  // large ones make the arena grow and wrap
+  std::mt19937 rng(3);
+  std::vector<std::pair<OdUInt32, Bytes> > records;
+  Bytes data;
+  for (int i = 0; i < 400; ++i)
+  {
+    OdUInt32 len = rng() % 20 ? rng() % 2000 : rng() % 60000;
+    if (data.empty())
+      data = makeData(rng, len, 2);
+    data.resize(len, (OdUInt8)i);
+    for (OdUInt32 j = 0; len && j < 10; ++j)
+      data[rng() % len] = (OdUInt8)rng();
+
+    OdMemoryStreamPtr pStream = OdMemoryStream::createNew();
+    if (len)
+      pStream->putBytes(data.data(), len);
+    pStream->rewind();
+    OdUInt32 opt = rng();
+    pUndo->pushData(pStream, len, opt);
+    records.push_back(std::make_pair(opt, data));
+
+    ExUndoController::MemoryStats stats = pUndo->memoryStats();
+    EXTEST_CHECK(stats.m_records <= maxSteps && stats.m_memoryUsed <= maxMemory);
+    EXTEST_CHECK(stats.m_records <= records.size());
+    if (stats.m_records < records.size())
+      records.erase(records.begin(), records.end() - stats.m_records);
+
+    // Pop one now and then, the newest record must come back
+    if (rng() % 5 == 0)
+    {
+      OdMemoryStreamPtr pOut = OdMemoryStream::createNew();
+      EXTEST_CHECK(pUndo->popData(pOut) == records.back().first);
+      EXTEST_CHECK(pOut->length() == records.back().second.size());
+      records.pop_back();
+      data = records.empty() ? Bytes() : records.back().second;
+    }
+  }
+  if (bDeltaMode)
+    EXTEST_CHECK(pUndo->memoryStats().m_deltaRecords > 0);
+
+  // The remaining records come back newest first
+  while (pUndo->hasData())
+  {
+    EXTEST_CHECK(!records.empty());
+    if (records.empty())
+      break;
+    OdMemoryStreamPtr pOut = OdMemoryStream::createNew();
+    OdUInt32 opt = pUndo->popData(pOut);
+    EXTEST_CHECK(opt == records.back().first);
+    const Bytes& expected = records.back().second;
+    Bytes out((size_t)pOut->length());
+    pOut->rewind();
+    if (!out.empty())
+      pOut->getBytes(out.data(), (OdUInt32)out.size());
+    EXTEST_CHECK(out == expected);
+    records.pop_back();
+  }
+  EXTEST_CHECK(records.empty());
+  EXTEST_CHECK(pUndo->memoryStats().m_memoryUsed == 0);
+}
+
+int main(int argc, char* argv[])
+{
+  testLzCompressor();
+  testPageStore(OdString(argc > 1 ? argv[1] : "ExServicesTests.pag"));
+  testUndoController(false);
+  testUndoController(true);
+
+  printf(s_nFailed ? "%d checks failed\n" : "All checks passed\n", s_nFailed);
+  return s_nFailed;
+}